@@ -22,12 +22,12 @@ project "App"
        defines { "WINDOWS" }
 
    filter "configurations:Debug"
-       defines { "DEBUG" }
+       defines { "DEBUG", "COMPOSIA_INSTRUMENTATION" }
        runtime "Debug"
        symbols "On"
 
    filter "configurations:Release"
-       defines { "RELEASE" }
+       defines { "RELEASE", "COMPOSIA_INSTRUMENTATION" }
        runtime "Release"
        optimize "On"
        symbols "On"
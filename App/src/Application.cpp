@@ -6,10 +6,11 @@
 #include <chrono>
 #include <cstdint>
 #include <cstddef>
+#include <sstream>
 
 using namespace Composia;
 
-void Benchmark();
+void PrintMemoryStats(const Registry& registry);
 
 struct Position
 {
@@ -50,52 +51,39 @@ void Application::Start()
         std::cout << "Has ent2 Velocity after destroyed? : " << reg.Has<Velocity>(ent2) << "\n";
     }
 
-    Benchmark();
+    // Benchmarks live in the Benchmarks project
+    Registry world;
+    for (int i = 0; i < 100000; ++i)
+    {
+        Entity e = world.Create();
+        world.Emplace<Position>(e, float(i), 0.f);
+        if (i % 4 == 0)
+            world.Emplace<Velocity>(e, 1.f, 1.f);
+    }
+    PrintMemoryStats(world);
 }
 
-void Benchmark()
+void PrintMemoryStats(const Registry& registry)
 {
-    std::cout << "\n-----------------Benchmark------------------\n";
+    std::cout << "\n-----------------Memory Stats-----------------\n";
 
     using Clock = std::chrono::high_resolution_clock;
-    Registry registry;
+    auto start = Clock::now();
+    MemoryReport report = registry.MemoryStats();
+    double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
 
-    constexpr int entityCount = 100000;
+    auto kib = [](const ArrayMemory& memory) {
+        std::ostringstream text;
+        text << memory.used / 1024 << "/" << memory.reserved / 1024 << " KiB";
+        return text.str();
+    };
 
-    // Entity create benchmark
-    auto start = Clock::now();
-    for (int i = 0; i < entityCount; ++i)
-        registry.Create();
-    auto end = Clock::now();
-    std::cout << "Create " << entityCount << " entities: "
-        << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
-
-    // Emplace components benchmark
-    Composia::Core::DynamicArray<Entity> entities;
-    entities.Reserve(entityCount);
-    for (int i = 0; i < entityCount; ++i)
-        entities.PushBack(registry.Create());
-
-    start = Clock::now();
-    for (auto e : entities)
-        registry.Emplace<Position>(e, 0.f, 0.f);
-    end = Clock::now();
-    std::cout << "Emplace Position: "
-        << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
-
-    start = Clock::now();
-    for (auto e : entities)
-        registry.Emplace<Velocity>(e, 1.f, 1.f);
-    end = Clock::now();
-    std::cout << "Emplace Velocity: "
-        << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
-
-
-    // Entity destroy benchmark
-    start = Clock::now();
-    for (auto e : entities)
-        registry.Destroy(e);
-    end = Clock::now();
-    std::cout << "Destroy " << entityCount << " entities: "
-        << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
-}
\ No newline at end of file
+    for (const PoolMemory& pool : report.pools)
+    {
+        std::cout << pool.typeName << " (" << pool.count << "): dense " << kib(pool.dense)
+            << ", packed " << kib(pool.packed) << ", sparse " << kib(pool.sparse) << "\n";
+    }
+    std::cout << "Entities: " << report.entities.alive << " alive, " << report.entities.freeListLength
+        << " free, " << kib(report.entities.Total()) << "\n";
+    std::cout << "Total: " << kib(report.Total()) << " (collected in " << us << " us)\n";
+}
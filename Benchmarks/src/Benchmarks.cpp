@@ -0,0 +1,528 @@
+#include "Harness.h"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "Composia.h"
+
+using namespace Composia;
+
+namespace {
+
+struct Position { float x, y; };
+struct Velocity { float x, y; };
+struct Health { float value, max; };
+struct Mass { float value, inverse; };
+
+float Value(const Position& position) { return position.x; }
+float Value(const Velocity& velocity) { return velocity.x; }
+float Value(const Health& health) { return health.value; }
+float Value(const Mass& mass) { return mass.value; }
+
+// Same shuffle on every run so random access patterns are comparable between runs
+std::vector<Entity> Shuffled(size_t count)
+{
+    std::vector<Entity> entities(count);
+    std::iota(entities.begin(), entities.end(), Entity(0));
+    std::shuffle(entities.begin(), entities.end(), std::mt19937(1234));
+    return entities;
+}
+
+template<typename RegistryType>
+void Populate(RegistryType& registry, size_t count, int components)
+{
+    registry = RegistryType();
+    for (size_t i = 0; i < count; ++i)
+    {
+        Entity e = registry.Create();
+        if (components > 0) registry.template Emplace<Position>(e, float(i), 0.f);
+        if (components > 1) registry.template Emplace<Velocity>(e, 1.f, 1.f);
+        if (components > 2) registry.template Emplace<Health>(e, 100.f, 100.f);
+        if (components > 3) registry.template Emplace<Mass>(e, 1.f, 1.f);
+    }
+}
+
+void Create(BenchmarkRun& run)
+{
+    Registry registry;
+    run.Measure(
+        [&] { for (size_t i = 0; i < run.Entities(); ++i) registry.Create(); },
+        [&] { registry = Registry(); });
+}
+
+void Emplace(BenchmarkRun& run)
+{
+    Registry registry;
+    run.Measure(
+        [&] { for (Entity e = 0; e < run.Entities(); ++e) registry.Emplace<Position>(e, 0.f, 0.f); },
+        [&] { Populate(registry, run.Entities(), 0); });
+}
+
+// Adding a second component, which moves every row to another archetype with archetype storage
+template<typename RegistryType>
+void EmplaceSecond(BenchmarkRun& run)
+{
+    RegistryType registry;
+    run.Measure(
+        [&] { for (Entity e = 0; e < run.Entities(); ++e) registry.template Emplace<Velocity>(e, 0.f, 0.f); },
+        [&] { Populate(registry, run.Entities(), 1); });
+}
+
+void GetRandom(BenchmarkRun& run)
+{
+    Registry registry;
+    Populate(registry, run.Entities(), 1);
+    std::vector<Entity> order = Shuffled(run.Entities());
+
+    run.Measure([&] {
+        float sum = 0.f;
+        for (Entity e : order)
+            sum += registry.Get<Position>(e).x;
+        DoNotOptimize(sum);
+        });
+}
+
+void StorageGetRandom(BenchmarkRun& run)
+{
+    Registry registry;
+    Populate(registry, run.Entities(), 1);
+    std::vector<Entity> order = Shuffled(run.Entities());
+    StorageHandle<Position> positions = registry.Storage<Position>();
+
+    run.Measure([&] {
+        float sum = 0.f;
+        for (Entity e : order)
+            sum += positions.Get(e).x;
+        DoNotOptimize(sum);
+        });
+}
+
+// Same lookups as GetRandom, batched so the prefetches overlap the misses
+void GetManyRandom(BenchmarkRun& run)
+{
+    Registry registry;
+    Populate(registry, run.Entities(), 1);
+    std::vector<Entity> order = Shuffled(run.Entities());
+    StorageHandle<Position> positions = registry.Storage<Position>();
+
+    constexpr size_t BATCH = 256;
+    std::vector<Position*> found(BATCH);
+    run.Measure([&] {
+        float sum = 0.f;
+        for (size_t first = 0; first < order.size(); first += BATCH)
+        {
+            size_t count = std::min(BATCH, order.size() - first);
+            positions.GetMany(order.data() + first, count, found.data());
+            for (size_t i = 0; i < count; ++i)
+                sum += found[i]->x;
+        }
+        DoNotOptimize(sum);
+        });
+}
+
+void RemoveRandom(BenchmarkRun& run)
+{
+    Registry registry;
+    std::vector<Entity> order = Shuffled(run.Entities());
+    run.Measure(
+        [&] { for (Entity e : order) registry.Remove<Position>(e); },
+        [&] { Populate(registry, run.Entities(), 1); });
+}
+
+void Destroy(BenchmarkRun& run)
+{
+    Registry registry;
+    run.Measure(
+        [&] { for (Entity e = 0; e < run.Entities(); ++e) registry.Destroy(e); },
+        [&] { Populate(registry, run.Entities(), 2); });
+}
+
+template<typename RegistryType, typename... Components>
+void ViewEach(BenchmarkRun& run)
+{
+    RegistryType registry;
+    Populate(registry, run.Entities(), int(sizeof...(Components)));
+
+    run.Measure([&] {
+        float sum = 0.f;
+        registry.template View<Components...>().each([&](Components&... components) {
+            ((sum += Value(components)), ...);
+            });
+        DoNotOptimize(sum);
+        });
+}
+
+// Every pool filled in its own random order, as after long churn, so the view reads each pool's
+// sparse and dense slots at random addresses. Passes with and without prefetching alternate and
+// prefetchSpeedup is the median ratio of neighbouring passes, which holds up on noisy machines
+// where separate runs drift apart by more than the difference.
+constexpr size_t SHUFFLED_PAIRS = 10;
+
+double ViewPass(Registry& registry, bool prefetch)
+{
+    auto start = std::chrono::steady_clock::now();
+    float sum = 0.f;
+    auto view = registry.View<Position, Velocity>();
+    if (!prefetch)
+        view.PrefetchDistance(0);
+    view.each([&](Position& position, Velocity& velocity) {
+        sum += position.x + velocity.x;
+        });
+    DoNotOptimize(sum);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ViewShuffled(BenchmarkRun& run)
+{
+    Registry registry;
+    for (size_t i = 0; i < run.Entities(); ++i)
+        registry.Create();
+
+    std::vector<Entity> order = Shuffled(run.Entities());
+    for (Entity e : order)
+        registry.Emplace<Position>(e, float(e), 0.f);
+    std::shuffle(order.begin(), order.end(), std::mt19937(5678));
+    for (Entity e : order)
+        registry.Emplace<Velocity>(e, 1.f, 1.f);
+
+    ViewPass(registry, false);
+    std::vector<double> plain;
+    std::vector<double> ratios;
+    for (size_t i = 0; i < SHUFFLED_PAIRS; ++i)
+    {
+        double withoutPrefetch = ViewPass(registry, false);
+        double withPrefetch = run.Sample([&] { ViewPass(registry, true); return run.Entities(); });
+        plain.push_back(withoutPrefetch);
+        ratios.push_back(withoutPrefetch / withPrefetch);
+    }
+
+    std::sort(plain.begin(), plain.end());
+    std::sort(ratios.begin(), ratios.end());
+    run.Metric("noPrefetchMedianMs", plain[plain.size() / 2] * 1e-6);
+    run.Metric("prefetchSpeedup", ratios[ratios.size() / 2]);
+}
+
+// ViewShuffled's pools next to an ArchetypeRegistry holding the same entities, passes over the two
+// alternating. Rows of one archetype are contiguous whatever order they were added in, so
+// archetypeSpeedup is what archetype storage gains once the pools have been shuffled by churn.
+void ArchetypeViewShuffled(BenchmarkRun& run)
+{
+    Registry registry;
+    ArchetypeRegistry archetypes;
+    for (size_t i = 0; i < run.Entities(); ++i)
+    {
+        registry.Create();
+        archetypes.Create();
+    }
+
+    std::vector<Entity> order = Shuffled(run.Entities());
+    for (Entity e : order)
+    {
+        registry.Emplace<Position>(e, float(e), 0.f);
+        archetypes.Emplace<Position>(e, float(e), 0.f);
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(5678));
+    for (Entity e : order)
+    {
+        registry.Emplace<Velocity>(e, 1.f, 1.f);
+        archetypes.Emplace<Velocity>(e, 1.f, 1.f);
+    }
+
+    auto archetypePass = [&] {
+        auto start = std::chrono::steady_clock::now();
+        float sum = 0.f;
+        archetypes.View<Position, Velocity>().each([&](Position& position, Velocity& velocity) {
+            sum += position.x + velocity.x;
+            });
+        DoNotOptimize(sum);
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        };
+
+    archetypePass();
+    std::vector<double> ratios;
+    for (size_t i = 0; i < SHUFFLED_PAIRS; ++i)
+    {
+        double pools = ViewPass(registry, true);
+        double rows = run.Sample([&] { archetypePass(); return run.Entities(); });
+        ratios.push_back(pools / rows);
+    }
+
+    std::sort(ratios.begin(), ratios.end());
+    run.Metric("archetypeSpeedup", ratios[ratios.size() / 2]);
+}
+
+// Eight components, each but the first owned by 90% of the entities, so fewer than half match
+// and the view spends its time on membership tests
+template<int N>
+struct Trait { float value; };
+
+template<int... N>
+void ViewTraits(BenchmarkRun& run)
+{
+    Registry registry;
+    std::mt19937 random(42);
+    std::bernoulli_distribution owns(0.9);
+    for (size_t i = 0; i < run.Entities(); ++i)
+    {
+        Entity e = registry.Create();
+        ((N == 0 || owns(random) ? (void)registry.Emplace<Trait<N>>(e, 1.f) : (void)0), ...);
+    }
+
+    run.Measure([&] {
+        float sum = 0.f;
+        registry.View<Trait<N>...>().each([&](Trait<N>&... traits) { ((sum += traits.value), ...); });
+        DoNotOptimize(sum);
+        });
+}
+
+// HasBatch over a shuffled batch, the dispatched kernel paired with the scalar one as in
+// ViewShuffled. avx2Speedup stays at 1 on CPUs without AVX2.
+void HasBatch(BenchmarkRun& run)
+{
+    Core::SparseSet<void> set;
+    std::vector<Entity> order = Shuffled(run.Entities());
+    for (size_t i = 0; i < order.size(); i += 2)
+        set.Add(order[i]);
+    std::shuffle(order.begin(), order.end(), std::mt19937(5678));
+    std::vector<uint64_t> mask((order.size() + 63) / 64);
+
+    auto pass = [&](auto kernel) {
+        auto start = std::chrono::steady_clock::now();
+        kernel(set.RawSparse().Data(), set.RawSparse().Size(), set.Size(), order.data(), order.size(), mask.data());
+        DoNotOptimize(mask[0]);
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        };
+
+    pass(Core::SparseHasBatch);
+    std::vector<double> ratios;
+    for (size_t i = 0; i < SHUFFLED_PAIRS; ++i)
+    {
+        double scalar = pass(Core::SparseHasBatchScalar);
+        double dispatched = run.Sample([&] { pass(Core::SparseHasBatch); return run.Entities(); });
+        ratios.push_back(scalar / dispatched);
+    }
+
+    std::sort(ratios.begin(), ratios.end());
+    run.Metric("avx2", Core::CpuHasAvx2() ? 1.0 : 0.0);
+    run.Metric("avx2Speedup", ratios[ratios.size() / 2]);
+}
+
+// Positions sorted by a cell index, re-sorted after 1% of the entities moved to another cell,
+// which is what a per-frame sort sees
+template<typename SortFunc>
+void SortCells(BenchmarkRun& run, SortFunc sort)
+{
+    Registry registry;
+    Populate(registry, run.Entities(), 1);
+    for (Entity e = 0; e < run.Entities(); ++e)
+        registry.Get<Position>(e).y = float((e * 7919) % 4096);
+    sort(registry);
+
+    std::mt19937 random(99);
+    run.Measure(
+        [&] { sort(registry); },
+        [&] {
+            for (size_t i = 0; i < run.Entities() / 100; ++i)
+                registry.Get<Position>(Entity(random() % run.Entities())).y = float(random() % 4096);
+        });
+}
+
+void SortCompare(BenchmarkRun& run)
+{
+    SortCells(run, [](Registry& registry) {
+        registry.Sort<Position>([](const Position& a, const Position& b) { return a.y < b.y; });
+        });
+}
+
+void SortByKey(BenchmarkRun& run)
+{
+    SortCells(run, [](Registry& registry) {
+        registry.SortByKey<Position>([](const Position& p) { return uint32_t(p.y); });
+        });
+}
+
+// 2% of the world changes between diffs: moved entities plus a component swapped out or back in
+void DeltaDiff(BenchmarkRun& run)
+{
+    Registry registry;
+    Populate(registry, run.Entities(), 2);
+    DeltaBaseline baseline;
+    registry.Capture(baseline);
+
+    Delta delta;
+    size_t churn = run.Entities() / 50;
+    Entity next = 0;
+    auto change = [&] {
+        baseline.Advance(delta);
+        for (size_t i = 0; i < churn / 2; ++i)
+            registry.Get<Position>(Entity((next + i * 97) % run.Entities())).y += 1.f;
+        for (size_t i = 0; i < churn / 2; ++i)
+        {
+            Entity e = Entity((next + i * 89) % run.Entities());
+            if (registry.Has<Velocity>(e)) registry.Remove<Velocity>(e);
+            else registry.Emplace<Velocity>(e, 1.f, 1.f);
+        }
+        next += 7919;
+    };
+
+    run.Measure([&] { delta = registry.Diff(baseline); }, change);
+}
+
+void SnapshotSave(BenchmarkRun& run)
+{
+    Registry registry;
+    Populate(registry, run.Entities(), 2);
+    std::stringstream stream;
+
+    run.Measure(
+        [&] { registry.Save(stream); },
+        [&] { stream.str(std::string()); });
+}
+
+void Clone(BenchmarkRun& run)
+{
+    Registry registry;
+    Populate(registry, run.Entities(), 2);
+    Registry copy;
+
+    run.Measure(
+        [&] { copy = registry.Clone(); },
+        [&] { copy = Registry(); });
+}
+
+// Fork plus the first write, which copies the written pool
+void CloneShared(BenchmarkRun& run)
+{
+    Registry registry;
+    Populate(registry, run.Entities(), 2);
+    Registry fork;
+
+    run.Measure(
+        [&] {
+            fork = registry.CloneShared();
+            fork.Get<Position>(0).x = 1.f;
+        },
+        [&] { fork = Registry(); });
+}
+
+// Twice as many ids as live entities, the dead half scattered, renumbered in Position's order
+void Defragment(BenchmarkRun& run)
+{
+    Registry registry;
+    run.Measure(
+        [&] { DoNotOptimize(registry.Defragment<Position>()); },
+        [&] {
+            Populate(registry, run.Entities() * 2, 2);
+            std::vector<Entity> order = Shuffled(run.Entities() * 2);
+            for (size_t i = 0; i < run.Entities(); ++i)
+                registry.Destroy(order[i]);
+        });
+}
+
+// A random tenth of the world disabled and enabled again, e.g. objects leaving and entering range
+void DisableEnable(BenchmarkRun& run)
+{
+    Registry registry;
+    Populate(registry, run.Entities(), 2);
+    std::vector<Entity> order = Shuffled(run.Entities());
+    order.resize(std::max<size_t>(run.Entities() / 10, 1));
+
+    run.Measure(
+        [&] {
+            for (Entity e : order)
+                registry.Disable(e);
+            for (Entity e : order)
+                registry.Enable(e);
+        },
+        {}, order.size());
+}
+
+// One read of global state per entity: a cached resource handle against the singleton entity it replaces
+struct Settings { float gravity, drag; };
+
+void ResourceHandleAccess(BenchmarkRun& run)
+{
+    Registry registry;
+    registry.SetResource<Settings>(9.81f, 0.1f);
+    ResourceHandle<Settings> settings = registry.Resource<Settings>();
+
+    run.Measure([&] {
+        float sum = 0.f;
+        for (size_t i = 0; i < run.Entities(); ++i)
+        {
+            sum += settings->gravity;
+            DoNotOptimize(sum);
+        }
+        });
+}
+
+void SingletonEntityAccess(BenchmarkRun& run)
+{
+    Registry registry;
+    Entity global = registry.Create();
+    registry.Emplace<Settings>(global, 9.81f, 0.1f);
+
+    run.Measure([&] {
+        float sum = 0.f;
+        for (size_t i = 0; i < run.Entities(); ++i)
+        {
+            sum += registry.Get<Settings>(global).gravity;
+            DoNotOptimize(sum);
+        }
+        });
+}
+
+void TraceZone(BenchmarkRun& run)
+{
+    if constexpr (Core::Trace::Enabled)
+    {
+        run.Measure(
+            [&] {
+                for (size_t i = 0; i < run.Entities(); ++i)
+                {
+                    COMPOSIA_TRACE_ZONE("Empty zone");
+                }
+            },
+            [] { Core::Trace::Clear(); });
+    }
+}
+
+} // namespace
+
+void RegisterBenchmarks(Harness& harness)
+{
+    harness.Add("Create", Create);
+    harness.Add("Emplace", Emplace);
+    harness.Add("EmplaceSecond", EmplaceSecond<Registry>);
+    harness.Add("ArchetypeEmplaceSecond", EmplaceSecond<ArchetypeRegistry>);
+    harness.Add("GetRandom", GetRandom);
+    harness.Add("StorageGetRandom", StorageGetRandom);
+    harness.Add("GetManyRandom", GetManyRandom);
+    harness.Add("RemoveRandom", RemoveRandom);
+    harness.Add("Destroy", Destroy);
+    harness.Add("View1", ViewEach<Registry, Position>);
+    harness.Add("View2", ViewEach<Registry, Position, Velocity>);
+    harness.Add("View4", ViewEach<Registry, Position, Velocity, Health, Mass>);
+    harness.Add("View2Shuffled", ViewShuffled);
+    harness.Add("ArchetypeView1", ViewEach<ArchetypeRegistry, Position>);
+    harness.Add("ArchetypeView2", ViewEach<ArchetypeRegistry, Position, Velocity>);
+    harness.Add("ArchetypeView4", ViewEach<ArchetypeRegistry, Position, Velocity, Health, Mass>);
+    harness.Add("ArchetypeView2Shuffled", ArchetypeViewShuffled);
+    harness.Add("View8Traits", ViewTraits<0, 1, 2, 3, 4, 5, 6, 7>);
+    harness.Add("HasBatch", HasBatch);
+    harness.Add("SortCompare", SortCompare);
+    harness.Add("SortByKey", SortByKey);
+    harness.Add("DeltaDiff", DeltaDiff, 500000);
+    harness.Add("SnapshotSave", SnapshotSave, 500000);
+    harness.Add("Clone", Clone, 1000000);
+    harness.Add("CloneShared", CloneShared, 1000000);
+    harness.Add("Defragment", Defragment, 1000000);
+    harness.Add("DisableEnable", DisableEnable);
+    harness.Add("ResourceHandle", ResourceHandleAccess, 1000000);
+    harness.Add("SingletonEntity", SingletonEntityAccess, 1000000);
+    harness.Add("TraceZone", TraceZone, 1000000);
+    RegisterChurn(harness);
+}
@@ -0,0 +1,168 @@
+#include "Harness.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "Composia.h"
+
+using namespace Composia;
+
+namespace {
+
+struct Position { float x, y; };
+struct Velocity { float x, y; };
+struct Lifetime { float remaining; };
+
+// A long running world at a steady population where entities keep spawning and dying and gain or
+// lose components in random order, like projectiles and effects in a game. Each frame records the
+// time of one Position + Velocity pass, so later samples against earlier ones show what the churn
+// does to iteration. Every mutation is timed on its own for the worst case latency.
+constexpr size_t FRAMES = 600;
+constexpr size_t WINDOW = FRAMES / 10; // frames averaged for the first and last iteration figures
+
+class Churn
+{
+public:
+    explicit Churn(size_t population)
+        : m_PerFrame(std::max<size_t>(population / 200, 1))
+    {
+        m_Alive.reserve(population + m_PerFrame);
+        for (size_t i = 0; i < population; ++i)
+            Spawn();
+    }
+
+    void Frame()
+    {
+        for (size_t i = 0; i < m_PerFrame; ++i)
+            Timed(m_WorstDestroy, [&] { Kill(Pick()); });
+        for (size_t i = 0; i < m_PerFrame; ++i)
+            Timed(m_WorstCreate, [&] { Spawn(); });
+
+        // component churn on survivors, half of which toggle the iterated Velocity
+        for (size_t i = 0; i < m_PerFrame; ++i)
+        {
+            Entity e = m_Alive[Pick()];
+            if (i % 2 == 0)
+                Toggle<Velocity>(e);
+            else
+                Toggle<Lifetime>(e);
+        }
+    }
+
+    // Returns the number of entities visited
+    size_t Iterate()
+    {
+        float sum = 0.f;
+        size_t count = 0;
+        m_Registry.View<Position, Velocity>().each([&](Position& position, Velocity& velocity) {
+            position.x += velocity.x;
+            sum += position.x;
+            ++count;
+            });
+        DoNotOptimize(sum);
+        return count;
+    }
+
+    size_t ReservedBytes() { return m_Registry.MemoryStats().Total().reserved; }
+
+    double WorstCreate() const { return m_WorstCreate; }
+    double WorstDestroy() const { return m_WorstDestroy; }
+    double WorstEmplace() const { return m_WorstEmplace; }
+    double WorstRemove() const { return m_WorstRemove; }
+
+private:
+    template<typename F>
+    static void Timed(double& worst, F&& operation)
+    {
+        auto start = std::chrono::steady_clock::now();
+        operation();
+        worst = std::max(worst, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    template<typename T>
+    void Toggle(Entity e)
+    {
+        if (m_Registry.Has<T>(e))
+            Timed(m_WorstRemove, [&] { m_Registry.Remove<T>(e); });
+        else
+            Timed(m_WorstEmplace, [&] { m_Registry.Emplace<T>(e); });
+    }
+
+    void Spawn()
+    {
+        Entity e = m_Registry.Create();
+        m_Registry.Emplace<Position>(e, 0.f, 0.f);
+        if (m_Random() % 4 != 0)
+            m_Registry.Emplace<Velocity>(e, 1.f, 1.f);
+        if (m_Random() % 2 == 0)
+            m_Registry.Emplace<Lifetime>(e, 1.f);
+        m_Alive.push_back(e);
+    }
+
+    void Kill(size_t index)
+    {
+        m_Registry.Destroy(m_Alive[index]);
+        m_Alive[index] = m_Alive.back();
+        m_Alive.pop_back();
+    }
+
+    size_t Pick() { return m_Random() % m_Alive.size(); }
+
+    Registry m_Registry;
+    std::vector<Entity> m_Alive;
+    std::mt19937 m_Random{ 4321 };
+    size_t m_PerFrame;
+
+    double m_WorstCreate = 0.0;
+    double m_WorstDestroy = 0.0;
+    double m_WorstEmplace = 0.0;
+    double m_WorstRemove = 0.0;
+};
+
+double Average(const std::vector<double>& values, size_t first, size_t count)
+{
+    double sum = 0.0;
+    for (size_t i = first; i < first + count; ++i)
+        sum += values[i];
+    return sum / static_cast<double>(count);
+}
+
+void ChurnScenario(BenchmarkRun& run)
+{
+    Churn churn(run.Entities());
+    size_t initialBytes = churn.ReservedBytes();
+    size_t peakBytes = initialBytes;
+
+    // ns per iterated entity, in frame order
+    std::vector<double> frames;
+    frames.reserve(FRAMES);
+    for (size_t frame = 0; frame < FRAMES; ++frame)
+    {
+        churn.Frame();
+        size_t iterated = 0;
+        double ns = run.Sample([&] { return iterated = churn.Iterate(); });
+        frames.push_back(ns / static_cast<double>(iterated));
+        peakBytes = std::max(peakBytes, churn.ReservedBytes());
+    }
+
+    double first = Average(frames, 0, WINDOW);
+    double last = Average(frames, FRAMES - WINDOW, WINDOW);
+    run.Metric("firstNsPerEntity", first);
+    run.Metric("lastNsPerEntity", last);
+    run.Metric("iterationSlowdown", last / first);
+    run.Metric("initialBytes", static_cast<double>(initialBytes));
+    run.Metric("peakBytes", static_cast<double>(peakBytes));
+    run.Metric("steadyBytes", static_cast<double>(churn.ReservedBytes()));
+    run.Metric("worstCreateNs", churn.WorstCreate());
+    run.Metric("worstDestroyNs", churn.WorstDestroy());
+    run.Metric("worstEmplaceNs", churn.WorstEmplace());
+    run.Metric("worstRemoveNs", churn.WorstRemove());
+}
+
+} // namespace
+
+void RegisterChurn(Harness& harness)
+{
+    harness.Add("Churn", ChurnScenario, 200000);
+}
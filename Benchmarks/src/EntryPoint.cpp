@@ -0,0 +1,118 @@
+#include "Harness.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+void PrintUsage()
+{
+    std::cout <<
+        "Usage: Benchmarks [options]\n"
+        "  --filter <text>        run benchmarks whose name contains text\n"
+        "  --sizes <n,n,...>      entity counts to scale over (default 1000,...,10000000)\n"
+        "  --warmup <n>           untimed iterations per case (default 1)\n"
+        "  --iterations <min,max> timed iterations per case (default 3,20)\n"
+        "  --max-time <seconds>   stop adding iterations past min once a case measured this long (default 1)\n"
+        "  --pin <cpu>            pin the benchmark thread to one cpu\n"
+        "  --perf                 report cycles, instructions, cache and branch misses per item (Linux)\n"
+        "  --json <path>          write results as JSON, '-' for stdout\n";
+}
+
+std::vector<size_t> ParseList(const char* text)
+{
+    std::vector<size_t> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ','))
+        values.push_back(static_cast<size_t>(std::strtod(item.c_str(), nullptr)));
+    return values;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    HarnessOptions options;
+    const char* jsonPath = nullptr;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (std::strcmp(arg, "--help") == 0)
+        {
+            PrintUsage();
+            return 0;
+        }
+        if (std::strcmp(arg, "--perf") == 0)
+        {
+            options.perf = true;
+            continue;
+        }
+        if (!value)
+        {
+            std::cerr << "Missing value for " << arg << "\n";
+            return 1;
+        }
+        ++i;
+
+        if (std::strcmp(arg, "--filter") == 0)
+            options.filter = value;
+        else if (std::strcmp(arg, "--sizes") == 0)
+            options.sizes = ParseList(value);
+        else if (std::strcmp(arg, "--warmup") == 0)
+            options.warmup = static_cast<size_t>(std::atoi(value));
+        else if (std::strcmp(arg, "--iterations") == 0)
+        {
+            std::vector<size_t> range = ParseList(value);
+            options.minIterations = std::max<size_t>(range.front(), 1);
+            options.maxIterations = std::max(range.back(), options.minIterations);
+        }
+        else if (std::strcmp(arg, "--max-time") == 0)
+            options.maxSeconds = std::atof(value);
+        else if (std::strcmp(arg, "--pin") == 0)
+            options.pinCpu = std::atoi(value);
+        else if (std::strcmp(arg, "--json") == 0)
+            jsonPath = value;
+        else
+        {
+            std::cerr << "Unknown option " << arg << "\n";
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (options.pinCpu >= 0 && !PinThread(options.pinCpu))
+    {
+        std::cerr << "Could not pin to cpu " << options.pinCpu << ", running unpinned\n";
+        options.pinCpu = -1;
+    }
+
+    Harness harness;
+    RegisterBenchmarks(harness);
+
+    bool jsonToStdout = jsonPath && std::strcmp(jsonPath, "-") == 0;
+    harness.Run(options, jsonToStdout ? std::cerr : std::cout);
+
+    if (jsonToStdout)
+    {
+        harness.WriteJson(std::cout, options);
+    }
+    else if (jsonPath)
+    {
+        std::ofstream file(jsonPath);
+        harness.WriteJson(file, options);
+        if (!file.good())
+        {
+            std::cerr << "Could not write " << jsonPath << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,219 @@
+#include "Harness.h"
+
+#include <cmath>
+#include <iomanip>
+#include <numeric>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+#include "Composia.h"
+
+double BenchmarkResult::Mean() const
+{
+    return std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size());
+}
+
+// Nearest rank, so p99 of fewer than 100 samples is the slowest one
+double BenchmarkResult::Percentile(double fraction) const
+{
+    size_t rank = static_cast<size_t>(std::ceil(fraction * static_cast<double>(samples.size())));
+    return samples[std::min(samples.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+template<typename Body>
+double BenchmarkRun::Time(Body&& body)
+{
+    using Clock = std::chrono::steady_clock;
+
+    // counters stay outside the timed span, their ioctls cost microseconds
+    if (m_Counters)
+        m_Counters->Start();
+    auto start = Clock::now();
+    body();
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    if (m_Counters)
+        m_Counters->Stop();
+    return ns;
+}
+
+void BenchmarkRun::Measure(const std::function<void()>& body, const std::function<void()>& setup, size_t items)
+{
+    m_Result.items = items != 0 ? items : m_Result.entities;
+
+    double measured = 0.0;
+    for (size_t i = 0; i < m_Options.warmup + m_Options.maxIterations; ++i)
+    {
+        bool warmup = i < m_Options.warmup;
+        if (!warmup && m_Result.samples.size() >= m_Options.minIterations && measured >= m_Options.maxSeconds)
+            break;
+
+        if (setup)
+            setup();
+
+        if (warmup)
+        {
+            body();
+            continue;
+        }
+
+        double ns = Time(body);
+        m_Result.samples.push_back(ns);
+        measured += ns * 1e-9;
+    }
+}
+
+double BenchmarkRun::Sample(const std::function<size_t()>& body)
+{
+    size_t items = 0;
+    double ns = Time([&] { items = body(); });
+    m_Result.items = items;
+    m_Result.samples.push_back(ns);
+    return ns;
+}
+
+void BenchmarkRun::Metric(std::string name, double value)
+{
+    m_Result.metrics.emplace_back(std::move(name), value);
+}
+
+void Harness::Add(std::string name, BenchmarkFunc func, size_t fixedEntities)
+{
+    m_Benchmarks.push_back(Benchmark{ std::move(name), std::move(func), fixedEntities });
+}
+
+namespace {
+
+// Counter totals over all timed iterations, per item of one iteration
+void AddPerfMetrics(BenchmarkResult& result, const PerfValues& values)
+{
+    double items = static_cast<double>(result.samples.size()) * static_cast<double>(result.items);
+    for (size_t i = 0; i < PERF_EVENT_COUNT; ++i)
+    {
+        PerfEvent event = static_cast<PerfEvent>(i);
+        if (values.Valid(event))
+            result.metrics.emplace_back(std::string(PerfValues::Name(event)) + "PerItem", static_cast<double>(values[event]) / items);
+    }
+    if (values.Valid(PerfEvent::Cycles) && values.Valid(PerfEvent::Instructions) && values[PerfEvent::Cycles] != 0)
+        result.metrics.emplace_back("ipc", static_cast<double>(values[PerfEvent::Instructions]) / static_cast<double>(values[PerfEvent::Cycles]));
+}
+
+} // namespace
+
+size_t Harness::Run(const HarnessOptions& options, std::ostream& log)
+{
+    m_Results.clear();
+
+    PerfCounters counters;
+    PerfCounters* perf = nullptr;
+    if (options.perf)
+    {
+        std::string error;
+        if (counters.Open(error))
+            perf = &counters;
+        if (!error.empty())
+            log << "perf: " << error << "\n";
+    }
+
+    log << std::left << std::setw(28) << "Benchmark" << std::right << std::setw(10) << "Entities"
+        << std::setw(8) << "Iters" << std::setw(14) << "Median ms" << std::setw(14) << "P99 ms"
+        << std::setw(14) << "ns/item" << "\n";
+
+    for (const Benchmark& benchmark : m_Benchmarks)
+    {
+        if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos)
+            continue;
+
+        std::vector<size_t> sizes = options.sizes;
+        if (benchmark.fixedEntities != 0)
+            sizes = { benchmark.fixedEntities };
+
+        for (size_t entities : sizes)
+        {
+            BenchmarkResult result;
+            result.name = benchmark.name;
+            result.entities = entities;
+
+            if (perf)
+                perf->Reset();
+            BenchmarkRun run(options, result, perf);
+            benchmark.func(run);
+            if (result.samples.empty())
+                continue;
+            std::sort(result.samples.begin(), result.samples.end());
+            if (perf)
+                AddPerfMetrics(result, perf->Read());
+
+            log << std::left << std::setw(28) << result.name << std::right << std::setw(10) << result.entities
+                << std::setw(8) << result.samples.size() << std::fixed << std::setprecision(3)
+                << std::setw(14) << result.Median() * 1e-6 << std::setw(14) << result.P99() * 1e-6
+                << std::setw(14) << result.Median() / static_cast<double>(result.items) << "\n" << std::defaultfloat;
+            for (const auto& [name, value] : result.metrics)
+                log << "    " << name << ": " << std::setprecision(6) << value << "\n";
+            m_Results.push_back(std::move(result));
+        }
+    }
+    return m_Results.size();
+}
+
+void Harness::WriteJson(std::ostream& stream, const HarnessOptions& options) const
+{
+#if defined(DEBUG)
+    const char* config = "Debug";
+#elif defined(RELEASE)
+    const char* config = "Release";
+#elif defined(DIST)
+    const char* config = "Dist";
+#else
+    const char* config = "Unknown";
+#endif
+
+    stream << "{\n  \"context\": {\"config\": \"" << config << "\", \"instrumentation\": "
+        << (Composia::Core::Instrumentation::Enabled ? "true" : "false") << ", \"pinnedCpu\": " << options.pinCpu
+        << ", \"warmup\": " << options.warmup << ", \"maxIterations\": " << options.maxIterations << "},\n";
+    stream << "  \"benchmarks\": [";
+
+    stream << std::setprecision(10);
+    for (size_t i = 0; i < m_Results.size(); ++i)
+    {
+        const BenchmarkResult& result = m_Results[i];
+        stream << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << result.name << "\", \"entities\": " << result.entities
+            << ", \"items\": " << result.items << ", \"iterations\": " << result.samples.size()
+            << ", \"medianNs\": " << result.Median() << ", \"p99Ns\": " << result.P99()
+            << ", \"minNs\": " << result.Min() << ", \"meanNs\": " << result.Mean()
+            << ", \"nsPerItem\": " << result.Median() / static_cast<double>(result.items);
+        if (!result.metrics.empty())
+        {
+            stream << ", \"metrics\": {";
+            for (size_t m = 0; m < result.metrics.size(); ++m)
+                stream << (m == 0 ? "" : ", ") << "\"" << result.metrics[m].first << "\": " << result.metrics[m].second;
+            stream << "}";
+        }
+        stream << "}";
+    }
+    stream << "\n  ]\n}\n";
+}
+
+bool PinThread(int cpu)
+{
+#if defined(_WIN32)
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
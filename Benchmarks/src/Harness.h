@@ -0,0 +1,113 @@
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "PerfCounters.h"
+
+// Keeps the optimizer from dropping a computed value
+template<typename T>
+inline void DoNotOptimize(const T& value)
+{
+#if defined(_MSC_VER)
+    static volatile const void* sink;
+    sink = &value;
+#else
+    asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+struct HarnessOptions
+{
+    std::vector<size_t> sizes = { 1000, 10000, 100000, 1000000, 10000000 };
+    std::string filter;
+    size_t warmup = 1;
+    size_t minIterations = 3;
+    size_t maxIterations = 20;
+    double maxSeconds = 1.0; // measured time per case after which no more iterations start
+    int pinCpu = -1;
+    bool perf = false; // hardware counters around every timed iteration, see PerfCounters
+};
+
+struct BenchmarkResult
+{
+    std::string name;
+    size_t entities = 0;
+    size_t items = 0;
+    std::vector<double> samples; // ns per iteration, sorted
+    std::vector<std::pair<std::string, double>> metrics; // scenario specific figures
+
+    double Median() const { return Percentile(0.5); }
+    double P99() const { return Percentile(0.99); }
+    double Min() const { return samples.front(); }
+    double Mean() const;
+    double Percentile(double fraction) const;
+};
+
+// Handed to every benchmark once per entity count. A benchmark builds what all iterations share,
+// then calls Measure, which runs setup untimed before every timed body.
+class BenchmarkRun
+{
+public:
+    BenchmarkRun(const HarnessOptions& options, BenchmarkResult& result, PerfCounters* counters = nullptr)
+        : m_Options(options), m_Result(result), m_Counters(counters) {}
+
+    size_t Entities() const { return m_Result.entities; }
+
+    // items is what ns/item is reported against, by default the entity count
+    void Measure(const std::function<void()>& body, const std::function<void()>& setup = {}, size_t items = 0);
+
+    // For scenarios that decide themselves when to sample instead of calling Measure: times one
+    // run of body, which returns the items it processed, and returns its ns
+    double Sample(const std::function<size_t()>& body);
+    void Metric(std::string name, double value);
+
+private:
+    // One timed run of body, inside the perf counters when there are any
+    template<typename Body>
+    double Time(Body&& body);
+
+    const HarnessOptions& m_Options;
+    BenchmarkResult& m_Result;
+    PerfCounters* m_Counters;
+};
+
+class Harness
+{
+public:
+    using BenchmarkFunc = std::function<void(BenchmarkRun&)>;
+
+    // fixedEntities runs the benchmark at that count only instead of at every size
+    void Add(std::string name, BenchmarkFunc func, size_t fixedEntities = 0);
+
+    // Returns the number of cases that ran
+    size_t Run(const HarnessOptions& options, std::ostream& log);
+
+    void WriteJson(std::ostream& stream, const HarnessOptions& options) const;
+
+private:
+    struct Benchmark
+    {
+        std::string name;
+        BenchmarkFunc func;
+        size_t fixedEntities;
+    };
+
+    std::vector<Benchmark> m_Benchmarks;
+    std::vector<BenchmarkResult> m_Results;
+};
+
+// Pins the calling thread to one cpu, returns false where that is not possible
+bool PinThread(int cpu);
+
+void RegisterBenchmarks(Harness& harness);
+void RegisterChurn(Harness& harness);
+
+#endif // !HARNESS_H
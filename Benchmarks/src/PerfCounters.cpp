@@ -0,0 +1,174 @@
+#include "PerfCounters.h"
+
+#include <cerrno>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char* PerfValues::Name(PerfEvent event)
+{
+    constexpr const char* names[PERF_EVENT_COUNT] = {
+        "cycles", "instructions", "l1Misses", "llcMisses", "branchMisses", "pageFaults"
+    };
+    return names[static_cast<size_t>(event)];
+}
+
+#if defined(__linux__)
+
+namespace {
+
+struct EventConfig
+{
+    uint32_t type;
+    uint64_t config;
+};
+
+constexpr uint64_t CacheConfig(uint64_t cache, uint64_t op, uint64_t result)
+{
+    return cache | (op << 8) | (result << 16);
+}
+
+constexpr EventConfig EVENT_CONFIGS[PERF_EVENT_COUNT] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HW_CACHE, CacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+};
+
+// Matches read_format below
+struct ReadFormat
+{
+    uint64_t value;
+    uint64_t timeEnabled;
+    uint64_t timeRunning;
+};
+
+} // namespace
+
+PerfCounters::~PerfCounters()
+{
+    for (int fd : m_Fds)
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+}
+
+bool PerfCounters::Open(std::string& error)
+{
+    bool any = false;
+    bool anyHardware = false;
+    int hardwareErrno = 0;
+    for (size_t i = 0; i < PERF_EVENT_COUNT; ++i)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = EVENT_CONFIGS[i].type;
+        attr.config = EVENT_CONFIGS[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        m_Fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        if (m_Fds[i] >= 0)
+        {
+            any = true;
+            anyHardware |= EVENT_CONFIGS[i].type != PERF_TYPE_SOFTWARE;
+        }
+        else if (EVENT_CONFIGS[i].type != PERF_TYPE_SOFTWARE)
+        {
+            hardwareErrno = errno;
+        }
+    }
+
+    if (!anyHardware)
+    {
+        // ENOENT is a missing PMU (common in VMs), EACCES/EPERM is perf_event_paranoid
+        error = std::string("hardware counters unavailable: ") + std::strerror(hardwareErrno);
+        if (hardwareErrno == EACCES || hardwareErrno == EPERM)
+            error += " (see /proc/sys/kernel/perf_event_paranoid)";
+    }
+    return any;
+}
+
+void PerfCounters::Start()
+{
+    for (int fd : m_Fds)
+    {
+        if (fd >= 0)
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void PerfCounters::Stop()
+{
+    for (int fd : m_Fds)
+    {
+        if (fd >= 0)
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+}
+
+void PerfCounters::Reset()
+{
+    for (size_t i = 0; i < PERF_EVENT_COUNT; ++i)
+    {
+        if (m_Fds[i] < 0)
+            continue;
+
+        ioctl(m_Fds[i], PERF_EVENT_IOC_RESET, 0);
+        ReadFormat data;
+        if (read(m_Fds[i], &data, sizeof(data)) == static_cast<ssize_t>(sizeof(data)))
+        {
+            m_TimeEnabled[i] = data.timeEnabled;
+            m_TimeRunning[i] = data.timeRunning;
+        }
+    }
+}
+
+PerfValues PerfCounters::Read() const
+{
+    PerfValues result;
+    for (size_t i = 0; i < PERF_EVENT_COUNT; ++i)
+    {
+        ReadFormat data;
+        if (m_Fds[i] < 0 || read(m_Fds[i], &data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)))
+            continue;
+        uint64_t enabled = data.timeEnabled - m_TimeEnabled[i];
+        uint64_t running = data.timeRunning - m_TimeRunning[i];
+        if (running == 0)
+            continue;
+
+        // scale up when the kernel multiplexed more events than the pmu has counters
+        double scale = static_cast<double>(enabled) / static_cast<double>(running);
+        result.values[i] = static_cast<uint64_t>(static_cast<double>(data.value) * scale);
+        result.valid[i] = true;
+    }
+    return result;
+}
+
+#else
+
+PerfCounters::~PerfCounters() = default;
+
+bool PerfCounters::Open(std::string& error)
+{
+    error = "perf counters are only supported on Linux";
+    return false;
+}
+
+void PerfCounters::Start() {}
+void PerfCounters::Stop() {}
+void PerfCounters::Reset() {}
+PerfValues PerfCounters::Read() const { return PerfValues(); }
+
+#endif
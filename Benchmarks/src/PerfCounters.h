@@ -0,0 +1,59 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <string>
+
+enum class PerfEvent : uint32_t
+{
+    Cycles,
+    Instructions,
+    L1Misses,     // L1 data cache read misses
+    LlcMisses,    // last level cache misses
+    BranchMisses,
+    PageFaults,   // a software event, so also available where the hardware counters are not
+    Count
+};
+
+inline constexpr size_t PERF_EVENT_COUNT = static_cast<size_t>(PerfEvent::Count);
+
+struct PerfValues
+{
+    uint64_t values[PERF_EVENT_COUNT] = {};
+    bool valid[PERF_EVENT_COUNT] = {};
+
+    uint64_t operator[](PerfEvent event) const { return values[static_cast<size_t>(event)]; }
+    bool Valid(PerfEvent event) const { return valid[static_cast<size_t>(event)]; }
+
+    static const char* Name(PerfEvent event);
+};
+
+// Linux perf_event_open counters for the calling thread, user space only. Every event is opened
+// on its own so a kernel or VM that exposes only some of them still reports those. Elsewhere, or
+// when perf_event_paranoid forbids access, Open fails and the harness runs without them.
+class PerfCounters
+{
+public:
+    PerfCounters() = default;
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Returns false if no event could be opened, error then says why
+    bool Open(std::string& error);
+
+    // Counting is paused between Stop and the next Start, Read sums every Start/Stop span since Reset
+    void Start();
+    void Stop();
+    void Reset();
+    PerfValues Read() const;
+
+private:
+    int m_Fds[PERF_EVENT_COUNT] = { -1, -1, -1, -1, -1, -1 };
+    // PERF_EVENT_IOC_RESET only zeroes the counts, the enabled and running times are taken from here
+    uint64_t m_TimeEnabled[PERF_EVENT_COUNT] = {};
+    uint64_t m_TimeRunning[PERF_EVENT_COUNT] = {};
+};
+
+#endif // !PERF_COUNTERS_H
@@ -11,4 +11,5 @@ OutputDir = "%{cfg.system}-%{cfg.architecture}/%{cfg.buildcfg}"
 
 include "Composia/Build-Composia.lua"
 include "Tests/Build-Tests.lua"
-include "App/Build-App.lua"
\ No newline at end of file
+include "App/Build-App.lua"
+include "Benchmarks/Build-Benchmarks.lua"
\ No newline at end of file
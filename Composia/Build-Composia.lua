@@ -20,12 +20,12 @@ project "Composia"
        defines { }
 
    filter "configurations:Debug"
-       defines { "DEBUG" }
+       defines { "DEBUG", "COMPOSIA_INSTRUMENTATION" }
        runtime "Debug"
        symbols "On"
 
    filter "configurations:Release"
-       defines { "RELEASE" }
+       defines { "RELEASE", "COMPOSIA_INSTRUMENTATION" }
        runtime "Release"
        optimize "On"
        symbols "On"
@@ -0,0 +1,278 @@
+#ifndef COMPOSIA_ARCHETYPE_H
+#define COMPOSIA_ARCHETYPE_H
+
+#include <algorithm> // std::max, std::min, std::binary_search
+#include <cassert> // assert
+#include <cstddef> // std::byte
+#include <limits> // std::numeric_limits
+#include <memory> // std::unique_ptr
+#include <new> // std::align_val_t
+#include <type_traits> // std::is_copy_constructible_v
+#include <utility> // std::move
+#include "Entity.h"
+#include "Core/DynamicArray.h"
+#include "Core/TypeInfo.h"
+using Composia::Core::DynamicArray;
+
+namespace Composia {
+
+// Type-erased operations on one component type, shared by every archetype column holding it
+struct ColumnType
+{
+	using Relocate = void(*)(void* to, void* from) noexcept;
+	using Copy = void(*)(void* to, const void* from);
+	using Destroy = void(*)(void* value) noexcept;
+
+	uint64_t id;
+	size_t size;
+	size_t alignment;
+	Relocate relocate; // move constructs to, then destroys from
+	Copy copy; // nullptr for types that are not copy constructible
+	Destroy destroy;
+
+	template<typename T>
+	static const ColumnType* Of() noexcept
+	{
+		static const ColumnType type{
+			TypeId<T>, sizeof(T), alignof(T),
+			[](void* to, void* from) noexcept {
+				T* source = static_cast<T*>(from);
+				new (to) T(std::move(*source));
+				source->~T();
+			},
+			CopyOf<T>(),
+			[](void* value) noexcept { static_cast<T*>(value)->~T(); }
+		};
+		return &type;
+	}
+
+private:
+	template<typename T>
+	static Copy CopyOf() noexcept
+	{
+		if constexpr (std::is_copy_constructible_v<T>)
+			return [](void* to, const void* from) { new (to) T(*static_cast<const T*>(from)); };
+		else
+			return nullptr;
+	}
+};
+
+// Table of the entities owning exactly one set of component types. Rows live in chunks of about
+// CHUNK_BYTES holding the rows' entity ids followed by one array per non-tag component, so a view
+// reads every column of a chunk linearly. Rows stay dense: removing one moves the last row into it.
+class Archetype
+{
+public:
+	static constexpr size_t CHUNK_BYTES = 16 * 1024;
+	static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+	// signature holds every component type id in ascending order, columns the non-tag ones in the same order
+	Archetype(DynamicArray<uint64_t>&& signature, DynamicArray<const ColumnType*>&& columns)
+		: m_Signature(std::move(signature)), m_Columns(std::move(columns))
+	{
+		size_t rowBytes = sizeof(Entity);
+		size_t padding = 0;
+		m_Alignment = alignof(Entity);
+		for (const ColumnType* column : m_Columns)
+		{
+			rowBytes += column->size;
+			padding += column->alignment - 1;
+			m_Alignment = std::max(m_Alignment, column->alignment);
+		}
+		m_Capacity = std::max<size_t>(1, (CHUNK_BYTES - std::min(padding, CHUNK_BYTES)) / rowBytes);
+
+		size_t offset = m_Capacity * sizeof(Entity);
+		for (const ColumnType* column : m_Columns)
+		{
+			offset = (offset + column->alignment - 1) & ~(column->alignment - 1);
+			m_Offsets.PushBack(offset);
+			offset += m_Capacity * column->size;
+		}
+		m_ChunkBytes = offset;
+	}
+
+	Archetype(const Archetype&) = delete;
+	Archetype& operator=(const Archetype&) = delete;
+
+	~Archetype()
+	{
+		for (uint32_t row = 0; row < m_Size; ++row)
+			DestroyRow(row);
+		while (!m_Chunks.Empty())
+			FreeLastChunk();
+	}
+
+	[[nodiscard]] inline bool Has(uint64_t id) const noexcept
+	{
+		return std::binary_search(m_Signature.begin(), m_Signature.end(), id);
+	}
+
+	// Position of id among the columns, NONE for tags and types the archetype doesn't hold
+	[[nodiscard]] inline uint32_t ColumnIndex(uint64_t id) const noexcept
+	{
+		for (uint32_t i = 0; i < m_Columns.Size(); ++i)
+		{
+			if (m_Columns[i]->id == id)
+				return i;
+		}
+		return NONE;
+	}
+
+	[[nodiscard]] inline const DynamicArray<uint64_t>& Signature() const noexcept
+	{
+		return m_Signature;
+	}
+
+	[[nodiscard]] inline const DynamicArray<const ColumnType*>& Columns() const noexcept
+	{
+		return m_Columns;
+	}
+
+	[[nodiscard]] inline size_t Size() const noexcept
+	{
+		return m_Size;
+	}
+
+	// Rows per chunk
+	[[nodiscard]] inline size_t ChunkCapacity() const noexcept
+	{
+		return m_Capacity;
+	}
+
+	// Chunks holding rows, a spare empty one may follow
+	[[nodiscard]] inline size_t ChunkCount() const noexcept
+	{
+		return (m_Size + m_Capacity - 1) / m_Capacity;
+	}
+
+	[[nodiscard]] inline size_t ChunkSize(size_t chunk) const noexcept
+	{
+		return std::min(m_Capacity, m_Size - chunk * m_Capacity);
+	}
+
+	[[nodiscard]] inline Entity* Entities(size_t chunk) const noexcept
+	{
+		return reinterpret_cast<Entity*>(m_Chunks[chunk]);
+	}
+
+	[[nodiscard]] inline void* Column(size_t chunk, uint32_t column) const noexcept
+	{
+		return m_Chunks[chunk] + m_Offsets[column];
+	}
+
+	[[nodiscard]] inline void* At(uint32_t row, uint32_t column) const noexcept
+	{
+		return m_Chunks[row / m_Capacity] + m_Offsets[column] + (row % m_Capacity) * m_Columns[column]->size;
+	}
+
+	[[nodiscard]] inline Entity EntityAt(uint32_t row) const noexcept
+	{
+		return Entities(row / m_Capacity)[row % m_Capacity];
+	}
+
+	// Appends a row for e and returns it. Its components are left unconstructed for the caller.
+	uint32_t Append(Entity e)
+	{
+		if (m_Size == m_Chunks.Size() * m_Capacity)
+			m_Chunks.PushBack(static_cast<std::byte*>(::operator new(m_ChunkBytes, std::align_val_t(m_Alignment))));
+
+		uint32_t row = m_Size++;
+		Entities(row / m_Capacity)[row % m_Capacity] = e;
+		return row;
+	}
+
+	inline void DestroyRow(uint32_t row) noexcept
+	{
+		for (uint32_t column = 0; column < m_Columns.Size(); ++column)
+			m_Columns[column]->destroy(At(row, column));
+	}
+
+	// Fills row, whose components were already destroyed or moved out, with the last row. Returns the
+	// entity now at row, INVALID_ENTITY if row was the last one. Only one spare chunk is kept.
+	Entity RemoveRow(uint32_t row) noexcept
+	{
+		uint32_t last = m_Size - 1;
+		Entity moved = INVALID_ENTITY;
+		if (row != last)
+		{
+			for (uint32_t column = 0; column < m_Columns.Size(); ++column)
+				m_Columns[column]->relocate(At(row, column), At(last, column));
+			moved = EntityAt(last);
+			Entities(row / m_Capacity)[row % m_Capacity] = moved;
+		}
+
+		--m_Size;
+		if (m_Chunks.Size() > ChunkCount() + 1)
+			FreeLastChunk();
+		return moved;
+	}
+
+	// Cached transition to the archetype with id added or removed, NONE until SetEdge
+	[[nodiscard]] inline uint32_t Edge(uint64_t id, bool adding) const noexcept
+	{
+		for (const Transition& edge : m_Edges)
+		{
+			if (edge.id == id)
+				return adding ? edge.add : edge.remove;
+		}
+		return NONE;
+	}
+
+	void SetEdge(uint64_t id, bool adding, uint32_t archetype)
+	{
+		for (Transition& edge : m_Edges)
+		{
+			if (edge.id == id)
+			{
+				(adding ? edge.add : edge.remove) = archetype;
+				return;
+			}
+		}
+		m_Edges.PushBack(adding ? Transition{ id, archetype, NONE } : Transition{ id, NONE, archetype });
+	}
+
+	// Copies rows and edges, every column type must be copy constructible
+	[[nodiscard]] std::unique_ptr<Archetype> Clone() const
+	{
+		auto copy = std::make_unique<Archetype>(DynamicArray<uint64_t>(m_Signature), DynamicArray<const ColumnType*>(m_Columns));
+		copy->m_Edges = m_Edges;
+		for (uint32_t row = 0; row < m_Size; ++row)
+		{
+			uint32_t copied = copy->Append(EntityAt(row));
+			for (uint32_t column = 0; column < m_Columns.Size(); ++column)
+			{
+				assert(m_Columns[column]->copy && "Cloned components must be copy constructible");
+				m_Columns[column]->copy(copy->At(copied, column), At(row, column));
+			}
+		}
+		return copy;
+	}
+
+private:
+	struct Transition
+	{
+		uint64_t id;
+		uint32_t add;
+		uint32_t remove;
+	};
+
+	inline void FreeLastChunk() noexcept
+	{
+		::operator delete(m_Chunks.Back(), std::align_val_t(m_Alignment));
+		m_Chunks.PopBack();
+	}
+
+	DynamicArray<uint64_t> m_Signature;
+	DynamicArray<const ColumnType*> m_Columns;
+	DynamicArray<size_t> m_Offsets{ 0 };
+	DynamicArray<std::byte*> m_Chunks{ 0 };
+	DynamicArray<Transition> m_Edges{ 0 };
+	size_t m_Capacity = 1;
+	size_t m_ChunkBytes = 0;
+	size_t m_Alignment = alignof(Entity);
+	uint32_t m_Size = 0;
+};
+
+} // namespace Composia
+
+#endif // !COMPOSIA_ARCHETYPE_H
@@ -0,0 +1,304 @@
+#ifndef COMPOSIA_ARCHETYPE_REGISTRY_H
+#define COMPOSIA_ARCHETYPE_REGISTRY_H
+
+#include <algorithm> // std::equal
+#include <memory> // std::unique_ptr
+#include <utility> // std::forward, std::move
+#include "EntityManager.h"
+#include "ResourceManager.h"
+#include "Archetype.h"
+#include "ArchetypeView.h"
+
+namespace Composia {
+
+// Registry backend storing every entity as a row of the archetype matching its exact component set,
+// see Archetype. Views read all their columns linearly whatever order entities were created in, while
+// Emplace and Remove move the entity's row to another archetype, found through edges cached on the
+// archetypes. Storage policies are ignored, every component lives in a column and tags only in the
+// archetype signature.
+//
+// Defining COMPOSIA_ARCHETYPE_STORAGE makes Registry this class. It covers entities, components, views,
+// resources and Clone; signals, observers, snapshots, deltas, sorting, compaction, enabling and storage
+// handles are built on component pools and only exist on the sparse set Registry.
+class ArchetypeRegistry
+{
+public:
+	ArchetypeRegistry()
+	{
+		// archetype 0 is the empty one, entities without components have no row anywhere
+		m_Archetypes.PushBack(std::make_unique<Archetype>(DynamicArray<uint64_t>(0), DynamicArray<const ColumnType*>(0)));
+	}
+
+	ArchetypeRegistry(ArchetypeRegistry&&) = default;
+	ArchetypeRegistry& operator=(ArchetypeRegistry&&) = default;
+
+	// Copies are made explicitly with Clone
+	ArchetypeRegistry(const ArchetypeRegistry&) = delete;
+	ArchetypeRegistry& operator=(const ArchetypeRegistry&) = delete;
+
+	inline Entity Create() noexcept
+	{
+		return m_EntityManager.Create();
+	}
+
+	inline void Destroy(Entity e) noexcept
+	{
+		if (e < m_Locations.Size())
+			Detach(e);
+		m_EntityManager.Destroy(e);
+	}
+
+	template<typename T>
+	inline void Add(Entity e, const T& comp) noexcept
+	{
+		Emplace<T>(e, comp);
+	}
+
+	// Assigns T in place if e already has one, otherwise moves e's row to the archetype with T added
+	template<typename T, typename... Args>
+	void Emplace(Entity e, Args&&... args) noexcept
+	{
+		Location& location = Locate(e);
+		const Archetype& source = *m_Archetypes[location.archetype];
+		if constexpr (IsTag<T>)
+		{
+			if (source.Has(TypeId<T>))
+				return;
+
+			Move(e, Transition(location.archetype, TypeId<T>, nullptr));
+		}
+		else
+		{
+			uint32_t column = source.ColumnIndex(TypeId<T>);
+			if (column != Archetype::NONE)
+			{
+				*static_cast<T*>(source.At(location.row, column)) = T(std::forward<Args>(args)...);
+				return;
+			}
+
+			// built before the move, args may refer to e's current components
+			T value(std::forward<Args>(args)...);
+			uint32_t target = Transition(location.archetype, TypeId<T>, ColumnType::Of<T>());
+			uint32_t row = Move(e, target);
+			const Archetype& archetype = *m_Archetypes[target];
+			new (archetype.At(row, archetype.ColumnIndex(TypeId<T>))) T(std::move(value));
+		}
+	}
+
+	template<typename T>
+	inline void Insert(const Entity* entities, size_t count, const T& comp = {})
+	{
+		for (size_t i = 0; i < count; ++i)
+			Emplace<T>(entities[i], comp);
+	}
+
+	template<typename T>
+	void Remove(Entity e) noexcept
+	{
+		if (e >= m_Locations.Size() || !m_Archetypes[m_Locations[e].archetype]->Has(TypeId<T>))
+			return;
+
+		uint32_t target = Transition(m_Locations[e].archetype, TypeId<T>, nullptr);
+		if (target == EMPTY)
+			Detach(e);
+		else
+			Move(e, target);
+	}
+
+	template<typename T>
+	inline void Remove(const Entity* entities, size_t count) noexcept
+	{
+		for (size_t i = 0; i < count; ++i)
+			Remove<T>(entities[i]);
+	}
+
+	template<typename T>
+	[[nodiscard]] inline bool Has(Entity e)
+	{
+		return e < m_Locations.Size() && m_Archetypes[m_Locations[e].archetype]->Has(TypeId<T>);
+	}
+
+	template<typename T>
+	inline T& Get(Entity e) noexcept
+	{
+		const Location& location = m_Locations[e];
+		const Archetype& archetype = *m_Archetypes[location.archetype];
+		uint32_t column = archetype.ColumnIndex(TypeId<T>);
+		assert(column != Archetype::NONE && "Entity has no such component");
+		return *static_cast<T*>(archetype.At(location.row, column));
+	}
+
+	template<typename... Components>
+	inline ArchetypeView<Components...> View() noexcept
+	{
+		return ArchetypeView<Components...>(m_Archetypes);
+	}
+
+	// See Registry::SetResource
+	template<typename T, typename... Args>
+	inline T& SetResource(Args&&... args)
+	{
+		return m_Resources.Set<T>(std::forward<Args>(args)...);
+	}
+
+	template<typename T>
+	[[nodiscard]] inline ResourceHandle<T> Resource() noexcept
+	{
+		return ResourceHandle<T>(m_Resources.Find<T>());
+	}
+
+	template<typename T>
+	inline bool RemoveResource()
+	{
+		return m_Resources.Remove<T>();
+	}
+
+	// Number of archetypes created so far, including the empty one
+	[[nodiscard]] inline size_t ArchetypeCount() const noexcept
+	{
+		return m_Archetypes.Size();
+	}
+
+	// Copies entities, archetypes with their rows and the copy constructible resources
+	[[nodiscard]] ArchetypeRegistry Clone() const
+	{
+		ArchetypeRegistry copy;
+		copy.m_EntityManager = m_EntityManager;
+		copy.m_Locations = m_Locations;
+		copy.m_Archetypes.Clear();
+		for (const auto& archetype : m_Archetypes)
+			copy.m_Archetypes.PushBack(archetype->Clone());
+		copy.m_Resources = m_Resources.Clone();
+		return copy;
+	}
+
+private:
+	static constexpr uint32_t EMPTY = 0;
+
+	struct Location
+	{
+		uint32_t archetype = EMPTY;
+		uint32_t row = 0;
+	};
+
+	inline Location& Locate(Entity e)
+	{
+		if (e >= m_Locations.Size())
+		{
+			size_t newSize = m_Locations.Size() == 0 ? 64 : m_Locations.Size();
+			while (e >= newSize)
+				newSize *= 2;
+			m_Locations.Resize(newSize, Location{});
+		}
+		return m_Locations[e];
+	}
+
+	// Archetype with id added to, or removed from, archetype from. column is the added type's column,
+	// nullptr for tags and removals. Cached on both archetypes as an edge once found or created.
+	uint32_t Transition(uint32_t from, uint64_t id, const ColumnType* column)
+	{
+		bool adding = !m_Archetypes[from]->Has(id);
+		uint32_t cached = m_Archetypes[from]->Edge(id, adding);
+		if (cached != Archetype::NONE)
+			return cached;
+
+		// both lists stay sorted by id, the added one is merged in on the way
+		const Archetype& source = *m_Archetypes[from];
+		DynamicArray<uint64_t> signature(source.Signature().Size() + 1);
+		for (uint64_t existing : source.Signature())
+		{
+			if (adding && id < existing && (signature.Empty() || signature.Back() < id))
+				signature.PushBack(id);
+			if (existing != id)
+				signature.PushBack(existing);
+		}
+		if (adding && (signature.Empty() || signature.Back() < id))
+			signature.PushBack(id);
+
+		uint32_t target = Find(signature);
+		if (target == Archetype::NONE)
+		{
+			DynamicArray<const ColumnType*> columns(source.Columns().Size() + 1);
+			for (const ColumnType* existing : source.Columns())
+			{
+				if (column && id < existing->id && (columns.Empty() || columns.Back()->id < id))
+					columns.PushBack(column);
+				if (existing->id != id)
+					columns.PushBack(existing);
+			}
+			if (column && (columns.Empty() || columns.Back()->id < id))
+				columns.PushBack(column);
+
+			target = static_cast<uint32_t>(m_Archetypes.Size());
+			m_Archetypes.PushBack(std::make_unique<Archetype>(std::move(signature), std::move(columns)));
+		}
+
+		m_Archetypes[from]->SetEdge(id, adding, target);
+		m_Archetypes[target]->SetEdge(id, !adding, from);
+		return target;
+	}
+
+	inline uint32_t Find(const DynamicArray<uint64_t>& signature) const noexcept
+	{
+		for (uint32_t i = 0; i < m_Archetypes.Size(); ++i)
+		{
+			const DynamicArray<uint64_t>& candidate = m_Archetypes[i]->Signature();
+			if (candidate.Size() == signature.Size() && std::equal(candidate.begin(), candidate.end(), signature.begin()))
+				return i;
+		}
+		return Archetype::NONE;
+	}
+
+	// Moves e's row into target, carrying over the components both archetypes hold and destroying
+	// the others. Returns the new row, its columns missing from e's old archetype are unconstructed.
+	uint32_t Move(Entity e, uint32_t target)
+	{
+		Location& location = m_Locations[e];
+		Archetype& to = *m_Archetypes[target];
+		uint32_t row = to.Append(e);
+		if (location.archetype != EMPTY)
+		{
+			Archetype& from = *m_Archetypes[location.archetype];
+			const DynamicArray<const ColumnType*>& columns = from.Columns();
+			for (uint32_t column = 0; column < columns.Size(); ++column)
+			{
+				uint32_t kept = to.ColumnIndex(columns[column]->id);
+				if (kept != Archetype::NONE)
+					columns[column]->relocate(to.At(row, kept), from.At(location.row, column));
+				else
+					columns[column]->destroy(from.At(location.row, column));
+			}
+
+			Entity moved = from.RemoveRow(location.row);
+			if (moved != INVALID_ENTITY)
+				m_Locations[moved].row = location.row;
+		}
+
+		location = Location{ target, row };
+		return row;
+	}
+
+	// Destroys e's components and drops its row
+	inline void Detach(Entity e) noexcept
+	{
+		Location& location = m_Locations[e];
+		if (location.archetype == EMPTY)
+			return;
+
+		Archetype& archetype = *m_Archetypes[location.archetype];
+		archetype.DestroyRow(location.row);
+		Entity moved = archetype.RemoveRow(location.row);
+		if (moved != INVALID_ENTITY)
+			m_Locations[moved].row = location.row;
+		location = Location{};
+	}
+
+	EntityManager m_EntityManager;
+	DynamicArray<Location> m_Locations{ 0 };
+	DynamicArray<std::unique_ptr<Archetype>> m_Archetypes{ 0 };
+	ResourceManager m_Resources;
+};
+
+} // namespace Composia
+
+#endif // !COMPOSIA_ARCHETYPE_REGISTRY_H
@@ -0,0 +1,126 @@
+#ifndef COMPOSIA_ARCHETYPE_VIEW_H
+#define COMPOSIA_ARCHETYPE_VIEW_H
+
+#include <array> // std::array
+#include <memory> // std::unique_ptr
+#include <tuple> // std::tuple, std::tuple_element_t
+#include <utility> // std::index_sequence
+#include "Archetype.h"
+#include "ComponentPool.h"
+#include "Core/Trace.h"
+
+namespace Composia {
+
+	// View over an ArchetypeRegistry, with the same each() as View: one reference per non-tag component,
+	// in declaration order. The archetypes holding every component are collected once; each() then walks
+	// their chunks and hands out the rows of each chunk straight from its column arrays.
+	template<typename... Components>
+	class ArchetypeView
+	{
+	public:
+		static_assert(sizeof...(Components) > 0, "Views need at least one component type");
+
+		ArchetypeView(const DynamicArray<std::unique_ptr<Archetype>>& archetypes)
+		{
+			for (const auto& archetype : archetypes)
+			{
+				if ((archetype->Has(TypeId<Components>) && ...) && archetype->Size() != 0)
+					matches.PushBack(archetype.get());
+			}
+		}
+
+		struct Iterator
+		{
+			Iterator(const DynamicArray<Archetype*>* matches, size_t archetype)
+				: matches(matches), archetype(archetype)
+			{
+			}
+
+			Iterator& operator++() noexcept
+			{
+				if (++row == (*matches)[archetype]->Size())
+				{
+					++archetype;
+					row = 0;
+				}
+				return *this;
+			}
+
+			Entity operator*() const noexcept
+			{
+				return (*matches)[archetype]->EntityAt(row);
+			}
+
+			bool operator!=(const Iterator& other) const noexcept
+			{
+				return archetype != other.archetype || row != other.row;
+			}
+
+		private:
+			const DynamicArray<Archetype*>* matches;
+			size_t archetype;
+			uint32_t row = 0;
+		};
+
+		inline Iterator begin() const noexcept
+		{
+			return Iterator(&matches, 0);
+		}
+
+		inline Iterator end() const noexcept
+		{
+			return Iterator(&matches, matches.Size());
+		}
+
+		template<typename Func>
+		void each(Func&& func) noexcept
+		{
+			COMPOSIA_TRACE_ZONE(Core::TypeName<ArchetypeView>());
+
+			[[maybe_unused]] size_t visited = 0;
+			for (Archetype* archetype : matches)
+			{
+				for (size_t chunk = 0; chunk < archetype->ChunkCount(); ++chunk)
+					EachInChunk(*archetype, chunk, func, std::make_index_sequence<ValueCount>{});
+				visited += archetype->Size();
+			}
+			COMPOSIA_COUNT(ViewCandidates, visited);
+			COMPOSIA_COUNT(ViewAccepted, visited);
+		}
+
+	private:
+		static constexpr size_t ValueCount = (size_t(!IsTag<Components>) + ... + 0);
+
+		// Indices into Components of the types that carry a value
+		static constexpr std::array<size_t, ValueCount> ValueIndices = [] {
+			constexpr bool isTag[] = { IsTag<Components>... };
+			std::array<size_t, ValueCount> indices{};
+			size_t count = 0;
+			for (size_t i = 0; i < sizeof...(Components); ++i)
+			{
+				if (!isTag[i])
+					indices[count++] = i;
+			}
+			return indices;
+		}();
+
+		template<size_t I>
+		using ValueType = std::tuple_element_t<ValueIndices[I], std::tuple<Components...>>;
+
+		template<typename Func, size_t... Is>
+		inline void EachInChunk(const Archetype& archetype, size_t chunk, Func& func, std::index_sequence<Is...>) noexcept
+		{
+			std::tuple<ValueType<Is>*...> columns{
+				static_cast<ValueType<Is>*>(archetype.Column(chunk, archetype.ColumnIndex(TypeId<ValueType<Is>>)))...
+			};
+			size_t count = archetype.ChunkSize(chunk);
+			for (size_t i = 0; i < count; ++i)
+				func(std::get<Is>(columns)[i]...);
+		}
+
+		DynamicArray<Archetype*> matches{ 0 };
+	};
+
+} // namespace Composia
+
+#endif // !COMPOSIA_ARCHETYPE_VIEW_H
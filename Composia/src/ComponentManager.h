@@ -1,20 +1,88 @@
 #ifndef COMPOSIA_COMPONENT_MANAGER_H
 #define COMPOSIA_COMPONENT_MANAGER_H
 
+#include <algorithm> // std::find
 #include "ComponentPool.h"
 #include "Core/PoolMap.h"
 using Composia::Core::PoolMap;
 
 namespace Composia {
 
+// T's pool resolved once, see Registry::Storage. Calls skip the pool map and go straight to the
+// sparse lookup. Valid as long as the pool, which moves along with the registry.
+template<typename T>
+class StorageHandle
+{
+public:
+	StorageHandle(ComponentPool<T>& pool, const BitSet& disabled) noexcept
+		: m_Pool(&pool), m_Disabled(&disabled) {}
+
+	[[nodiscard]] inline T& Get(Entity e) noexcept requires (!IsTag<T>)
+	{
+		return *m_Pool->Get(e);
+	}
+
+	// See ComponentPool::GetMany
+	inline void GetMany(const Entity* entities, size_t count, T** out) noexcept requires (!IsTag<T>)
+	{
+		m_Pool->GetMany(entities, count, out);
+	}
+
+	[[nodiscard]] inline bool Has(Entity e) const noexcept
+	{
+		return m_Pool->Has(e);
+	}
+
+	template<typename... Args>
+	inline void Emplace(Entity e, Args&&... args) noexcept
+	{
+		m_Pool->Emplace(e, std::forward<Args>(args)...);
+		if (m_Disabled->Size() != 0 && m_Disabled->Has(e)) [[unlikely]]
+			m_Pool->Disable(e);
+	}
+
+	inline void Remove(Entity e) noexcept
+	{
+		m_Pool->Remove(e);
+	}
+
+	[[nodiscard]] inline ComponentPool<T>& Pool() const noexcept
+	{
+		return *m_Pool;
+	}
+
+private:
+	ComponentPool<T>* m_Pool;
+	const BitSet* m_Disabled; // components emplaced for disabled entities start out disabled
+};
+
 class ComponentManager
 {
 public:
+	ComponentManager() = default;
+
+	// The disabled set goes along with the pools, the moved-from manager keeps an empty one
+	ComponentManager(ComponentManager&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	ComponentManager& operator=(ComponentManager&& other) noexcept
+	{
+		m_Pools = std::move(other.m_Pools);
+		std::swap(m_Disabled, other.m_Disabled);
+		other.m_Disabled->Clear();
+		m_CompactCursor = other.m_CompactCursor;
+		return *this;
+	}
+
 	template<typename T>
 	inline void Add(Entity e, const T& comp) noexcept
 	{
 		auto* wrapper = GetOrCreatePool<T>();
 		wrapper->pool.Add(e, comp);
+		if (m_Disabled->Size() != 0) [[unlikely]]
+			KeepDisabled(wrapper->pool, e);
 	}
 
 	template<typename T, typename... Args>
@@ -22,51 +90,74 @@ public:
 	{
 		auto* wrapper = GetOrCreatePool<T>();
 		wrapper->pool.Emplace(e, std::forward<Args>(args)...);
+		if (m_Disabled->Size() != 0) [[unlikely]]
+			KeepDisabled(wrapper->pool, e);
+	}
+
+	template<typename T>
+	inline void Insert(const Entity* entities, size_t count, const T& comp)
+	{
+		auto* wrapper = GetOrCreatePool<T>();
+		wrapper->pool.Insert(entities, count, comp);
+		if (m_Disabled->Size() != 0) [[unlikely]]
+		{
+			for (size_t i = 0; i < count; ++i)
+				KeepDisabled(wrapper->pool, entities[i]);
+		}
 	}
 
 	template<typename T>
 	void Remove(Entity e) noexcept
 	{
-		auto existing = m_Pools.Get(typeid(T));
-		if (existing)
+		if (auto existing = LookupPool<T>())
 		{
-			static_cast<ComponentPoolWrapper<T>*>(existing)->pool.Remove(e);
+			existing->pool.Remove(e);
+		}
+	}
+
+	template<typename T>
+	void Remove(const Entity* entities, size_t count) noexcept
+	{
+		if (auto existing = LookupPool<T>())
+		{
+			existing->pool.Remove(entities, count);
 		}
 	}
 
 	template<typename T>
 	T* Get(Entity e) noexcept
 	{
-		auto existing = m_Pools.Get(typeid(T));
+		static_assert(!IsTag<T>, "Tag components have no value, query them with Has");
+
+		auto existing = LookupPool<T>();
 		if (!existing)
 		{
 			return nullptr;
 		}
 
-		return static_cast<ComponentPoolWrapper<T>*>(existing)->pool.Get(e);
+		return existing->pool.Get(e);
 	}
 
 	template<typename T>
 	bool Has(Entity e) noexcept
 	{
-		auto existing = m_Pools.Get(typeid(T)); 
+		auto existing = LookupPool<T>();
 		if (!existing)
 			return false;
 
-		auto wrapper = static_cast<ComponentPoolWrapper<T>*>(existing);
-		return wrapper->Has(e);
+		return existing->Has(e);
 	}
 
 	template<typename T>
 	ComponentPool<T>* Pool()
 	{
-		auto existing = m_Pools.Get(typeid(T));
+		auto existing = LookupPool<T>();
 		if (!existing)
 		{
 			return nullptr;
 		}
 
-		return &static_cast<ComponentPoolWrapper<T>*>(existing)->pool;
+		return &existing->pool;
 	}
 
 	void RemoveAllForEntity(Entity entity) noexcept
@@ -79,28 +170,371 @@ public:
 				slot.value->Remove(entity);
 			}
 		}
+		m_Disabled->Remove(entity);
+	}
+
+	// Moves the entity's components behind the enabled ones in every pool, see Registry::Disable
+	void Disable(Entity e)
+	{
+		if (m_Disabled->Has(e))
+			return;
+
+		m_Disabled->Add(e);
+		ForEachPool([&](IComponentPool& pool) { pool.Disable(e); });
+	}
+
+	void Enable(Entity e)
+	{
+		if (!m_Disabled->Has(e))
+			return;
+
+		m_Disabled->Remove(e);
+		ForEachPool([&](IComponentPool& pool) { pool.Enable(e); });
+	}
+
+	[[nodiscard]] inline bool IsEnabled(Entity e) const noexcept
+	{
+		return !m_Disabled->Has(e);
+	}
+
+	// One bit per disabled entity, views over bitset pools mask their words with it
+	[[nodiscard]] inline const BitSet& Disabled() const noexcept
+	{
+		return *m_Disabled;
+	}
+
+	// Forgets the disabled state of the entities dead(e) returns true for, e.g. after a delta destroyed them
+	template<typename Dead>
+	void DropDisabled(Dead dead)
+	{
+		if (m_Disabled->Size() == 0)
+			return;
+
+		DynamicArray<Entity> dropped(0);
+		m_Disabled->Each([&](Entity e) {
+			if (dead(e))
+				dropped.PushBack(e);
+			});
+		for (Entity e : dropped)
+			m_Disabled->Remove(e);
+	}
+
+	// Writes every serializable pool as a section tagged with its component layout and byte length
+	void Save(OutputArchive& archive) const
+	{
+		uint32_t sections = 0;
+		ForEachPool([&](const IComponentPool& pool) { sections += pool.Serializable(); });
+		archive.Write(sections);
+
+		ForEachPool([&](const IComponentPool& pool) {
+			if (!pool.Serializable())
+				return;
+
+			ComponentLayout layout = pool.Layout();
+			archive.Write(layout.typeHash);
+			archive.Write(layout.size);
+			archive.Write(layout.alignment);
+			archive.Write(layout.storage);
+
+			// the length is patched in once the section is written. Streams that can't seek back get
+			// it counted first, from the section's real offset so block padding comes out the same.
+			size_t lengthAt = archive.Written();
+			size_t start = lengthAt + sizeof(uint64_t);
+			bool patch = archive.Patchable();
+			uint64_t length = 0;
+			if (!patch)
+			{
+				OutputArchive counter(nullptr, archive.BlockAlignment(), start);
+				pool.Save(counter);
+				length = counter.Written() - start;
+			}
+			archive.Write(length);
+			pool.Save(archive);
+			if (patch)
+				archive.Patch(lengthAt, static_cast<uint64_t>(archive.Written() - start));
+			});
+
+		// pools are saved in packed order, so only which entities were disabled has to be kept
+		archive.WriteArray(m_Disabled->RawWords());
+	}
+
+	// Loads sections written by Save into the existing pools. Sections of types without a pool
+	// are skipped and pools missing from the archive are cleared. A section the running build can't
+	// read, its component size changed or it switched to or from bitset storage, is skipped the same
+	// way. Sections with a different alignment or other storage, or whose mapped blocks don't check
+	// out, are copied instead of being used in place. Sections are read into empty pools first, so
+	// the existing ones are left untouched when the archive turns out to be invalid.
+	bool Load(InputArchive& archive)
+	{
+		uint32_t sections = 0;
+		if (!archive.Read(sections) || !archive.Holds(sections, SECTION_HEADER_BYTES))
+			return false;
+
+		struct Loaded
+		{
+			IComponentPool* pool;
+			std::unique_ptr<IComponentPool> content;
+		};
+		DynamicArray<Loaded> loaded(0);
+		for (uint32_t i = 0; i < sections; ++i)
+		{
+			ComponentLayout layout{};
+			uint64_t size = 0;
+			if (!archive.Read(layout.typeHash) || !archive.Read(layout.size) || !archive.Read(layout.alignment) ||
+				!archive.Read(layout.storage) || !archive.Read(size))
+				return false;
+
+			IComponentPool* pool = FindPool(layout.typeHash);
+			if (!pool || !Readable(layout, pool->Layout()))
+			{
+				if (!archive.Skip(static_cast<size_t>(size)))
+					return false;
+				continue;
+			}
+
+			std::unique_ptr<IComponentPool> content = pool->Empty();
+			size_t start = archive.Consumed();
+			bool borrowing = archive.Borrowing();
+			archive.Borrowing(borrowing && layout.alignment == pool->Layout().alignment);
+			bool restored = content->Load(archive, static_cast<StoragePolicy>(layout.storage));
+			archive.Borrowing(borrowing);
+
+			// a section read as another storage may leave blocks behind, the sparse array of an image
+			size_t used = archive.Consumed() - start;
+			if (!restored || used > size || !archive.Skip(static_cast<size_t>(size - used)))
+				return false;
+			loaded.PushBack(Loaded{ pool, std::move(content) });
+		}
+
+		DynamicArray<uint64_t> disabled(0);
+		if (!archive.ReadArray(disabled))
+			return false;
+
+		ForEachPool([&](IComponentPool& pool) {
+			auto found = std::find_if(loaded.begin(), loaded.end(), [&](const Loaded& entry) { return entry.pool == &pool; });
+			if (found != loaded.end())
+				pool.Take(*found->content);
+			else
+				pool.Clear();
+			});
+		m_Disabled->Assign(std::move(disabled));
+		m_Disabled->Each([&](Entity e) {
+			ForEachPool([&](IComponentPool& pool) { pool.Disable(e); });
+			});
+		return true;
+	}
+
+	// Captures every delta tracked pool, replacing states
+	void Capture(DynamicArray<PoolState>& states) const
+	{
+		states.Clear();
+		ForEachPool([&](const IComponentPool& pool) {
+			if (!pool.DeltaTracked())
+				return;
+
+			PoolState state;
+			pool.Capture(state);
+			states.PushBack(std::move(state));
+			});
+	}
+
+	// Appends the changes of every delta tracked pool since baseline, pools created after it start empty
+	void Diff(const DeltaBaseline& baseline, DynamicArray<PoolDelta>& deltas) const
+	{
+		const PoolState empty;
+		ForEachPool([&](const IComponentPool& pool) {
+			if (!pool.DeltaTracked())
+				return;
+
+			const PoolState* state = baseline.Find(pool.Layout().typeHash);
+			PoolDelta delta;
+			pool.Diff(state ? *state : empty, delta);
+			if (!delta.Empty())
+				deltas.PushBack(std::move(delta));
+			});
+	}
+
+	// Applies (or reverts) pool deltas. Nothing is changed unless every delta has a matching pool.
+	bool Apply(const DynamicArray<PoolDelta>& deltas, bool revert)
+	{
+		for (const PoolDelta& delta : deltas)
+		{
+			IComponentPool* pool = FindPool(delta.typeHash);
+			if (!pool || !pool->DeltaTracked() || pool->Layout().size != delta.valueSize)
+				return false;
+		}
+
+		for (const PoolDelta& delta : deltas)
+		{
+			IComponentPool* pool = FindPool(delta.typeHash);
+			pool->Apply(delta, revert);
+
+			// deltas don't record the enabled state, components coming back keep their entity's
+			if (m_Disabled->Size() != 0) [[unlikely]]
+			{
+				for (Entity e : revert ? delta.removed : delta.added)
+				{
+					if (m_Disabled->Has(e))
+						pool->Disable(e);
+				}
+			}
+		}
+		return true;
+	}
+
+	// Copies every pool with bulk array copies
+	[[nodiscard]] ComponentManager Clone() const
+	{
+		ComponentManager copy;
+		for (size_t i = 0; i < m_Pools.GetBuckets().Size(); ++i)
+		{
+			auto& slot = m_Pools.GetBuckets().At(i);
+			if (!slot.occupied || !slot.value)
+				continue;
+
+			if (auto pool = slot.value->Clone())
+				copy.m_Pools.Insert(slot.key, std::move(pool));
+		}
+		*copy.m_Disabled = *m_Disabled;
+		return copy;
+	}
+
+	// Copy-on-write clone, every pool shares its arrays with this manager's until one side modifies it
+	[[nodiscard]] ComponentManager Share()
+	{
+		ComponentManager copy;
+		for (size_t i = 0; i < m_Pools.GetBuckets().Size(); ++i)
+		{
+			auto& slot = m_Pools.GetBuckets().At(i);
+			if (!slot.occupied || !slot.value)
+				continue;
+
+			if (auto pool = slot.value->Share())
+				copy.m_Pools.Insert(slot.key, std::move(pool));
+		}
+		*copy.m_Disabled = *m_Disabled;
+		return copy;
+	}
+
+	// Adds every pool's footprint and the pool map's buckets to report
+	void Memory(MemoryReport& report) const
+	{
+		report.pools.Clear();
+		ForEachPool([&](const IComponentPool& pool) { report.pools.PushBack(pool.Memory()); });
+
+		report.poolMap = ArrayMemory::Of(m_Pools.GetBuckets());
+		report.poolMap.used = m_Pools.Size() * sizeof(*m_Pools.GetBuckets().Data());
+	}
+
+	// Compacts pools from where the previous call stopped until budget work is done, stopping inside a
+	// pool if needed (see Core::CompactBudget). Returns true once the last pool was compacted.
+	bool Compact(Core::CompactBudget& budget)
+	{
+		const auto& buckets = m_Pools.GetBuckets();
+		while (m_CompactCursor < buckets.Size())
+		{
+			if (budget.Spent())
+				return false;
+
+			// an unfinished pool keeps the cursor, it is resumed first next time
+			auto& slot = buckets.At(m_CompactCursor);
+			if (slot.occupied && slot.value && !slot.value->Compact(budget))
+				return false;
+			++m_CompactCursor;
+		}
+
+		if (!m_Disabled->Compact(budget))
+			return false;
+		m_CompactCursor = 0;
+		return true;
+	}
+
+	// Renames the entities of every pool, see Registry::Defragment
+	void Remap(const DynamicArray<Entity>& remap, size_t entityCount)
+	{
+		ForEachPool([&](IComponentPool& pool) { pool.Remap(remap, entityCount); });
+		m_Disabled->Remap(remap, entityCount);
+	}
+
+	// Returns the pool for T, creating it if needed. Pools are never moved once created.
+	template<typename T>
+	ComponentPool<T>* AssurePool()
+	{
+		return &GetOrCreatePool<T>()->pool;
+	}
+
+	template<typename T>
+	StorageHandle<T> Storage()
+	{
+		return StorageHandle<T>(*AssurePool<T>(), *m_Disabled);
 	}
 
 private:
+	// type hash, size, alignment, storage and byte count in front of every saved pool
+	static constexpr size_t SECTION_HEADER_BYTES = sizeof(uint64_t) + 3 * sizeof(uint32_t) + sizeof(uint64_t);
+
+	// Sparse set and hash map pools save the same blocks, apart from the sparse array of images
+	[[nodiscard]] static bool Readable(const ComponentLayout& saved, const ComponentLayout& expected) noexcept
+	{
+		constexpr uint32_t BITSET = static_cast<uint32_t>(StoragePolicy::Bitset);
+		constexpr uint32_t HASH_MAP = static_cast<uint32_t>(StoragePolicy::HashMap);
+		return saved.size == expected.size && saved.storage <= HASH_MAP &&
+			(saved.storage == BITSET) == (expected.storage == BITSET);
+	}
+
+	template<typename Func>
+	void ForEachPool(Func&& func) const
+	{
+		for (size_t i = 0; i < m_Pools.GetBuckets().Size(); ++i)
+		{
+			auto& slot = m_Pools.GetBuckets().At(i);
+			if (slot.occupied && slot.value)
+				func(*slot.value);
+		}
+	}
+
 	template<typename T>
-	ComponentPoolWrapper<T>* GetOrCreatePool()
+	inline void KeepDisabled(ComponentPool<T>& pool, Entity e)
 	{
-		static auto& idx = typeid(T);
+		if (m_Disabled->Has(e))
+			pool.Disable(e);
+	}
 
-		auto existing = m_Pools.Get(idx);
+	IComponentPool* FindPool(uint64_t typeId) noexcept
+	{
+		return m_Pools.Get(typeId);
+	}
+
+	// Every typed lookup goes through here, so T's id is registered on its first use and a
+	// collision with another type aborts before that type's pool is cast to T
+	template<typename T>
+	ComponentPoolWrapper<T>* LookupPool() noexcept
+	{
+		static const bool claimed = Core::ClaimTypeId(TypeId<T>, Core::TypeName<T>());
+		(void)claimed;
+
+		return static_cast<ComponentPoolWrapper<T>*>(m_Pools.Get(TypeId<T>));
+	}
+
+	template<typename T>
+	ComponentPoolWrapper<T>* GetOrCreatePool()
+	{
+		auto existing = LookupPool<T>();
 		if (existing)
 		{
-			return static_cast<ComponentPoolWrapper<T>*>(existing);
+			return existing;
 		}
 
 		auto wrapper = std::make_unique<ComponentPoolWrapper<T>>();
 		auto ptr = wrapper.get();
-		m_Pools.Insert(idx,std::move(wrapper));
+		m_Pools.Insert(TypeId<T>, std::move(wrapper));
 		
 		return ptr;
 	}
 private:
 	PoolMap m_Pools;
+	std::unique_ptr<BitSet> m_Disabled = std::make_unique<BitSet>(0); // held apart so storage handles survive moves
+	size_t m_CompactCursor = 0; // next bucket Compact visits
 };
 
 } // namespace Composia 
@@ -1,20 +1,102 @@
 #ifndef COMPOSIA_COMPONENT_POOL_H
 #define COMPOSIA_COMPONENT_POOL_H
 
+#include <algorithm> // std::min, std::sort, std::stable_partition
 #include <limits> // std::numeric_limits
+#include <memory> // std::unique_ptr
+#include <type_traits> // std::is_empty_v, std::conditional_t
+#include <concepts> // std::convertible_to
+#include <cstring> // memcpy, memcmp
+#include <numeric> // std::iota
 
 #include "Entity.h"
 #include "Core/SparseSet.h"
+#include "Core/BitSet.h"
+#include "Core/HashedSet.h"
+#include "Core/Signal.h"
+#include "Core/Archive.h"
+#include "Core/TypeInfo.h"
+#include "Delta.h"
+#include "MemoryStats.h"
 using Composia::Core::SparseSet;
+using Composia::Core::BitSet;
+using Composia::Core::HashedSet;
+using Composia::Core::Signal;
+using Composia::Core::Sink;
+using Composia::Core::OutputArchive;
+using Composia::Core::InputArchive;
 
 
 
 namespace Composia {
 
+// Empty types are tags: their pools only track membership and keep no dense value array
+template<typename T>
+inline constexpr bool IsTag = std::is_empty_v<T>;
+
+enum class StoragePolicy
+{
+	SparseSet, // sparse + packed entity arrays, plus a dense value array for non-tags
+	Bitset,    // one bit per entity id, for very dense tags
+	HashMap    // open-addressing entity -> index table instead of a sparse array, for very rare components
+};
+
+// Specialize to choose how a component type is stored, e.g.
+// template<> struct Composia::ComponentTraits<Visible> { static constexpr auto Storage = StoragePolicy::Bitset; };
+template<typename T>
+struct ComponentTraits
+{
+	static constexpr StoragePolicy Storage = StoragePolicy::SparseSet;
+};
+
+template<typename T>
+inline constexpr bool UsesBitset = ComponentTraits<T>::Storage == StoragePolicy::Bitset;
+
+// Snapshots copy trivially copyable components as raw blocks. Other components need a
+// specialization of this hook to be saved, pools of types without one are skipped:
+// template<> struct Composia::ComponentSerializer<Name> {
+//     static void Save(OutputArchive& archive, const Name& value);
+//     static bool Load(InputArchive& archive, Name& value);
+// };
+template<typename T>
+struct ComponentSerializer {};
+
+template<typename T>
+inline constexpr bool HasSerializer = requires(OutputArchive& out, InputArchive& in, const T& saved, T& loaded)
+{
+	ComponentSerializer<T>::Save(out, saved);
+	{ ComponentSerializer<T>::Load(in, loaded) } -> std::convertible_to<bool>;
+};
+
+// Identity and memory layout of a component type as recorded in snapshots
+struct ComponentLayout
+{
+	uint64_t typeHash;
+	uint32_t size;
+	uint32_t alignment;
+	uint32_t storage;
+};
+
+template<typename T>
+inline constexpr bool IsSerializable = IsTag<T> ||
+	(std::is_default_constructible_v<T> && (std::is_trivially_copyable_v<T> || HasSerializer<T>));
+
+// Delta snapshots compare and copy components as raw bytes
+template<typename T>
+inline constexpr bool IsDeltaTracked = IsTag<T> ||
+	(std::is_default_constructible_v<T> && std::is_trivially_copyable_v<T>);
+
 template<typename T>
 class ComponentPool
 {
 public:
+	static_assert(!UsesBitset<T> || IsTag<T>, "Bitset storage only holds tag components");
+
+	using ComponentType = T;
+	using ValueType = std::conditional_t<IsTag<T>, void, T>;
+	using StorageType = std::conditional_t<UsesBitset<T>, BitSet,
+		std::conditional_t<ComponentTraits<T>::Storage == StoragePolicy::HashMap, HashedSet<ValueType>, SparseSet<ValueType>>>;
+
 	ComponentPool() = default;
 
 	inline bool Has(Entity e) const noexcept
@@ -22,45 +104,731 @@ public:
 		return m_Set.Has(e);
 	}
 
+	// Bit i of mask (64 entities per word) is set when entities[i] has a T, see SparseSet::HasBatch
+	inline void HasBatch(const Entity* entities, size_t count, uint64_t* mask) const noexcept
+	{
+		m_Set.HasBatch(entities, count, mask);
+	}
+
 	inline void Add(Entity e, const T& value) noexcept
 	{
-		m_Set.Add(e,value);
+		Unshare();
+		if (m_ListenerCount == 0) [[likely]]
+		{
+			Store(e, value);
+			return;
+		}
+
+		bool existed = m_Set.Has(e);
+		Store(e, value);
+		PublishEmplaced(e, existed);
 	}
 
 	template<typename... Args>
 	void Emplace(Entity e, Args&&... args) noexcept
 	{
-		m_Set.Emplace(e, std::forward<Args>(args)...);
+		static_assert(!IsTag<T> || sizeof...(Args) == 0, "Tag components are emplaced without arguments");
+
+		Unshare();
+		if (m_ListenerCount == 0) [[likely]]
+		{
+			EmplaceStore(e, std::forward<Args>(args)...);
+			return;
+		}
+
+		bool existed = m_Set.Has(e);
+		EmplaceStore(e, std::forward<Args>(args)...);
+		PublishEmplaced(e, existed);
+	}
+
+	// Bulk insert, entities that already own the component get value assigned
+	void Insert(const Entity* entities, size_t count, const T& value)
+	{
+		Unshare();
+		if constexpr (!UsesBitset<T>)
+			m_Set.Reserve(m_Set.Size() + count);
+
+		if (m_ListenerCount == 0) [[likely]]
+		{
+			for (size_t i = 0; i < count; ++i)
+				Store(entities[i], value);
+			return;
+		}
+
+		// sparse sets append newly constructed entities to the packed array, unless disabled
+		// entities sit at its end and get swapped behind them
+		bool appended = false;
+		if constexpr (!UsesBitset<T>)
+			appended = m_Set.EnabledSize() == m_Set.Size();
+
+		DynamicArray<Entity> constructed(0);
+		size_t firstInserted = m_Set.Size();
+		for (size_t i = 0; i < count; ++i)
+		{
+			bool existed = m_Set.Has(entities[i]);
+			Store(entities[i], value);
+			if (existed)
+				m_OnUpdate.Publish(entities[i]);
+			else if (!appended)
+				constructed.PushBack(entities[i]);
+		}
+
+		const Entity* inserted = constructed.Data();
+		if (appended)
+			inserted = m_Set.RawPacked().Data() + firstInserted;
+
+		size_t insertedCount = m_Set.Size() - firstInserted;
+		for (size_t i = 0; i < insertedCount; ++i)
+			m_OnConstruct.Publish(inserted[i]);
+		if (insertedCount > 0)
+			m_OnConstructBatch.Publish(inserted, insertedCount);
 	}
 
 	inline void Remove(Entity e)
 	{
+		Unshare();
+		if (m_ListenerCount != 0) [[unlikely]]
+		{
+			if (!m_Set.Has(e)) return;
+
+			// published before removal so listeners can still read the component
+			m_OnDestroy.Publish(e);
+			m_OnDestroyBatch.Publish(&e, 1);
+		}
 		m_Set.Remove(e);
 	}
 
-	[[nodiscard]] inline T* Get(Entity e) noexcept
+	void Remove(const Entity* entities, size_t count)
+	{
+		Unshare();
+		if (m_ListenerCount != 0) [[unlikely]]
+		{
+			DynamicArray<Entity> removed(count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (m_Set.Has(entities[i]))
+				{
+					m_OnDestroy.Publish(entities[i]);
+					removed.PushBack(entities[i]);
+				}
+			}
+			if (!removed.Empty())
+				m_OnDestroyBatch.Publish(removed.Data(), removed.Size());
+
+			for (Entity e : removed)
+				m_Set.Remove(e);
+			return;
+		}
+
+		for (size_t i = 0; i < count; ++i)
+			m_Set.Remove(entities[i]);
+	}
+
+	// Tags have no storage to point at, query them with Has instead
+	[[nodiscard]] inline T* Get(Entity e) noexcept requires (!IsTag<T>)
 	{
 		if (!Has(e)) return nullptr;
+		Unshare();
 		return m_Set.Get(e);
 	}
 
-	[[nodiscard]] inline const DynamicArray<T>& RawDense() const noexcept
+	// Fills out[i] with the component of entities[i], nullptr where there is none. The sparse and
+	// dense slots of later entities are prefetched while earlier ones are read, so random lookups
+	// overlap their cache misses instead of taking them one after another.
+	void GetMany(const Entity* entities, size_t count, T** out) noexcept requires (!IsTag<T>)
+	{
+		Unshare();
+		constexpr size_t DISTANCE = Core::PREFETCH_DISTANCE;
+		size_t i = 0;
+		for (; i + 2 * DISTANCE < count; ++i)
+		{
+			m_Set.PrefetchSparse(entities[i + 2 * DISTANCE]);
+			m_Set.PrefetchDense(entities[i + DISTANCE]);
+			out[i] = m_Set.Get(entities[i]);
+		}
+		for (; i + DISTANCE < count; ++i)
+		{
+			m_Set.PrefetchDense(entities[i + DISTANCE]);
+			out[i] = m_Set.Get(entities[i]);
+		}
+		for (; i < count; ++i)
+			out[i] = m_Set.Get(entities[i]);
+	}
+
+	// Cache hints for a coming lookup of e, see SparseSet::PrefetchSparse
+	inline void PrefetchSparse(Entity e) const noexcept
+	{
+		m_Set.PrefetchSparse(e);
+	}
+
+	inline void PrefetchDense(Entity e) const noexcept
+	{
+		m_Set.PrefetchDense(e);
+	}
+
+	[[nodiscard]] inline const DynamicArray<T>& RawDense() const noexcept requires (!IsTag<T>)
 	{
 		return m_Set.RawDense();
 	}
 
-	[[nodiscard]] inline const DynamicArray<Entity>& RawEntities() const noexcept
+	// Bitset pools have no packed array, iterate them with Each or RawWords.
+	// The first EnabledSize() entities are the enabled ones.
+	[[nodiscard]] inline const DynamicArray<Entity>& RawEntities() const noexcept requires (!UsesBitset<T>)
 	{
 		return m_Set.RawPacked();
 	}
 
+	[[nodiscard]] inline const DynamicArray<uint64_t>& RawWords() const noexcept requires UsesBitset<T>
+	{
+		return m_Set.RawWords();
+	}
+
+	// Calls func(entity) for every entity in the pool, whatever the storage
+	template<typename Func>
+	void Each(Func&& func) const
+	{
+		if constexpr (UsesBitset<T>)
+		{
+			m_Set.Each(std::forward<Func>(func));
+		}
+		else
+		{
+			for (Entity e : m_Set.RawPacked())
+				func(e);
+		}
+	}
+
 	[[nodiscard]] inline size_t Size() const noexcept
 	{
 		return m_Set.Size();
 	}
 
+	// Moves e's component behind the enabled ones, where views don't look. No signals are published.
+	// Bitset pools have no order to split, views mask their words with the disabled set instead.
+	inline void Disable(Entity e)
+	{
+		if constexpr (!UsesBitset<T>)
+		{
+			Unshare();
+			m_Set.Disable(e);
+		}
+	}
+
+	inline void Enable(Entity e)
+	{
+		if constexpr (!UsesBitset<T>)
+		{
+			Unshare();
+			m_Set.Enable(e);
+		}
+	}
+
+	// Number of components of enabled entities, they come first in RawEntities/RawDense
+	[[nodiscard]] inline size_t EnabledSize() const noexcept requires (!UsesBitset<T>)
+	{
+		return m_Set.EnabledSize();
+	}
+
+	// Reorders the pool so iteration follows compare, which takes two components or two entities
+	// (tags only have the latter). Membership does not change, so no signals are published.
+	template<typename Compare>
+	void Sort(Compare compare) requires (!UsesBitset<T>)
+	{
+		DynamicArray<uint32_t> order(Size());
+		order.Resize(Size());
+		std::iota(order.begin(), order.end(), 0u);
+
+		if constexpr (!IsTag<T> && std::is_invocable_r_v<bool, Compare&, const T&, const T&>)
+		{
+			const DynamicArray<T>& dense = RawDense();
+			std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return compare(dense[a], dense[b]); });
+		}
+		else
+		{
+			const DynamicArray<Entity>& packed = m_Set.RawPacked();
+			std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return compare(packed[a], packed[b]); });
+		}
+		Reorder(order);
+	}
+
+	// Sorts by an integer returned by key(component) or key(entity). Radix sorted, so linear in the
+	// pool size and cheap enough to run every frame, e.g. on a render layer or spatial cell.
+	template<typename KeyFunc>
+	void SortByKey(KeyFunc key) requires (!UsesBitset<T>)
+	{
+		constexpr bool byValue = !IsTag<T> && std::is_invocable_v<KeyFunc&, const T&>;
+		using KeyType = std::decay_t<decltype(SortKey<byValue>(key, 0))>;
+
+		DynamicArray<KeyType> keys(Size());
+		for (uint32_t i = 0; i < Size(); ++i)
+			keys.PushBack(SortKey<byValue>(key, i));
+
+		DynamicArray<uint32_t> order(0);
+		Core::RadixOrder(keys, order);
+		Reorder(order);
+	}
+
+	// Moves the entities this pool shares with other to the front, in other's order, and keeps the rest
+	// behind them in their current order. A view driven by other then reads this pool front to back.
+	template<typename U>
+	void SortAs(const ComponentPool<U>& other) requires (!UsesBitset<T>)
+	{
+		const DynamicArray<Entity>& packed = m_Set.RawPacked();
+		DynamicArray<uint32_t> order(Size());
+		other.Each([&](Entity e) {
+			if (m_Set.Has(e))
+				order.PushBack(m_Set.Index(e));
+			});
+		for (uint32_t i = 0; i < Size(); ++i)
+		{
+			if (!other.Has(packed[i]))
+				order.PushBack(i);
+		}
+		Reorder(order);
+	}
+
+	// Removes every component, publishing OnDestroy for each of them
+	void Clear()
+	{
+		if (m_ListenerCount != 0) [[unlikely]]
+		{
+			DynamicArray<Entity> entities(Size());
+			Each([&](Entity e) { entities.PushBack(e); });
+			for (Entity e : entities)
+				m_OnDestroy.Publish(e);
+			if (!entities.Empty())
+				m_OnDestroyBatch.Publish(entities.Data(), entities.Size());
+		}
+		Unshare();
+		m_Set.Clear();
+	}
+
+	// Writes the packed entities and the dense values as contiguous blocks. Archives with a block
+	// alignment (world images) also carry the sparse array so it can be mapped instead of rebuilt.
+	bool Save(OutputArchive& archive) const
+	{
+		if constexpr (!IsSerializable<T>)
+		{
+			return false;
+		}
+		else if constexpr (UsesBitset<T>)
+		{
+			archive.WriteArray(m_Set.RawWords());
+			return true;
+		}
+		else
+		{
+			archive.WriteArray(m_Set.RawPacked());
+			if constexpr (!IsTag<T>)
+			{
+				if constexpr (std::is_trivially_copyable_v<T>)
+				{
+					archive.WriteArray(RawDense());
+				}
+				else
+				{
+					for (const T& value : RawDense())
+						ComponentSerializer<T>::Save(archive, value);
+				}
+			}
+
+			if constexpr (ComponentTraits<T>::Storage == StoragePolicy::SparseSet)
+			{
+				if (archive.BlockAlignment() != 0)
+					archive.WriteArray(m_Set.RawSparse());
+			}
+			return true;
+		}
+	}
+
+	// Replaces the pool content with a block written by Save, by a pool of this type stored as saved.
+	// Blocks of a mapped archive are used in place when possible, see InputArchive::ReadArray.
+	// Listeners see the old components destroyed and the loaded ones constructed.
+	bool Load(InputArchive& archive, StoragePolicy saved = ComponentTraits<T>::Storage)
+	{
+		if constexpr (!IsSerializable<T>)
+		{
+			return false;
+		}
+		else
+		{
+			Clear();
+
+			bool loaded = LoadStorage(archive, saved);
+			if (loaded)
+				PublishLoaded();
+			return loaded;
+		}
+	}
+
+	// Replaces the pool content with the components Load read into loaded, a pool discarded afterwards.
+	// Listeners see the old components destroyed and the new ones constructed, as with Load.
+	void Take(ComponentPool&& loaded)
+	{
+		Clear();
+		m_Set = std::move(loaded.m_Set);
+		m_Shared = false;
+		PublishLoaded();
+	}
+
+	// Replaces the components with a copy of source's. Listeners are not copied.
+	void CopyFrom(const ComponentPool& source)
+	{
+		m_Set = source.m_Set;
+		m_Shared = false;
+	}
+
+	// Like CopyFrom, but the arrays are shared with source until either pool is modified,
+	// at which point that pool copies them (see DynamicArray::Share)
+	void ShareFrom(ComponentPool& source)
+	{
+		m_Set = source.m_Set.Share();
+		m_Shared = source.m_Shared = true;
+	}
+
+	// Copies the arrays shared with a CloneShared copy, if any. Every write and every Get does this
+	// first; views call it before reading the pool's arrays, which it may reallocate.
+	inline void Unshare()
+	{
+		if (m_Shared) [[unlikely]]
+		{
+			m_Set.Detach();
+			m_Shared = false;
+		}
+	}
+
+	// Gives back memory the pool no longer needs, see Registry::Compact. Pools sharing their
+	// arrays with a CloneShared copy are skipped until they are written to. Returns false when budget
+	// ran out inside the pool, the next call picks up where this one stopped.
+	bool Compact(Core::CompactBudget& budget)
+	{
+		if (m_Shared)
+			return true;
+		return m_Set.Compact(budget);
+	}
+
+	// Renames every entity e to remap[e], see Registry::Defragment. No signals are published.
+	void Remap(const DynamicArray<Entity>& remap, size_t entityCount)
+	{
+		Unshare();
+		m_Set.Remap(remap, entityCount);
+	}
+
+	// Bytes used and reserved by the pool's arrays
+	[[nodiscard]] PoolMemory Memory() const noexcept
+	{
+		PoolMemory memory;
+		memory.typeName = Core::TypeName<T>();
+		memory.typeId = TypeId<T>;
+		memory.count = Size();
+
+		if constexpr (UsesBitset<T>)
+		{
+			memory.sparse = ArrayMemory::Of(m_Set.RawWords());
+		}
+		else
+		{
+			memory.packed = ArrayMemory::Of(m_Set.RawPacked());
+			if constexpr (!IsTag<T>)
+				memory.dense = ArrayMemory::Of(m_Set.RawDense());
+			if constexpr (ComponentTraits<T>::Storage == StoragePolicy::HashMap)
+				memory.sparse = ArrayMemory::Of(m_Set.RawSlots());
+			else
+				memory.sparse = ArrayMemory::Of(m_Set.RawSparse());
+		}
+		return memory;
+	}
+
+	// Copies the pool into state as the baseline for later Diff calls
+	void Capture(PoolState& state) const requires IsDeltaTracked<T>
+	{
+		state = PoolState(Layout().typeHash, Layout().size);
+		if constexpr (!IsTag<T>)
+		{
+			state.Assign(m_Set.RawPacked().Data(), RawDense().Data(), Size());
+		}
+		else
+		{
+			DynamicArray<Entity> entities(Size());
+			Each([&](Entity e) { entities.PushBack(e); });
+			state.Assign(entities.Data(), nullptr, entities.Size());
+		}
+	}
+
+	// Records what was added, removed and changed since baseline. Changes are found by comparing bytes.
+	void Diff(const PoolState& baseline, PoolDelta& delta) const requires IsDeltaTracked<T>
+	{
+		constexpr size_t valueSize = Layout().size;
+		delta.typeHash = Layout().typeHash;
+		delta.valueSize = valueSize;
+		size_t addedBefore = delta.added.Size();
+
+		auto visit = [&](Entity e, const void* value) {
+			if (!baseline.Has(e))
+			{
+				delta.added.PushBack(e);
+				AppendBytes(delta.addedValues, value, valueSize);
+			}
+			else if (valueSize > 0 && memcmp(baseline.Value(e), value, valueSize) != 0)
+			{
+				delta.changed.PushBack(e);
+				AppendBytes(delta.changedBefore, baseline.Value(e), valueSize);
+				AppendBytes(delta.changedAfter, value, valueSize);
+			}
+			};
+
+		if constexpr (!IsTag<T>)
+		{
+			const Entity* packed = m_Set.RawPacked().Data();
+			const T* dense = RawDense().Data();
+			const Entity* before = baseline.Entities().Data();
+			const uint8_t* beforeValues = baseline.Values().Data();
+
+			// rows that kept their entity are compared a block at a time, usually most of the pool
+			constexpr size_t BLOCK = 256;
+			size_t unmoved = std::min(Size(), baseline.Entities().Size());
+			size_t i = 0;
+			for (; i + BLOCK <= unmoved; i += BLOCK)
+			{
+				if (memcmp(packed + i, before + i, BLOCK * sizeof(Entity)) == 0 &&
+					memcmp(dense + i, beforeValues + i * valueSize, BLOCK * valueSize) == 0)
+					continue;
+
+				for (size_t j = i; j < i + BLOCK; ++j)
+				{
+					if (packed[j] != before[j])
+						visit(packed[j], &dense[j]);
+					else if (memcmp(&dense[j], beforeValues + j * valueSize, valueSize) != 0)
+						visit(packed[j], &dense[j]);
+				}
+			}
+			for (; i < Size(); ++i)
+				visit(packed[i], &dense[i]);
+		}
+		else
+		{
+			Each([&](Entity e) { visit(e, nullptr); });
+		}
+
+		// every baseline entity is still present unless some were replaced by the added ones
+		if (Size() - (delta.added.Size() - addedBefore) == baseline.Entities().Size())
+			return;
+
+		for (Entity e : baseline.Entities())
+		{
+			if (!m_Set.Has(e))
+			{
+				delta.removed.PushBack(e);
+				AppendBytes(delta.removedValues, baseline.Value(e), valueSize);
+			}
+		}
+	}
+
+	// Moves the pool to the delta's end state, or back to its start state when reverting. Goes through
+	// Add and Remove, so listeners see the changes as regular construct, update and destroy events.
+	void Apply(const PoolDelta& delta, bool revert) requires IsDeltaTracked<T>
+	{
+		auto store = [this](Entity e, const uint8_t* bytes) {
+			if constexpr (IsTag<T>)
+			{
+				Emplace(e);
+			}
+			else
+			{
+				T value;
+				memcpy(&value, bytes, sizeof(T));
+				Add(e, value);
+			}
+			};
+
+		const auto& gone = revert ? delta.added : delta.removed;
+		const auto& back = revert ? delta.removed : delta.added;
+		const auto& backValues = revert ? delta.removedValues : delta.addedValues;
+		const auto& changedValues = revert ? delta.changedBefore : delta.changedAfter;
+
+		for (Entity e : gone)
+			Remove(e);
+		for (size_t i = 0; i < back.Size(); ++i)
+			store(back[i], backValues.Data() + i * delta.valueSize);
+		for (size_t i = 0; i < delta.changed.Size(); ++i)
+			store(delta.changed[i], changedValues.Data() + i * delta.valueSize);
+	}
+
+	// Layout the pool's blocks are written with, stored in snapshots to validate them on load
+	[[nodiscard]] static constexpr ComponentLayout Layout() noexcept
+	{
+		return ComponentLayout{
+			TypeId<T>,
+			IsTag<T> ? 0u : static_cast<uint32_t>(sizeof(T)),
+			static_cast<uint32_t>(alignof(T)),
+			static_cast<uint32_t>(ComponentTraits<T>::Storage)
+		};
+	}
+
+	// Fired after a component is added to an entity that did not own one
+	[[nodiscard]] inline Sink<Entity> OnConstruct() noexcept
+	{
+		return { m_OnConstruct, m_ListenerCount };
+	}
+
+	// Fired after an existing component is replaced through Add/Emplace/Insert
+	[[nodiscard]] inline Sink<Entity> OnUpdate() noexcept
+	{
+		return { m_OnUpdate, m_ListenerCount };
+	}
+
+	// Fired before a component is removed, including removals done by Registry::Destroy
+	[[nodiscard]] inline Sink<Entity> OnDestroy() noexcept
+	{
+		return { m_OnDestroy, m_ListenerCount };
+	}
+
+	// Batch variants receive every constructed/destroyed entity as well, as contiguous arrays
+	[[nodiscard]] inline Sink<const Entity*, size_t> OnConstructBatch() noexcept
+	{
+		return { m_OnConstructBatch, m_ListenerCount };
+	}
+
+	[[nodiscard]] inline Sink<const Entity*, size_t> OnDestroyBatch() noexcept
+	{
+		return { m_OnDestroyBatch, m_ListenerCount };
+	}
+
 private:
-	SparseSet<T> m_Set;
+
+	// Moves the element at packed index order[i] to index i. Disabled elements stay behind the
+	// enabled ones, both keeping the relative order they have in order.
+	inline void Reorder(DynamicArray<uint32_t>& order)
+	{
+		Unshare();
+		uint32_t enabled = static_cast<uint32_t>(m_Set.EnabledSize());
+		if (enabled != Size())
+			std::stable_partition(order.begin(), order.end(), [enabled](uint32_t index) { return index < enabled; });
+		m_Set.Permute(order);
+	}
+
+	template<bool ByValue, typename KeyFunc>
+	inline auto SortKey(KeyFunc& key, uint32_t index) const
+	{
+		if constexpr (ByValue)
+			return key(RawDense()[index]);
+		else
+			return key(m_Set.RawPacked()[index]);
+	}
+
+	inline void PublishLoaded()
+	{
+		if (m_ListenerCount == 0) [[likely]]
+			return;
+
+		DynamicArray<Entity> entities(Size());
+		Each([&](Entity e) { entities.PushBack(e); });
+		for (Entity e : entities)
+			m_OnConstruct.Publish(e);
+		if (!entities.Empty())
+			m_OnConstructBatch.Publish(entities.Data(), entities.Size());
+	}
+
+	bool LoadStorage(InputArchive& archive, StoragePolicy saved)
+	{
+		if constexpr (UsesBitset<T>)
+		{
+			DynamicArray<uint64_t> words(0);
+			if (!archive.ReadArray(words))
+				return false;
+
+			m_Set.Assign(std::move(words));
+			return true;
+		}
+		else
+		{
+			DynamicArray<Entity> packed(0);
+			if (!archive.ReadArray(packed))
+				return false;
+
+			DynamicArray<std::conditional_t<IsTag<T>, char, T>> dense(0);
+			if constexpr (!IsTag<T>)
+			{
+				if constexpr (std::is_trivially_copyable_v<T>)
+				{
+					if (!archive.ReadArray(dense) || dense.Size() != packed.Size())
+						return false;
+				}
+				else
+				{
+					dense.Resize(packed.Size());
+					for (T& value : dense)
+					{
+						if (!ComponentSerializer<T>::Load(archive, value))
+							return false;
+					}
+				}
+			}
+
+			// images of sparse set pools end with the sparse array, used only if it maps exactly
+			// the loaded keys and rebuilt otherwise
+			DynamicArray<uint32_t> sparse(0);
+			if (saved == StoragePolicy::SparseSet && archive.BlockAlignment() != 0 && !archive.ReadArray(sparse))
+				return false;
+
+			if constexpr (ComponentTraits<T>::Storage == StoragePolicy::SparseSet)
+			{
+				if (!sparse.Empty() && Core::SparseMatches(packed, sparse))
+				{
+					if constexpr (IsTag<T>)
+						m_Set.Assign(std::move(packed), std::move(sparse));
+					else
+						m_Set.Assign(std::move(packed), std::move(dense), std::move(sparse));
+					return true;
+				}
+			}
+
+			if constexpr (IsTag<T>)
+				m_Set.Assign(std::move(packed));
+			else
+				m_Set.Assign(std::move(packed), std::move(dense));
+			return true;
+		}
+	}
+
+	inline void Store(Entity e, const T& value)
+	{
+		if constexpr (IsTag<T>)
+			m_Set.Add(e);
+		else
+			m_Set.Add(e, value);
+	}
+
+	template<typename... Args>
+	inline void EmplaceStore(Entity e, Args&&... args)
+	{
+		if constexpr (IsTag<T>)
+			m_Set.Add(e);
+		else
+			m_Set.Emplace(e, std::forward<Args>(args)...);
+	}
+
+	inline void PublishEmplaced(Entity e, bool existed)
+	{
+		if (existed)
+		{
+			m_OnUpdate.Publish(e);
+			return;
+		}
+
+		m_OnConstruct.Publish(e);
+		m_OnConstructBatch.Publish(&e, 1);
+	}
+
+	StorageType m_Set;
+	bool m_Shared = false;
+
+	uint32_t m_ListenerCount = 0;
+	Signal<Entity> m_OnConstruct;
+	Signal<Entity> m_OnUpdate;
+	Signal<Entity> m_OnDestroy;
+	Signal<const Entity*, size_t> m_OnConstructBatch;
+	Signal<const Entity*, size_t> m_OnDestroyBatch;
 };
 
 // Type-erased component pool interface
@@ -69,7 +837,31 @@ struct IComponentPool
 	virtual ~IComponentPool() = default;
 	virtual void Remove(Entity e) noexcept = 0;
 	virtual bool Has(Entity e) const noexcept = 0;
+	virtual void Disable(Entity e) = 0;
+	virtual void Enable(Entity e) = 0;
 	virtual size_t Size() const noexcept = 0;
+	virtual void Clear() = 0;
+	virtual std::string_view TypeName() const noexcept = 0;
+	virtual PoolMemory Memory() const noexcept = 0;
+	virtual bool Compact(Core::CompactBudget& budget) = 0;
+	virtual void Remap(const DynamicArray<Entity>& remap, size_t entityCount) = 0;
+
+	virtual ComponentLayout Layout() const noexcept = 0;
+	virtual bool Serializable() const noexcept = 0;
+	virtual bool Save(OutputArchive& archive) const = 0;
+	virtual bool Load(InputArchive& archive, StoragePolicy saved) = 0;
+	// An empty pool of the same type, filled by Load and then handed to Take
+	virtual std::unique_ptr<IComponentPool> Empty() const = 0;
+	virtual void Take(IComponentPool& loaded) = 0;
+
+	virtual bool DeltaTracked() const noexcept = 0;
+	virtual void Capture(PoolState& state) const = 0;
+	virtual void Diff(const PoolState& baseline, PoolDelta& delta) const = 0;
+	virtual void Apply(const PoolDelta& delta, bool revert) = 0;
+
+	// nullptr for components that are not copy constructible
+	virtual std::unique_ptr<IComponentPool> Clone() const = 0;
+	virtual std::unique_ptr<IComponentPool> Share() = 0;
 };
 
 template<typename T>
@@ -86,11 +878,126 @@ struct ComponentPoolWrapper : IComponentPool
 		return pool.Has(e);
 	}
 
+	void Disable(Entity e) override
+	{
+		pool.Disable(e);
+	}
+
+	void Enable(Entity e) override
+	{
+		pool.Enable(e);
+	}
+
 	size_t Size() const noexcept override
 	{
 		return pool.Size();
 	}
 
+	void Clear() override
+	{
+		pool.Clear();
+	}
+
+	std::string_view TypeName() const noexcept override
+	{
+		return Core::TypeName<T>();
+	}
+
+	PoolMemory Memory() const noexcept override
+	{
+		return pool.Memory();
+	}
+
+	bool Compact(Core::CompactBudget& budget) override
+	{
+		return pool.Compact(budget);
+	}
+
+	void Remap(const DynamicArray<Entity>& remap, size_t entityCount) override
+	{
+		pool.Remap(remap, entityCount);
+	}
+
+	ComponentLayout Layout() const noexcept override
+	{
+		return ComponentPool<T>::Layout();
+	}
+
+	bool Serializable() const noexcept override
+	{
+		return IsSerializable<T>;
+	}
+
+	bool Save(OutputArchive& archive) const override
+	{
+		return pool.Save(archive);
+	}
+
+	bool Load(InputArchive& archive, StoragePolicy saved) override
+	{
+		return pool.Load(archive, saved);
+	}
+
+	std::unique_ptr<IComponentPool> Empty() const override
+	{
+		return std::make_unique<ComponentPoolWrapper<T>>();
+	}
+
+	void Take(IComponentPool& loaded) override
+	{
+		pool.Take(std::move(static_cast<ComponentPoolWrapper<T>&>(loaded).pool));
+	}
+
+	bool DeltaTracked() const noexcept override
+	{
+		return IsDeltaTracked<T>;
+	}
+
+	void Capture(PoolState& state) const override
+	{
+		if constexpr (IsDeltaTracked<T>)
+			pool.Capture(state);
+	}
+
+	void Diff(const PoolState& baseline, PoolDelta& delta) const override
+	{
+		if constexpr (IsDeltaTracked<T>)
+			pool.Diff(baseline, delta);
+	}
+
+	void Apply(const PoolDelta& delta, bool revert) override
+	{
+		if constexpr (IsDeltaTracked<T>)
+			pool.Apply(delta, revert);
+	}
+
+	std::unique_ptr<IComponentPool> Clone() const override
+	{
+		if constexpr (!std::is_copy_constructible_v<T>)
+		{
+			return nullptr;
+		}
+		else
+		{
+			auto copy = std::make_unique<ComponentPoolWrapper<T>>();
+			copy->pool.CopyFrom(pool);
+			return copy;
+		}
+	}
+
+	std::unique_ptr<IComponentPool> Share() override
+	{
+		if constexpr (!std::is_copy_constructible_v<T>)
+		{
+			return nullptr;
+		}
+		else
+		{
+			auto copy = std::make_unique<ComponentPoolWrapper<T>>();
+			copy->pool.ShareFrom(pool);
+			return copy;
+		}
+	}
 };
 
 } // namespace Composia 
@@ -0,0 +1,314 @@
+#ifndef COMPOSIA_ARCHIVE_H
+#define COMPOSIA_ARCHIVE_H
+
+#include <istream> // std::istream
+#include <ostream> // std::ostream
+#include <type_traits> // std::is_trivially_copyable_v
+#include <algorithm> // std::min
+#include <cstring> // memcpy
+#include <limits> // std::numeric_limits
+#include <memory> // std::shared_ptr
+
+#include "DynamicArray.h"
+
+using Composia::Core::DynamicArray;
+
+namespace Composia::Core {
+
+// Binary writer used by snapshots. Without a stream it only counts bytes, which is how encoded
+// sizes are computed without writing anything. A non-zero block alignment pads
+// every block so it starts at a multiple of it, which lets a mapped archive be used in place.
+class OutputArchive
+{
+public:
+	// offset is where the archive starts within the final output, padding is computed from it
+	OutputArchive(std::ostream* stream = nullptr, size_t blockAlignment = 0, size_t offset = 0) noexcept
+		: m_Stream(stream), m_BlockAlignment(blockAlignment), m_Written(offset) {}
+
+	inline void Write(const void* data, size_t size)
+	{
+		if (m_Stream && size > 0)
+			m_Stream->write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		m_Written += size;
+	}
+
+	template<typename T>
+	inline void Write(const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be written as raw bytes");
+		Write(&value, sizeof(T));
+	}
+
+	inline void WriteBlock(const void* data, size_t size)
+	{
+		if (m_BlockAlignment != 0)
+		{
+			static constexpr char zeros[64] = {};
+			size_t padding = (m_BlockAlignment - m_Written % m_BlockAlignment) % m_BlockAlignment;
+			for (; padding > 0; padding -= std::min(padding, sizeof(zeros)))
+				Write(zeros, std::min(padding, sizeof(zeros)));
+		}
+		Write(data, size);
+	}
+
+	// Writes the element count followed by the elements as one contiguous block
+	template<typename T>
+	inline void WriteArray(const DynamicArray<T>& array)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable arrays can be written as one block");
+		Write(static_cast<uint64_t>(array.Size()));
+		WriteBlock(array.Data(), array.Size() * sizeof(T));
+	}
+
+	// LEB128, seven bits per byte
+	inline void WriteVarint(uint64_t value)
+	{
+		uint8_t bytes[10];
+		size_t size = 0;
+		do
+		{
+			bytes[size++] = static_cast<uint8_t>((value & 0x7F) | (value > 0x7F ? 0x80 : 0));
+			value >>= 7;
+		} while (value != 0);
+		Write(bytes, size);
+	}
+
+	[[nodiscard]] inline size_t Written() const noexcept
+	{
+		return m_Written;
+	}
+
+	// True if Patch can rewrite bytes already written, always so when only counting
+	[[nodiscard]] inline bool Patchable() const
+	{
+		return !m_Stream || m_Stream->tellp() != std::streampos(-1);
+	}
+
+	// Overwrites the value written at offset, e.g. a length only known once what follows it is written
+	template<typename T>
+	inline void Patch(size_t offset, const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be written as raw bytes");
+		if (!m_Stream)
+			return;
+
+		std::streampos end = m_Stream->tellp();
+		m_Stream->seekp(end - static_cast<std::streamoff>(m_Written - offset));
+		m_Stream->write(reinterpret_cast<const char*>(&value), sizeof(T));
+		m_Stream->seekp(end);
+	}
+
+	[[nodiscard]] inline size_t BlockAlignment() const noexcept
+	{
+		return m_BlockAlignment;
+	}
+
+	[[nodiscard]] inline bool Good() const noexcept
+	{
+		return !m_Stream || m_Stream->good();
+	}
+
+private:
+	std::ostream* m_Stream;
+	size_t m_BlockAlignment;
+	size_t m_Written;
+};
+
+// Reads archives written by OutputArchive, either from a stream or from memory. In memory mode
+// ReadArray can adopt aligned blocks in place instead of copying them, owner keeps the memory alive.
+// Counts read from the archive are checked against the bytes left before anything is allocated for
+// them, so corrupt data fails the read instead of exhausting memory.
+class InputArchive
+{
+public:
+	InputArchive(std::istream& stream, size_t blockAlignment = 0)
+		: m_Stream(&stream), m_Size(UNKNOWN_SIZE), m_BlockAlignment(blockAlignment)
+	{
+		// the bytes left are only known for streams that can seek
+		std::streampos start = stream.tellg();
+		if (start == std::streampos(-1))
+			return;
+
+		if (stream.seekg(0, std::ios::end))
+		{
+			std::streampos end = stream.tellg();
+			if (end != std::streampos(-1) && end >= start)
+				m_Size = static_cast<size_t>(end - start);
+		}
+		stream.clear();
+		stream.seekg(start);
+	}
+
+	InputArchive(const void* data, size_t size, std::shared_ptr<const void> owner, size_t blockAlignment = 0) noexcept
+		: m_Data(static_cast<const char*>(data)), m_Size(size), m_Owner(std::move(owner)), m_BlockAlignment(blockAlignment), m_Borrowing(m_Owner != nullptr) {}
+
+	inline bool Read(void* data, size_t size)
+	{
+		if (!m_Stream)
+		{
+			if (!m_Good || size > m_Size - m_Position)
+				return m_Good = false;
+			memcpy(data, m_Data + m_Position, size);
+		}
+		else if (size > 0)
+		{
+			m_Stream->read(static_cast<char*>(data), static_cast<std::streamsize>(size));
+		}
+		m_Position += size;
+		return Good();
+	}
+
+	inline bool ReadVarint(uint64_t& value)
+	{
+		value = 0;
+		for (uint32_t shift = 0; shift < 64; shift += 7)
+		{
+			uint8_t byte = 0;
+			if (!Read(byte))
+				return false;
+
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	inline bool ReadBlock(void* data, size_t size)
+	{
+		return SkipPadding() && Read(data, size);
+	}
+
+	template<typename T>
+	inline bool Read(T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be read as raw bytes");
+		return Read(&value, sizeof(T));
+	}
+
+	// Reads an array written by OutputArchive::WriteArray, replacing the content of array
+	template<typename T>
+	inline bool ReadArray(DynamicArray<T>& array)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable arrays can be read as one block");
+		uint64_t size = 0;
+		if (!Read(size) || !SkipPadding() || !Holds(size, sizeof(T))) return false;
+
+		if (!m_Stream && m_Borrowing && reinterpret_cast<uintptr_t>(m_Data + m_Position) % alignof(T) == 0)
+		{
+			array.Adopt(reinterpret_cast<T*>(const_cast<char*>(m_Data + m_Position)), static_cast<size_t>(size), m_Owner);
+			m_Position += static_cast<size_t>(size) * sizeof(T);
+			return true;
+		}
+		return ReadElements(array, size);
+	}
+
+	// Reads count elements into array, replacing its content
+	template<typename T>
+	bool ReadElements(DynamicArray<T>& array, uint64_t count)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable elements can be read as raw bytes");
+		if (!Holds(count, sizeof(T)))
+			return false;
+
+		array.Clear();
+		if (m_Size != UNKNOWN_SIZE)
+		{
+			array.Resize(static_cast<size_t>(count));
+			return Read(array.Data(), array.Size() * sizeof(T));
+		}
+
+		// nothing bounds count on streams that can't seek, the array only grows as data arrives
+		constexpr size_t STEP = std::max<size_t>(1, UNKNOWN_SIZE_STEP_BYTES / sizeof(T));
+		for (size_t read = 0; read < count; )
+		{
+			size_t step = static_cast<size_t>(std::min<uint64_t>(STEP, count - read));
+			array.Reserve(std::max(array.Capacity() * 2, read + step));
+			array.Resize(read + step);
+			if (!Read(array.Data() + read, step * sizeof(T)))
+				return false;
+			read += step;
+		}
+		return true;
+	}
+
+	// True if count elements of elementSize bytes may still be in the archive: their total size does
+	// not overflow and does not exceed the bytes left, when those are known
+	[[nodiscard]] inline bool Holds(uint64_t count, size_t elementSize) const noexcept
+	{
+		size_t left = m_Size == UNKNOWN_SIZE ? std::numeric_limits<size_t>::max() : m_Size - std::min(m_Position, m_Size);
+		return elementSize == 0 || count <= left / elementSize;
+	}
+
+	inline bool Skip(size_t size)
+	{
+		if (!m_Stream)
+		{
+			if (size > m_Size - m_Position)
+				return m_Good = false;
+		}
+		else
+		{
+			m_Stream->ignore(static_cast<std::streamsize>(size));
+		}
+		m_Position += size;
+		return Good();
+	}
+
+	// Bytes read or skipped so far
+	[[nodiscard]] inline size_t Consumed() const noexcept
+	{
+		return m_Position;
+	}
+
+	// Memory mode adopts blocks in place only while borrowing is enabled
+	inline void Borrowing(bool enabled) noexcept
+	{
+		m_Borrowing = enabled && m_Owner != nullptr;
+	}
+
+	[[nodiscard]] inline bool Borrowing() const noexcept
+	{
+		return m_Borrowing;
+	}
+
+	[[nodiscard]] inline size_t BlockAlignment() const noexcept
+	{
+		return m_BlockAlignment;
+	}
+
+	// Set once the archive header telling how blocks were written has been read
+	inline void BlockAlignment(size_t alignment) noexcept
+	{
+		m_BlockAlignment = alignment;
+	}
+
+	[[nodiscard]] inline bool Good() const noexcept
+	{
+		return m_Stream ? m_Stream->good() : m_Good;
+	}
+
+private:
+	static constexpr size_t UNKNOWN_SIZE = std::numeric_limits<size_t>::max();
+	static constexpr size_t UNKNOWN_SIZE_STEP_BYTES = 1 << 20;
+
+	inline bool SkipPadding()
+	{
+		if (m_BlockAlignment == 0)
+			return Good();
+		return Skip((m_BlockAlignment - m_Position % m_BlockAlignment) % m_BlockAlignment);
+	}
+
+	std::istream* m_Stream = nullptr;
+	const char* m_Data = nullptr;
+	size_t m_Size = 0;
+	std::shared_ptr<const void> m_Owner;
+	size_t m_BlockAlignment;
+	size_t m_Position = 0;
+	bool m_Borrowing = false;
+	bool m_Good = true;
+};
+
+} // namespace Composia::Core
+
+#endif // !COMPOSIA_ARCHIVE_H
@@ -0,0 +1,184 @@
+#ifndef COMPOSIA_BIT_SET_H
+#define COMPOSIA_BIT_SET_H
+
+#include <algorithm> // std::fill, std::min
+#include <bit> // std::popcount, std::countr_zero
+#include <cassert> // assert
+
+#include "DynamicArray.h"
+#include "Prefetch.h"
+
+using Composia::Core::DynamicArray;
+using Key = uint32_t;
+
+namespace Composia::Core {
+
+// Membership set with one bit per key. Costs maxKey / 8 bytes regardless of how many keys
+// are present, which beats a sparse set's 8+ bytes per key once the set is dense.
+class BitSet
+{
+public:
+	static constexpr size_t BITS_PER_WORD = 64;
+
+	BitSet(size_t reserveKeys = 1024)
+	{
+		m_Words.Resize((reserveKeys + BITS_PER_WORD - 1) / BITS_PER_WORD, 0);
+	}
+
+	inline bool Has(Key k) const noexcept
+	{
+		size_t word = k / BITS_PER_WORD;
+		return word < m_Words.Size() && (m_Words[word] >> (k % BITS_PER_WORD)) & 1;
+	}
+
+	inline void Add(Key k) noexcept
+	{
+		size_t word = k / BITS_PER_WORD;
+		if (word >= m_Words.Size())
+			EnsureWordCount(word + 1);
+
+		uint64_t mask = uint64_t(1) << (k % BITS_PER_WORD);
+		m_Count += (m_Words[word] & mask) == 0;
+		m_Words[word] |= mask;
+	}
+
+	inline void Remove(Key k) noexcept
+	{
+		size_t word = k / BITS_PER_WORD;
+		if (word >= m_Words.Size()) return;
+
+		uint64_t mask = uint64_t(1) << (k % BITS_PER_WORD);
+		m_Count -= (m_Words[word] & mask) != 0;
+		m_Words[word] &= ~mask;
+	}
+
+	// See SparseSet::HasBatch
+	inline void HasBatch(const Key* keys, size_t count, uint64_t* mask) const noexcept
+	{
+		std::fill(mask, mask + (count + 63) / 64, 0);
+		for (size_t i = 0; i < count; ++i)
+			mask[i / 64] |= uint64_t(Has(keys[i])) << (i % 64);
+	}
+
+	// Same interface as SparseSet, a key's word is all there is to fetch
+	inline void PrefetchSparse(Key k) const noexcept
+	{
+		if (k / BITS_PER_WORD < m_Words.Size())
+			Prefetch(m_Words.Data() + k / BITS_PER_WORD);
+	}
+
+	inline void PrefetchDense(Key) const noexcept {}
+
+	inline void Reserve(size_t keys)
+	{
+		m_Words.Reserve((keys + BITS_PER_WORD - 1) / BITS_PER_WORD);
+	}
+
+	// Drops the all-zero words past the highest key and gives back spare capacity. Stays within
+	// budget, words are dropped as they are scanned, and returns false when it has to be called again.
+	bool Compact(CompactBudget& budget)
+	{
+		size_t end = m_Words.Size() - std::min(m_Words.Size(), budget.Left());
+		size_t words = m_Words.Size();
+		while (words > end && m_Words[words - 1] == 0)
+			--words;
+		budget.work += m_Words.Size() - words;
+		m_Words.Resize(words);
+
+		if (words != 0 && words == end && m_Words[words - 1] == 0)
+			return false;
+		return budget.Compact(m_Words);
+	}
+
+	// Renames every key k to remap[k], keeping words for keys below keyCount only
+	void Remap(const DynamicArray<Key>& remap, size_t keyCount)
+	{
+		DynamicArray<uint64_t> words((keyCount + BITS_PER_WORD - 1) / BITS_PER_WORD);
+		words.Resize((keyCount + BITS_PER_WORD - 1) / BITS_PER_WORD, 0);
+		Each([&](Key k) {
+			assert(k < remap.Size() && remap[k] < keyCount && "Key missing from the remap table");
+			Key renamed = remap[k];
+			words[renamed / BITS_PER_WORD] |= uint64_t(1) << (renamed % BITS_PER_WORD);
+			});
+		m_Words = std::move(words);
+	}
+
+	// Copy that shares the words with this set, see DynamicArray::Share
+	BitSet Share()
+	{
+		BitSet shared(0);
+		shared.m_Words = m_Words.Share();
+		shared.m_Count = m_Count;
+		return shared;
+	}
+
+	// Must be called before modifying a set that came out of Share
+	inline void Detach()
+	{
+		m_Words.Detach();
+	}
+
+	inline void Clear() noexcept
+	{
+		for (uint64_t& word : m_Words)
+			word = 0;
+		m_Count = 0;
+	}
+
+	// Takes over words, recounting the set bits
+	void Assign(DynamicArray<uint64_t>&& words) noexcept
+	{
+		m_Words = std::move(words);
+
+		m_Count = 0;
+		for (uint64_t word : m_Words)
+			m_Count += std::popcount(word);
+	}
+
+	// Calls func(key) for every set bit in ascending order, one tzcnt per key
+	template<typename Func>
+	void Each(Func&& func) const
+	{
+		for (size_t w = 0; w < m_Words.Size(); ++w)
+		{
+			uint64_t word = m_Words[w];
+			while (word)
+			{
+				func(static_cast<Key>(w * BITS_PER_WORD + std::countr_zero(word)));
+				word &= word - 1;
+			}
+		}
+	}
+
+	[[nodiscard]] inline const DynamicArray<uint64_t>& RawWords() const noexcept
+	{
+		return m_Words;
+	}
+
+	[[nodiscard]] inline size_t WordCount() const noexcept
+	{
+		return m_Words.Size();
+	}
+
+	[[nodiscard]] inline size_t Size() const noexcept
+	{
+		return m_Count;
+	}
+
+private:
+	inline void EnsureWordCount(size_t count) noexcept
+	{
+		size_t newCount = m_Words.Size() == 0 ? 1 : m_Words.Size();
+		while (newCount < count)
+			newCount *= 2;
+
+		m_Words.Resize(newCount, 0);
+	}
+
+	DynamicArray<uint64_t> m_Words;
+	size_t m_Count = 0;
+};
+
+} // namespace Composia::Core
+
+#endif // !COMPOSIA_BIT_SET_H
@@ -2,12 +2,17 @@
 #define COMPOSIA_DYNAMIC_ARRAY_H
 
 
+#include <algorithm> // std::min
 #include <cstdint>
 #include <cstddef>
 #include <new>       // operator new / delete
 #include <utility>   // std::move, std::forward
 #include <cassert> // assert
 #include <type_traits> // std::is_trivially_destructible_v
+#include <memory> // std::shared_ptr
+#include <cstring> // memcpy
+
+#include "Instrumentation.h"
 
 namespace Composia::Core {
 
@@ -21,11 +26,129 @@ public:
 		m_Data = static_cast<T*>(operator new(m_Capacity * sizeof(T)));
 	}
 
+	DynamicArray(const DynamicArray& other)
+		: m_Capacity(other.m_Size), m_Size(0), m_GrowMultiplier(other.m_GrowMultiplier), m_Data(nullptr)
+	{
+		m_Data = static_cast<T*>(operator new(m_Capacity * sizeof(T)));
+		CopyElements(other);
+	}
+
+	DynamicArray(DynamicArray&& other) noexcept
+		: m_Capacity(other.m_Capacity), m_Size(other.m_Size), m_GrowMultiplier(other.m_GrowMultiplier),
+		m_Data(other.m_Data), m_Owner(std::move(other.m_Owner)), m_CopyOnWrite(other.m_CopyOnWrite)
+	{
+		other.m_Capacity = 0;
+		other.m_Size = 0;
+		other.m_Data = nullptr;
+		other.m_CopyOnWrite = false;
+	}
+
+	DynamicArray& operator=(const DynamicArray& other)
+	{
+		if (this != &other)
+		{
+			Clear();
+			if (other.m_Size > m_Capacity || m_Owner)
+			{
+				Release();
+				m_Capacity = other.m_Size;
+				m_Data = static_cast<T*>(operator new(m_Capacity * sizeof(T)));
+			}
+			m_GrowMultiplier = other.m_GrowMultiplier;
+			CopyElements(other);
+		}
+		return *this;
+	}
+
+	DynamicArray& operator=(DynamicArray&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Release();
+			m_Capacity = other.m_Capacity;
+			m_Size = other.m_Size;
+			m_GrowMultiplier = other.m_GrowMultiplier;
+			m_Data = other.m_Data;
+			m_Owner = std::move(other.m_Owner);
+			m_CopyOnWrite = other.m_CopyOnWrite;
+
+			other.m_Capacity = 0;
+			other.m_Size = 0;
+			other.m_Data = nullptr;
+			other.m_CopyOnWrite = false;
+		}
+		return *this;
+	}
+
 	~DynamicArray()
 	{
-		for (size_t i = 0; i < m_Size; ++i)
-			m_Data[i].~T();
-		operator delete(m_Data);
+		Release();
+	}
+
+	// Uses size elements at data in place instead of an owned buffer, owner keeps that memory alive.
+	// Elements may be written in place; the first growth copies them to an owned buffer.
+	void Adopt(T* data, size_t size, std::shared_ptr<const void> owner)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable elements can live in borrowed memory");
+
+		Release();
+		m_Data = data;
+		m_Size = size;
+		m_Capacity = size;
+		m_Owner = std::move(owner);
+	}
+
+	// True while the elements live in memory adopted through Adopt or shared through Share
+	inline bool Borrowed() const noexcept
+	{
+		return m_Owner != nullptr;
+	}
+
+	// Returns an array reading the same elements without copying them. Both arrays are copy-on-write
+	// from then on: their owners have to call Detach before modifying them in any way other than growing.
+	// Arrays of non trivially copyable elements are copied right away.
+	DynamicArray Share()
+	{
+		if constexpr (!std::is_trivially_copyable_v<T>)
+		{
+			return DynamicArray(*this);
+		}
+		else
+		{
+			// hand the buffer over to an owner both arrays keep alive
+			if (!m_Owner)
+				m_Owner = std::shared_ptr<const void>(m_Data, [](const void* data) { operator delete(const_cast<void*>(data)); });
+			m_Capacity = m_Size;
+			m_CopyOnWrite = true;
+
+			DynamicArray shared(0);
+			shared.Release();
+			shared.m_Capacity = m_Size;
+			shared.m_Size = m_Size;
+			shared.m_GrowMultiplier = m_GrowMultiplier;
+			shared.m_Data = m_Data;
+			shared.m_Owner = m_Owner;
+			shared.m_CopyOnWrite = true;
+			return shared;
+		}
+	}
+
+	// Copies shared elements to an owned buffer, a no-op unless the array came out of Share. Once
+	// every other array sharing them was detached or destroyed the elements are taken over as they are.
+	inline void Detach()
+	{
+		if (m_CopyOnWrite) [[unlikely]]
+		{
+			if (m_Owner.use_count() == 1)
+				m_CopyOnWrite = false;
+			else
+				Reserve(m_Capacity + 1);
+		}
+	}
+
+	inline bool Shared() const noexcept
+	{
+		return m_CopyOnWrite;
 	}
 
 	inline void PushBack(const T& value) noexcept
@@ -94,6 +217,12 @@ public:
 		return m_Size;
 	}
 
+	// Bytes Compact would give back
+	[[nodiscard]] inline size_t CompactBytes() const noexcept
+	{
+		return CompactMoves() == 0 ? 0 : (m_Capacity - (m_Size + m_Size / 4)) * sizeof(T);
+	}
+
 	inline size_t Capacity() const noexcept
 	{
 		return m_Capacity;
@@ -107,25 +236,27 @@ public:
 	void Reserve(size_t newCapacity)
 	{
 		if (newCapacity <= m_Capacity) return;
-		T* newPtr = static_cast<T*>(operator new(newCapacity * sizeof(T)));
+		Reallocate(newCapacity);
+	}
 
-		if constexpr (std::is_trivially_copyable_v<T>)
-		{
-			memcpy(newPtr, m_Data, m_Size * sizeof(T));
-		}
-		else
-		{
-			for (size_t i = 0; i < m_Size; ++i)
-			{
-				new (&newPtr[i]) T(std::move(m_Data[i]));
-				if constexpr (!std::is_trivially_destructible_v<T>)
-					m_Data[i].~T();
-			}
-		}
+	// Gives capacity back once less than half of it is used, keeping a quarter of the size as headroom
+	// so an array that shrank does not bounce between growing and shrinking. Arrays smaller than a page
+	// and borrowed arrays are left alone. Returns the bytes released.
+	size_t Compact()
+	{
+		size_t released = CompactBytes();
+		if (released != 0)
+			Reallocate(m_Size + m_Size / 4);
+		return released;
+	}
 
-		operator delete(m_Data);
-		m_Data = newPtr;
-		m_Capacity = newCapacity;
+	// Elements Compact would move, 0 when it would leave the array as it is
+	[[nodiscard]] inline size_t CompactMoves() const noexcept
+	{
+		size_t target = m_Size + m_Size / 4;
+		if (m_Owner || m_Capacity <= 2 * m_Size || (m_Capacity - target) * sizeof(T) < COMPACT_MIN_BYTES)
+			return 0;
+		return m_Size;
 	}
 
 	void Resize(size_t newSize)
@@ -242,16 +373,129 @@ public:
 	const T* end() const noexcept { return m_Data + m_Size; }
 
 private:
+	inline void Release() noexcept
+	{
+		for (size_t i = 0; i < m_Size; ++i)
+			m_Data[i].~T();
+		if (!m_Owner)
+			operator delete(m_Data);
+		m_Owner.reset();
+		m_CopyOnWrite = false;
+	}
+
+	inline void CopyElements(const DynamicArray& other)
+	{
+		if constexpr (std::is_trivially_copyable_v<T>)
+		{
+			if (other.m_Size > 0)
+				memcpy(m_Data, other.m_Data, other.m_Size * sizeof(T));
+		}
+		else
+		{
+			for (size_t i = 0; i < other.m_Size; ++i)
+				new (&m_Data[i]) T(other.m_Data[i]);
+		}
+		m_Size = other.m_Size;
+	}
+
+	void Reallocate(size_t newCapacity)
+	{
+		T* newPtr = static_cast<T*>(operator new(newCapacity * sizeof(T)));
+		COMPOSIA_COUNT(ArrayReallocations, 1);
+		COMPOSIA_COUNT(ArrayBytesMoved, m_Size * sizeof(T));
+
+		if constexpr (std::is_trivially_copyable_v<T>)
+		{
+			memcpy(newPtr, m_Data, m_Size * sizeof(T));
+		}
+		else
+		{
+			for (size_t i = 0; i < m_Size; ++i)
+			{
+				new (&newPtr[i]) T(std::move(m_Data[i]));
+				if constexpr (!std::is_trivially_destructible_v<T>)
+					m_Data[i].~T();
+			}
+		}
+
+		if (!m_Owner)
+			operator delete(m_Data);
+		m_Owner.reset();
+		m_CopyOnWrite = false;
+		m_Data = newPtr;
+		m_Capacity = newCapacity;
+	}
+
 	inline void Grow() noexcept
 	{
 		size_t newCapacity = m_Capacity != 0 ? m_Capacity * m_GrowMultiplier : 1;
 		Reserve(newCapacity);
 	}
 
+	static constexpr size_t COMPACT_MIN_BYTES = 4096;
+
 	size_t m_Capacity;
 	size_t m_Size;
 	uint8_t m_GrowMultiplier;
 	T* m_Data;
+	std::shared_ptr<const void> m_Owner;
+	bool m_CopyOnWrite = false;
+};
+
+// Work allowance of one budgeted compaction pass, shared by every array it visits. work counts the
+// elements scanned or moved so far; a step may run COMPACT_STEP elements past budget, so every pass
+// makes progress however small budget is, but never further.
+struct CompactBudget
+{
+	static constexpr size_t COMPACT_STEP = 1024;
+
+	size_t budget = SIZE_MAX;
+	size_t work = 0;
+	size_t released = 0;
+	size_t deferred = 0; // bytes the skipped steps would have given back
+
+	// Elements that may still be scanned or moved in this pass
+	[[nodiscard]] inline size_t Left() const noexcept
+	{
+		size_t limit = budget < SIZE_MAX - COMPACT_STEP ? budget + COMPACT_STEP : SIZE_MAX;
+		return work < limit ? limit - work : 0;
+	}
+
+	// Whether the pass should stop before starting on another array
+	[[nodiscard]] inline bool Spent() const noexcept
+	{
+		return work >= budget;
+	}
+
+	// Runs step, which moves that many elements to give back bytes, if it fits what is left. Returns
+	// false without running it when it would fit a fresh pass instead. A step larger than budget +
+	// COMPACT_STEP fits no pass of this budget: it is skipped and its bytes are counted as deferred.
+	template<typename Func>
+	bool Step(size_t moves, size_t bytes, Func&& step)
+	{
+		if (moves - std::min(moves, COMPACT_STEP) > budget)
+		{
+			deferred += bytes;
+			return true;
+		}
+		if (moves > Left())
+			return false;
+
+		step();
+		work += moves;
+		released += bytes;
+		return true;
+	}
+
+	// Reallocates array smaller as one Step, see DynamicArray::Compact
+	template<typename T>
+	bool Compact(DynamicArray<T>& array)
+	{
+		size_t moves = array.CompactMoves();
+		if (moves == 0)
+			return true;
+		return Step(moves, array.CompactBytes(), [&] { array.Compact(); });
+	}
 };
 
 } // namespace Composia::Core 
@@ -0,0 +1,434 @@
+#ifndef COMPOSIA_HASHED_SET_H
+#define COMPOSIA_HASHED_SET_H
+
+#include <algorithm> // std::fill, std::min
+#include <cassert> // assert
+#include <limits> // std::numeric_limits
+#include <type_traits> // std::is_void_v, std::conditional_t
+#include <utility> // std::swap
+
+#include "DynamicArray.h"
+#include "Prefetch.h"
+#include "Sort.h"
+
+using Composia::Core::DynamicArray;
+using Key = uint32_t;
+
+namespace Composia::Core {
+
+// Sparse set variant for very rare keys: the key -> dense index mapping lives in an
+// open-addressing table (linear probing, backward shift deletion) sized by the number of
+// keys instead of a sparse array sized by the largest key. The packed and dense arrays are
+// kept as in SparseSet so iteration stays linear. T = void stores keys only.
+template<typename T>
+class HashedSet
+{
+	struct NoValues {};
+
+public:
+	HashedSet(size_t reserveSize = 16)
+	{
+		m_Packed.Reserve(reserveSize);
+		if constexpr (!std::is_void_v<T>)
+			m_Dense.Reserve(reserveSize);
+		Rehash(MIN_SLOTS);
+	}
+
+	inline bool Has(Key k) const noexcept
+	{
+		return Find(k) != NOT_FOUND;
+	}
+
+	template<typename U = T>
+	inline void Add(Key k, const U& value) noexcept requires (!std::is_void_v<T>)
+	{
+		size_t slot = Find(k);
+		if (slot != NOT_FOUND)
+		{
+			m_Dense[m_Slots[slot].index] = value;
+			return;
+		}
+
+		Insert(k);
+		m_Dense.PushBack(value);
+		EnableLast();
+	}
+
+	template<typename... Args>
+	inline void Emplace(Key k, Args&&... args) requires (!std::is_void_v<T>)
+	{
+		size_t slot = Find(k);
+		if (slot != NOT_FOUND)
+		{
+			m_Dense[m_Slots[slot].index] = T(std::forward<Args>(args)...);
+			return;
+		}
+
+		Insert(k);
+		m_Dense.EmplaceBack(std::forward<Args>(args)...);
+		EnableLast();
+	}
+
+	inline void Add(Key k) noexcept requires std::is_void_v<T>
+	{
+		if (Find(k) == NOT_FOUND)
+		{
+			Insert(k);
+			EnableLast();
+		}
+	}
+
+	inline void Remove(Key k) noexcept
+	{
+		size_t slot = Find(k);
+		if (slot == NOT_FOUND) return;
+
+		uint32_t removedIndex = m_Slots[slot].index;
+		uint32_t lastIndex = static_cast<uint32_t>(m_Packed.Size() - 1);
+
+		// an enabled element first trades places with the last enabled one, keeping the partition
+		if (removedIndex < m_Enabled && --m_Enabled != lastIndex)
+		{
+			Swap(removedIndex, m_Enabled);
+			removedIndex = m_Enabled;
+		}
+		EraseSlot(slot);
+
+		// move last element into removed slot
+		if (removedIndex != lastIndex)
+		{
+			Key movedKey = m_Packed[lastIndex];
+			m_Packed[removedIndex] = movedKey;
+			m_Slots[Find(movedKey)].index = removedIndex;
+			if constexpr (!std::is_void_v<T>)
+				m_Dense[removedIndex] = std::move(m_Dense[lastIndex]);
+		}
+
+		m_Packed.PopBack();
+		if constexpr (!std::is_void_v<T>)
+			m_Dense.PopBack();
+	}
+
+	template<typename U = T>
+	[[nodiscard]] inline U* Get(Key k) noexcept requires (!std::is_void_v<T>)
+	{
+		size_t slot = Find(k);
+		if (slot == NOT_FOUND) return nullptr;
+		return &m_Dense[m_Slots[slot].index];
+	}
+
+	// See SparseSet::HasBatch, probes one key at a time
+	inline void HasBatch(const Key* keys, size_t count, uint64_t* mask) const noexcept
+	{
+		std::fill(mask, mask + (count + 63) / 64, 0);
+		for (size_t i = 0; i < count; ++i)
+			mask[i / 64] |= uint64_t(Has(keys[i])) << (i % 64);
+	}
+
+	// See SparseSet::PrefetchSparse. Only the home slot is fetched, and the dense slot only when
+	// the key sits there, which the low load factor makes the common case.
+	inline void PrefetchSparse(Key k) const noexcept
+	{
+		Prefetch(m_Slots.Data() + Home(k));
+	}
+
+	inline void PrefetchDense(Key k) const noexcept
+	{
+		if constexpr (!std::is_void_v<T>)
+		{
+			const Slot& slot = m_Slots[Home(k)];
+			if (slot.key == k)
+				Prefetch(m_Dense.Data() + slot.index);
+		}
+	}
+
+	// Enabled keys come first in the packed order, see SparseSet::Disable
+	inline void Disable(Key k) noexcept
+	{
+		size_t slot = Find(k);
+		if (slot == NOT_FOUND || m_Slots[slot].index >= m_Enabled) return;
+		Swap(m_Slots[slot].index, --m_Enabled);
+	}
+
+	inline void Enable(Key k) noexcept
+	{
+		size_t slot = Find(k);
+		if (slot == NOT_FOUND || m_Slots[slot].index < m_Enabled) return;
+		Swap(m_Slots[slot].index, m_Enabled++);
+	}
+
+	[[nodiscard]] inline bool IsEnabled(Key k) const noexcept
+	{
+		size_t slot = Find(k);
+		return slot != NOT_FOUND && m_Slots[slot].index < m_Enabled;
+	}
+
+	inline void Reserve(size_t capacity)
+	{
+		m_Packed.Reserve(capacity);
+		if constexpr (!std::is_void_v<T>)
+			m_Dense.Reserve(capacity);
+
+		size_t slots = m_Slots.Size();
+		while (capacity * 2 > slots)
+			slots *= 2;
+		if (slots != m_Slots.Size())
+			Rehash(slots);
+	}
+
+	// Copy that shares all arrays with this set, see DynamicArray::Share
+	HashedSet Share()
+	{
+		HashedSet shared(0);
+		shared.m_Slots = m_Slots.Share();
+		shared.m_Packed = m_Packed.Share();
+		if constexpr (!std::is_void_v<T>)
+			shared.m_Dense = m_Dense.Share();
+		shared.m_Shift = m_Shift;
+		shared.m_Enabled = m_Enabled;
+		return shared;
+	}
+
+	// Must be called before modifying a set that came out of Share
+	inline void Detach()
+	{
+		m_Slots.Detach();
+		m_Packed.Detach();
+		if constexpr (!std::is_void_v<T>)
+			m_Dense.Detach();
+	}
+
+	inline void Clear()
+	{
+		m_Packed.Clear();
+		if constexpr (!std::is_void_v<T>)
+			m_Dense.Clear();
+		m_Enabled = 0;
+		Rehash(MIN_SLOTS);
+	}
+
+	// Takes over packed keys and their values, then rebuilds the table in one pass
+	template<typename U = T>
+	void Assign(DynamicArray<Key>&& packed, DynamicArray<U>&& dense) noexcept requires (!std::is_void_v<T>)
+	{
+		m_Dense = std::move(dense);
+		AssignPacked(std::move(packed));
+	}
+
+	void Assign(DynamicArray<Key>&& packed) noexcept requires std::is_void_v<T>
+	{
+		AssignPacked(std::move(packed));
+	}
+
+	template<typename U = T>
+	[[nodiscard]] const DynamicArray<U>& RawDense() const noexcept requires (!std::is_void_v<T>)
+	{
+		return m_Dense;
+	}
+
+	// Halves the slot table while it is less than an eighth full and gives back spare capacity.
+	// The rehash is one CompactBudget::Step, so it may wait for the next call (returning false).
+	bool Compact(CompactBudget& budget)
+	{
+		size_t slots = m_Slots.Size();
+		while (slots > MIN_SLOTS && m_Packed.Size() * 8 < slots)
+			slots /= 2;
+		if (slots != m_Slots.Size())
+		{
+			size_t bytes = (m_Slots.Size() - slots) * sizeof(Slot);
+			bool stepped = budget.Step(slots + m_Packed.Size(), bytes, [&] {
+				m_Slots = DynamicArray<Slot>(slots);
+				Rehash(slots);
+				});
+			if (!stepped)
+				return false;
+		}
+
+		if constexpr (!std::is_void_v<T>)
+			return budget.Compact(m_Packed) && budget.Compact(m_Dense);
+		else
+			return budget.Compact(m_Packed);
+	}
+
+	// Renames every key k to remap[k], the table is rebuilt at its current size
+	void Remap(const DynamicArray<Key>& remap, size_t keyCount)
+	{
+		for (Key& k : m_Packed)
+		{
+			assert(k < remap.Size() && remap[k] < keyCount && "Key missing from the remap table");
+			k = remap[k];
+		}
+		Rehash(m_Slots.Size());
+	}
+
+	// Position of k in the packed order, k must be in the set
+	[[nodiscard]] inline uint32_t Index(Key k) const noexcept
+	{
+		return m_Slots[Find(k)].index;
+	}
+
+	// Moves the element at packed index order[i] to index i
+	void Permute(DynamicArray<uint32_t>& order)
+	{
+		for (uint32_t i = 0; i < order.Size(); ++i)
+		{
+			if (order[i] != i)
+				m_Slots[Find(m_Packed[order[i]])].index = i;
+		}
+
+		if constexpr (std::is_void_v<T>)
+			PermuteInPlace(order, m_Packed);
+		else
+			PermuteInPlace(order, m_Packed, m_Dense);
+	}
+
+	[[nodiscard]] inline const DynamicArray<Key>& RawPacked() const noexcept
+	{
+		return m_Packed;
+	}
+
+	[[nodiscard]] inline size_t Size() const noexcept
+	{
+		return m_Packed.Size();
+	}
+
+	[[nodiscard]] inline size_t EnabledSize() const noexcept
+	{
+		return m_Enabled;
+	}
+
+	[[nodiscard]] inline size_t SlotCount() const noexcept
+	{
+		return m_Slots.Size();
+	}
+
+	[[nodiscard]] inline const auto& RawSlots() const noexcept
+	{
+		return m_Slots;
+	}
+
+private:
+	struct Slot
+	{
+		Key key = EMPTY_KEY;
+		uint32_t index = 0;
+	};
+
+	static constexpr Key EMPTY_KEY = std::numeric_limits<Key>::max();
+	static constexpr size_t NOT_FOUND = std::numeric_limits<size_t>::max();
+	static constexpr size_t MIN_SLOTS = 16;
+
+	// Fibonacci hashing spreads sequential entity ids over the table
+	inline size_t Home(Key k) const noexcept
+	{
+		return static_cast<size_t>((uint64_t(k) * 0x9E3779B97F4A7C15ull) >> m_Shift);
+	}
+
+	inline void AssignPacked(DynamicArray<Key>&& packed) noexcept
+	{
+		m_Packed = std::move(packed);
+		m_Enabled = static_cast<uint32_t>(m_Packed.Size());
+
+		size_t slots = MIN_SLOTS;
+		while (m_Packed.Size() * 2 > slots)
+			slots *= 2;
+		Rehash(slots);
+	}
+
+	inline size_t Find(Key k) const noexcept
+	{
+		size_t mask = m_Slots.Size() - 1;
+		for (size_t i = Home(k);; i = (i + 1) & mask)
+		{
+			const Slot& slot = m_Slots[i];
+			if (slot.key == k)
+				return i;
+			if (slot.key == EMPTY_KEY)
+				return NOT_FOUND;
+		}
+	}
+
+	inline void Insert(Key k) noexcept
+	{
+		// keep the load factor at or below 1/2 so probe sequences stay short
+		if ((m_Packed.Size() + 1) * 2 > m_Slots.Size())
+			Rehash(m_Slots.Size() * 2);
+
+		Place(k, static_cast<uint32_t>(m_Packed.Size()));
+		m_Packed.PushBack(k);
+	}
+
+	// Trades the packed (and dense) positions of two elements, slots only change their index
+	inline void Swap(uint32_t a, uint32_t b) noexcept
+	{
+		if (a == b) return;
+
+		m_Slots[Find(m_Packed[a])].index = b;
+		m_Slots[Find(m_Packed[b])].index = a;
+		std::swap(m_Packed[a], m_Packed[b]);
+		if constexpr (!std::is_void_v<T>)
+			std::swap(m_Dense[a], m_Dense[b]);
+	}
+
+	// Moves an element just appended in front of the disabled ones
+	inline void EnableLast() noexcept
+	{
+		Swap(m_Enabled++, static_cast<uint32_t>(m_Packed.Size() - 1));
+	}
+
+	inline void Place(Key k, uint32_t index) noexcept
+	{
+		size_t mask = m_Slots.Size() - 1;
+		size_t i = Home(k);
+		while (m_Slots[i].key != EMPTY_KEY)
+			i = (i + 1) & mask;
+
+		m_Slots[i].key = k;
+		m_Slots[i].index = index;
+	}
+
+	// Backward shift deletion, no tombstones are left behind
+	inline void EraseSlot(size_t hole) noexcept
+	{
+		size_t mask = m_Slots.Size() - 1;
+		size_t i = hole;
+		while (true)
+		{
+			i = (i + 1) & mask;
+			if (m_Slots[i].key == EMPTY_KEY)
+				break;
+
+			size_t home = Home(m_Slots[i].key);
+			// entry at i may fill the hole only if its home is not in (hole, i]
+			bool movable = hole <= i ? (home <= hole || home > i) : (home <= hole && home > i);
+			if (movable)
+			{
+				m_Slots[hole] = m_Slots[i];
+				hole = i;
+			}
+		}
+		m_Slots[hole] = Slot{};
+	}
+
+	void Rehash(size_t slotCount) noexcept
+	{
+		m_Shift = 64;
+		for (size_t n = slotCount; n > 1; n >>= 1)
+			--m_Shift;
+
+		m_Slots.Clear();
+		m_Slots.Resize(slotCount, Slot{});
+		for (size_t i = 0; i < m_Packed.Size(); ++i)
+			Place(m_Packed[i], static_cast<uint32_t>(i));
+	}
+
+	DynamicArray<Slot> m_Slots;
+	DynamicArray<Key> m_Packed;
+	[[no_unique_address]] std::conditional_t<std::is_void_v<T>, NoValues, DynamicArray<std::conditional_t<std::is_void_v<T>, char, T>>> m_Dense;
+	uint32_t m_Shift = 64;
+	uint32_t m_Enabled = 0;
+};
+
+} // namespace Composia::Core
+
+#endif // !COMPOSIA_HASHED_SET_H
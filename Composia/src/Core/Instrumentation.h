@@ -0,0 +1,154 @@
+#ifndef COMPOSIA_INSTRUMENTATION_H
+#define COMPOSIA_INSTRUMENTATION_H
+
+#include <atomic> // std::atomic
+#include <cstdint> // uint64_t
+#include <mutex> // std::mutex, std::lock_guard
+#include <string_view> // std::string_view
+
+// Hot-path counters. The premake Debug and Release configurations define COMPOSIA_INSTRUMENTATION,
+// except for the Benchmarks' Release; without it (Dist, or the amalgamated header on its own)
+// COMPOSIA_COUNT expands to nothing and its arguments are never evaluated.
+#if defined(COMPOSIA_INSTRUMENTATION)
+	#define COMPOSIA_COUNT(counter, amount) ::Composia::Core::Instrumentation::Add(::Composia::Core::Counter::counter, (amount))
+#else
+	#define COMPOSIA_COUNT(counter, amount) ((void)0)
+#endif
+
+namespace Composia::Core {
+
+enum class Counter : uint32_t
+{
+	ArrayReallocations, // DynamicArray::Reserve moving elements to a new buffer
+	ArrayBytesMoved,    // bytes copied by those reallocations
+	SparseResizes,      // SparseSet sparse array growths
+	ViewCandidates,     // pivot entities tested by views
+	ViewAccepted,       // candidates that owned every component
+	PoolMapLookups,
+	PoolMapProbes,      // buckets visited by those lookups, probes / lookups is the mean probe length
+	Count
+};
+
+inline constexpr size_t COUNTER_COUNT = static_cast<size_t>(Counter::Count);
+
+struct CounterValues
+{
+	uint64_t values[COUNTER_COUNT] = {};
+
+	[[nodiscard]] inline uint64_t operator[](Counter counter) const noexcept
+	{
+		return values[static_cast<size_t>(counter)];
+	}
+
+	[[nodiscard]] static constexpr std::string_view Name(Counter counter) noexcept
+	{
+		constexpr std::string_view names[COUNTER_COUNT] = {
+			"ArrayReallocations", "ArrayBytesMoved", "SparseResizes",
+			"ViewCandidates", "ViewAccepted", "PoolMapLookups", "PoolMapProbes"
+		};
+		return names[static_cast<size_t>(counter)];
+	}
+};
+
+// Every thread counts into its own block, so Add is a plain load and store without a lock prefix.
+// Snapshot sums the blocks of live threads and of threads that already exited. Reset only moves a
+// baseline, which keeps it safe while other threads are counting.
+class Instrumentation
+{
+public:
+#if defined(COMPOSIA_INSTRUMENTATION)
+	static constexpr bool Enabled = true;
+#else
+	static constexpr bool Enabled = false;
+#endif
+
+	static inline void Add(Counter counter, uint64_t amount) noexcept
+	{
+		std::atomic<uint64_t>& value = Local().values[static_cast<size_t>(counter)];
+		value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+	}
+
+	// Totals over all threads since the last Reset, e.g. taken once per frame
+	[[nodiscard]] static CounterValues Snapshot()
+	{
+		Shared& shared = State();
+		std::lock_guard lock(shared.mutex);
+
+		CounterValues totals = Totals(shared);
+		for (size_t i = 0; i < COUNTER_COUNT; ++i)
+			totals.values[i] -= shared.baseline.values[i];
+		return totals;
+	}
+
+	static void Reset()
+	{
+		Shared& shared = State();
+		std::lock_guard lock(shared.mutex);
+		shared.baseline = Totals(shared);
+	}
+
+private:
+	struct ThreadBlock;
+
+	struct Shared
+	{
+		std::mutex mutex;
+		ThreadBlock* head = nullptr;
+		CounterValues retired;
+		CounterValues baseline;
+	};
+
+	struct ThreadBlock
+	{
+		std::atomic<uint64_t> values[COUNTER_COUNT] = {};
+		ThreadBlock* next = nullptr;
+
+		ThreadBlock()
+		{
+			Shared& shared = State();
+			std::lock_guard lock(shared.mutex);
+			next = shared.head;
+			shared.head = this;
+		}
+
+		~ThreadBlock()
+		{
+			Shared& shared = State();
+			std::lock_guard lock(shared.mutex);
+			for (size_t i = 0; i < COUNTER_COUNT; ++i)
+				shared.retired.values[i] += values[i].load(std::memory_order_relaxed);
+
+			ThreadBlock** link = &shared.head;
+			while (*link != this)
+				link = &(*link)->next;
+			*link = next;
+		}
+	};
+
+	static Shared& State() noexcept
+	{
+		static Shared shared;
+		return shared;
+	}
+
+	static ThreadBlock& Local() noexcept
+	{
+		thread_local ThreadBlock block;
+		return block;
+	}
+
+	static CounterValues Totals(const Shared& shared) noexcept
+	{
+		CounterValues totals = shared.retired;
+		for (const ThreadBlock* block = shared.head; block; block = block->next)
+		{
+			for (size_t i = 0; i < COUNTER_COUNT; ++i)
+				totals.values[i] += block->values[i].load(std::memory_order_relaxed);
+		}
+		return totals;
+	}
+};
+
+} // namespace Composia::Core
+
+#endif // !COMPOSIA_INSTRUMENTATION_H
@@ -0,0 +1,130 @@
+#ifndef COMPOSIA_MAPPED_FILE_H
+#define COMPOSIA_MAPPED_FILE_H
+
+#include <cstddef> // size_t
+#include <cstdint> // uint64_t, intptr_t, SIZE_MAX
+#include <memory> // std::shared_ptr
+
+#if defined(_WIN32)
+// The few kernel32 functions used below, declared with windows.h's exact signatures (HANDLE is void*,
+// DWORD unsigned long, BOOL int) instead of including it: its macros (min, max, LoadImage, ...) would
+// leak into everything including Composia. Declaring them again is fine when windows.h is included too.
+struct _SECURITY_ATTRIBUTES;
+
+extern "C" {
+	__declspec(dllimport) void* __stdcall CreateFileA(const char* name, unsigned long access, unsigned long share,
+		struct _SECURITY_ATTRIBUTES* security, unsigned long disposition, unsigned long flags, void* templateFile);
+	__declspec(dllimport) unsigned long __stdcall GetFileSize(void* file, unsigned long* sizeHigh);
+	__declspec(dllimport) void* __stdcall CreateFileMappingA(void* file, struct _SECURITY_ATTRIBUTES* security,
+		unsigned long protect, unsigned long sizeHigh, unsigned long sizeLow, const char* name);
+	__declspec(dllimport) void* __stdcall MapViewOfFile(void* mapping, unsigned long access, unsigned long offsetHigh,
+		unsigned long offsetLow, size_t bytes);
+	__declspec(dllimport) int __stdcall UnmapViewOfFile(const void* address);
+	__declspec(dllimport) int __stdcall CloseHandle(void* handle);
+}
+#else
+#include <fcntl.h> // open
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#include <unistd.h> // close
+#endif
+
+namespace Composia::Core {
+
+// Private (copy-on-write) mapping of a whole file. Pages are read on first access and
+// writes go to process-local copies, the file itself is never modified.
+class MappedFile
+{
+public:
+	// Returns nullptr if the file can not be opened or mapped
+	static std::shared_ptr<MappedFile> Open(const char* path)
+	{
+		std::shared_ptr<MappedFile> file(new MappedFile());
+		if (!file->Map(path))
+			return nullptr;
+		return file;
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile()
+	{
+#if defined(_WIN32)
+		if (m_Data) UnmapViewOfFile(m_Data);
+#else
+		if (m_Data) munmap(m_Data, m_Size);
+#endif
+	}
+
+	[[nodiscard]] inline void* Data() const noexcept
+	{
+		return m_Data;
+	}
+
+	[[nodiscard]] inline size_t Size() const noexcept
+	{
+		return m_Size;
+	}
+
+private:
+#if defined(_WIN32)
+	// Values of the windows.h macros Map needs, named apart from them in case windows.h is included first
+	static constexpr unsigned long ACCESS_READ = 0x80000000ul;         // GENERIC_READ
+	static constexpr unsigned long SHARE_READ = 0x1;                   // FILE_SHARE_READ
+	static constexpr unsigned long OPEN_IF_EXISTING = 3;               // OPEN_EXISTING
+	static constexpr unsigned long ATTRIBUTES_NORMAL = 0x80;           // FILE_ATTRIBUTE_NORMAL
+	static constexpr unsigned long PROTECT_WRITECOPY = 0x08;           // PAGE_WRITECOPY
+	static constexpr unsigned long VIEW_COPY = 0x1;                    // FILE_MAP_COPY
+	static constexpr uint64_t SIZE_INVALID = 0xFFFFFFFFull;            // INVALID_FILE_SIZE with no high word
+	static inline void* const HANDLE_INVALID = reinterpret_cast<void*>(intptr_t(-1)); // INVALID_HANDLE_VALUE
+#endif
+
+	MappedFile() = default;
+
+	bool Map(const char* path)
+	{
+#if defined(_WIN32)
+		void* file = CreateFileA(path, ACCESS_READ, SHARE_READ, nullptr, OPEN_IF_EXISTING, ATTRIBUTES_NORMAL, nullptr);
+		if (file == HANDLE_INVALID)
+			return false;
+
+		unsigned long sizeHigh = 0;
+		unsigned long sizeLow = GetFileSize(file, &sizeHigh);
+		uint64_t size = (uint64_t(sizeHigh) << 32) | sizeLow;
+		void* mapping = nullptr;
+		if (size != SIZE_INVALID && size > 0 && size <= SIZE_MAX)
+			mapping = CreateFileMappingA(file, nullptr, PROTECT_WRITECOPY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (!mapping)
+			return false;
+
+		m_Data = MapViewOfFile(mapping, VIEW_COPY, 0, 0, 0);
+		CloseHandle(mapping);
+		m_Size = static_cast<size_t>(size);
+#else
+		int fd = open(path, O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat info {};
+		void* data = MAP_FAILED;
+		if (fstat(fd, &info) == 0 && info.st_size > 0)
+			data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED)
+			return false;
+
+		m_Data = data;
+		m_Size = static_cast<size_t>(info.st_size);
+#endif
+		return m_Data != nullptr;
+	}
+
+	void* m_Data = nullptr;
+	size_t m_Size = 0;
+};
+
+} // namespace Composia::Core
+
+#endif // !COMPOSIA_MAPPED_FILE_H
@@ -1,7 +1,7 @@
 #ifndef COMPOSIA_POOL_MAP_H
 #define COMPOSIA_POOL_MAP_H
 
-#include <typeindex> // std::type_index
+#include <cstdint> // uint64_t
 #include <memory> // std::unique_ptr
 #include "DynamicArray.h"
 
@@ -11,18 +11,18 @@ class IComponentPool; // forward declaration
 
 namespace Composia::Core {
 
-// Map structure for storing storing ComponentPools by type_index using robin hood hashing.
+// Map structure for storing ComponentPools by TypeId using robin hood hashing.
 class PoolMap
 {
 private:
     struct Entry
     {
-        std::type_index key;
+        uint64_t key = 0;
         std::unique_ptr<IComponentPool> value;
         size_t probeDistance = 0;
         bool occupied = false;
 
-        Entry() noexcept : key(typeid(void)), value(nullptr), probeDistance(0), occupied(false) {}
+        Entry() noexcept : key(0), value(nullptr), probeDistance(0), occupied(false) {}
     };
 
     DynamicArray<Entry> m_Buckets;
@@ -49,14 +49,14 @@ public:
 		m_Buckets.Resize(capacity);
 	}
 
-    void Insert(std::type_index key, std::unique_ptr<IComponentPool> value) noexcept
+    void Insert(uint64_t key, std::unique_ptr<IComponentPool> value) noexcept
     {
         if ((float)(m_Size + 1) / m_Buckets.Size() > m_LoadFactor) 
         {
             Rehash(m_Buckets.Size() * 2);
         }
 
-        size_t hash = key.hash_code();
+        size_t hash = static_cast<size_t>(key);
         size_t index = hash % m_Buckets.Size();
         size_t dist = 0;
 
@@ -91,14 +91,16 @@ public:
         }
     }
 
-    [[nodiscard]] IComponentPool* Get(std::type_index key) noexcept
+    [[nodiscard]] IComponentPool* Get(uint64_t key) noexcept
     {
-        size_t hash = key.hash_code();
+        size_t hash = static_cast<size_t>(key);
         size_t index = hash % m_Buckets.Size();
         size_t dist = 0;
+        COMPOSIA_COUNT(PoolMapLookups, 1);
 
         while (true) 
         {
+            COMPOSIA_COUNT(PoolMapProbes, 1);
             Entry& e = m_Buckets[index];
             if (!e.occupied || dist > m_Buckets.Size())
                 return nullptr;
@@ -111,14 +113,16 @@ public:
         }
     }
 
-    [[nodiscard]] const IComponentPool* Get(std::type_index key) const noexcept
+    [[nodiscard]] const IComponentPool* Get(uint64_t key) const noexcept
     {
-        size_t hash = key.hash_code();
+        size_t hash = static_cast<size_t>(key);
         size_t index = hash % m_Buckets.Size();
         size_t dist = 0;
+        COMPOSIA_COUNT(PoolMapLookups, 1);
 
         while (true)
         {
+            COMPOSIA_COUNT(PoolMapProbes, 1);
             const auto& e = m_Buckets.At(index);
             if (!e.occupied || dist > m_Buckets.Size())
                 return nullptr;
@@ -131,6 +135,11 @@ public:
         }
     }
 
+    [[nodiscard]] size_t Size() const noexcept
+    {
+        return m_Size;
+    }
+
     [[nodiscard]] const DynamicArray<Entry>& GetBuckets() const noexcept
     {
         return m_Buckets;
@@ -0,0 +1,30 @@
+#ifndef COMPOSIA_PREFETCH_H
+#define COMPOSIA_PREFETCH_H
+
+#include <cstddef> // size_t
+
+#if defined(_MSC_VER) && !defined(__clang__) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h> // _mm_prefetch
+#endif
+
+namespace Composia::Core {
+
+// How many keys ahead batched lookups start loading. Sparse slots are fetched at twice this
+// distance, so their dense index is cached by the time the dense slot is fetched at this one.
+inline constexpr size_t PREFETCH_DISTANCE = 16;
+
+// Asks for the cache line holding address to be loaded, a hint that never faults
+inline void Prefetch(const void* address) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+	__builtin_prefetch(address, 0, 3);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	_mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+	(void)address;
+#endif
+}
+
+} // namespace Composia::Core
+
+#endif // !COMPOSIA_PREFETCH_H
@@ -0,0 +1,184 @@
+#ifndef COMPOSIA_SIGNAL_H
+#define COMPOSIA_SIGNAL_H
+
+#include <cstdint> // uint32_t
+#include "DynamicArray.h"
+
+using Composia::Core::DynamicArray;
+
+namespace Composia::Core {
+
+// Multicast callback list. A listener is a plain function pointer plus an opaque instance
+// pointer, so publishing never allocates and connecting never type-erases through std::function.
+template<typename... Args>
+class Signal
+{
+public:
+	using Callback = void(*)(void*, Args...);
+
+	template<auto Candidate>
+	inline void Connect()
+	{
+		Connect(&FreeThunk<Candidate>, nullptr);
+	}
+
+	template<auto Candidate, typename Type>
+	inline void Connect(Type& instance)
+	{
+		Connect(&MemberThunk<Candidate, Type>, &instance);
+	}
+
+	inline void Connect(Callback callback, void* instance)
+	{
+		m_Listeners.PushBack({ callback, instance });
+	}
+
+	// Returns the number of listeners removed
+	template<auto Candidate>
+	inline uint32_t Disconnect()
+	{
+		return Disconnect(&FreeThunk<Candidate>, nullptr);
+	}
+
+	template<auto Candidate, typename Type>
+	inline uint32_t Disconnect(Type& instance)
+	{
+		return Disconnect(&MemberThunk<Candidate, Type>, &instance);
+	}
+
+	uint32_t Disconnect(Callback callback, const void* instance)
+	{
+		uint32_t removed = 0;
+		for (size_t i = m_Listeners.Size(); i > 0; --i)
+		{
+			if (m_Listeners[i - 1].callback == callback && m_Listeners[i - 1].instance == instance)
+			{
+				EraseAt(i - 1);
+				++removed;
+			}
+		}
+		return removed;
+	}
+
+	// Removes every listener bound to instance
+	uint32_t Disconnect(const void* instance)
+	{
+		uint32_t removed = 0;
+		for (size_t i = m_Listeners.Size(); i > 0; --i)
+		{
+			if (m_Listeners[i - 1].instance == instance)
+			{
+				EraseAt(i - 1);
+				++removed;
+			}
+		}
+		return removed;
+	}
+
+	inline void Publish(Args... args) const
+	{
+		for (size_t i = 0; i < m_Listeners.Size(); ++i)
+			m_Listeners[i].callback(m_Listeners[i].instance, args...);
+	}
+
+	[[nodiscard]] inline bool Empty() const noexcept
+	{
+		return m_Listeners.Empty();
+	}
+
+	[[nodiscard]] inline size_t Size() const noexcept
+	{
+		return m_Listeners.Size();
+	}
+
+private:
+	struct Listener
+	{
+		Callback callback;
+		void* instance;
+	};
+
+	template<auto Candidate>
+	static void FreeThunk(void*, Args... args)
+	{
+		Candidate(args...);
+	}
+
+	template<auto Candidate, typename Type>
+	static void MemberThunk(void* instance, Args... args)
+	{
+		(static_cast<Type*>(instance)->*Candidate)(args...);
+	}
+
+	// Keeps connection order, listeners are expected to run in the order they were added
+	inline void EraseAt(size_t index)
+	{
+		for (size_t i = index + 1; i < m_Listeners.Size(); ++i)
+			m_Listeners[i - 1] = m_Listeners[i];
+		m_Listeners.PopBack();
+	}
+
+	DynamicArray<Listener> m_Listeners{ 0 };
+};
+
+// Connection handle handed out by pools. It keeps the owner's listener count in sync,
+// which lets the owner skip all signal work with a single branch when nobody listens.
+template<typename... Args>
+class Sink
+{
+public:
+	using Callback = typename Signal<Args...>::Callback;
+
+	Sink(Signal<Args...>& signal, uint32_t& listenerCount) noexcept
+		: m_Signal(signal), m_ListenerCount(listenerCount) {}
+
+	template<auto Candidate>
+	inline void Connect()
+	{
+		m_Signal.template Connect<Candidate>();
+		++m_ListenerCount;
+	}
+
+	template<auto Candidate, typename Type>
+	inline void Connect(Type& instance)
+	{
+		m_Signal.template Connect<Candidate>(instance);
+		++m_ListenerCount;
+	}
+
+	inline void Connect(Callback callback, void* instance)
+	{
+		m_Signal.Connect(callback, instance);
+		++m_ListenerCount;
+	}
+
+	template<auto Candidate>
+	inline void Disconnect()
+	{
+		m_ListenerCount -= m_Signal.template Disconnect<Candidate>();
+	}
+
+	template<auto Candidate, typename Type>
+	inline void Disconnect(Type& instance)
+	{
+		m_ListenerCount -= m_Signal.template Disconnect<Candidate>(instance);
+	}
+
+	inline void Disconnect(const void* instance)
+	{
+		m_ListenerCount -= m_Signal.Disconnect(instance);
+	}
+
+	[[nodiscard]] inline bool Empty() const noexcept
+	{
+		return m_Signal.Empty();
+	}
+
+private:
+	Signal<Args...>& m_Signal;
+	uint32_t& m_ListenerCount;
+};
+
+} // namespace Composia::Core
+
+#endif // !COMPOSIA_SIGNAL_H
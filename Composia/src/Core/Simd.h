@@ -0,0 +1,111 @@
+#ifndef COMPOSIA_SIMD_H
+#define COMPOSIA_SIMD_H
+
+#include <algorithm> // std::fill
+#include <cstddef> // size_t
+#include <cstdint> // uint32_t, uint64_t
+
+// AVX2 kernels are compiled for their own target and only called once the CPU reports AVX2,
+// so the library itself keeps building for baseline x86-64
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define COMPOSIA_AVX2_DISPATCH
+#define COMPOSIA_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define COMPOSIA_AVX2_DISPATCH
+#define COMPOSIA_TARGET_AVX2
+#include <immintrin.h>
+#include <intrin.h> // __cpuid, _xgetbv
+#endif
+
+namespace Composia::Core {
+
+// Detected once, true if both the CPU and the OS (saving ymm registers) support AVX2
+inline bool CpuHasAvx2() noexcept
+{
+#if defined(COMPOSIA_AVX2_DISPATCH) && defined(_MSC_VER) && !defined(__clang__)
+	static const bool hasAvx2 = [] {
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		__cpuid(info, 1);
+		bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+		__cpuid(info, 7);
+		return osSavesYmm && (info[1] & (1 << 5)) != 0;
+		}();
+	return hasAvx2;
+#elif defined(COMPOSIA_AVX2_DISPATCH)
+	static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+	return hasAvx2;
+#else
+	return false;
+#endif
+}
+
+// Sets bit i of mask (64 keys per word) when keys[i] has a sparse slot below size, the
+// membership test of a sparse set. Every word the count keys span is overwritten.
+inline void SparseHasBatchScalar(const uint32_t* sparse, size_t sparseSize, size_t size,
+	const uint32_t* keys, size_t count, uint64_t* mask) noexcept
+{
+	std::fill(mask, mask + (count + 63) / 64, 0);
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint32_t k = keys[i];
+		bool has = k < sparseSize && sparse[k] < size;
+		mask[i / 64] |= uint64_t(has) << (i % 64);
+	}
+}
+
+#if defined(COMPOSIA_AVX2_DISPATCH)
+// Eight keys per step: one masked gather loads their sparse slots, keys outside the sparse
+// array load nothing and read as invalid. sparseSize must fit a signed gather index.
+COMPOSIA_TARGET_AVX2 inline void SparseHasBatchAvx2(const uint32_t* sparse, size_t sparseSize, size_t size,
+	const uint32_t* keys, size_t count, uint64_t* mask) noexcept
+{
+	std::fill(mask, mask + (count + 63) / 64, 0);
+
+	// unsigned compares are signed ones with the sign bits flipped
+	const __m256i sign = _mm256_set1_epi32(INT32_MIN);
+	const __m256i sparseLimit = _mm256_set1_epi32(static_cast<int32_t>(static_cast<uint32_t>(sparseSize) ^ 0x80000000u));
+	const __m256i sizeLimit = _mm256_set1_epi32(static_cast<int32_t>(static_cast<uint32_t>(size) ^ 0x80000000u));
+	const __m256i invalid = _mm256_set1_epi32(-1);
+	const int* base = reinterpret_cast<const int*>(sparse);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+		__m256i inSparse = _mm256_cmpgt_epi32(sparseLimit, _mm256_xor_si256(k, sign));
+		__m256i index = _mm256_mask_i32gather_epi32(invalid, base, k, inSparse, 4);
+		__m256i has = _mm256_cmpgt_epi32(sizeLimit, _mm256_xor_si256(index, sign));
+		uint64_t bits = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(has)));
+		mask[i / 64] |= bits << (i % 64);
+	}
+
+	for (; i < count; ++i)
+	{
+		uint32_t k = keys[i];
+		bool has = k < sparseSize && sparse[k] < size;
+		mask[i / 64] |= uint64_t(has) << (i % 64);
+	}
+}
+#endif
+
+inline void SparseHasBatch(const uint32_t* sparse, size_t sparseSize, size_t size,
+	const uint32_t* keys, size_t count, uint64_t* mask) noexcept
+{
+#if defined(COMPOSIA_AVX2_DISPATCH)
+	if (sparseSize <= static_cast<size_t>(INT32_MAX) && CpuHasAvx2())
+	{
+		SparseHasBatchAvx2(sparse, sparseSize, size, keys, count, mask);
+		return;
+	}
+#endif
+	SparseHasBatchScalar(sparse, sparseSize, size, keys, count, mask);
+}
+
+} // namespace Composia::Core
+
+#endif // !COMPOSIA_SIMD_H
@@ -0,0 +1,103 @@
+#ifndef COMPOSIA_SORT_H
+#define COMPOSIA_SORT_H
+
+#include <numeric> // std::iota
+#include <tuple> // std::tuple, std::get
+#include <type_traits> // std::make_unsigned_t, std::is_integral_v
+#include <utility> // std::move, std::index_sequence_for
+
+#include "DynamicArray.h"
+
+namespace Composia::Core {
+
+// Moves element order[i] of every array to index i. The permutation is followed cycle by cycle,
+// so each array only ever holds one element aside instead of being copied. order ends up as the identity.
+template<typename... Elements>
+void PermuteInPlace(DynamicArray<uint32_t>& order, DynamicArray<Elements>&... arrays)
+{
+	for (uint32_t start = 0; start < order.Size(); ++start)
+	{
+		if (order[start] == start)
+			continue;
+
+		std::tuple<Elements...> held(std::move(arrays[start])...);
+		uint32_t current = start;
+		while (order[current] != start)
+		{
+			uint32_t next = order[current];
+			((arrays[current] = std::move(arrays[next])), ...);
+			order[current] = current;
+			current = next;
+		}
+
+		[&]<size_t... I>(std::index_sequence<I...>) {
+			((arrays[current] = std::move(std::get<I>(held))), ...);
+		}(std::index_sequence_for<Elements...>{});
+		order[current] = current;
+	}
+}
+
+// Fills order with the indices of keys in ascending key order, stable for equal keys. LSD radix
+// sort over 8 bit digits; digits every key shares (e.g. the high bytes of small keys) are skipped.
+template<typename K>
+void RadixOrder(const DynamicArray<K>& keys, DynamicArray<uint32_t>& order)
+{
+	static_assert(std::is_integral_v<K>, "Radix sort keys must be integers");
+
+	using Unsigned = std::make_unsigned_t<K>;
+	// flipping the sign bit makes signed keys sort as unsigned ones
+	constexpr Unsigned SIGN = std::is_signed_v<K> ? Unsigned(Unsigned(1) << (sizeof(K) * 8 - 1)) : Unsigned(0);
+
+	struct Item
+	{
+		Unsigned key;
+		uint32_t index;
+	};
+
+	constexpr size_t DIGITS = sizeof(K);
+	size_t count = keys.Size();
+	DynamicArray<Item> items(count);
+	DynamicArray<Item> scratch(count);
+	items.Resize(count);
+	scratch.Resize(count);
+
+	// one pass counts every digit
+	DynamicArray<size_t> offsets(DIGITS * 256);
+	offsets.Resize(DIGITS * 256, 0);
+	for (size_t i = 0; i < count; ++i)
+	{
+		Unsigned key = static_cast<Unsigned>(static_cast<Unsigned>(keys[i]) ^ SIGN);
+		items[i] = Item{ key, static_cast<uint32_t>(i) };
+		for (size_t digit = 0; digit < DIGITS; ++digit)
+			++offsets[digit * 256 + ((key >> (digit * 8)) & 0xFF)];
+	}
+
+	for (size_t digit = 0; digit < DIGITS && count > 0; ++digit)
+	{
+		size_t* digitOffsets = offsets.Data() + digit * 256;
+		size_t shift = digit * 8;
+		if (digitOffsets[(items[0].key >> shift) & 0xFF] == count)
+			continue;
+
+		size_t total = 0;
+		for (size_t bucket = 0; bucket < 256; ++bucket)
+		{
+			size_t bucketCount = digitOffsets[bucket];
+			digitOffsets[bucket] = total;
+			total += bucketCount;
+		}
+
+		for (const Item& item : items)
+			scratch[digitOffsets[(item.key >> shift) & 0xFF]++] = item;
+		std::swap(items, scratch);
+	}
+
+	order.Clear();
+	order.Reserve(count);
+	for (const Item& item : items)
+		order.PushBack(item.index);
+}
+
+} // namespace Composia::Core
+
+#endif // !COMPOSIA_SORT_H
@@ -1,14 +1,58 @@
 #ifndef COMPOSIA_SPARSE_SET_H
+#define COMPOSIA_SPARSE_SET_H
 
+#include <algorithm> // std::max, std::min
+#include <cassert> // assert
 #include <limits> // std::numeric_limits
+#include <utility> // std::swap
 
 #include "DynamicArray.h"
+#include "Prefetch.h"
+#include "Simd.h"
+#include "Sort.h"
 
 using Composia::Core::DynamicArray;
 using Key = uint32_t;
 
 namespace Composia::Core {
 
+// Scans a sparse array down from its end while its keys are absent, at most budget.Left() of them,
+// and cuts it past the highest key found present, rounded up to 64. The cut keeps the progress of a
+// scan that ran out of budget. Returns false when the highest present key was not reached yet.
+template<typename HasFunc>
+inline bool CutSparse(DynamicArray<uint32_t>& sparse, CompactBudget& budget, HasFunc&& has)
+{
+	size_t size = sparse.Size();
+	size_t end = size - std::min(size, budget.Left());
+	size_t top = size;
+	while (top > end && !has(static_cast<Key>(top - 1)))
+		--top;
+	budget.work += size - top;
+
+	size_t cut = (top + 63) & ~size_t(63);
+	if (cut < size)
+		sparse.Resize(cut);
+	return top == 0 || top > end || has(static_cast<Key>(top - 1));
+}
+
+// True if sparse maps exactly the keys of packed to their positions. A sparse array read from a file
+// is checked this way before it is used instead of rebuilt; every present entry naming a distinct
+// key of packed and as many entries as keys means each key maps back to its own position.
+inline bool SparseMatches(const DynamicArray<Key>& packed, const DynamicArray<uint32_t>& sparse) noexcept
+{
+	size_t present = 0;
+	for (size_t k = 0; k < sparse.Size(); ++k)
+	{
+		uint32_t index = sparse[k];
+		if (index == std::numeric_limits<uint32_t>::max())
+			continue;
+		if (index >= packed.Size() || packed[index] != k)
+			return false;
+		++present;
+	}
+	return present == packed.Size();
+}
+
 template<typename T>
 class SparseSet
 {
@@ -39,6 +83,7 @@ public:
 		m_Sparse[k] = static_cast<uint32_t>(m_Dense.Size());
 		m_Dense.PushBack(value);
 		m_Packed.PushBack(k);
+		EnableLast();
 	}
 
 	template<typename... Args>
@@ -54,6 +99,7 @@ public:
 		m_Sparse[k] = static_cast<uint32_t>(m_Dense.Size());
 		m_Dense.EmplaceBack(std::forward<Args>(args)...);
 		m_Packed.PushBack(k);
+		EnableLast();
 	}
 
 	inline void Remove(Key k)
@@ -63,6 +109,13 @@ public:
 		uint32_t denseRemovedIndex = m_Sparse[k];
 		uint32_t denseLastIndex = static_cast<uint32_t>(m_Dense.Size() - 1);
 
+		// an enabled element first trades places with the last enabled one, keeping the partition
+		if (denseRemovedIndex < m_Enabled && --m_Enabled != denseLastIndex)
+		{
+			Swap(denseRemovedIndex, m_Enabled);
+			denseRemovedIndex = m_Enabled;
+		}
+
 		// move last element into removed slot
 		m_Dense[denseRemovedIndex] = std::move(m_Dense[denseLastIndex]);
 		Key movedKey = m_Packed[denseLastIndex];
@@ -82,6 +135,139 @@ public:
 		return &m_Dense[m_Sparse[k]];
 	}
 
+	// Has for count keys at once, bit i of mask (64 keys per word) is set when keys[i] is in the
+	// set. Uses AVX2 gathers when the CPU has them, see Core::SparseHasBatch.
+	inline void HasBatch(const Key* keys, size_t count, uint64_t* mask) const noexcept
+	{
+		SparseHasBatch(m_Sparse.Data(), m_Sparse.Size(), m_Dense.Size(), keys, count, mask);
+	}
+
+	// Two step prefetch for batched lookups: the sparse slot first, then once that is cached the
+	// dense slot it points at. Keys outside the set are ignored.
+	inline void PrefetchSparse(Key k) const noexcept
+	{
+		if (k < m_Sparse.Size())
+			Prefetch(m_Sparse.Data() + k);
+	}
+
+	inline void PrefetchDense(Key k) const noexcept
+	{
+		if (k < m_Sparse.Size() && m_Sparse[k] < m_Dense.Size())
+			Prefetch(m_Dense.Data() + m_Sparse[k]);
+	}
+
+	// Packed order is split into enabled keys followed by disabled ones. Both calls swap k
+	// across the boundary, so they are O(1) and only move k and one other element.
+	inline void Disable(Key k) noexcept
+	{
+		if (!Has(k) || m_Sparse[k] >= m_Enabled) return;
+		Swap(m_Sparse[k], --m_Enabled);
+	}
+
+	inline void Enable(Key k) noexcept
+	{
+		if (!Has(k) || m_Sparse[k] < m_Enabled) return;
+		Swap(m_Sparse[k], m_Enabled++);
+	}
+
+	[[nodiscard]] inline bool IsEnabled(Key k) const noexcept
+	{
+		return Has(k) && m_Sparse[k] < m_Enabled;
+	}
+
+	inline void Reserve(size_t capacity)
+	{
+		m_Dense.Reserve(capacity);
+		m_Packed.Reserve(capacity);
+	}
+
+	// Cuts the sparse array past the highest key and gives back spare capacity, see DynamicArray::Compact.
+	// Stays within budget and returns false when it has to be called again to finish.
+	bool Compact(CompactBudget& budget)
+	{
+		return CutSparse(m_Sparse, budget, [this](Key k) { return Has(k); }) &&
+			budget.Compact(m_Sparse) && budget.Compact(m_Packed) && budget.Compact(m_Dense);
+	}
+
+	// Renames every key k to remap[k] and rebuilds the sparse array for keys below keyCount
+	void Remap(const DynamicArray<Key>& remap, size_t keyCount)
+	{
+		for (Key& k : m_Packed)
+		{
+			assert(k < remap.Size() && remap[k] < keyCount && "Key missing from the remap table");
+			k = remap[k];
+		}
+
+		m_Sparse = DynamicArray<uint32_t>(keyCount);
+		m_Sparse.Resize(keyCount, INVALID_INDEX);
+		for (uint32_t i = 0; i < m_Packed.Size(); ++i)
+			m_Sparse[m_Packed[i]] = i;
+	}
+
+	// Copy that shares all arrays with this set, see DynamicArray::Share
+	SparseSet Share()
+	{
+		SparseSet shared(0);
+		shared.m_Dense = m_Dense.Share();
+		shared.m_Sparse = m_Sparse.Share();
+		shared.m_Packed = m_Packed.Share();
+		shared.m_Enabled = m_Enabled;
+		return shared;
+	}
+
+	// Must be called before modifying a set that came out of Share
+	inline void Detach()
+	{
+		m_Dense.Detach();
+		m_Sparse.Detach();
+		m_Packed.Detach();
+	}
+
+	inline void Clear()
+	{
+		for (Key k : m_Packed)
+			m_Sparse[k] = INVALID_INDEX;
+		m_Dense.Clear();
+		m_Packed.Clear();
+		m_Enabled = 0;
+	}
+
+	// Takes over packed keys and their values, then rebuilds the sparse array in a single pass
+	void Assign(DynamicArray<Key>&& packed, DynamicArray<T>&& dense) noexcept
+	{
+		m_Packed = std::move(packed);
+		m_Dense = std::move(dense);
+		m_Enabled = static_cast<uint32_t>(m_Packed.Size());
+		RebuildSparse();
+	}
+
+	// Same as above with a sparse array that already matches packed, nothing is rebuilt
+	void Assign(DynamicArray<Key>&& packed, DynamicArray<T>&& dense, DynamicArray<uint32_t>&& sparse) noexcept
+	{
+		m_Packed = std::move(packed);
+		m_Dense = std::move(dense);
+		m_Sparse = std::move(sparse);
+		m_Enabled = static_cast<uint32_t>(m_Packed.Size());
+	}
+
+	// Position of k in the packed order, k must be in the set
+	[[nodiscard]] inline uint32_t Index(Key k) const noexcept
+	{
+		return m_Sparse[k];
+	}
+
+	// Moves the element at packed index order[i] to index i
+	void Permute(DynamicArray<uint32_t>& order)
+	{
+		// only rows that move need their sparse entry rewritten
+		for (uint32_t i = 0; i < order.Size(); ++i)
+		{
+			if (order[i] != i)
+				m_Sparse[m_Packed[order[i]]] = i;
+		}
+		PermuteInPlace(order, m_Packed, m_Dense);
+	}
+
 	[[nodiscard]] const DynamicArray<T>& RawDense() const noexcept
 	{
 		return m_Dense;
@@ -92,13 +278,40 @@ public:
 		return m_Packed;
 	}
 
+	[[nodiscard]] inline const DynamicArray<uint32_t>& RawSparse() const noexcept
+	{
+		return m_Sparse;
+	}
+
 	[[nodiscard]] inline size_t Size() const noexcept
 	{
 		return m_Dense.Size();
 	}
 
+	// Number of enabled keys, which come first in the packed order
+	[[nodiscard]] inline size_t EnabledSize() const noexcept
+	{
+		return m_Enabled;
+	}
+
 private:
 	static constexpr Key INVALID_INDEX = std::numeric_limits<Key>::max();
+
+	inline void Swap(uint32_t a, uint32_t b) noexcept
+	{
+		if (a == b) return;
+
+		std::swap(m_Dense[a], m_Dense[b]);
+		std::swap(m_Packed[a], m_Packed[b]);
+		m_Sparse[m_Packed[a]] = a;
+		m_Sparse[m_Packed[b]] = b;
+	}
+
+	// Moves a key just appended in front of the disabled ones
+	inline void EnableLast() noexcept
+	{
+		Swap(m_Enabled++, static_cast<uint32_t>(m_Packed.Size() - 1));
+	}
 	
 	inline void EnsureSparseSize(Key k) noexcept
 	{
@@ -108,14 +321,251 @@ private:
 			while (k >= newCapacity)
 				newCapacity *= 2;
 
+			COMPOSIA_COUNT(SparseResizes, 1);
 			m_Sparse.Resize(newCapacity, INVALID_INDEX);
 		}
 	}
 
+	inline void RebuildSparse() noexcept
+	{
+		for (uint32_t& index : m_Sparse)
+			index = INVALID_INDEX;
+
+		for (size_t i = 0; i < m_Packed.Size(); ++i)
+		{
+			EnsureSparseSize(m_Packed[i]);
+			m_Sparse[m_Packed[i]] = static_cast<uint32_t>(i);
+		}
+	}
+
 	DynamicArray<T> m_Dense;
 	DynamicArray<uint32_t> m_Sparse;
 	DynamicArray<Key> m_Packed;
+	uint32_t m_Enabled = 0;
+};
+
+// Key-only sparse set, used where membership is all that has to be tracked.
+template<>
+class SparseSet<void>
+{
+public:
+	SparseSet(size_t reserveSize = 1024)
+	{
+		m_Sparse.Resize(reserveSize, INVALID_INDEX);
+		m_Packed.Reserve(reserveSize);
+	}
+
+	inline bool Has(Key k) const noexcept
+	{
+		return k < m_Sparse.Size() &&
+			m_Sparse[k] != INVALID_INDEX &&
+			m_Sparse[k] < m_Packed.Size();
+	}
+
+	inline void Add(Key k) noexcept
+	{
+		EnsureSparseSize(k);
+		if (Has(k)) return;
+
+		m_Sparse[k] = static_cast<uint32_t>(m_Packed.Size());
+		m_Packed.PushBack(k);
+		EnableLast();
+	}
+
+	inline void Remove(Key k) noexcept
+	{
+		if (!Has(k)) return;
+
+		uint32_t removedIndex = m_Sparse[k];
+		uint32_t lastIndex = static_cast<uint32_t>(m_Packed.Size() - 1);
+		if (removedIndex < m_Enabled && --m_Enabled != lastIndex)
+		{
+			Swap(removedIndex, m_Enabled);
+			removedIndex = m_Enabled;
+		}
+
+		Key movedKey = m_Packed.Back();
+		m_Packed[removedIndex] = movedKey;
+		m_Sparse[movedKey] = removedIndex;
+
+		m_Packed.PopBack();
+		m_Sparse[k] = INVALID_INDEX;
+	}
 
+	inline void HasBatch(const Key* keys, size_t count, uint64_t* mask) const noexcept
+	{
+		SparseHasBatch(m_Sparse.Data(), m_Sparse.Size(), m_Packed.Size(), keys, count, mask);
+	}
+
+	inline void PrefetchSparse(Key k) const noexcept
+	{
+		if (k < m_Sparse.Size())
+			Prefetch(m_Sparse.Data() + k);
+	}
+
+	// Keys only, there is no dense slot to fetch
+	inline void PrefetchDense(Key) const noexcept {}
+
+	inline void Disable(Key k) noexcept
+	{
+		if (!Has(k) || m_Sparse[k] >= m_Enabled) return;
+		Swap(m_Sparse[k], --m_Enabled);
+	}
+
+	inline void Enable(Key k) noexcept
+	{
+		if (!Has(k) || m_Sparse[k] < m_Enabled) return;
+		Swap(m_Sparse[k], m_Enabled++);
+	}
+
+	[[nodiscard]] inline bool IsEnabled(Key k) const noexcept
+	{
+		return Has(k) && m_Sparse[k] < m_Enabled;
+	}
+
+	inline void Reserve(size_t capacity)
+	{
+		m_Packed.Reserve(capacity);
+	}
+
+	bool Compact(CompactBudget& budget)
+	{
+		return CutSparse(m_Sparse, budget, [this](Key k) { return Has(k); }) &&
+			budget.Compact(m_Sparse) && budget.Compact(m_Packed);
+	}
+
+	void Remap(const DynamicArray<Key>& remap, size_t keyCount)
+	{
+		for (Key& k : m_Packed)
+		{
+			assert(k < remap.Size() && remap[k] < keyCount && "Key missing from the remap table");
+			k = remap[k];
+		}
+
+		m_Sparse = DynamicArray<uint32_t>(keyCount);
+		m_Sparse.Resize(keyCount, INVALID_INDEX);
+		for (uint32_t i = 0; i < m_Packed.Size(); ++i)
+			m_Sparse[m_Packed[i]] = i;
+	}
+
+	SparseSet Share()
+	{
+		SparseSet shared(0);
+		shared.m_Sparse = m_Sparse.Share();
+		shared.m_Packed = m_Packed.Share();
+		shared.m_Enabled = m_Enabled;
+		return shared;
+	}
+
+	inline void Detach()
+	{
+		m_Sparse.Detach();
+		m_Packed.Detach();
+	}
+
+	inline void Clear() noexcept
+	{
+		for (Key k : m_Packed)
+			m_Sparse[k] = INVALID_INDEX;
+		m_Packed.Clear();
+		m_Enabled = 0;
+	}
+
+	void Assign(DynamicArray<Key>&& packed) noexcept
+	{
+		m_Packed = std::move(packed);
+		m_Enabled = static_cast<uint32_t>(m_Packed.Size());
+		RebuildSparse();
+	}
+
+	void Assign(DynamicArray<Key>&& packed, DynamicArray<uint32_t>&& sparse) noexcept
+	{
+		m_Packed = std::move(packed);
+		m_Sparse = std::move(sparse);
+		m_Enabled = static_cast<uint32_t>(m_Packed.Size());
+	}
+
+	[[nodiscard]] inline uint32_t Index(Key k) const noexcept
+	{
+		return m_Sparse[k];
+	}
+
+	void Permute(DynamicArray<uint32_t>& order)
+	{
+		// only rows that move need their sparse entry rewritten
+		for (uint32_t i = 0; i < order.Size(); ++i)
+		{
+			if (order[i] != i)
+				m_Sparse[m_Packed[order[i]]] = i;
+		}
+		PermuteInPlace(order, m_Packed);
+	}
+
+	[[nodiscard]] inline const DynamicArray<Key>& RawPacked() const noexcept
+	{
+		return m_Packed;
+	}
+
+	[[nodiscard]] inline const DynamicArray<uint32_t>& RawSparse() const noexcept
+	{
+		return m_Sparse;
+	}
+
+	[[nodiscard]] inline size_t Size() const noexcept
+	{
+		return m_Packed.Size();
+	}
+
+	[[nodiscard]] inline size_t EnabledSize() const noexcept
+	{
+		return m_Enabled;
+	}
+
+private:
+	static constexpr Key INVALID_INDEX = std::numeric_limits<Key>::max();
+
+	inline void Swap(uint32_t a, uint32_t b) noexcept
+	{
+		if (a == b) return;
+
+		std::swap(m_Packed[a], m_Packed[b]);
+		m_Sparse[m_Packed[a]] = a;
+		m_Sparse[m_Packed[b]] = b;
+	}
+
+	inline void EnableLast() noexcept
+	{
+		Swap(m_Enabled++, static_cast<uint32_t>(m_Packed.Size() - 1));
+	}
+
+	inline void EnsureSparseSize(Key k) noexcept
+	{
+		if (k >= m_Sparse.Size())
+		{
+			size_t newCapacity = m_Sparse.Size() == 0 ? 64 : m_Sparse.Size();
+			while (k >= newCapacity)
+				newCapacity *= 2;
+
+			COMPOSIA_COUNT(SparseResizes, 1);
+			m_Sparse.Resize(newCapacity, INVALID_INDEX);
+		}
+	}
+
+	inline void RebuildSparse() noexcept
+	{
+		for (uint32_t& index : m_Sparse)
+			index = INVALID_INDEX;
+
+		for (size_t i = 0; i < m_Packed.Size(); ++i)
+		{
+			EnsureSparseSize(m_Packed[i]);
+			m_Sparse[m_Packed[i]] = static_cast<uint32_t>(i);
+		}
+	}
+
+	DynamicArray<uint32_t> m_Sparse;
+	DynamicArray<Key> m_Packed;
+	uint32_t m_Enabled = 0;
 };
 
 } // namespace Composia::Core 
@@ -0,0 +1,243 @@
+#ifndef COMPOSIA_TRACE_H
+#define COMPOSIA_TRACE_H
+
+#include <algorithm> // std::max
+#include <atomic> // std::atomic
+#include <chrono> // std::chrono::steady_clock
+#include <cstdint> // uint64_t
+#include <fstream> // std::ofstream
+#include <memory> // std::unique_ptr
+#include <mutex> // std::mutex, std::lock_guard
+#include <ostream> // std::ostream
+#include <string> // std::string
+#include <string_view> // std::string_view
+#include <thread> // std::this_thread::yield
+
+#if defined(_M_X64)
+#include <intrin.h> // __rdtsc
+#elif defined(__x86_64__)
+#include <x86intrin.h> // __rdtsc
+#endif
+
+#include "DynamicArray.h"
+
+// Timeline zones, exported as Chrome trace JSON (chrome://tracing, ui.perfetto.dev). Like the
+// counters in Instrumentation.h they only exist when COMPOSIA_INSTRUMENTATION is defined.
+// Zone names are not copied, they must outlive the export (string literals, TypeName<T>()).
+// A zone reads the clock twice, which dominates its cost: tens of ns, more under virtualization
+// (see the TraceZone benchmark). Zones belong around work of microseconds, not per entity.
+#if defined(COMPOSIA_INSTRUMENTATION)
+	#define COMPOSIA_TRACE_CONCAT_IMPL(a, b) a##b
+	#define COMPOSIA_TRACE_CONCAT(a, b) COMPOSIA_TRACE_CONCAT_IMPL(a, b)
+	#define COMPOSIA_TRACE_ZONE(name) ::Composia::Core::TraceZone COMPOSIA_TRACE_CONCAT(composiaTraceZone, __LINE__)(name)
+#else
+	#define COMPOSIA_TRACE_ZONE(name) ((void)0)
+#endif
+
+namespace Composia::Core {
+
+// rdtsc where available, converted to wall time once at export. A read takes some 20 cycles on
+// bare metal and several times that in a VM.
+inline uint64_t TraceTicks() noexcept
+{
+#if defined(_M_X64) || defined(__x86_64__)
+	return __rdtsc();
+#else
+	return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+struct TraceEvent
+{
+	std::string_view name;
+	uint64_t begin;
+	uint64_t end;
+};
+
+// Every thread writes zones into its own ring without locking, the oldest zones are overwritten
+// once a ring is full. Exporting while other threads record is safe, zones that may have been
+// overwritten during the copy are dropped.
+class Trace
+{
+public:
+#if defined(COMPOSIA_INSTRUMENTATION)
+	static constexpr bool Enabled = true;
+#else
+	static constexpr bool Enabled = false;
+#endif
+
+	static constexpr size_t RING_CAPACITY = size_t(1) << 15; // zones kept per thread
+
+	static inline void Record(std::string_view name, uint64_t begin, uint64_t end) noexcept
+	{
+		ThreadRing& ring = Local();
+		uint64_t head = ring.head.load(std::memory_order_relaxed);
+		ring.events[head & (RING_CAPACITY - 1)] = TraceEvent{ name, begin, end };
+		ring.head.store(head + 1, std::memory_order_release);
+	}
+
+	// Label shown for the calling thread's track
+	static void NameThread(std::string name)
+	{
+		ThreadRing& ring = Local();
+		std::lock_guard lock(State().mutex);
+		ring.name = std::move(name);
+	}
+
+	// Drops every zone recorded so far
+	static void Clear()
+	{
+		Shared& shared = State();
+		std::lock_guard lock(shared.mutex);
+		for (auto& ring : shared.rings)
+			ring->cleared = ring->head.load(std::memory_order_acquire);
+	}
+
+	static void WriteChromeJson(std::ostream& stream)
+	{
+		Shared& shared = State();
+		std::lock_guard lock(shared.mutex);
+
+		double microsecondsPerTick = Calibrate(shared);
+
+		stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+		bool first = true;
+		for (auto& ring : shared.rings)
+		{
+			if (!ring->name.empty())
+			{
+				stream << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->id
+					<< ",\"args\":{\"name\":\"";
+				WriteEscaped(stream, ring->name);
+				stream << "\"}}";
+				first = false;
+			}
+
+			uint64_t head = ring->head.load(std::memory_order_acquire);
+			uint64_t oldest = std::max(ring->cleared, head > RING_CAPACITY ? head - RING_CAPACITY : 0);
+			DynamicArray<TraceEvent> events(static_cast<size_t>(head - oldest));
+			for (uint64_t i = oldest; i < head; ++i)
+				events.PushBack(ring->events[i & (RING_CAPACITY - 1)]);
+
+			// zones the owner wrote over while they were copied are torn, including the slot it may
+			// be writing right now
+			uint64_t after = ring->head.load(std::memory_order_acquire) + 1;
+			uint64_t valid = after > RING_CAPACITY ? after - RING_CAPACITY : 0;
+
+			for (uint64_t i = std::max(oldest, valid); i < head; ++i)
+			{
+				const TraceEvent& event = events[static_cast<size_t>(i - oldest)];
+				stream << (first ? "" : ",") << "\n{\"name\":\"";
+				WriteEscaped(stream, event.name);
+				stream << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->id
+					<< ",\"ts\":" << static_cast<double>(event.begin - shared.startTicks) * microsecondsPerTick
+					<< ",\"dur\":" << static_cast<double>(event.end - event.begin) * microsecondsPerTick << "}";
+				first = false;
+			}
+		}
+		stream << "\n]}\n";
+	}
+
+	// Returns false if the file could not be written
+	static bool Save(const char* path)
+	{
+		std::ofstream stream(path, std::ios::binary);
+		WriteChromeJson(stream);
+		return stream.good();
+	}
+
+private:
+	struct ThreadRing
+	{
+		std::unique_ptr<TraceEvent[]> events = std::make_unique<TraceEvent[]>(RING_CAPACITY);
+		std::atomic<uint64_t> head = 0;
+		uint64_t cleared = 0;
+		uint32_t id = 0;
+		std::string name;
+	};
+
+	struct Shared
+	{
+		std::mutex mutex;
+		DynamicArray<std::unique_ptr<ThreadRing>> rings;
+		uint64_t startTicks = TraceTicks();
+		std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	};
+
+	static Shared& State() noexcept
+	{
+		static Shared shared;
+		return shared;
+	}
+
+	// Rings are kept after their thread exits so its zones can still be exported
+	static ThreadRing& Local() noexcept
+	{
+		thread_local ThreadRing* ring = nullptr;
+		if (!ring) [[unlikely]]
+		{
+			Shared& shared = State();
+			std::lock_guard lock(shared.mutex);
+			shared.rings.PushBack(std::make_unique<ThreadRing>());
+			ring = shared.rings.Back().get();
+			ring->id = static_cast<uint32_t>(shared.rings.Size());
+		}
+		return *ring;
+	}
+
+	static double Calibrate(const Shared& shared) noexcept
+	{
+#if defined(_M_X64) || defined(__x86_64__)
+		// measure the tsc rate over at least 10 ms since the first zone
+		using namespace std::chrono;
+		steady_clock::time_point now = steady_clock::now();
+		while (now - shared.startTime < milliseconds(10))
+		{
+			std::this_thread::yield();
+			now = steady_clock::now();
+		}
+		uint64_t ticks = TraceTicks() - shared.startTicks;
+		return duration<double, std::micro>(now - shared.startTime).count() / static_cast<double>(ticks);
+#else
+		(void)shared;
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::duration(1)).count();
+#endif
+	}
+
+	static void WriteEscaped(std::ostream& stream, std::string_view text)
+	{
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				stream << '\\' << c;
+			else if (static_cast<unsigned char>(c) < 0x20)
+				stream << ' ';
+			else
+				stream << c;
+		}
+	}
+};
+
+// Records the time between its construction and destruction as one zone
+class TraceZone
+{
+public:
+	explicit TraceZone(std::string_view name) noexcept
+		: m_Name(name), m_Begin(TraceTicks()) {}
+
+	~TraceZone()
+	{
+		Trace::Record(m_Name, m_Begin, TraceTicks());
+	}
+
+	TraceZone(const TraceZone&) = delete;
+	TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+	std::string_view m_Name;
+	uint64_t m_Begin;
+};
+
+} // namespace Composia::Core
+
+#endif // !COMPOSIA_TRACE_H
@@ -0,0 +1,133 @@
+#ifndef COMPOSIA_TYPE_INFO_H
+#define COMPOSIA_TYPE_INFO_H
+
+#include <cstdint> // uint64_t
+#include <cstdio> // std::fprintf
+#include <cstdlib> // std::abort
+#include <string_view> // std::string_view
+#include <type_traits> // std::remove_cv_t
+#include <unordered_map> // std::unordered_map
+#include <mutex> // std::mutex, std::lock_guard
+
+namespace Composia::Core {
+
+template<typename T>
+constexpr std::string_view RawTypeName() noexcept
+{
+#if defined(_MSC_VER)
+	return __FUNCSIG__;
+#else
+	return __PRETTY_FUNCTION__;
+#endif
+}
+
+// Offsets of the type inside RawTypeName's signature, measured once on a known type
+inline constexpr std::string_view TYPE_NAME_PROBE = RawTypeName<int>();
+inline constexpr size_t TYPE_NAME_PREFIX = TYPE_NAME_PROBE.find("int");
+inline constexpr size_t TYPE_NAME_SUFFIX = TYPE_NAME_PROBE.size() - TYPE_NAME_PREFIX - 3;
+
+// Compile-time name of T as spelled by the compiler
+template<typename T>
+constexpr std::string_view TypeName() noexcept
+{
+	constexpr std::string_view raw = RawTypeName<T>();
+	return raw.substr(TYPE_NAME_PREFIX, raw.size() - TYPE_NAME_PREFIX - TYPE_NAME_SUFFIX);
+}
+
+// 64-bit FNV-1a
+constexpr uint64_t HashString(std::string_view text) noexcept
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (char c : text)
+	{
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+// FNV-1a over a type name with the class/struct/enum keywords and all spaces dropped, so
+// "struct Foo<int, float>" (MSVC) and "Foo<int,float>" hash the same
+constexpr uint64_t HashTypeName(std::string_view name) noexcept
+{
+	constexpr std::string_view keywords[] = { "struct ", "class ", "enum " };
+
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < name.size();)
+	{
+		bool wordStart = i == 0 || !(name[i - 1] == '_' || (name[i - 1] >= '0' && name[i - 1] <= '9') ||
+			(name[i - 1] >= 'a' && name[i - 1] <= 'z') || (name[i - 1] >= 'A' && name[i - 1] <= 'Z'));
+
+		size_t skip = 0;
+		for (std::string_view keyword : keywords)
+		{
+			if (wordStart && name.substr(i, keyword.size()) == keyword)
+				skip = keyword.size();
+		}
+		if (skip != 0)
+		{
+			i += skip;
+			continue;
+		}
+
+		if (name[i] != ' ')
+		{
+			hash ^= static_cast<uint8_t>(name[i]);
+			hash *= 0x100000001b3ull;
+		}
+		++i;
+	}
+	return hash;
+}
+
+// Hash of T's name, unlike std::type_index::hash_code it is the same in every process
+template<typename T>
+constexpr uint64_t TypeHash() noexcept
+{
+	return HashTypeName(TypeName<T>());
+}
+
+// Process wide record of which type name owns each id. Returns false when id is already
+// owned by another name, i.e. two types collide.
+inline bool RegisterTypeId(uint64_t id, std::string_view name)
+{
+	static std::mutex mutex;
+	static std::unordered_map<uint64_t, std::string_view> owners;
+
+	std::lock_guard lock(mutex);
+	auto [it, inserted] = owners.try_emplace(id, name);
+	return inserted || it->second == name;
+}
+
+// RegisterTypeId that aborts on a collision, in every build: the colliding types would share a pool
+// or resource and be cast to each other. Returns true so typed lookups can run it once from a static.
+inline bool ClaimTypeId(uint64_t id, std::string_view name)
+{
+	if (RegisterTypeId(id, name))
+		return true;
+
+	std::fprintf(stderr, "Composia: %.*s shares its TypeId with another type, specialize Composia::TypeIdTraits for one of them\n",
+		static_cast<int>(name.size()), name.data());
+	std::abort();
+}
+
+} // namespace Composia::Core
+
+namespace Composia {
+
+// Specialize to pin a type's id, e.g. when its name differs between compilers or it is renamed:
+// template<> struct Composia::TypeIdTraits<Position> { static constexpr uint64_t value = 0x1234; };
+template<typename T>
+struct TypeIdTraits
+{
+	static constexpr uint64_t value = Core::TypeHash<T>();
+};
+
+// Stable 64-bit type id, the same across builds, compilers and processes. Keys the pool map and
+// tags serialized pools.
+template<typename T>
+inline constexpr uint64_t TypeId = TypeIdTraits<std::remove_cv_t<T>>::value;
+
+} // namespace Composia
+
+#endif // !COMPOSIA_TYPE_INFO_H
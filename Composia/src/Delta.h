@@ -0,0 +1,418 @@
+#ifndef COMPOSIA_DELTA_H
+#define COMPOSIA_DELTA_H
+
+#include <algorithm> // std::max, std::min
+#include <cstring> // memcpy
+#include <limits> // std::numeric_limits
+#include <istream> // std::istream
+#include <ostream> // std::ostream
+#include "Entity.h"
+#include "Core/DynamicArray.h"
+#include "Core/Archive.h"
+
+using Composia::Core::DynamicArray;
+using Composia::Core::OutputArchive;
+using Composia::Core::InputArchive;
+
+namespace Composia {
+
+// Appends size bytes, growing geometrically since Resize only grows to the exact size
+inline void AppendBytes(DynamicArray<uint8_t>& bytes, const void* data, size_t size)
+{
+	size_t offset = bytes.Size();
+	if (offset + size > bytes.Capacity())
+		bytes.Reserve(std::max(bytes.Capacity() * 2, offset + size));
+	bytes.Resize(offset + size);
+	if (size > 0)
+		memcpy(bytes.Data() + offset, data, size);
+}
+
+// Copy of one pool's entities and raw component bytes, the reference pool deltas are computed against.
+// Rows are kept packed like a sparse set so lookups and updates stay O(1).
+class PoolState
+{
+public:
+	PoolState(uint64_t typeHash = 0, uint32_t valueSize = 0) noexcept
+		: m_TypeHash(typeHash), m_ValueSize(valueSize), m_Entities(0), m_Values(0), m_Rows(0) {}
+
+	[[nodiscard]] inline bool Has(Entity e) const noexcept
+	{
+		return e < m_Rows.Size() && m_Rows[e] != INVALID_ROW;
+	}
+
+	[[nodiscard]] inline const uint8_t* Value(Entity e) const noexcept
+	{
+		return m_Values.Data() + static_cast<size_t>(m_Rows[e]) * m_ValueSize;
+	}
+
+	// Replaces the content with count entities and their values laid out back to back
+	void Assign(const Entity* entities, const void* values, size_t count)
+	{
+		for (Entity e : m_Entities)
+			m_Rows[e] = INVALID_ROW;
+
+		m_Entities.Clear();
+		m_Entities.Resize(count);
+		if (count > 0)
+			memcpy(m_Entities.Data(), entities, count * sizeof(Entity));
+
+		m_Values.Clear();
+		m_Values.Resize(count * m_ValueSize);
+		if (count > 0 && m_ValueSize > 0)
+			memcpy(m_Values.Data(), values, count * m_ValueSize);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			EnsureRows(m_Entities[i]);
+			m_Rows[m_Entities[i]] = static_cast<uint32_t>(i);
+		}
+	}
+
+	void Set(Entity e, const void* value)
+	{
+		if (!Has(e))
+		{
+			EnsureRows(e);
+			m_Rows[e] = static_cast<uint32_t>(m_Entities.Size());
+			m_Entities.PushBack(e);
+			AppendBytes(m_Values, value, m_ValueSize);
+			return;
+		}
+
+		if (m_ValueSize > 0)
+			memcpy(m_Values.Data() + static_cast<size_t>(m_Rows[e]) * m_ValueSize, value, m_ValueSize);
+	}
+
+	void Erase(Entity e)
+	{
+		if (!Has(e)) return;
+
+		// move last row into the erased one
+		uint32_t row = m_Rows[e];
+		uint32_t last = static_cast<uint32_t>(m_Entities.Size() - 1);
+		if (row != last)
+		{
+			Entity moved = m_Entities[last];
+			m_Entities[row] = moved;
+			m_Rows[moved] = row;
+			if (m_ValueSize > 0)
+				memcpy(m_Values.Data() + static_cast<size_t>(row) * m_ValueSize, m_Values.Data() + static_cast<size_t>(last) * m_ValueSize, m_ValueSize);
+		}
+
+		m_Entities.PopBack();
+		m_Values.Resize(m_Values.Size() - m_ValueSize);
+		m_Rows[e] = INVALID_ROW;
+	}
+
+	[[nodiscard]] inline const DynamicArray<Entity>& Entities() const noexcept
+	{
+		return m_Entities;
+	}
+
+	// Values in the same row order as Entities
+	[[nodiscard]] inline const DynamicArray<uint8_t>& Values() const noexcept
+	{
+		return m_Values;
+	}
+
+	[[nodiscard]] inline uint64_t TypeHash() const noexcept
+	{
+		return m_TypeHash;
+	}
+
+	[[nodiscard]] inline uint32_t ValueSize() const noexcept
+	{
+		return m_ValueSize;
+	}
+
+private:
+	static constexpr uint32_t INVALID_ROW = std::numeric_limits<uint32_t>::max();
+
+	inline void EnsureRows(Entity e)
+	{
+		if (e >= m_Rows.Size())
+		{
+			size_t newSize = m_Rows.Size() == 0 ? 64 : m_Rows.Size();
+			while (e >= newSize)
+				newSize *= 2;
+
+			m_Rows.Resize(newSize, INVALID_ROW);
+		}
+	}
+
+	uint64_t m_TypeHash;
+	uint32_t m_ValueSize;
+	DynamicArray<Entity> m_Entities;
+	DynamicArray<uint8_t> m_Values;
+	DynamicArray<uint32_t> m_Rows;
+};
+
+// Component changes of one pool between a baseline and the current state. Old values are kept
+// next to new ones so the delta can be reverted as well as applied.
+struct PoolDelta
+{
+	uint64_t typeHash = 0;
+	uint32_t valueSize = 0;
+
+	DynamicArray<Entity> added{ 0 };
+	DynamicArray<uint8_t> addedValues{ 0 };
+	DynamicArray<Entity> removed{ 0 };
+	DynamicArray<uint8_t> removedValues{ 0 };
+	DynamicArray<Entity> changed{ 0 };
+	DynamicArray<uint8_t> changedBefore{ 0 };
+	DynamicArray<uint8_t> changedAfter{ 0 };
+
+	[[nodiscard]] inline bool Empty() const noexcept
+	{
+		return added.Empty() && removed.Empty() && changed.Empty();
+	}
+};
+
+// Generations and free list of an EntityManager. Liveness is not stored: an id below the
+// generation count is alive unless it sits in the free list.
+struct EntityState
+{
+	DynamicArray<uint32_t> generations{ 0 };
+	DynamicArray<Entity> freeList{ 0 };
+};
+
+// Ids whose generation changed or that exist on one side only, plus both free lists when they
+// differ since liveness follows from them and recycling order matters
+struct EntityDelta
+{
+	uint32_t countBefore = 0;
+	uint32_t countAfter = 0;
+	DynamicArray<Entity> ids{ 0 };
+	DynamicArray<uint32_t> generationsBefore{ 0 };
+	DynamicArray<uint32_t> generationsAfter{ 0 };
+	DynamicArray<Entity> freeListBefore{ 0 };
+	DynamicArray<Entity> freeListAfter{ 0 };
+	bool freeListChanged = false;
+
+	[[nodiscard]] inline bool Empty() const noexcept
+	{
+		return countBefore == countAfter && ids.Empty() && !freeListChanged;
+	}
+};
+
+// Applies an entity delta to a captured state, keeping a baseline in step with the world
+inline void ApplyEntityDelta(EntityState& state, const EntityDelta& delta, bool revert)
+{
+	const auto& generations = revert ? delta.generationsBefore : delta.generationsAfter;
+	const auto& freeList = revert ? delta.freeListBefore : delta.freeListAfter;
+	uint32_t count = revert ? delta.countBefore : delta.countAfter;
+
+	state.generations.Resize(count, 0);
+	for (size_t i = 0; i < delta.ids.Size(); ++i)
+	{
+		if (delta.ids[i] < count)
+			state.generations[delta.ids[i]] = generations[i];
+	}
+
+	if (delta.freeListChanged)
+	{
+		state.freeList.Clear();
+		for (Entity e : freeList)
+			state.freeList.PushBack(e);
+	}
+}
+
+// World changes since a DeltaBaseline, see Registry::Diff. Entity lists are encoded as zigzag
+// varints of the difference to the previous id, which keeps sorted or clustered ids to a byte or two.
+class Delta
+{
+public:
+	EntityDelta entities;
+	DynamicArray<PoolDelta> pools{ 0 };
+
+	[[nodiscard]] bool Empty() const noexcept
+	{
+		for (const PoolDelta& pool : pools)
+		{
+			if (!pool.Empty())
+				return false;
+		}
+		return entities.Empty();
+	}
+
+	bool Save(std::ostream& stream) const
+	{
+		OutputArchive archive(&stream);
+		Write(archive);
+		return archive.Good();
+	}
+
+	// Encoded size in bytes
+	[[nodiscard]] size_t EncodedSize() const
+	{
+		OutputArchive counter;
+		Write(counter);
+		return counter.Written();
+	}
+
+	bool Load(std::istream& stream)
+	{
+		InputArchive archive(stream);
+		entities = EntityDelta{};
+		pools.Clear();
+
+		uint32_t magic = 0;
+		uint32_t poolCount = 0;
+		if (!archive.Read(magic) || magic != DELTA_MAGIC)
+			return false;
+		if (!archive.Read(entities.countBefore) || !archive.Read(entities.countAfter) ||
+			!ReadIds(archive, entities.ids) ||
+			!ReadValues(archive, entities.generationsBefore, entities.ids.Size()) ||
+			!ReadValues(archive, entities.generationsAfter, entities.ids.Size()) ||
+			!archive.Read(entities.freeListChanged) ||
+			!ReadIds(archive, entities.freeListBefore) || !ReadIds(archive, entities.freeListAfter) ||
+			!archive.Read(poolCount))
+			return false;
+
+		for (uint32_t i = 0; i < poolCount; ++i)
+		{
+			PoolDelta pool;
+			if (!archive.Read(pool.typeHash) || !archive.Read(pool.valueSize) ||
+				!ReadIds(archive, pool.added) || !ReadValues(archive, pool.addedValues, pool.added.Size(), pool.valueSize) ||
+				!ReadIds(archive, pool.removed) || !ReadValues(archive, pool.removedValues, pool.removed.Size(), pool.valueSize) ||
+				!ReadIds(archive, pool.changed) || !ReadValues(archive, pool.changedBefore, pool.changed.Size(), pool.valueSize) ||
+				!ReadValues(archive, pool.changedAfter, pool.changed.Size(), pool.valueSize))
+				return false;
+			pools.PushBack(std::move(pool));
+		}
+		return true;
+	}
+
+private:
+	static constexpr uint32_t DELTA_MAGIC = 0x544C4443; // "CDLT"
+	static constexpr uint64_t ID_RESERVE_LIMIT = 1 << 16;
+
+	void Write(OutputArchive& archive) const
+	{
+		archive.Write(DELTA_MAGIC);
+		archive.Write(entities.countBefore);
+		archive.Write(entities.countAfter);
+		WriteIds(archive, entities.ids);
+		archive.Write(entities.generationsBefore.Data(), entities.generationsBefore.Size() * sizeof(uint32_t));
+		archive.Write(entities.generationsAfter.Data(), entities.generationsAfter.Size() * sizeof(uint32_t));
+		archive.Write(entities.freeListChanged);
+		WriteIds(archive, entities.freeListBefore);
+		WriteIds(archive, entities.freeListAfter);
+
+		uint32_t poolCount = 0;
+		for (const PoolDelta& pool : pools)
+			poolCount += !pool.Empty();
+		archive.Write(poolCount);
+
+		for (const PoolDelta& pool : pools)
+		{
+			if (pool.Empty())
+				continue;
+
+			archive.Write(pool.typeHash);
+			archive.Write(pool.valueSize);
+			WriteIds(archive, pool.added);
+			archive.Write(pool.addedValues.Data(), pool.addedValues.Size());
+			WriteIds(archive, pool.removed);
+			archive.Write(pool.removedValues.Data(), pool.removedValues.Size());
+			WriteIds(archive, pool.changed);
+			archive.Write(pool.changedBefore.Data(), pool.changedBefore.Size());
+			archive.Write(pool.changedAfter.Data(), pool.changedAfter.Size());
+		}
+	}
+
+	static void WriteIds(OutputArchive& archive, const DynamicArray<Entity>& ids)
+	{
+		archive.WriteVarint(ids.Size());
+		int64_t previous = 0;
+		for (Entity e : ids)
+		{
+			int64_t difference = static_cast<int64_t>(e) - previous;
+			archive.WriteVarint((static_cast<uint64_t>(difference) << 1) ^ static_cast<uint64_t>(difference >> 63));
+			previous = e;
+		}
+	}
+
+	static bool ReadIds(InputArchive& archive, DynamicArray<Entity>& ids)
+	{
+		uint64_t count = 0;
+		if (!archive.ReadVarint(count))
+			return false;
+
+		// every id takes at least a byte, larger counts can't be in the archive
+		if (!archive.Holds(count, 1))
+			return false;
+
+		// streams that can't seek leave count unbounded, past the cap ids grow as they are read
+		ids.Clear();
+		ids.Reserve(static_cast<size_t>(std::min<uint64_t>(count, ID_RESERVE_LIMIT)));
+		int64_t previous = 0;
+		for (uint64_t i = 0; i < count; ++i)
+		{
+			uint64_t encoded = 0;
+			if (!archive.ReadVarint(encoded))
+				return false;
+
+			previous += static_cast<int64_t>(encoded >> 1) ^ -static_cast<int64_t>(encoded & 1);
+			ids.PushBack(static_cast<Entity>(previous));
+		}
+		return true;
+	}
+
+	// Reads count values of width elements each
+	template<typename T>
+	static bool ReadValues(InputArchive& archive, DynamicArray<T>& values, size_t count, size_t width = 1)
+	{
+		return archive.Holds(count, width) && archive.ReadElements(values, static_cast<uint64_t>(count) * width);
+	}
+};
+
+// Captured world the next Diff is computed against. Advance moves it forward by a delta
+// so a baseline can follow the world tick by tick without being captured again.
+class DeltaBaseline
+{
+public:
+	EntityState entities;
+	DynamicArray<PoolState> pools{ 0 };
+
+	[[nodiscard]] PoolState* Find(uint64_t typeHash) noexcept
+	{
+		for (PoolState& pool : pools)
+		{
+			if (pool.TypeHash() == typeHash)
+				return &pool;
+		}
+		return nullptr;
+	}
+
+	[[nodiscard]] const PoolState* Find(uint64_t typeHash) const noexcept
+	{
+		return const_cast<DeltaBaseline*>(this)->Find(typeHash);
+	}
+
+	void Advance(const Delta& delta)
+	{
+		ApplyEntityDelta(entities, delta.entities, false);
+
+		for (const PoolDelta& change : delta.pools)
+		{
+			PoolState* pool = Find(change.typeHash);
+			if (!pool)
+			{
+				pools.PushBack(PoolState(change.typeHash, change.valueSize));
+				pool = &pools.Back();
+			}
+
+			for (size_t i = 0; i < change.removed.Size(); ++i)
+				pool->Erase(change.removed[i]);
+			for (size_t i = 0; i < change.added.Size(); ++i)
+				pool->Set(change.added[i], change.addedValues.Data() + i * change.valueSize);
+			for (size_t i = 0; i < change.changed.Size(); ++i)
+				pool->Set(change.changed[i], change.changedAfter.Data() + i * change.valueSize);
+		}
+	}
+};
+
+} // namespace Composia
+
+#endif // !COMPOSIA_DELTA_H
@@ -2,9 +2,17 @@
 #define COMPOSIA_ENTITY_MANAGER_H
 
 #include <vector>
+#include <algorithm> // std::max, std::min
+#include <cassert> // assert
+#include <cstring> // memcpy, memcmp
 #include "Entity.h"
 #include "Core/DynamicArray.h"
+#include "Core/Archive.h"
+#include "Delta.h"
+#include "MemoryStats.h"
 using Composia::Core::DynamicArray;
+using Composia::Core::OutputArchive;
+using Composia::Core::InputArchive;
 
 namespace Composia {
 
@@ -54,10 +62,350 @@ public:
 		return e < m_Generations.Size() ? m_Generations.At(e) : 0;
 	}
 
+	// Every id below the high-water mark is either alive or free
+	EntityMemory Memory() const noexcept
+	{
+		EntityMemory memory;
+		memory.ids = m_Generations.Size();
+		memory.freeListLength = m_FreeList.Size() + m_Trimmed.Size();
+		memory.alive = memory.ids - memory.freeListLength;
+		memory.generations = ArrayMemory::Of(m_Generations);
+		memory.aliveFlags = ArrayMemory{ (m_Alive.size() + 7) / 8, (m_Alive.capacity() + 7) / 8 };
+		memory.freeList = ArrayMemory::Of(m_FreeList);
+		memory.freeList += ArrayMemory::Of(m_Trimmed);
+		return memory;
+	}
+
+	// Gives back spare capacity. With trimIds the dead ids above the highest live one are forgotten,
+	// lowering the high-water mark; they are handed out again starting from generation 0. Stays within
+	// budget, returns false when it has to be called again to finish.
+	bool Compact(bool trimIds, Core::CompactBudget& budget)
+	{
+		if (!Trim(trimIds, budget))
+			return false;
+
+		if (m_Alive.capacity() > 2 * m_Alive.size() + 8 * 4096)
+		{
+			size_t words = m_Alive.size() / 64 + 1;
+			bool stepped = budget.Step(words, (m_Alive.capacity() - m_Alive.size()) / 8, [&] { m_Alive.shrink_to_fit(); });
+			if (!stepped)
+				return false;
+		}
+		return budget.Compact(m_Generations) && budget.Compact(m_FreeList);
+	}
+
+	// Numbers the live ids 0..alive-1: those listed in first come first in that order (dead or repeated
+	// ones are skipped), the other live ids follow in ascending order. remap receives the new id of every
+	// old id, INVALID_ENTITY for dead ones. Generations move with their ids and the free list empties.
+	size_t Renumber(const Entity* first, size_t firstCount, DynamicArray<Entity>& remap)
+	{
+		EndTrim();
+		constexpr Entity PENDING = INVALID_ENTITY - 1;
+		size_t ids = m_Generations.Size();
+		size_t alive = ids - m_FreeList.Size();
+
+		remap.Clear();
+		remap.Resize(ids);
+		for (Entity e = 0; e < ids; ++e)
+			remap[e] = m_Alive[e] ? PENDING : INVALID_ENTITY;
+
+		// new ids are handed out in order, so generations are written front to back
+		DynamicArray<uint32_t> generations(alive + 1);
+		for (size_t i = 0; i < firstCount; ++i)
+		{
+			Entity e = first[i];
+			if (e < ids && remap[e] == PENDING)
+			{
+				remap[e] = static_cast<Entity>(generations.Size());
+				generations.PushBack(m_Generations[e]);
+			}
+		}
+
+		// branchless, whether an id is still pending is close to random after heavy churn
+		Entity next = static_cast<Entity>(generations.Size());
+		generations.Resize(alive + 1);
+		for (Entity e = 0; e < ids; ++e)
+		{
+			bool pending = remap[e] == PENDING;
+			generations[next] = m_Generations[e];
+			remap[e] = pending ? next : remap[e];
+			next += pending;
+		}
+		generations.Resize(next);
+
+		m_Generations = std::move(generations);
+		m_Alive.assign(next, true);
+		m_FreeList.Clear();
+		return next;
+	}
+
+	void Save(OutputArchive& archive) const
+	{
+		DynamicArray<Entity> scratch(0);
+		archive.WriteArray(m_Generations);
+		archive.WriteArray(FreeIds(scratch));
+	}
+
+	// Every id below the saved count is alive unless it sits in the free list
+	bool Load(InputArchive& archive)
+	{
+		m_Trimmed.Clear();
+		m_Trim = TrimPass{};
+		if (!archive.ReadArray(m_Generations) || !archive.ReadArray(m_FreeList))
+			return false;
+
+		m_Alive.assign(m_Generations.Size(), true);
+		for (Entity e : m_FreeList)
+		{
+			if (e >= m_Generations.Size())
+				return false;
+			m_Alive[e] = false;
+		}
+		return true;
+	}
+
+	void Capture(EntityState& state) const
+	{
+		state.generations.Clear();
+		state.generations.Resize(m_Generations.Size());
+		if (!m_Generations.Empty())
+			memcpy(state.generations.Data(), m_Generations.Data(), m_Generations.Size() * sizeof(uint32_t));
+
+		DynamicArray<Entity> scratch(0);
+		state.freeList.Clear();
+		for (Entity e : FreeIds(scratch))
+			state.freeList.PushBack(e);
+	}
+
+	void Diff(const EntityState& baseline, EntityDelta& delta) const
+	{
+		DynamicArray<Entity> scratch(0);
+		const DynamicArray<Entity>& freeList = FreeIds(scratch);
+
+		delta.countBefore = static_cast<uint32_t>(baseline.generations.Size());
+		delta.countAfter = static_cast<uint32_t>(m_Generations.Size());
+
+		// generations only change when ids are recycled, so whole blocks are skipped
+		constexpr size_t BLOCK = 1024;
+		size_t shared = std::min(baseline.generations.Size(), m_Generations.Size());
+		for (size_t i = 0; i < shared; i += BLOCK)
+		{
+			size_t blockEnd = std::min(i + BLOCK, shared);
+			if (memcmp(baseline.generations.Data() + i, m_Generations.Data() + i, (blockEnd - i) * sizeof(uint32_t)) == 0)
+				continue;
+
+			for (size_t j = i; j < blockEnd; ++j)
+			{
+				if (baseline.generations[j] != m_Generations[j])
+					AddChangedId(delta, static_cast<Entity>(j), baseline.generations[j], m_Generations[j]);
+			}
+		}
+
+		for (size_t i = shared; i < baseline.generations.Size(); ++i)
+			AddChangedId(delta, static_cast<Entity>(i), baseline.generations[i], 0);
+		for (size_t i = shared; i < m_Generations.Size(); ++i)
+			AddChangedId(delta, static_cast<Entity>(i), 0, m_Generations[i]);
+
+		delta.freeListChanged = baseline.freeList.Size() != freeList.Size() ||
+			(!freeList.Empty() && memcmp(baseline.freeList.Data(), freeList.Data(), freeList.Size() * sizeof(Entity)) != 0);
+		if (delta.freeListChanged)
+		{
+			for (Entity e : baseline.freeList)
+				delta.freeListBefore.PushBack(e);
+			for (Entity e : freeList)
+				delta.freeListAfter.PushBack(e);
+		}
+	}
+
+	// Checks a delta, possibly read from an untrusted source, before Apply. Ids past the current
+	// count must be listed in the delta, as Diff lists every id it adds, and the free list it sets
+	// must name distinct ids below its count. Dropping ids takes a new free list without them.
+	[[nodiscard]] bool Accepts(const EntityDelta& delta, bool revert) const
+	{
+		if (delta.generationsBefore.Size() != delta.ids.Size() || delta.generationsAfter.Size() != delta.ids.Size())
+			return false;
+
+		uint32_t count = revert ? delta.countBefore : delta.countAfter;
+		if (count > m_Generations.Size() && count - m_Generations.Size() > delta.ids.Size())
+			return false;
+		if (!delta.freeListChanged)
+			return count >= m_Generations.Size() || delta.Empty();
+
+		std::vector<bool> listed(count, false);
+		for (Entity e : revert ? delta.freeListBefore : delta.freeListAfter)
+		{
+			if (e >= count || listed[e])
+				return false;
+			listed[e] = true;
+		}
+		return true;
+	}
+
+	// Moves the entity state to the delta's end state, or back to its start state when reverting.
+	// The delta must pass Accepts.
+	void Apply(const EntityDelta& delta, bool revert)
+	{
+		assert(Accepts(delta, revert));
+		if (delta.Empty())
+			return;
+
+		EndTrim();
+
+		const auto& generations = revert ? delta.generationsBefore : delta.generationsAfter;
+		const auto& freeListFrom = revert ? delta.freeListAfter : delta.freeListBefore;
+		const auto& freeListTo = revert ? delta.freeListBefore : delta.freeListAfter;
+		uint32_t count = revert ? delta.countBefore : delta.countAfter;
+
+		m_Generations.Resize(count, 0);
+		m_Alive.resize(count, true);
+		for (size_t i = 0; i < delta.ids.Size(); ++i)
+		{
+			if (delta.ids[i] < count)
+				m_Generations[delta.ids[i]] = generations[i];
+		}
+
+		if (delta.freeListChanged)
+		{
+			for (Entity e : freeListFrom)
+			{
+				if (e < count)
+					m_Alive[e] = true;
+			}
+
+			m_FreeList.Clear();
+			for (Entity e : freeListTo)
+			{
+				m_Alive[e] = false;
+				m_FreeList.PushBack(e);
+			}
+		}
+	}
+
 private:
+	// Progress of the id trimming Compact spreads over calls. The dead ids above the highest live one
+	// are found scanning down from top, then moved out of the free list into m_Trimmed, where Create
+	// doesn't recycle them; once all of them are there the ids are cut in one go.
+	struct TrimPass
+	{
+		size_t top = SIZE_MAX;  // id count the pass started from, SIZE_MAX when none is under way
+		size_t count = 0;       // the ids from count to top were found dead
+		size_t filtered = 0;    // free list entries checked so far
+		bool scanned = false;
+	};
+
+	// Returns true once a trimming pass is finished, or with !trimIds once none is under way
+	bool Trim(bool trimIds, Core::CompactBudget& budget)
+	{
+		// ids created since the pass started, or the pass being called off, put the ids it set aside back
+		size_t size = m_Generations.Size();
+		if (!trimIds || m_Trim.top != size)
+		{
+			if (!Restore(budget))
+				return false;
+			m_Trim = TrimPass{ size, size, 0, false };
+			if (!trimIds)
+				return true;
+		}
+
+		if (!m_Trim.scanned)
+		{
+			size_t end = m_Trim.count - std::min(m_Trim.count, budget.Left());
+			size_t count = m_Trim.count;
+			while (count > end && !m_Alive[count - 1])
+				--count;
+			budget.work += m_Trim.count - count;
+			m_Trim.count = count;
+			if (count != 0 && !m_Alive[count - 1])
+				return false;
+
+			m_Trim.scanned = true;
+			m_Trimmed.Reserve(m_Trim.top - m_Trim.count);
+		}
+
+		size_t dead = m_Trim.top - m_Trim.count;
+		size_t steps = budget.Left();
+		m_Trim.filtered = std::min(m_Trim.filtered, m_FreeList.Size());
+		while (m_Trimmed.Size() < dead && m_Trim.filtered < m_FreeList.Size() && steps > 0)
+		{
+			--steps;
+			Entity e = m_FreeList[m_Trim.filtered];
+			if (e < m_Trim.count)
+			{
+				++m_Trim.filtered;
+				continue;
+			}
+			m_Trimmed.PushBack(e);
+			m_FreeList[m_Trim.filtered] = m_FreeList.Back();
+			m_FreeList.PopBack();
+		}
+		budget.work += budget.Left() - steps;
+		if (m_Trimmed.Size() < dead && m_Trim.filtered < m_FreeList.Size())
+			return false;
+
+		// every id from count up sits in m_Trimmed unless one was recycled while the free list was
+		// being filtered, in which case the pass ends without trimming
+		if (m_Trimmed.Size() == dead)
+		{
+			m_Generations.Resize(m_Trim.count);
+			m_Alive.resize(m_Trim.count);
+		}
+		else if (!Restore(budget))
+			return false;
+
+		// the set aside ids only needed a buffer for the duration of the pass
+		m_Trimmed = DynamicArray<Entity>(0);
+		m_Trim = TrimPass{};
+		return true;
+	}
+
+	// Moves the ids a trimming pass set aside back to the free list, returns true once they all are
+	bool Restore(Core::CompactBudget& budget)
+	{
+		size_t moves = std::min(m_Trimmed.Size(), budget.Left());
+		for (size_t i = 0; i < moves; ++i)
+		{
+			m_FreeList.PushBack(m_Trimmed.Back());
+			m_Trimmed.PopBack();
+		}
+		budget.work += moves;
+		return m_Trimmed.Empty();
+	}
+
+	// Calls off a trimming pass whatever it costs, before the ids or the free list are rewritten
+	inline void EndTrim()
+	{
+		for (Entity e : m_Trimmed)
+			m_FreeList.PushBack(e);
+		m_Trimmed.Clear();
+		m_Trim = TrimPass{};
+	}
+
+	// The free list, with the ids a trimming pass set aside appended in scratch if there are any
+	const DynamicArray<Entity>& FreeIds(DynamicArray<Entity>& scratch) const
+	{
+		if (m_Trimmed.Empty())
+			return m_FreeList;
+
+		scratch.Reserve(m_FreeList.Size() + m_Trimmed.Size());
+		for (Entity e : m_FreeList)
+			scratch.PushBack(e);
+		for (Entity e : m_Trimmed)
+			scratch.PushBack(e);
+		return scratch;
+	}
+
+	static void AddChangedId(EntityDelta& delta, Entity e, uint32_t before, uint32_t after)
+	{
+		delta.ids.PushBack(e);
+		delta.generationsBefore.PushBack(before);
+		delta.generationsAfter.PushBack(after);
+	}
+
 	DynamicArray<uint32_t> m_Generations;
 	std::vector<bool> m_Alive;
 	DynamicArray<Entity> m_FreeList;
+	DynamicArray<Entity> m_Trimmed{ 0 };
+	TrimPass m_Trim;
 };
 
 } // namespace Composia 
@@ -0,0 +1,108 @@
+#ifndef COMPOSIA_MEMORY_STATS_H
+#define COMPOSIA_MEMORY_STATS_H
+
+#include <string_view> // std::string_view
+#include "Core/DynamicArray.h"
+
+using Composia::Core::DynamicArray;
+
+namespace Composia {
+
+// Bytes held by one array: used covers its elements, reserved its whole allocation
+struct ArrayMemory
+{
+	size_t used = 0;
+	size_t reserved = 0;
+
+	template<typename T>
+	[[nodiscard]] static ArrayMemory Of(const DynamicArray<T>& array) noexcept
+	{
+		return ArrayMemory{ array.Size() * sizeof(T), array.Capacity() * sizeof(T) };
+	}
+
+	inline ArrayMemory& operator+=(const ArrayMemory& other) noexcept
+	{
+		used += other.used;
+		reserved += other.reserved;
+		return *this;
+	}
+};
+
+// Footprint of one component pool. Sparse is whatever maps entities to rows: the sparse array,
+// the hash table of HashMap pools or the words of Bitset pools.
+struct PoolMemory
+{
+	std::string_view typeName;
+	uint64_t typeId = 0;
+	size_t count = 0;
+	ArrayMemory dense;
+	ArrayMemory packed;
+	ArrayMemory sparse;
+
+	[[nodiscard]] inline ArrayMemory Total() const noexcept
+	{
+		ArrayMemory total = dense;
+		total += packed;
+		total += sparse;
+		return total;
+	}
+};
+
+struct EntityMemory
+{
+	size_t alive = 0;
+	size_t ids = 0; // high-water mark, alive + free list
+	size_t freeListLength = 0;
+	ArrayMemory generations;
+	ArrayMemory aliveFlags;
+	ArrayMemory freeList;
+
+	[[nodiscard]] inline ArrayMemory Total() const noexcept
+	{
+		ArrayMemory total = generations;
+		total += aliveFlags;
+		total += freeList;
+		return total;
+	}
+};
+
+// Registry wide report returned by Registry::MemoryStats. Arrays shared by a CloneShared copy
+// or borrowed from a mapped image are counted in every registry that uses them.
+struct MemoryReport
+{
+	EntityMemory entities;
+	DynamicArray<PoolMemory> pools;
+	ArrayMemory poolMap;
+
+	[[nodiscard]] inline ArrayMemory Total() const noexcept
+	{
+		ArrayMemory total = entities.Total();
+		total += poolMap;
+		for (const PoolMemory& pool : pools)
+			total += pool.Total();
+		return total;
+	}
+
+	[[nodiscard]] inline const PoolMemory* Find(std::string_view typeName) const noexcept
+	{
+		for (const PoolMemory& pool : pools)
+		{
+			if (pool.typeName == typeName)
+				return &pool;
+		}
+		return nullptr;
+	}
+};
+
+// Outcome of a Registry::Compact call
+struct CompactResult
+{
+	size_t released = 0;  // bytes given back
+	size_t deferred = 0;  // bytes kept because giving them back is a larger step than budget allows
+	size_t work = 0;      // array elements scanned or moved
+	bool swept = false;   // the call finished a pass over every pool and the entity ids
+};
+
+} // namespace Composia
+
+#endif // !COMPOSIA_MEMORY_STATS_H
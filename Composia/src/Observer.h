@@ -0,0 +1,161 @@
+#ifndef COMPOSIA_OBSERVER_H
+#define COMPOSIA_OBSERVER_H
+
+#include <tuple>
+#include <limits>
+#include <algorithm>
+#include "Core/SparseSet.h"
+#include "ComponentManager.h"
+
+namespace Composia {
+
+	// Marker listing the components an entity must not have to match an Observer
+	template<typename... Excluded>
+	struct Exclude {};
+
+	// Type-erased base so the Registry can own observers of any signature
+	struct IObserver
+	{
+		virtual ~IObserver() = default;
+		virtual void Remap(const DynamicArray<Entity>& remap, size_t entityCount) = 0;
+	};
+
+	template<typename ExcludeList, typename... Components>
+	class Observer;
+
+	// Persistent query that keeps the set of entities owning all Components and none of Excluded.
+	// The set is updated from the watched pools' signals, so iterating it costs
+	// only as much as the number of matches. Clear() drops the collected entities, which allows
+	// "collect then handle" workflows: entities come back once one of their watched components changes.
+	template<typename... Excluded, typename... Components>
+	class Observer<Exclude<Excluded...>, Components...> final : public IObserver
+	{
+	public:
+		static_assert(sizeof...(Components) > 0, "Observer needs at least one included component");
+
+		Observer(ComponentManager& manager)
+			: m_Included(manager.AssurePool<Components>()...), m_Excluded(manager.AssurePool<Excluded>()...)
+		{
+			std::apply([this](auto*... pools) {
+				(pools->OnConstruct().template Connect<&Observer::OnIncludedChange>(*this), ...);
+				(pools->OnUpdate().template Connect<&Observer::OnIncludedChange>(*this), ...);
+				(pools->OnDestroy().template Connect<&Observer::Discard>(*this), ...);
+				}, m_Included);
+			(std::get<ComponentPool<Excluded>*>(m_Excluded)->OnConstruct().template Connect<&Observer::Discard>(*this), ...);
+			(std::get<ComponentPool<Excluded>*>(m_Excluded)->OnDestroy().template Connect<&Observer::template OnExcludedDestroy<Excluded>>(*this), ...);
+			Populate();
+		}
+
+		~Observer() override
+		{
+			std::apply([this](auto*... pools) {
+				(pools->OnConstruct().Disconnect(this), ...);
+				(pools->OnUpdate().Disconnect(this), ...);
+				(pools->OnDestroy().Disconnect(this), ...);
+				}, m_Included);
+			std::apply([this](auto*... pools) {
+				(pools->OnConstruct().Disconnect(this), ...);
+				(pools->OnDestroy().Disconnect(this), ...);
+				}, m_Excluded);
+		}
+
+		Observer(const Observer&) = delete;
+		Observer& operator=(const Observer&) = delete;
+
+		[[nodiscard]] inline bool Has(Entity e) const noexcept
+		{
+			return m_Entities.Has(e);
+		}
+
+		[[nodiscard]] inline size_t Size() const noexcept
+		{
+			return m_Entities.Size();
+		}
+
+		[[nodiscard]] inline bool Empty() const noexcept
+		{
+			return m_Entities.Size() == 0;
+		}
+
+		inline void Clear() noexcept
+		{
+			m_Entities.Clear();
+		}
+
+		void Remap(const DynamicArray<Entity>& remap, size_t entityCount) override
+		{
+			m_Entities.Remap(remap, entityCount);
+		}
+
+		// Iterates back to front, so func may add or remove watched components of the visited entity.
+		template<typename Func>
+		void each(Func&& func)
+		{
+			const auto& entities = m_Entities.RawPacked();
+			for (size_t i = entities.Size(); i > 0; --i)
+			{
+				if (i > entities.Size())
+					continue;
+
+				func(entities[i - 1]);
+			}
+		}
+
+		const Entity* begin() const noexcept { return m_Entities.RawPacked().begin(); }
+		const Entity* end() const noexcept { return m_Entities.RawPacked().end(); }
+
+	private:
+		void OnIncludedChange(Entity e)
+		{
+			if (Matches(e))
+				m_Entities.Add(e);
+		}
+
+		void Discard(Entity e)
+		{
+			m_Entities.Remove(e);
+		}
+
+		// Destroy signals fire before removal, so the excluded pool being emptied is skipped
+		template<typename Removed>
+		void OnExcludedDestroy(Entity e)
+		{
+			if (Matches<Removed>(e))
+				m_Entities.Add(e);
+		}
+
+		template<typename Skipped = void>
+		inline bool Matches(Entity e) const noexcept
+		{
+			bool included = std::apply([e](auto*... pools) { return (pools->Has(e) && ...); }, m_Included);
+			bool excluded = (... || (!std::is_same_v<Excluded, Skipped> && std::get<ComponentPool<Excluded>*>(m_Excluded)->Has(e)));
+			return included && !excluded;
+		}
+
+		void Populate() noexcept
+		{
+			size_t smallest = std::numeric_limits<size_t>::max();
+			std::apply([&](auto*... pools) { ((smallest = std::min(smallest, pools->Size())), ...); }, m_Included);
+
+			bool populated = false;
+			auto populateFrom = [&](auto* pool) {
+				if (populated || pool->Size() != smallest)
+					return;
+
+				populated = true;
+				pool->Each([&](Entity e) {
+					if (Matches(e))
+						m_Entities.Add(e);
+					});
+				};
+			std::apply([&](auto*... pools) { (populateFrom(pools), ...); }, m_Included);
+		}
+
+		std::tuple<ComponentPool<Components>*...> m_Included;
+		std::tuple<ComponentPool<Excluded>*...> m_Excluded;
+		SparseSet<void> m_Entities;
+	};
+
+} // namespace Composia
+
+#endif // !COMPOSIA_OBSERVER_H
@@ -1,15 +1,53 @@
 #ifndef COMPOSIA_REGISTRY_H
 #define COMPOSIA_REGISTRY_H
 
+// Defining COMPOSIA_ARCHETYPE_STORAGE swaps the backend at compile time, see ArchetypeRegistry
+#if defined(COMPOSIA_ARCHETYPE_STORAGE)
+#include "ArchetypeRegistry.h"
+
+namespace Composia {
+
+using Registry = ArchetypeRegistry;
+
+} // namespace Composia
+
+#else
+
+#include <fstream> // std::ifstream
+#include <istream> // std::istream
+#include <limits> // std::numeric_limits
+#include <ostream> // std::ostream
 #include "EntityManager.h"
 #include "ComponentManager.h"
+#include "ResourceManager.h"
 #include "View.h"
+#include "Observer.h"
+#include "Core/MappedFile.h"
 
 namespace Composia {
 
 class Registry
 {
 public:
+	Registry() = default;
+	Registry(Registry&&) = default;
+
+	// Copies are made explicitly with Clone or CloneShared
+	Registry(const Registry&) = delete;
+	Registry& operator=(const Registry&) = delete;
+
+	Registry& operator=(Registry&& other) noexcept
+	{
+		// observers disconnect from the pools before those are replaced
+		m_Observers.Clear();
+		m_EntityManager = std::move(other.m_EntityManager);
+		m_ComponentManager = std::move(other.m_ComponentManager);
+		m_Resources = std::move(other.m_Resources);
+		m_Observers = std::move(other.m_Observers);
+		m_CompactingEntities = other.m_CompactingEntities;
+		return *this;
+	}
+
 	inline Entity Create() noexcept
 	{
 		return m_EntityManager.Create();
@@ -21,6 +59,12 @@ public:
 		m_ComponentManager.Remove<T>(e);
 	}
 
+	template<typename T>
+	inline void Remove(const Entity* entities, size_t count) noexcept
+	{
+		m_ComponentManager.Remove<T>(entities, count);
+	}
+
 	inline void Destroy(Entity e) noexcept
 	{
 		m_ComponentManager.RemoveAllForEntity(e);
@@ -38,6 +82,26 @@ public:
 	{
 		return m_ComponentManager.Has<T>(e);
 	}
+
+	// Hides e from views while keeping its components, e.g. for pooled or out of range objects.
+	// Each pool keeps the components of enabled entities in front of the disabled ones, so views read
+	// that prefix without checking anything per entity. Has, Get and signals are not affected, and
+	// components added to e while it is disabled start out disabled. Costs one swap per component
+	// of e plus a visit of every pool, as Destroy does.
+	inline void Disable(Entity e)
+	{
+		m_ComponentManager.Disable(e);
+	}
+
+	inline void Enable(Entity e)
+	{
+		m_ComponentManager.Enable(e);
+	}
+
+	[[nodiscard]] inline bool IsEnabled(Entity e) const noexcept
+	{
+		return m_ComponentManager.IsEnabled(e);
+	}
  
 	template<typename T, typename... Args>
 	inline void Emplace(Entity e, Args&&... args) noexcept
@@ -45,23 +109,336 @@ public:
 		m_ComponentManager.Emplace<T>(e, std::forward<Args>(args)...);
 	}
 
+	template<typename T>
+	inline void Insert(const Entity* entities, size_t count, const T& comp = {})
+	{
+		m_ComponentManager.Insert<T>(entities, count, comp);
+	}
+
 	template<typename T>
 	inline T& Get(Entity e) noexcept
 	{
 		return *m_ComponentManager.Get<T>(e);
 	}
 
+	// Handle to T's pool for hot loops doing random access, e.g. Get on target entities. The pool is
+	// looked up once here instead of on every call. Stays valid while the registry lives, including
+	// across moving it into another one, but not once another registry is assigned to it.
+	template<typename T>
+	[[nodiscard]] inline StorageHandle<T> Storage()
+	{
+		return m_ComponentManager.Storage<T>();
+	}
+
 	template<typename... Components>
 	inline Composia::View<Components...> View() noexcept
 	{
 		return Composia::View<Components...>(this->m_ComponentManager);
 	}
 
+	// Reorders T's pool, see ComponentPool::Sort
+	template<typename T, typename Compare>
+	inline void Sort(Compare compare)
+	{
+		m_ComponentManager.AssurePool<T>()->Sort(std::move(compare));
+	}
+
+	// Integer key sort of T's pool, see ComponentPool::SortByKey
+	template<typename T, typename KeyFunc>
+	inline void SortByKey(KeyFunc key)
+	{
+		m_ComponentManager.AssurePool<T>()->SortByKey(std::move(key));
+	}
+
+	// Reorders T's pool to follow U's, see ComponentPool::SortAs
+	template<typename T, typename U>
+	inline void SortAs()
+	{
+		m_ComponentManager.AssurePool<T>()->SortAs(*m_ComponentManager.AssurePool<U>());
+	}
+
+	// Stores the registry's single T, e.g. settings, time or an input snapshot, replacing the current
+	// one in place. Resources are held directly instead of on an entity, so no pool is involved.
+	template<typename T, typename... Args>
+	inline T& SetResource(Args&&... args)
+	{
+		return m_Resources.Set<T>(std::forward<Args>(args)...);
+	}
+
+	// Handle to the registry's T, empty if none was set. Looking it up scans the few resource ids,
+	// systems that run often keep the handle and pay a single pointer load per access.
+	template<typename T>
+	[[nodiscard]] inline ResourceHandle<T> Resource() noexcept
+	{
+		return ResourceHandle<T>(m_Resources.Find<T>());
+	}
+
+	// Destroys the registry's T, handles to it dangle afterwards. Returns false if there was none.
+	template<typename T>
+	inline bool RemoveResource()
+	{
+		return m_Resources.Remove<T>();
+	}
+
+	// Lifecycle signals of T's pool, see ComponentPool::OnConstruct/OnUpdate/OnDestroy
+	template<typename T>
+	[[nodiscard]] inline Sink<Entity> OnConstruct()
+	{
+		return m_ComponentManager.AssurePool<T>()->OnConstruct();
+	}
+
+	template<typename T>
+	[[nodiscard]] inline Sink<Entity> OnUpdate()
+	{
+		return m_ComponentManager.AssurePool<T>()->OnUpdate();
+	}
+
+	template<typename T>
+	[[nodiscard]] inline Sink<Entity> OnDestroy()
+	{
+		return m_ComponentManager.AssurePool<T>()->OnDestroy();
+	}
+
+	template<typename T>
+	[[nodiscard]] inline Sink<const Entity*, size_t> OnConstructBatch()
+	{
+		return m_ComponentManager.AssurePool<T>()->OnConstructBatch();
+	}
+
+	template<typename T>
+	[[nodiscard]] inline Sink<const Entity*, size_t> OnDestroyBatch()
+	{
+		return m_ComponentManager.AssurePool<T>()->OnDestroyBatch();
+	}
+
+	// Registers an observer that lives as long as the registry, e.g. Observe<Damage, Health>(Exclude<Dead>{})
+	template<typename... Components, typename... Excluded>
+	inline Observer<Exclude<Excluded...>, Components...>& Observe(Exclude<Excluded...> = {})
+	{
+		auto observer = std::make_unique<Observer<Exclude<Excluded...>, Components...>>(m_ComponentManager);
+		auto* ptr = observer.get();
+		m_Observers.PushBack(std::move(observer));
+		return *ptr;
+	}
+
+	// Bytes used and reserved per pool and by the entity manager. Walks the pools once without
+	// touching their elements, cheap enough to poll every frame.
+	[[nodiscard]] MemoryReport MemoryStats() const
+	{
+		MemoryReport report;
+		report.entities = m_EntityManager.Memory();
+		m_ComponentManager.Memory(report);
+		return report;
+	}
+
+	// Gives memory back a little at a time, cheap enough to call every frame: arrays using less than half
+	// of their capacity are reallocated smaller and sparse arrays are cut past their pool's highest entity.
+	// With trimIds the dead ids above the highest live entity are dropped as well (they come back with
+	// generation 0). Each call does about budget elements of work, continuing where the last one stopped,
+	// also inside a large pool. A step overshoots budget by at most Core::CompactBudget::COMPACT_STEP;
+	// reallocating an array larger than that is skipped and counted in deferred, summed over the calls
+	// of a pass those are the bytes only a call with a larger budget (a loading screen, say) gives back.
+	CompactResult Compact(size_t budget = std::numeric_limits<size_t>::max(), bool trimIds = false)
+	{
+		Core::CompactBudget step{ budget };
+		if (!m_CompactingEntities)
+			m_CompactingEntities = m_ComponentManager.Compact(step);
+		bool swept = m_CompactingEntities && m_EntityManager.Compact(trimIds, step);
+		if (swept)
+			m_CompactingEntities = false;
+
+		CompactResult result;
+		result.released = step.released;
+		result.deferred = step.deferred;
+		result.work = step.work;
+		result.swept = swept;
+		return result;
+	}
+
+	// Renumbers the live entities to 0..alive-1, so sparse arrays shrink to the live count and entity
+	// indexed data is dense. Entities owning OrderBy get the lowest ids, in OrderBy's pool order, the
+	// others follow in ascending id order. Every pool and observer is rewritten in one pass without
+	// publishing signals. Returns the new id of every old id (INVALID_ENTITY for dead ones) to patch
+	// entity references held outside the registry; delta baselines taken before are invalidated.
+	template<typename OrderBy = void>
+	DynamicArray<Entity> Defragment()
+	{
+		DynamicArray<Entity> first(0);
+		if constexpr (!std::is_void_v<OrderBy>)
+		{
+			if (auto* pool = m_ComponentManager.Pool<OrderBy>())
+			{
+				first.Reserve(pool->Size());
+				pool->Each([&](Entity e) { first.PushBack(e); });
+			}
+		}
+
+		DynamicArray<Entity> remap(0);
+		size_t alive = m_EntityManager.Renumber(first.Data(), first.Size(), remap);
+		m_ComponentManager.Remap(remap, alive);
+		for (auto& observer : m_Observers)
+			observer->Remap(remap, alive);
+		return remap;
+	}
+
+	// Copies entities and components with one bulk copy per array, and the resources. Observers,
+	// listeners and pools or resources that are not copy constructible are not carried over.
+	[[nodiscard]] Registry Clone() const
+	{
+		Registry copy;
+		copy.m_EntityManager = m_EntityManager;
+		copy.m_ComponentManager = m_ComponentManager.Clone();
+		copy.m_Resources = m_Resources.Clone();
+		return copy;
+	}
+
+	// Like Clone, but pools of trivially copyable components share their arrays with this registry
+	// instead of being copied. The first modification of a pool on either side copies that pool,
+	// so forking a large world only costs the entity copy up front. Get counts as a modification since
+	// it hands out a mutable reference, Has does not. Once one side has copied a pool or was destroyed,
+	// the other keeps the arrays without copying them.
+	[[nodiscard]] Registry CloneShared()
+	{
+		Registry copy;
+		copy.m_EntityManager = m_EntityManager;
+		copy.m_ComponentManager = m_ComponentManager.Share();
+		copy.m_Resources = m_Resources.Clone();
+		return copy;
+	}
+
+	// Writes entities and every serializable pool to stream, resources are not saved. Returns false if the stream failed.
+	bool Save(std::ostream& stream) const
+	{
+		return Write(stream, 0);
+	}
+
+	// Writes a world image, a snapshot whose blocks are aligned so LoadImage can use them in place.
+	// The image has to start at the beginning of its file.
+	bool SaveImage(std::ostream& stream) const
+	{
+		return Write(stream, IMAGE_BLOCK_ALIGNMENT);
+	}
+
+	// Replaces the registry content with a snapshot written by Save or SaveImage. Pools are matched by type,
+	// so the component types stored in the snapshot must be listed unless their pool already exists.
+	// Returns false and keeps the current content if the snapshot can't be read.
+	template<typename... Components>
+	bool Load(std::istream& stream)
+	{
+		InputArchive archive(stream);
+		return Read<Components...>(archive);
+	}
+
+	// Maps a world image privately and builds pools on top of its pages instead of copying them, so
+	// components are only read from disk when touched and the first write to a page copies it.
+	// Sections that can't be used in place are copied, as is the whole file when it can't be mapped.
+	template<typename... Components>
+	bool LoadImage(const char* path)
+	{
+		if (auto file = Core::MappedFile::Open(path))
+		{
+			InputArchive archive(file->Data(), file->Size(), file);
+			return Read<Components...>(archive);
+		}
+
+		std::ifstream stream(path, std::ios::binary);
+		return stream && Load<Components...>(stream);
+	}
+
+	// Captures the world as the baseline Diff compares against
+	void Capture(DeltaBaseline& baseline) const
+	{
+		m_EntityManager.Capture(baseline.entities);
+		m_ComponentManager.Capture(baseline.pools);
+	}
+
+	// Entity and component changes since baseline. Only pools of tags and trivially copyable
+	// components are tracked. baseline.Advance(delta) makes the result the next baseline.
+	[[nodiscard]] Delta Diff(const DeltaBaseline& baseline) const
+	{
+		Delta delta;
+		m_EntityManager.Diff(baseline.entities, delta.entities);
+		m_ComponentManager.Diff(baseline, delta.pools);
+		return delta;
+	}
+
+	// Moves the world from the state a delta was computed against to the state it was computed from.
+	// As with Load, component types that have no pool yet must be listed.
+	template<typename... Components>
+	bool Apply(const Delta& delta)
+	{
+		(m_ComponentManager.AssurePool<Components>(), ...);
+		return ApplyDelta(delta, false);
+	}
+
+	// Undoes a delta, moving the world back to its baseline state
+	template<typename... Components>
+	bool Revert(const Delta& delta)
+	{
+		(m_ComponentManager.AssurePool<Components>(), ...);
+		return ApplyDelta(delta, true);
+	}
+
 private:
+	static constexpr uint32_t SNAPSHOT_MAGIC = 0x53504D43; // "CMPS"
+	static constexpr uint32_t SNAPSHOT_VERSION = 4;
+	static constexpr uint32_t IMAGE_BLOCK_ALIGNMENT = 64;
+
+	bool Write(std::ostream& stream, uint32_t blockAlignment) const
+	{
+		OutputArchive archive(&stream, blockAlignment);
+		archive.Write(SNAPSHOT_MAGIC);
+		archive.Write(SNAPSHOT_VERSION);
+		archive.Write(blockAlignment);
+		m_EntityManager.Save(archive);
+		m_ComponentManager.Save(archive);
+		return archive.Good();
+	}
+
+	bool ApplyDelta(const Delta& delta, bool revert)
+	{
+		if (!m_EntityManager.Accepts(delta.entities, revert) || !m_ComponentManager.Apply(delta.pools, revert))
+			return false;
+
+		m_EntityManager.Apply(delta.entities, revert);
+		m_ComponentManager.DropDisabled([&](Entity e) { return !m_EntityManager.IsAlive(e); });
+		return true;
+	}
+
+	template<typename... Components>
+	bool Read(InputArchive& archive)
+	{
+		uint32_t magic = 0;
+		uint32_t version = 0;
+		uint32_t blockAlignment = 0;
+		if (!archive.Read(magic) || magic != SNAPSHOT_MAGIC)
+			return false;
+		if (!archive.Read(version) || version != SNAPSHOT_VERSION)
+			return false;
+		if (!archive.Read(blockAlignment))
+			return false;
+
+		archive.BlockAlignment(blockAlignment);
+		(m_ComponentManager.AssurePool<Components>(), ...);
+
+		// entities are read aside and the pools only replaced once their sections all loaded,
+		// so a truncated or corrupt snapshot leaves the registry as it was
+		EntityManager entities;
+		if (!entities.Load(archive) || !m_ComponentManager.Load(archive))
+			return false;
+		m_EntityManager = std::move(entities);
+		return true;
+	}
+
 	EntityManager m_EntityManager;
 	ComponentManager m_ComponentManager;
+	ResourceManager m_Resources;
+	DynamicArray<std::unique_ptr<IObserver>> m_Observers{ 0 };
+	bool m_CompactingEntities = false; // Compact is past the pools, on to the entity ids
 };
 
 } // namespace Composia 
 
+#endif // COMPOSIA_ARCHETYPE_STORAGE
+
 #endif // !COMPOSIA_REGISTRY_H
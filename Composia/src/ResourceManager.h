@@ -0,0 +1,169 @@
+#ifndef COMPOSIA_RESOURCE_MANAGER_H
+#define COMPOSIA_RESOURCE_MANAGER_H
+
+#include <cassert> // assert
+#include <memory> // std::unique_ptr
+#include <type_traits> // std::is_copy_constructible_v
+#include <utility> // std::forward
+#include "Core/DynamicArray.h"
+#include "Core/TypeInfo.h"
+using Composia::Core::DynamicArray;
+
+namespace Composia {
+
+// Cached access to a resource, one pointer load per use. Stays valid until the resource is
+// removed or its registry destroyed, SetResource on an existing resource assigns in place.
+template<typename T>
+class ResourceHandle
+{
+public:
+	ResourceHandle() = default;
+	explicit ResourceHandle(T* value) noexcept : m_Value(value) {}
+
+	[[nodiscard]] inline T& operator*() const noexcept
+	{
+		assert(m_Value && "Resource was never set");
+		return *m_Value;
+	}
+
+	[[nodiscard]] inline T* operator->() const noexcept
+	{
+		assert(m_Value && "Resource was never set");
+		return m_Value;
+	}
+
+	[[nodiscard]] inline T* Get() const noexcept
+	{
+		return m_Value;
+	}
+
+	explicit operator bool() const noexcept
+	{
+		return m_Value != nullptr;
+	}
+
+private:
+	T* m_Value = nullptr;
+};
+
+// Type-erased resource holder
+struct IResource
+{
+	virtual ~IResource() = default;
+
+	// nullptr for resources that are not copy constructible
+	virtual std::unique_ptr<IResource> Clone() const = 0;
+};
+
+template<typename T>
+struct ResourceHolder : IResource
+{
+	template<typename... Args>
+	explicit ResourceHolder(Args&&... args) : value(std::forward<Args>(args)...) {}
+
+	T value;
+
+	std::unique_ptr<IResource> Clone() const override
+	{
+		if constexpr (!std::is_copy_constructible_v<T>)
+			return nullptr;
+		else
+			return std::make_unique<ResourceHolder<T>>(value);
+	}
+};
+
+// One instance per type, keyed by TypeId like the component pools. Worlds hold a handful of
+// resources, so lookup is a scan over their ids; each value sits in its own allocation and never moves.
+class ResourceManager
+{
+public:
+	ResourceManager() = default;
+	ResourceManager(ResourceManager&&) noexcept = default;
+	ResourceManager& operator=(ResourceManager&&) noexcept = default;
+
+	template<typename T, typename... Args>
+	T& Set(Args&&... args)
+	{
+		if (T* existing = Find<T>())
+		{
+			*existing = T(std::forward<Args>(args)...);
+			return *existing;
+		}
+
+		auto holder = std::make_unique<ResourceHolder<T>>(std::forward<Args>(args)...);
+		T& value = holder->value;
+		m_Ids.PushBack(TypeId<T>);
+		m_Resources.PushBack(std::move(holder));
+		return value;
+	}
+
+	template<typename T>
+	[[nodiscard]] T* Find() noexcept
+	{
+		static const bool claimed = Core::ClaimTypeId(TypeId<T>, Core::TypeName<T>());
+		(void)claimed;
+
+		size_t index = IndexOf(TypeId<T>);
+		if (index == m_Ids.Size())
+			return nullptr;
+		return &static_cast<ResourceHolder<T>*>(m_Resources[index].get())->value;
+	}
+
+	// Returns false if there was no T
+	template<typename T>
+	bool Remove()
+	{
+		static const bool claimed = Core::ClaimTypeId(TypeId<T>, Core::TypeName<T>());
+		(void)claimed;
+
+		size_t index = IndexOf(TypeId<T>);
+		if (index == m_Ids.Size())
+			return false;
+
+		size_t last = m_Ids.Size() - 1;
+		if (index != last)
+		{
+			m_Ids[index] = m_Ids[last];
+			m_Resources[index] = std::move(m_Resources[last]);
+		}
+		m_Ids.PopBack();
+		m_Resources.PopBack();
+		return true;
+	}
+
+	[[nodiscard]] inline size_t Size() const noexcept
+	{
+		return m_Ids.Size();
+	}
+
+	// Copies every copy constructible resource, handles keep pointing at the originals
+	[[nodiscard]] ResourceManager Clone() const
+	{
+		ResourceManager copy;
+		for (size_t i = 0; i < m_Ids.Size(); ++i)
+		{
+			if (auto resource = m_Resources[i]->Clone())
+			{
+				copy.m_Ids.PushBack(m_Ids[i]);
+				copy.m_Resources.PushBack(std::move(resource));
+			}
+		}
+		return copy;
+	}
+
+private:
+	inline size_t IndexOf(uint64_t id) const noexcept
+	{
+		size_t index = 0;
+		while (index < m_Ids.Size() && m_Ids[index] != id)
+			++index;
+		return index;
+	}
+
+	DynamicArray<uint64_t> m_Ids{ 0 };
+	DynamicArray<std::unique_ptr<IResource>> m_Resources{ 0 };
+};
+
+} // namespace Composia
+
+#endif // !COMPOSIA_RESOURCE_MANAGER_H
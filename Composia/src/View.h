@@ -1,14 +1,25 @@
 #ifndef VIEW_H
 #define VIEW_H
 
+#include <algorithm>
 #include <tuple>
+#include <array>
+#include <bit>
 #include <utility>
 #include <limits>
 #include "Core/DynamicArray.h"
+#include "Core/Trace.h"
 #include "ComponentManager.h"
 
 namespace Composia {
 
+	// each() passes one reference per non-tag component, in declaration order. Tags only filter.
+	// Iteration pivots on the smallest sparse set pool, or scans bitset pools word by word
+	// when one of them holds fewer entities than every sparse set pool. Disabled entities are
+	// skipped: the pivot is only read up to its enabled prefix, bitset words are masked.
+	// each() tests the pivot 64 entities at a time, with one HasBatch per pool, and prefetches
+	// the sparse slots of the next block and the dense slots of the matches, as they sit at
+	// random addresses once pools are shuffled.
 	template<typename... Components>
 	class View
 	{
@@ -16,17 +27,18 @@ namespace Composia {
 		using PoolsTuple = std::tuple<ComponentPool<Components>*...>;
 
 		View(ComponentManager& manager)
+			: disabledWords(&manager.Disabled().RawWords())
 		{
-			pools = std::make_tuple(manager.Pool<Components>()...);
-			smallestPoolIndex = FindSmallestPoolIndex();
+			pools = std::make_tuple(manager.AssurePool<Components>()...);
+			SelectPivot();
 		}
 
 		struct Iterator 
 		{
 			using EntityVec = const Core::DynamicArray<Entity>&;
 
-			Iterator(PoolsTuple* pools, size_t idx, size_t smallestPoolIndex)
-				: pools(pools), index(idx), smallestPoolIndex(smallestPoolIndex)
+			Iterator(PoolsTuple* pools, const DynamicArray<Entity>* entities, size_t idx, size_t size)
+				: pools(pools), entities(entities), index(idx), size(size)
 			{
 				AdvanceToValid();
 			}
@@ -40,11 +52,7 @@ namespace Composia {
 
 			Entity operator*() const noexcept
 			{
-				Entity result{};
-				get_by_index(*pools, smallestPoolIndex, [&](auto* pool) {
-					result = pool->RawEntities()[index];
-					});
-				return result;
+				return (*entities)[index];
 			}
 
 			bool operator!=(const Iterator& other) const noexcept
@@ -57,21 +65,15 @@ namespace Composia {
 			{
 				bool valid = false;
 				while (!valid) {
-					bool out_of_range = false;
-					get_by_index(*pools, smallestPoolIndex, [&](auto* pool) {
-						if (index >= pool->Size()) {
-							out_of_range = true;
-							return;
-						}
-						});
-					if (out_of_range) break;
-
-					Entity e{};
-					get_by_index(*pools, smallestPoolIndex, [&](auto* pool) {
-						e = pool->RawEntities()[index];
-						});
+					if (index >= size) break;
+
+					Entity e = (*entities)[index];
+					COMPOSIA_COUNT(ViewCandidates, 1);
 					if (HasAllComponents(e))
+					{
+						COMPOSIA_COUNT(ViewAccepted, 1);
 						valid = true;
+					}
 					else
 						++index;
 				}
@@ -95,116 +97,257 @@ namespace Composia {
 			}
 
 			PoolsTuple* pools;
+			const DynamicArray<Entity>* entities;
 			size_t index;
-			size_t smallestPoolIndex;
+			size_t size;
 		};
 
 		inline Iterator begin() noexcept
 		{
-			return Iterator(&pools, 0, smallestPoolIndex);
+			static_assert(PackedCount > 0, "Views over bitset pools only can be iterated with each()");
+			return Iterator(&pools, pivotEntities, 0, pivotSize);
 		}
 
 		inline Iterator end() noexcept
 		{
-			size_t size = 0;
-			get_by_index(pools, smallestPoolIndex, [&](auto* pool) 
-				{
-				size = pool->Size();
-				});
-			return Iterator(&pools, size, smallestPoolIndex);
+			static_assert(PackedCount > 0, "Views over bitset pools only can be iterated with each()");
+			return Iterator(&pools, pivotEntities, pivotSize, pivotSize);
+		}
+
+		// Pivot entities each() prefetches sparse slots ahead, one block by default. 0 turns prefetching off.
+		View& PrefetchDistance(size_t distance) noexcept
+		{
+			prefetchDistance = distance;
+			return *this;
 		}
 
 		template<typename Func>
 		void each(Func&& func) noexcept
 		{
-			size_t size = 0;
-			get_by_index(pools, smallestPoolIndex, [&](auto* pool) 
+			COMPOSIA_TRACE_ZONE(Core::TypeName<View>());
+
+			// func gets its components through Get, which copies pools still shared with a CloneShared
+			// copy. Done up front so the pivot array read below is not reallocated under the loop.
+			[this]<size_t... Is>(std::index_sequence<Is...>) {
+				(std::get<ValueIndices[Is]>(pools)->Unshare(), ...);
+			}(std::make_index_sequence<ValueCount>{});
+
+			if constexpr (BitsetCount > 0)
+			{
+				if (wordScan)
 				{
-				size = pool->Size();
-				});
-			auto& smallestPool = std::get<0>(pools);
+					EachWordwise(std::forward<Func>(func));
+					return;
+				}
+			}
+
+			if constexpr (PackedCount > 0)
+			{
+				// small worlds stay cached, the prefetches would only cost instructions there
+				if (prefetchDistance != 0 && pivotSize >= PREFETCH_MIN_SIZE)
+					EachPivot<true>(func);
+				else
+					EachPivot<false>(func);
+			}
+		}
 
-			for (size_t i = 0; i < size; ++i)
+	private:
+		static constexpr size_t BitsetCount = (size_t(UsesBitset<Components>) + ... + 0);
+		static constexpr size_t PackedCount = sizeof...(Components) - BitsetCount;
+		static constexpr size_t PREFETCH_MIN_SIZE = 1 << 15;
+		static constexpr size_t BLOCK_SIZE = BitSet::BITS_PER_WORD;
+
+		// Tests the pivot entities a block of 64 at a time: one HasBatch per pool is ANDed into the
+		// block's match mask, so the pools are probed with gathers and func only sees matches.
+		// func may add to or remove from the pivot, so its array is read again after every call.
+		template<bool Prefetching, typename Func>
+		void EachPivot(Func& func) noexcept
+		{
+			size_t size = pivotSize;
+			[[maybe_unused]] size_t accepted = 0;
+			for (size_t start = 0; start < size; start += BLOCK_SIZE)
 			{
-				Entity e{};
-				get_by_index(pools, smallestPoolIndex, [&](auto* pool) 
+				size_t end = std::min(size, pivotEntities->Size());
+				if (start >= end)
+					break;
+
+				const Entity* entities = pivotEntities->Data();
+				size_t count = std::min(BLOCK_SIZE, end - start);
+				if constexpr (Prefetching)
+				{
+					// sparse slots a block ahead, read by its HasBatch calls
+					size_t ahead = std::min(start + prefetchDistance, end);
+					size_t aheadEnd = std::min(ahead + BLOCK_SIZE, end);
+					for (size_t i = ahead; i < aheadEnd; ++i)
+						std::apply([&](auto*... poolPtrs) { (poolPtrs->PrefetchSparse(entities[i]), ...); }, pools);
+				}
+
+				uint64_t block = MatchBlock(entities + start, count);
+				if constexpr (Prefetching)
+				{
+					// dense slots of the matches, read by func right after
+					for (uint64_t bits = block; bits; bits &= bits - 1)
 					{
-					e = pool->RawEntities()[i];
-					});
-				if (!HasAllComponents(e))
-					continue;
+						Entity e = entities[start + std::countr_zero(bits)];
+						std::apply([&](auto*... poolPtrs) { (poolPtrs->PrefetchDense(e), ...); }, pools);
+					}
+				}
+
+				// the first match is tested with the block, func may have changed the later ones
+				bool fresh = true;
+				while (block)
+				{
+					size_t index = start + std::countr_zero(block);
+					block &= block - 1;
+					if (index >= pivotEntities->Size())
+						break;
 
-				invokeFunc(e, std::forward<Func>(func));
+					Entity e = (*pivotEntities)[index];
+					if (!fresh && MatchBlock(&e, 1) == 0)
+						continue;
+
+					fresh = false;
+					++accepted;
+					invokeFunc(e, func);
+				}
 			}
+			COMPOSIA_COUNT(ViewCandidates, size);
+			COMPOSIA_COUNT(ViewAccepted, accepted);
 		}
 
-	private:
-		inline bool HasAllComponents(Entity e) const noexcept
+		// Bit i is set when entities[i] is in every pool. The pivot pool is skipped, its enabled
+		// prefix holds the entities, and the remaining pools once no entity is left.
+		inline uint64_t MatchBlock(const Entity* entities, size_t count) const noexcept
 		{
-			bool result = true;
+			uint64_t block = count == BLOCK_SIZE ? ~uint64_t(0) : (uint64_t(1) << count) - 1;
 			std::apply([&](auto*... poolPtrs) {
-				((result = result && poolPtrs->Has(e)), ...);
+				([&](auto* pool) {
+					if constexpr (!UsesBitset<typename std::remove_pointer_t<decltype(pool)>::ComponentType>)
+					{
+						if (&pool->RawEntities() == pivotEntities)
+							return;
+					}
+					if (block == 0)
+						return;
+
+					uint64_t mask;
+					pool->HasBatch(entities, count, &mask);
+					block &= mask;
+					}(poolPtrs), ...);
 				}, pools);
-			return result;
+			return block;
 		}
 
-		template<typename Func, size_t... Is>
-		inline void invokeFuncImpl(Entity e, Func&& func, std::index_sequence<Is...>) noexcept
+		// ANDs the words of every bitset pool and clears the disabled entities' bits, then probes
+		// the sparse set pools for each remaining bit
+		template<typename Func>
+		void EachWordwise(Func&& func) noexcept
 		{
-			func(*std::get<Is>(pools)->Get(e)...);
+			[[maybe_unused]] size_t candidates = 0;
+			[[maybe_unused]] size_t accepted = 0;
+			size_t wordCount = std::numeric_limits<size_t>::max();
+			ApplyBitsets([&](auto* pool) { wordCount = std::min(wordCount, pool->RawWords().Size()); });
+
+			const DynamicArray<uint64_t>& disabled = *disabledWords;
+			for (size_t w = 0; w < wordCount; ++w)
+			{
+				uint64_t word = ~uint64_t(0);
+				ApplyBitsets([&](auto* pool) { word &= pool->RawWords()[w]; });
+				if (w < disabled.Size())
+					word &= ~disabled[w];
+
+				while (word)
+				{
+					Entity e = static_cast<Entity>(w * BitSet::BITS_PER_WORD + std::countr_zero(word));
+					word &= word - 1;
+
+					bool matched = true;
+					ApplyPacked([&](auto* pool) { matched = matched && pool->Has(e); });
+					++candidates;
+					if (matched)
+					{
+						++accepted;
+						invokeFunc(e, std::forward<Func>(func));
+					}
+				}
+			}
+			COMPOSIA_COUNT(ViewCandidates, candidates);
+			COMPOSIA_COUNT(ViewAccepted, accepted);
 		}
 
 		template<typename Func>
-		inline void invokeFunc(Entity e, Func&& func) noexcept
+		inline void ApplyBitsets(Func&& func) const noexcept
 		{
-			invokeFuncImpl(e, std::forward<Func>(func), std::index_sequence_for<Components...>{});
+			std::apply([&](auto*... poolPtrs) {
+				([&](auto* pool) {
+					if constexpr (UsesBitset<typename std::remove_pointer_t<decltype(pool)>::ComponentType>)
+						func(pool);
+					}(poolPtrs), ...);
+				}, pools);
 		}
 
-		size_t FindSmallestPoolIndex() const noexcept
+		template<typename Func>
+		inline void ApplyPacked(Func&& func) const noexcept
 		{
-			size_t smallest = 0;
-			size_t smallestSize = std::numeric_limits<size_t>::max();
+			std::apply([&](auto*... poolPtrs) {
+				([&](auto* pool) {
+					if constexpr (!UsesBitset<typename std::remove_pointer_t<decltype(pool)>::ComponentType>)
+						func(pool);
+					}(poolPtrs), ...);
+				}, pools);
+		}
+
+		static constexpr size_t ValueCount = (size_t(!IsTag<Components>) + ... + 0);
 
+		// Tuple indices of the components that carry a value
+		static constexpr std::array<size_t, ValueCount> ValueIndices = [] {
+			constexpr bool isTag[] = { IsTag<Components>... };
+			std::array<size_t, ValueCount> indices{};
+			size_t count = 0;
 			for (size_t i = 0; i < sizeof...(Components); ++i)
 			{
-				bool sizeFetched = false;
-				size_t poolSize = 0;
-
-				get_by_index(pools, i, [&](auto* pool) 
-					{
-					poolSize = pool->Size();
-					sizeFetched = true;
-					});
-
-				if (sizeFetched && poolSize < smallestSize)
-				{
-					smallestSize = poolSize;
-					smallest = i;
-				}
+				if (!isTag[i])
+					indices[count++] = i;
 			}
-			return smallest;
+			return indices;
+		}();
+
+		template<typename Func, size_t... Is>
+		inline void invokeFuncImpl([[maybe_unused]] Entity e, Func&& func, std::index_sequence<Is...>) noexcept
+		{
+			func(*std::get<ValueIndices[Is]>(pools)->Get(e)...);
 		}
 
-		// Helper to get tuple element by runtime index
-		template<size_t I = 0, typename FuncT, typename TupleT>
-		inline static typename std::enable_if<I == std::tuple_size<TupleT>::value, void>::type
-			get_by_index(TupleT&, size_t, FuncT)
+		template<typename Func>
+		inline void invokeFunc(Entity e, Func&& func) noexcept
 		{
-			// out of range, do nothing
+			invokeFuncImpl(e, std::forward<Func>(func), std::make_index_sequence<ValueCount>{});
 		}
 
-		template<size_t I = 0, typename FuncT, typename TupleT>
-		inline static typename std::enable_if < I < std::tuple_size<TupleT>::value, void>::type
-			get_by_index(TupleT& t, size_t index, FuncT f)
+		void SelectPivot() noexcept
 		{
-			if (I == index)
-				f(std::get<I>(t));
-			else
-				get_by_index<I + 1, FuncT, TupleT>(t, index, f);
+			size_t smallestPacked = std::numeric_limits<size_t>::max();
+			size_t smallestBitset = std::numeric_limits<size_t>::max();
+
+			ApplyPacked([&](auto* pool) {
+				if (pool->EnabledSize() < smallestPacked)
+				{
+					smallestPacked = pool->EnabledSize();
+					pivotEntities = &pool->RawEntities();
+					pivotSize = pool->EnabledSize();
+				}
+				});
+			ApplyBitsets([&](auto* pool) { smallestBitset = std::min(smallestBitset, pool->Size()); });
+
+			wordScan = BitsetCount > 0 && (PackedCount == 0 || smallestBitset < smallestPacked);
 		}
 
 		PoolsTuple pools;
-		size_t smallestPoolIndex = 0;
+		const DynamicArray<Entity>* pivotEntities = nullptr;
+		size_t pivotSize = 0;
+		size_t prefetchDistance = BLOCK_SIZE;
+		const DynamicArray<uint64_t>* disabledWords;
+		bool wordScan = false;
 	};
 
 } // namespace Composia
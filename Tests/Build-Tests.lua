@@ -23,12 +23,12 @@ project "Tests"
        defines { "WINDOWS" }
 
    filter "configurations:Debug"
-       defines { "DEBUG" }
+       defines { "DEBUG", "COMPOSIA_INSTRUMENTATION" }
        runtime "Debug"
        symbols "On"
 
    filter "configurations:Release"
-       defines { "RELEASE" }
+       defines { "RELEASE", "COMPOSIA_INSTRUMENTATION" }
        runtime "Release"
        optimize "On"
        symbols "On"
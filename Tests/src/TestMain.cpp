@@ -3,6 +3,8 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <random>
+#include <thread>
 
 using namespace Composia::Core;
 
@@ -155,6 +157,58 @@ TEST(DynamicArrayTest, STDFind)
     EXPECT_EQ(result, false);
 }
 
+TEST(DynamicArrayTest, AdoptUsesMemoryInPlaceUntilGrowth)
+{
+    auto buffer = std::make_shared<std::vector<int>>(std::vector<int>{ 1, 2, 3 });
+    DynamicArray<int> arr;
+    arr.Adopt(buffer->data(), buffer->size(), buffer);
+
+    EXPECT_TRUE(arr.Borrowed());
+    arr[0] = 10;
+    EXPECT_EQ((*buffer)[0], 10);
+
+    arr.PushBack(4);
+    EXPECT_FALSE(arr.Borrowed());
+    EXPECT_EQ(arr.Size(), 4);
+    EXPECT_EQ(arr[0], 10);
+    EXPECT_EQ(buffer.use_count(), 1);
+}
+
+TEST(DynamicArrayTest, DetachCopiesOnlyWhileShared)
+{
+    DynamicArray<int> arr;
+    for (int i = 0; i < 10; ++i)
+        arr.PushBack(i);
+
+    DynamicArray<int> shared = arr.Share();
+    const int* buffer = arr.Data();
+    arr.Detach();
+    EXPECT_NE(arr.Data(), buffer);
+    EXPECT_FALSE(arr.Shared());
+
+    // arr already copied, so shared holds the only reference and takes the buffer over
+    shared.Detach();
+    EXPECT_EQ(shared.Data(), buffer);
+    EXPECT_FALSE(shared.Shared());
+    shared[0] = 100;
+    EXPECT_EQ(arr[0], 0);
+}
+
+TEST(DynamicArrayTest, MoveTransfersBuffer)
+{
+    DynamicArray<int> arr;
+    arr.PushBack(7);
+    int* data = arr.Data();
+
+    DynamicArray<int> moved(std::move(arr));
+    EXPECT_EQ(moved.Data(), data);
+    EXPECT_EQ(moved[0], 7);
+    EXPECT_TRUE(arr.Empty());
+
+    arr = std::move(moved);
+    EXPECT_EQ(arr.Data(), data);
+}
+
 // -------------------------
 // DynamicArray<std::string> Tests
 // -------------------------
@@ -193,6 +247,7 @@ TEST(DynamicArrayStringTest, ClearAllValues)
 // -------------------------
 
 #include "EntityManager.h"
+#include "Core/HashedSet.h"
 #include <ComponentManager.h>
 #include <Registry.h>
 using namespace Composia;
@@ -468,6 +523,1786 @@ TEST_F(ViewTest, IterateEntitiesWithMultipleComponents)
     EXPECT_EQ(count, 2); // Only e1 and e2 should be in the view
 }
 
+#if !defined(COMPOSIA_ARCHETYPE_STORAGE)
+// -------------------------
+// Observer tests
+// -------------------------
+
+struct Dead {};
+
+class ObserverTest : public ::testing::Test
+{
+protected:
+    Composia::Registry registry;
+};
+
+TEST_F(ObserverTest, PopulatesFromExistingEntities)
+{
+    auto e1 = registry.Create();
+    auto e2 = registry.Create();
+    registry.Emplace<Position>(e1, 1, 2);
+    registry.Emplace<Velocity>(e1, 1.f, 2.f);
+    registry.Emplace<Position>(e2, 3, 4);
+
+    auto& observer = registry.Observe<Position, Velocity>();
+
+    EXPECT_EQ(observer.Size(), 1);
+    EXPECT_TRUE(observer.Has(e1));
+    EXPECT_FALSE(observer.Has(e2));
+}
+
+TEST_F(ObserverTest, TracksEmplaceRemoveAndDestroy)
+{
+    auto& observer = registry.Observe<Position, Velocity>(Exclude<Dead>{});
+    auto e1 = registry.Create();
+    auto e2 = registry.Create();
+
+    registry.Emplace<Position>(e1, 1, 2);
+    EXPECT_FALSE(observer.Has(e1));
+    registry.Emplace<Velocity>(e1, 1.f, 2.f);
+    EXPECT_TRUE(observer.Has(e1));
+
+    registry.Emplace<Dead>(e1);
+    EXPECT_FALSE(observer.Has(e1));
+    registry.Remove<Dead>(e1);
+    EXPECT_TRUE(observer.Has(e1));
+
+    registry.Emplace<Position>(e2, 3, 4);
+    registry.Emplace<Velocity>(e2, 3.f, 4.f);
+    EXPECT_EQ(observer.Size(), 2);
+
+    registry.Remove<Velocity>(e2);
+    EXPECT_FALSE(observer.Has(e2));
+
+    registry.Destroy(e1);
+    EXPECT_TRUE(observer.Empty());
+}
+
+TEST_F(ObserverTest, ClearAfterProcessing)
+{
+    auto& observer = registry.Observe<Position>();
+    auto e1 = registry.Create();
+    auto e2 = registry.Create();
+    registry.Emplace<Position>(e1, 1, 1);
+    registry.Emplace<Position>(e2, 2, 2);
+
+    int visited = 0;
+    observer.each([&](Entity e) {
+        registry.Remove<Position>(e);
+        ++visited;
+        });
+    EXPECT_EQ(visited, 2);
+    EXPECT_TRUE(observer.Empty());
+
+    registry.Emplace<Position>(e1, 5, 5);
+    EXPECT_EQ(observer.Size(), 1);
+    observer.Clear();
+    EXPECT_TRUE(observer.Empty());
+
+    registry.Emplace<Position>(e1, 6, 6);
+    EXPECT_TRUE(observer.Has(e1));
+}
+#endif // !COMPOSIA_ARCHETYPE_STORAGE
+
+// -------------------------
+// Tag component tests
+// -------------------------
+
+struct Enemy {};
+
+TEST_F(RegistryTest, TagComponentsStoreMembershipOnly)
+{
+    Entity e1 = registry.Create();
+    Entity e2 = registry.Create();
+    registry.Emplace<Enemy>(e1);
+
+    EXPECT_TRUE(registry.Has<Enemy>(e1));
+    EXPECT_FALSE(registry.Has<Enemy>(e2));
+
+    registry.Remove<Enemy>(e1);
+    EXPECT_FALSE(registry.Has<Enemy>(e1));
+
+    static_assert(IsTag<Enemy>);
+    static_assert(!IsTag<Position>);
+    static_assert(std::is_same_v<ComponentPool<Enemy>::StorageType, Composia::Core::SparseSet<void>>);
+}
+
+TEST_F(ViewTest, TagComponentsAreOmittedFromCallbacks)
+{
+    auto e1 = registry.Create();
+    auto e2 = registry.Create();
+    registry.Emplace<Position>(e1, 1, 1);
+    registry.Emplace<Velocity>(e1, 2.f, 2.f);
+    registry.Emplace<Enemy>(e1);
+    registry.Emplace<Position>(e2, 5, 5);
+    registry.Emplace<Velocity>(e2, 6.f, 6.f);
+
+    int count = 0;
+    registry.View<Position, Enemy, Velocity>().each([&](Position& p, Velocity& v) {
+        EXPECT_EQ(p.x, 1);
+        EXPECT_FLOAT_EQ(v.vx, 2.f);
+        ++count;
+        });
+    EXPECT_EQ(count, 1);
+
+    count = 0;
+    registry.View<Enemy>().each([&]() { ++count; });
+    EXPECT_EQ(count, 1);
+}
+
+#if !defined(COMPOSIA_ARCHETYPE_STORAGE)
+TEST_F(ViewTest, CallbacksMayGrowThePivotPool)
+{
+    // the entities emplaced by the callback reallocate the pivot's arrays under the loop,
+    // they are not visited as they come after the ones the view started with
+    for (int i = 0; i < 100; ++i)
+        registry.Emplace<Position>(registry.Create(), i, 0);
+
+    int visited = 0;
+    int sum = 0;
+    registry.View<Position>().each([&](Position& p) {
+        sum += p.x;
+        ++visited;
+        for (int i = 0; i < 20; ++i)
+            registry.Emplace<Position>(registry.Create(), 1000, 0);
+        });
+    EXPECT_EQ(visited, 100);
+    EXPECT_EQ(sum, 99 * 100 / 2);
+}
+
+TEST_F(ViewTest, CallbacksMayRemoveComponentsOfLaterEntities)
+{
+    // 50 and 60 sit in the block being visited when they lose their components
+    for (int i = 0; i < 100; ++i)
+    {
+        Entity e = registry.Create();
+        registry.Emplace<Position>(e, i, 0);
+        registry.Emplace<Velocity>(e, float(i), 0.f);
+    }
+
+    std::vector<Entity> visited;
+    registry.View<Position, Velocity>().each([&](Position& p, Velocity& v) {
+        EXPECT_EQ(float(p.x), v.vx);
+        visited.push_back(Entity(p.x));
+        if (p.x == 10)
+        {
+            registry.Remove<Velocity>(50);
+            registry.Destroy(60);
+        }
+        });
+    EXPECT_EQ(visited.size(), 98u);
+    EXPECT_EQ(std::count(visited.begin(), visited.end(), Entity(50)), 0);
+    EXPECT_EQ(std::count(visited.begin(), visited.end(), Entity(60)), 0);
+    EXPECT_EQ(std::count(visited.begin(), visited.end(), Entity(99)), 1);
+}
+#endif // !COMPOSIA_ARCHETYPE_STORAGE
+
+// -------------------------
+// Bitset storage tests
+// -------------------------
+
+struct Visible {};
+struct Selected {};
+
+template<> struct Composia::ComponentTraits<Visible> { static constexpr auto Storage = StoragePolicy::Bitset; };
+template<> struct Composia::ComponentTraits<Selected> { static constexpr auto Storage = StoragePolicy::Bitset; };
+
+TEST_F(RegistryTest, BitsetStorageTracksMembership)
+{
+    static_assert(std::is_same_v<ComponentPool<Visible>::StorageType, Composia::Core::BitSet>);
+
+    Entity e1 = registry.Create();
+    Entity e2 = registry.Create();
+    registry.Emplace<Visible>(e1);
+    registry.Emplace<Visible>(e1);
+
+    EXPECT_TRUE(registry.Has<Visible>(e1));
+    EXPECT_FALSE(registry.Has<Visible>(e2));
+
+    registry.Destroy(e1);
+    EXPECT_FALSE(registry.Has<Visible>(e1));
+}
+
+TEST_F(ViewTest, BitsetPoolsAreScannedWordwise)
+{
+    std::vector<Entity> entities;
+    for (int i = 0; i < 300; ++i)
+    {
+        Entity e = registry.Create();
+        entities.push_back(e);
+        registry.Emplace<Position>(e, i, 0);
+        if (i % 2 == 0) registry.Emplace<Visible>(e);
+        if (i % 3 == 0) registry.Emplace<Selected>(e);
+    }
+
+    int sum = 0, count = 0;
+    registry.View<Position, Visible>().each([&](Position& p) { sum += p.x; ++count; });
+    EXPECT_EQ(count, 150);
+    EXPECT_EQ(sum, 149 * 150);
+
+    // Selected is smaller than Position, so the bitsets drive the iteration
+    count = 0;
+    registry.View<Position, Visible, Selected>().each([&](Position& p) {
+        EXPECT_EQ(p.x % 6, 0);
+        ++count;
+        });
+    EXPECT_EQ(count, 50);
+
+    count = 0;
+    registry.View<Visible, Selected>().each([&]() { ++count; });
+    EXPECT_EQ(count, 50);
+
+    count = 0;
+    for (Entity e : registry.View<Position, Selected>())
+    {
+        EXPECT_TRUE(registry.Has<Selected>(e));
+        ++count;
+    }
+    EXPECT_EQ(count, 100);
+}
+
+#if !defined(COMPOSIA_ARCHETYPE_STORAGE)
+TEST_F(ObserverTest, WorksWithBitsetPools)
+{
+    auto e1 = registry.Create();
+    registry.Emplace<Visible>(e1);
+    auto& observer = registry.Observe<Visible>(Exclude<Selected>{});
+    EXPECT_TRUE(observer.Has(e1));
+
+    registry.Emplace<Selected>(e1);
+    EXPECT_FALSE(observer.Has(e1));
+}
+#endif // !COMPOSIA_ARCHETYPE_STORAGE
+
+// -------------------------
+// Hash map storage tests
+// -------------------------
+
+struct DebugLabel { int id; };
+struct DebugFlag {};
+
+template<> struct Composia::ComponentTraits<DebugLabel> { static constexpr auto Storage = StoragePolicy::HashMap; };
+template<> struct Composia::ComponentTraits<DebugFlag> { static constexpr auto Storage = StoragePolicy::HashMap; };
+
+TEST(HashedSetTest, AddRemoveKeepsLookupsValid)
+{
+    HashedSet<int> set;
+    for (Key k = 0; k < 1000; ++k)
+        set.Add(k * 7919, static_cast<int>(k));
+
+    for (Key k = 0; k < 1000; k += 2)
+        set.Remove(k * 7919);
+
+    EXPECT_EQ(set.Size(), 500);
+    for (Key k = 0; k < 1000; ++k)
+    {
+        EXPECT_EQ(set.Has(k * 7919), k % 2 == 1);
+        if (k % 2 == 1)
+        {
+            EXPECT_EQ(*set.Get(k * 7919), static_cast<int>(k));
+        }
+    }
+    EXPECT_LE(set.SlotCount(), 2048);
+}
+
+TEST(HashedSetTest, HugeKeysDoNotGrowTable)
+{
+    HashedSet<void> set;
+    set.Add(10'000'000);
+    set.Add(20'000'000);
+    EXPECT_TRUE(set.Has(10'000'000));
+    EXPECT_FALSE(set.Has(0));
+    EXPECT_EQ(set.SlotCount(), 16);
+}
+
+TEST_F(ViewTest, PivotsAndProbesHashMapPools)
+{
+    static_assert(std::is_same_v<ComponentPool<DebugLabel>::StorageType, HashedSet<DebugLabel>>);
+
+    std::vector<Entity> entities;
+    for (int i = 0; i < 100; ++i)
+    {
+        Entity e = registry.Create();
+        registry.Emplace<Position>(e, i, i);
+        if (i % 25 == 0)
+        {
+            registry.Emplace<DebugLabel>(e, i);
+            registry.Emplace<DebugFlag>(e);
+        }
+        entities.push_back(e);
+    }
+    registry.Remove<DebugLabel>(entities[0]);
+
+    int count = 0;
+    registry.View<Position, DebugLabel, DebugFlag>().each([&](Position& p, DebugLabel& label) {
+        EXPECT_EQ(p.x, label.id);
+        ++count;
+        });
+    EXPECT_EQ(count, 3);
+    EXPECT_EQ(registry.Get<DebugLabel>(entities[50]).id, 50);
+}
+
+#if !defined(COMPOSIA_ARCHETYPE_STORAGE)
+// -------------------------
+// Signal tests
+// -------------------------
+
+struct SignalRecorder
+{
+    std::vector<Entity> constructed;
+    std::vector<Entity> updated;
+    std::vector<Entity> destroyed;
+    size_t batches = 0;
+
+    void OnConstruct(Entity e) { constructed.push_back(e); }
+    void OnUpdate(Entity e) { updated.push_back(e); }
+    void OnDestroy(Entity e) { destroyed.push_back(e); }
+    void OnBatch(const Entity*, size_t) { ++batches; }
+};
+
+class SignalTest : public ::testing::Test
+{
+protected:
+    Composia::Registry registry;
+    SignalRecorder recorder;
+};
+
+TEST_F(SignalTest, ConstructUpdateDestroy)
+{
+    registry.OnConstruct<Position>().Connect<&SignalRecorder::OnConstruct>(recorder);
+    registry.OnUpdate<Position>().Connect<&SignalRecorder::OnUpdate>(recorder);
+    registry.OnDestroy<Position>().Connect<&SignalRecorder::OnDestroy>(recorder);
+
+    auto e = registry.Create();
+    registry.Emplace<Position>(e, 1, 2);
+    registry.Emplace<Position>(e, 3, 4);
+    registry.Remove<Position>(e);
+    registry.Remove<Position>(e);
+
+    EXPECT_EQ(recorder.constructed, std::vector<Entity>{ e });
+    EXPECT_EQ(recorder.updated, std::vector<Entity>{ e });
+    EXPECT_EQ(recorder.destroyed, std::vector<Entity>{ e });
+}
+
+TEST_F(SignalTest, DestroyEntityFiresOnDestroyWithComponentAlive)
+{
+    int seenX = 0;
+    struct Reader
+    {
+        Registry* registry;
+        int* seen;
+        void OnDestroy(Entity e) { *seen = registry->Get<Position>(e).x; }
+    } reader{ &registry, &seenX };
+    registry.OnDestroy<Position>().Connect<&Reader::OnDestroy>(reader);
+
+    auto e = registry.Create();
+    registry.Emplace<Position>(e, 42, 0);
+    registry.Destroy(e);
+
+    EXPECT_EQ(seenX, 42);
+    EXPECT_FALSE(registry.Has<Position>(e));
+}
+
+TEST_F(SignalTest, BatchInsertAndRemove)
+{
+    registry.OnConstruct<Velocity>().Connect<&SignalRecorder::OnConstruct>(recorder);
+    registry.OnConstructBatch<Velocity>().Connect<&SignalRecorder::OnBatch>(recorder);
+    registry.OnDestroyBatch<Velocity>().Connect<&SignalRecorder::OnBatch>(recorder);
+
+    Entity entities[4];
+    for (auto& e : entities)
+        e = registry.Create();
+
+    registry.Insert<Velocity>(entities, 4, Velocity{ 1.f, 1.f });
+    EXPECT_EQ(recorder.constructed.size(), 4);
+    EXPECT_EQ(recorder.batches, 1);
+
+    registry.Remove<Velocity>(entities, 2);
+    EXPECT_EQ(recorder.batches, 2);
+    EXPECT_FALSE(registry.Has<Velocity>(entities[0]));
+    EXPECT_TRUE(registry.Has<Velocity>(entities[3]));
+}
+
+TEST_F(SignalTest, DisconnectStopsNotifications)
+{
+    auto sink = registry.OnConstruct<Position>();
+    sink.Connect<&SignalRecorder::OnConstruct>(recorder);
+    sink.Disconnect(&recorder);
+    EXPECT_TRUE(sink.Empty());
+
+    registry.Emplace<Position>(registry.Create(), 1, 1);
+    EXPECT_TRUE(recorder.constructed.empty());
+}
+#endif // !COMPOSIA_ARCHETYPE_STORAGE
+
+// -------------------------
+// Snapshot tests
+// -------------------------
+#include <sstream>
+#include <fstream>
+#include <filesystem>
+
+struct Name { std::string value; };
+
+template<> struct Composia::ComponentSerializer<Name>
+{
+    static void Save(OutputArchive& archive, const Name& name)
+    {
+        archive.Write(static_cast<uint32_t>(name.value.size()));
+        archive.Write(name.value.data(), name.value.size());
+    }
+
+    static bool Load(InputArchive& archive, Name& name)
+    {
+        uint32_t size = 0;
+        if (!archive.Read(size)) return false;
+        name.value.resize(size);
+        return archive.Read(name.value.data(), size);
+    }
+};
+
+#if !defined(COMPOSIA_ARCHETYPE_STORAGE)
+TEST(SnapshotTest, RoundTripRestoresEntitiesAndComponents)
+{
+    Registry source;
+    Entity entities[5];
+    for (auto& e : entities)
+        e = source.Create();
+    source.Destroy(entities[1]);
+
+    source.Emplace<Position>(entities[0], 1, 2);
+    source.Emplace<Position>(entities[4], 5, 6);
+    source.Emplace<Velocity>(entities[2], 0.5f, 1.5f);
+    source.Emplace<Enemy>(entities[2]);
+    source.Emplace<Visible>(entities[3]);
+    source.Emplace<DebugLabel>(entities[4], 44);
+    source.Emplace<Name>(entities[0], "player");
+
+    std::stringstream stream;
+    ASSERT_TRUE(source.Save(stream));
+
+    Registry target;
+    target.Emplace<Position>(target.Create(), 9, 9);
+    ASSERT_TRUE((target.Load<Position, Velocity, Enemy, Visible, DebugLabel, Name>(stream)));
+
+    EXPECT_TRUE(target.Has<Position>(entities[0]));
+    EXPECT_EQ(target.Get<Position>(entities[4]).y, 6);
+    EXPECT_FLOAT_EQ(target.Get<Velocity>(entities[2]).vy, 1.5f);
+    EXPECT_TRUE(target.Has<Enemy>(entities[2]));
+    EXPECT_TRUE(target.Has<Visible>(entities[3]));
+    EXPECT_FALSE(target.Has<Visible>(entities[2]));
+    EXPECT_EQ(target.Get<DebugLabel>(entities[4]).id, 44);
+    EXPECT_EQ(target.Get<Name>(entities[0]).value, "player");
+
+    int count = 0;
+    target.View<Position>().each([&](Position&) { ++count; });
+    EXPECT_EQ(count, 2);
+
+    // the destroyed id is recycled first, as in the source registry
+    EXPECT_EQ(target.Create(), entities[1]);
+}
+
+// appends to a string and can't seek, like a pipe or a socket
+struct AppendOnlyBuffer : std::streambuf
+{
+    std::string bytes;
+
+    int_type overflow(int_type c) override
+    {
+        if (c != traits_type::eof())
+            bytes.push_back(static_cast<char>(c));
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* data, std::streamsize size) override
+    {
+        bytes.append(data, static_cast<size_t>(size));
+        return size;
+    }
+};
+
+TEST(SnapshotTest, SectionLengthsAreCountedForStreamsThatCantSeek)
+{
+    Registry source;
+    for (int i = 0; i < 10; ++i)
+    {
+        Entity e = source.Create();
+        source.Emplace<Position>(e, i, i);
+        source.Emplace<Name>(e, std::string(i, 'n'));
+    }
+
+    // seekable streams get the lengths patched in, the others counted first; the bytes are the same
+    for (bool image : { false, true })
+    {
+        std::stringstream seekable;
+        AppendOnlyBuffer buffer;
+        std::ostream appendOnly(&buffer);
+        ASSERT_TRUE(image ? source.SaveImage(seekable) : source.Save(seekable));
+        ASSERT_TRUE(image ? source.SaveImage(appendOnly) : source.Save(appendOnly));
+        EXPECT_EQ(buffer.bytes, seekable.str());
+
+        Registry target;
+        ASSERT_TRUE((target.Load<Position, Name>(seekable)));
+        EXPECT_EQ(target.Get<Name>(9).value, "nnnnnnnnn");
+    }
+}
+
+TEST(SnapshotTest, UnknownSectionsAreSkipped)
+{
+    Registry source;
+    Entity e = source.Create();
+    source.Emplace<Velocity>(e, 1.f, 2.f);
+    source.Emplace<Position>(e, 3, 4);
+
+    std::stringstream stream;
+    ASSERT_TRUE(source.Save(stream));
+
+    Registry target;
+    ASSERT_TRUE(target.Load<Position>(stream));
+    EXPECT_EQ(target.Get<Position>(e).x, 3);
+    EXPECT_FALSE(target.Has<Velocity>(e));
+}
+
+TEST(SnapshotTest, RejectsForeignData)
+{
+    std::stringstream stream("not a snapshot");
+    Registry target;
+    EXPECT_FALSE(target.Load<Position>(stream));
+}
+
+TEST(SnapshotTest, CorruptOrTruncatedDataLeavesTheRegistryUnchanged)
+{
+    Registry source;
+    for (int i = 0; i < 100; ++i)
+        source.Emplace<Position>(source.Create(), i, i);
+    std::stringstream saved;
+    ASSERT_TRUE(source.Save(saved));
+    const std::string bytes = saved.str();
+
+    Registry target;
+    Entity kept = target.Create();
+    target.Emplace<Position>(kept, 7, 7);
+    auto expectUnchanged = [&](const std::string& data) {
+        std::stringstream stream(data);
+        EXPECT_FALSE(target.Load<Position>(stream));
+        int count = 0;
+        target.View<Position>().each([&](Position&) { ++count; });
+        EXPECT_EQ(count, 1);
+        EXPECT_EQ(target.Get<Position>(kept).x, 7);
+        EXPECT_EQ(target.Create(), kept + 1);
+        target.Destroy(kept + 1);
+        };
+
+    // the generation count follows the magic, version and block alignment words
+    std::string huge = bytes;
+    uint64_t count = uint64_t(1) << 40;
+    memcpy(huge.data() + 3 * sizeof(uint32_t), &count, sizeof(count));
+    expectUnchanged(huge);
+
+    count = ~uint64_t(0) / 2;
+    memcpy(huge.data() + 3 * sizeof(uint32_t), &count, sizeof(count));
+    expectUnchanged(huge);
+
+    // cut inside the pool section, after the entities were read
+    expectUnchanged(bytes.substr(0, bytes.size() - 64));
+}
+
+TEST(SnapshotTest, WorldImageIsUsedInPlace)
+{
+    std::string path = (std::filesystem::temp_directory_path() / "composia_world_image.bin").string();
+    {
+        Registry source;
+        for (int i = 0; i < 1000; ++i)
+        {
+            Entity e = source.Create();
+            source.Emplace<Position>(e, i, -i);
+            if (i % 4 == 0) source.Emplace<Enemy>(e);
+        }
+        source.Emplace<Name>(7, "named");
+
+        std::ofstream file(path, std::ios::binary);
+        ASSERT_TRUE(source.SaveImage(file));
+    }
+
+    {
+        Registry target;
+        ASSERT_TRUE((target.LoadImage<Position, Enemy, Name>(path.c_str())));
+        EXPECT_EQ(target.Get<Position>(999).y, -999);
+        EXPECT_TRUE(target.Has<Enemy>(996));
+        EXPECT_FALSE(target.Has<Enemy>(997));
+        EXPECT_EQ(target.Get<Name>(7).value, "named");
+
+        // writes stay private to the process, growing a pool moves it to owned memory
+        target.Get<Position>(0).x = 123;
+        target.Emplace<Position>(target.Create(), 1, 1);
+        EXPECT_EQ(target.Get<Position>(0).x, 123);
+        EXPECT_EQ(target.Get<Position>(500).x, 500);
+    }
+
+    // the file is untouched and still loads through the copying stream path
+    Registry copy;
+    std::ifstream file(path, std::ios::binary);
+    ASSERT_TRUE(copy.Load<Position>(file));
+    EXPECT_EQ(copy.Get<Position>(0).x, 0);
+    file.close();
+    std::filesystem::remove(path);
+}
+
+TEST(SnapshotTest, ImageSectionsThatDontCheckOutFallBackAlone)
+{
+    // positions added out of order, so packed is 2 0 1 and the sparse array 1 2 0
+    Registry source;
+    for (int i = 0; i < 3; ++i)
+        source.Emplace<Enemy>(source.Create());
+    for (Entity e : { 2u, 0u, 1u })
+        source.Emplace<Position>(e, 100 + int(e), 200 + int(e));
+    std::stringstream stream;
+    ASSERT_TRUE(source.SaveImage(stream));
+    const std::string image = stream.str();
+
+    uint64_t hash = TypeId<Position>;
+    size_t header = image.find(std::string(reinterpret_cast<const char*>(&hash), sizeof(hash)));
+    const uint32_t order[] = { 1, 2, 0 };
+    size_t sparse = image.rfind(std::string(reinterpret_cast<const char*>(order), sizeof(order)));
+    ASSERT_NE(header, std::string::npos);
+    ASSERT_NE(sparse, std::string::npos);
+
+    std::string path = (std::filesystem::temp_directory_path() / "composia_patched_image.bin").string();
+    auto load = [&](size_t offset, uint32_t value, Registry& target) {
+        std::string patched = image;
+        memcpy(patched.data() + offset, &value, sizeof(value));
+        {
+            std::ofstream file(path, std::ios::binary);
+            file << patched;
+        }
+        return target.LoadImage<Position, Enemy>(path.c_str());
+        };
+
+    // a sparse entry out of range, one pointing at another key, and the section claiming hash map
+    // storage, which leaves the sparse array unread; each section is rebuilt by copying
+    const std::pair<size_t, uint32_t> patches[] = {
+        { sparse, 5 }, { sparse, 2 }, { header + 16, uint32_t(StoragePolicy::HashMap) } };
+    for (auto [offset, value] : patches)
+    {
+        Registry target;
+        ASSERT_TRUE(load(offset, value, target));
+        for (Entity e = 0; e < 3; ++e)
+        {
+            EXPECT_EQ(target.Get<Position>(e).y, 200 + int(e));
+            EXPECT_TRUE(target.Has<Enemy>(e));
+        }
+    }
+
+    // a component size that no longer matches skips the section, the rest of the image loads
+    Registry target;
+    ASSERT_TRUE(load(header + 8, 12, target));
+    EXPECT_FALSE(target.Has<Position>(0));
+    EXPECT_TRUE(target.Has<Enemy>(2));
+    std::filesystem::remove(path);
+}
+#endif // !COMPOSIA_ARCHETYPE_STORAGE
+
+#if !defined(COMPOSIA_ARCHETYPE_STORAGE)
+// -------------------------
+// Delta snapshot tests
+// -------------------------
+
+class DeltaTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        for (int i = 0; i < 10; ++i)
+        {
+            Entity e = registry.Create();
+            registry.Emplace<Position>(e, i, i);
+            if (i % 2 == 0) registry.Emplace<Enemy>(e);
+        }
+        registry.Capture(baseline);
+    }
+
+    void Change()
+    {
+        registry.Get<Position>(3).x = 300;
+        registry.Remove<Position>(4);
+        registry.Emplace<Enemy>(5);
+        registry.Emplace<Position>(registry.Create(), 11, 11);
+        registry.Destroy(6);
+    }
+
+    Registry registry;
+    Composia::DeltaBaseline baseline;
+};
+
+TEST_F(DeltaTest, DiffRecordsChanges)
+{
+    EXPECT_TRUE(registry.Diff(baseline).Empty());
+
+    Change();
+    Composia::Delta delta = registry.Diff(baseline);
+    ASSERT_EQ(delta.pools.Size(), 2);
+
+    const Composia::PoolDelta& positions = delta.pools[0].valueSize != 0 ? delta.pools[0] : delta.pools[1];
+    EXPECT_EQ(positions.changed.Size(), 1);
+    EXPECT_EQ(positions.added.Size(), 1);
+    EXPECT_EQ(positions.removed.Size(), 2); // 4 removed, 6 destroyed
+    EXPECT_EQ(delta.entities.countAfter, 11);
+}
+
+TEST_F(DeltaTest, RevertRestoresBaselineAndApplyRedoes)
+{
+    Change();
+    Composia::Delta delta = registry.Diff(baseline);
+
+    ASSERT_TRUE(registry.Revert(delta));
+    EXPECT_TRUE(registry.Diff(baseline).Empty());
+    EXPECT_EQ(registry.Get<Position>(3).x, 3);
+    EXPECT_TRUE(registry.Has<Position>(6));
+    EXPECT_FALSE(registry.Has<Enemy>(5));
+    EXPECT_EQ(registry.Create(), 10); // id 6 is alive again, so a fresh id is handed out
+
+    registry.Destroy(10);
+    Composia::Delta undo = registry.Diff(baseline);
+    ASSERT_TRUE(registry.Revert(undo));
+
+    ASSERT_TRUE(registry.Apply(delta));
+    EXPECT_EQ(registry.Get<Position>(3).x, 300);
+    EXPECT_FALSE(registry.Has<Position>(4));
+    EXPECT_TRUE(registry.Has<Enemy>(5));
+    EXPECT_EQ(registry.Get<Position>(10).y, 11);
+    EXPECT_EQ(registry.Create(), 6); // the destroyed id is recycled, as before the revert
+}
+
+TEST_F(DeltaTest, EncodedDeltaReplicatesToAnotherRegistry)
+{
+    std::stringstream world;
+    ASSERT_TRUE(registry.Save(world));
+    Registry replica;
+    ASSERT_TRUE((replica.Load<Position, Enemy>(world)));
+
+    Change();
+    Composia::Delta delta = registry.Diff(baseline);
+    std::stringstream encoded;
+    ASSERT_TRUE(delta.Save(encoded));
+    EXPECT_EQ(encoded.str().size(), delta.EncodedSize());
+
+    Composia::Delta received;
+    ASSERT_TRUE(received.Load(encoded));
+    ASSERT_TRUE(replica.Apply(received));
+
+    Composia::DeltaBaseline replicaState;
+    replica.Capture(replicaState);
+    baseline.Advance(delta);
+    EXPECT_TRUE(registry.Diff(baseline).Empty());
+    EXPECT_TRUE(registry.Diff(replicaState).Empty());
+}
+
+TEST_F(DeltaTest, MalformedDeltasAreRejectedWhole)
+{
+    Change();
+    Composia::Delta delta = registry.Diff(baseline);
+    ASSERT_TRUE(registry.Revert(delta));
+
+    // a free list id past the count, a repeated one, and a count no listed id backs
+    Composia::Delta outside = delta;
+    outside.entities.freeListAfter.PushBack(1u << 30);
+    Composia::Delta repeated = delta;
+    Entity freed = repeated.entities.freeListAfter[0];
+    repeated.entities.freeListAfter.PushBack(freed);
+    Composia::Delta oversized = delta;
+    oversized.entities.countAfter = UINT32_MAX;
+    for (const Composia::Delta* bad : { &outside, &repeated, &oversized })
+    {
+        EXPECT_FALSE(registry.Apply(*bad));
+        EXPECT_TRUE(registry.Diff(baseline).Empty());
+    }
+    EXPECT_TRUE(registry.Apply(delta));
+}
+#endif // !COMPOSIA_ARCHETYPE_STORAGE
+
+// -------------------------
+// Clone tests
+// -------------------------
+
+class CloneTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            Entity e = registry.Create();
+            registry.Emplace<Position>(e, i, i);
+            if (i % 3 == 0) registry.Emplace<Visible>(e);
+            if (i % 10 == 0) registry.Emplace<Name>(e, "entity");
+        }
+        registry.Destroy(50);
+    }
+
+    Registry registry;
+};
+
+TEST_F(CloneTest, CloneIsIndependent)
+{
+    Registry copy = registry.Clone();
+    EXPECT_EQ(copy.Get<Position>(42).x, 42);
+    EXPECT_TRUE(copy.Has<Visible>(3));
+    EXPECT_EQ(copy.Get<Name>(10).value, "entity");
+    EXPECT_EQ(copy.Create(), 50);
+
+    copy.Get<Position>(42).x = -1;
+    copy.Remove<Visible>(3);
+    EXPECT_EQ(registry.Get<Position>(42).x, 42);
+    EXPECT_TRUE(registry.Has<Visible>(3));
+    EXPECT_EQ(registry.Create(), 50);
+}
+
+#if !defined(COMPOSIA_ARCHETYPE_STORAGE)
+TEST_F(CloneTest, SharedCloneCopiesPoolsOnFirstWrite)
+{
+    Registry fork = registry.CloneShared();
+    EXPECT_EQ(fork.Get<Position>(99).y, 99);
+
+    // writes on either side stay on that side
+    fork.Get<Position>(1).x = 1000;
+    registry.Emplace<Position>(2, -2, -2);
+    fork.Remove<Visible>(6);
+    registry.Emplace<Visible>(7);
+
+    EXPECT_EQ(registry.Get<Position>(1).x, 1);
+    EXPECT_EQ(fork.Get<Position>(1).x, 1000);
+    EXPECT_EQ(fork.Get<Position>(2).x, 2);
+    EXPECT_TRUE(registry.Has<Visible>(6));
+    EXPECT_FALSE(fork.Has<Visible>(6));
+    EXPECT_FALSE(fork.Has<Visible>(7));
+
+    int forkCount = 0;
+    fork.View<Position>().each([&](Position&) { ++forkCount; });
+    EXPECT_EQ(forkCount, 99); // 50 was destroyed
+}
+
+TEST_F(CloneTest, OnlyWritesAndGetCopySharedPools)
+{
+    if constexpr (!Instrumentation::Enabled)
+        GTEST_SKIP() << "Built without COMPOSIA_INSTRUMENTATION";
+
+    {
+        Registry fork = registry.CloneShared();
+        Instrumentation::Reset();
+        EXPECT_TRUE(fork.Has<Position>(1));
+        EXPECT_TRUE(registry.Has<Visible>(3));
+        EXPECT_EQ(Instrumentation::Snapshot()[Counter::ArrayBytesMoved], 0u);
+
+        fork.Get<Position>(1).x = 1000;
+        EXPECT_GT(Instrumentation::Snapshot()[Counter::ArrayBytesMoved], 0u);
+    }
+
+    // the fork is gone, the original writes its pools without copying them
+    Instrumentation::Reset();
+    registry.Get<Position>(1).x = 5;
+    registry.Remove<Visible>(3);
+    EXPECT_EQ(Instrumentation::Snapshot()[Counter::ArrayBytesMoved], 0u);
+    EXPECT_FALSE(registry.Has<Visible>(3));
+}
+
+TEST_F(CloneTest, ViewsOnASharedCloneWriteTheirOwnCopy)
+{
+    // the original copies its pool first, so the fork's view is left holding the last reference
+    // to the shared arrays and its first Get would free the pivot array the loop reads
+    Registry fork = registry.CloneShared();
+    registry.Emplace<Position>(2, -2, -2);
+    int visited = 0;
+    fork.View<Position>().each([&](Position& p) { p.x += 1000; ++visited; });
+    EXPECT_EQ(visited, 99);
+
+    // tags only filter, Visible stays shared while Position is copied
+    fork.View<Position, Visible>().each([&](Position& p) { p.y = -1; });
+    EXPECT_EQ(fork.Get<Position>(3).x, 1003);
+    EXPECT_EQ(fork.Get<Position>(3).y, -1);
+    EXPECT_EQ(fork.Get<Position>(4).y, 4);
+    EXPECT_EQ(registry.Get<Position>(3).x, 3);
+}
+
+TEST_F(CloneTest, ObserversStayWithTheOriginal)
+{
+    auto& observer = registry.Observe<Position>();
+    observer.Clear();
+
+    Registry fork = registry.CloneShared();
+    fork.Emplace<Position>(fork.Create(), 0, 0);
+    EXPECT_TRUE(observer.Empty());
+
+    registry = std::move(fork);
+    EXPECT_EQ(registry.Get<Position>(50).x, 0);
+}
+#endif // !COMPOSIA_ARCHETYPE_STORAGE
+
+// -------------------------
+// TypeId tests
+// -------------------------
+struct PinnedId { int value; };
+
+template<> struct Composia::TypeIdTraits<PinnedId> { static constexpr uint64_t value = 0xC0FFEE; };
+
+// two types pinned to one id
+struct CollidingFirst { int value; };
+struct CollidingSecond { float value; };
+template<> struct Composia::TypeIdTraits<CollidingFirst> { static constexpr uint64_t value = 0xC011DE; };
+template<> struct Composia::TypeIdTraits<CollidingSecond> { static constexpr uint64_t value = 0xC011DE; };
+
+TEST(TypeIdTest, StableAcrossCompilerSpellings)
+{
+    static_assert(TypeId<Position> == TypeId<const Position>);
+    static_assert(TypeId<Position> != TypeId<Velocity>);
+
+    EXPECT_EQ(HashTypeName("struct Foo<class Bar, int>"), HashTypeName("Foo<Bar,int>"));
+    EXPECT_EQ(HashTypeName("enum Mode"), HashTypeName("Mode"));
+    EXPECT_NE(HashTypeName("Subclass Bar"), HashTypeName("SubBar"));
+}
+
+TEST(TypeIdTest, UserOverrideKeysPoolsAndSnapshots)
+{
+    static_assert(TypeId<PinnedId> == 0xC0FFEE);
+
+    ComponentManager manager;
+    manager.Emplace<PinnedId>(3, 7);
+    EXPECT_EQ(manager.Get<PinnedId>(3)->value, 7);
+    EXPECT_EQ(manager.Pool<PinnedId>()->Layout().typeHash, 0xC0FFEEu);
+}
+
+TEST(TypeIdTest, RegistrationDetectsCollisions)
+{
+    EXPECT_TRUE(RegisterTypeId(0xDEADBEEF, "First"));
+    EXPECT_TRUE(RegisterTypeId(0xDEADBEEF, "First"));
+    EXPECT_FALSE(RegisterTypeId(0xDEADBEEF, "Second"));
+}
+
+TEST(TypeIdTest, CollidingTypesAbortInEveryBuild)
+{
+    Registry registry;
+    registry.SetResource<CollidingFirst>(CollidingFirst{ 1 });
+    EXPECT_DEATH((void)registry.Resource<CollidingSecond>(), "shares its TypeId");
+    EXPECT_DEATH((void)registry.RemoveResource<CollidingSecond>(), "shares its TypeId");
+
+#if !defined(COMPOSIA_ARCHETYPE_STORAGE)
+    Entity e = registry.Create();
+    registry.Emplace<CollidingFirst>(e, 1);
+    EXPECT_DEATH((void)registry.Has<CollidingSecond>(e), "shares its TypeId");
+#endif
+}
+
+#if !defined(COMPOSIA_ARCHETYPE_STORAGE)
+// -------------------------
+// Memory stats tests
+// -------------------------
+TEST(MemoryStatsTest, ReportsPoolsAndEntities)
+{
+    Registry registry;
+    for (int i = 0; i < 100; ++i)
+    {
+        Entity e = registry.Create();
+        registry.Emplace<Position>(e, i, i);
+        if (i % 2 == 0)
+            registry.Emplace<Visible>(e);
+    }
+    registry.Destroy(10);
+    registry.Destroy(11);
+
+    MemoryReport report = registry.MemoryStats();
+    EXPECT_EQ(report.entities.alive, 98u);
+    EXPECT_EQ(report.entities.ids, 100u);
+    EXPECT_EQ(report.entities.freeListLength, 2u);
+
+    const PoolMemory* positions = report.Find(TypeName<Position>());
+    ASSERT_NE(positions, nullptr);
+    EXPECT_EQ(positions->typeId, TypeId<Position>);
+    EXPECT_EQ(positions->count, 98u);
+    EXPECT_EQ(positions->dense.used, 98 * sizeof(Position));
+    EXPECT_EQ(positions->packed.used, 98 * sizeof(Entity));
+    EXPECT_GE(positions->dense.reserved, positions->dense.used);
+    EXPECT_GE(positions->sparse.used, 100 * sizeof(uint32_t));
+
+    const PoolMemory* visible = report.Find(TypeName<Visible>());
+    ASSERT_NE(visible, nullptr);
+    EXPECT_EQ(visible->count, 49u);
+    EXPECT_EQ(visible->dense.reserved, 0u);
+    EXPECT_GT(visible->sparse.used, 0u);
+
+    EXPECT_GT(report.poolMap.reserved, report.poolMap.used);
+    EXPECT_GE(report.Total().reserved, report.Total().used);
+}
+#endif // !COMPOSIA_ARCHETYPE_STORAGE
+
+// -------------------------
+// Instrumentation tests
+// -------------------------
+
+#if !defined(COMPOSIA_ARCHETYPE_STORAGE)
+TEST(InstrumentationTest, CountsHotPathEvents)
+{
+    if constexpr (!Instrumentation::Enabled)
+        GTEST_SKIP() << "Built without COMPOSIA_INSTRUMENTATION";
+
+    Instrumentation::Reset();
+    Registry registry;
+    for (int i = 0; i < 5000; ++i)
+    {
+        Entity e = registry.Create();
+        registry.Emplace<Position>(e, i, i);
+        if (i % 4 == 0)
+            registry.Emplace<Velocity>(e, 0.f, 0.f);
+    }
+
+    int visited = 0;
+    registry.View<Position, Velocity>().each([&](Position&, Velocity&) { ++visited; });
+    EXPECT_EQ(visited, 1250);
+
+    CounterValues counters = Instrumentation::Snapshot();
+    EXPECT_GT(counters[Counter::ArrayReallocations], 0u);
+    EXPECT_GT(counters[Counter::ArrayBytesMoved], 0u);
+    EXPECT_GT(counters[Counter::SparseResizes], 0u);
+    EXPECT_EQ(counters[Counter::ViewCandidates], 1250u);
+    EXPECT_EQ(counters[Counter::ViewAccepted], 1250u);
+    EXPECT_GE(counters[Counter::PoolMapProbes], counters[Counter::PoolMapLookups]);
+    EXPECT_GE(counters[Counter::PoolMapLookups], 6250u);
+    EXPECT_EQ(CounterValues::Name(Counter::SparseResizes), "SparseResizes");
+}
+#endif // !COMPOSIA_ARCHETYPE_STORAGE
+
+TEST(InstrumentationTest, AggregatesExitedThreadsAndResets)
+{
+    if constexpr (!Instrumentation::Enabled)
+        GTEST_SKIP() << "Built without COMPOSIA_INSTRUMENTATION";
+
+    Instrumentation::Reset();
+    std::thread worker([] {
+        Registry registry;
+        Entity e = registry.Create();
+        registry.Emplace<Position>(e, 1, 1);
+        registry.View<Position>().each([](Position&) {});
+        });
+    worker.join();
+
+    EXPECT_EQ(Instrumentation::Snapshot()[Counter::ViewCandidates], 1u);
+    Instrumentation::Reset();
+    EXPECT_EQ(Instrumentation::Snapshot()[Counter::ViewCandidates], 0u);
+}
+
+// -------------------------
+// Trace tests
+// -------------------------
+TEST(TraceTest, ExportsZonesPerThreadAsChromeJson)
+{
+    if constexpr (!Trace::Enabled)
+        GTEST_SKIP() << "Built without COMPOSIA_INSTRUMENTATION";
+
+    Trace::Clear();
+    Registry registry;
+    registry.Emplace<Position>(registry.Create(), 1, 2);
+    {
+        COMPOSIA_TRACE_ZONE("Movement \"system\"");
+        registry.View<Position>().each([](Position&) {});
+    }
+
+    std::thread worker([] {
+        Trace::NameThread("Worker");
+        COMPOSIA_TRACE_ZONE("Worker job");
+        });
+    worker.join();
+
+    std::ostringstream json;
+    Trace::WriteChromeJson(json);
+    std::string text = json.str();
+    EXPECT_EQ(text.find("{\"displayTimeUnit\""), 0u);
+    EXPECT_NE(text.find("\"name\":\"Movement \\\"system\\\"\",\"ph\":\"X\""), std::string::npos);
+    EXPECT_NE(text.find(TypeName<decltype(registry.View<Position>())>()), std::string::npos);
+    EXPECT_NE(text.find("\"name\":\"Worker job\""), std::string::npos);
+    EXPECT_NE(text.find("\"args\":{\"name\":\"Worker\"}"), std::string::npos);
+
+    Trace::Clear();
+    std::ostringstream cleared;
+    Trace::WriteChromeJson(cleared);
+    EXPECT_EQ(cleared.str().find("Worker job"), std::string::npos);
+}
+
+// -------------------------
+// Sort tests
+// -------------------------
+TEST(SortTest, PermuteInPlaceAndRadixOrder)
+{
+    DynamicArray<int> values;
+    DynamicArray<int> mirror;
+    for (int v : { 40, 10, 30, 20 })
+    {
+        values.PushBack(v);
+        mirror.PushBack(-v);
+    }
+    DynamicArray<uint32_t> order;
+    for (uint32_t i : { 1u, 3u, 2u, 0u })
+        order.PushBack(i);
+
+    PermuteInPlace(order, values, mirror);
+    for (size_t i = 0; i < 4; ++i)
+    {
+        EXPECT_EQ(values[i], int(i + 1) * 10);
+        EXPECT_EQ(mirror[i], -values[i]);
+        EXPECT_EQ(order[i], i);
+    }
+
+    DynamicArray<int64_t> keys;
+    for (int64_t k : { int64_t(5), int64_t(-3), int64_t(1) << 40, int64_t(5), int64_t(-70000) })
+        keys.PushBack(k);
+    RadixOrder(keys, order);
+    std::vector<uint32_t> sorted(order.begin(), order.end());
+    EXPECT_EQ(sorted, (std::vector<uint32_t>{ 4, 1, 0, 3, 2 }));
+}
+
+#if !defined(COMPOSIA_ARCHETYPE_STORAGE)
+TEST_F(RegistryTest, SortReordersPoolsAndKeepsLookups)
+{
+    for (int i = 0; i < 200; ++i)
+    {
+        Entity e = registry.Create();
+        registry.Emplace<Position>(e, (i * 37) % 200, i);
+        if (i % 3 == 0) registry.Emplace<Velocity>(e, float(i), 0.f);
+        if (i % 5 == 0) registry.Emplace<DebugLabel>(e, 1000 - i);
+    }
+
+    auto positions = [&] {
+        std::vector<Position> seen;
+        registry.View<Position>().each([&](Position& p) { seen.push_back(p); });
+        return seen;
+    };
+
+    registry.Sort<Position>([](const Position& a, const Position& b) { return a.x < b.x; });
+    std::vector<Position> seen = positions();
+    ASSERT_EQ(seen.size(), 200u);
+    for (size_t i = 0; i < seen.size(); ++i)
+        EXPECT_EQ(seen[i].x, int(i));
+    for (Entity e = 0; e < 200; ++e)
+        EXPECT_EQ(registry.Get<Position>(e).y, int(e));
+
+    registry.SortByKey<Position>([](const Position& p) { return -p.y; });
+    seen = positions();
+    for (size_t i = 0; i < seen.size(); ++i)
+        EXPECT_EQ(seen[i].y, 199 - int(i));
+
+    // hash map pools sort the same way and keep their slots pointing at the moved rows
+    registry.SortByKey<DebugLabel>([](Entity e) { return uint8_t(e % 7); });
+    for (Entity e = 0; e < 200; e += 5)
+        EXPECT_EQ(registry.Get<DebugLabel>(e).id, 1000 - int(e));
+
+    // Position follows Velocity: shared entities first in Velocity's order, then the rest
+    registry.Sort<Velocity>([](Entity a, Entity b) { return a > b; });
+    registry.SortAs<Position, Velocity>();
+    std::vector<Entity> order;
+    registry.View<Position>().each([&](Position& p) { order.push_back(Entity(p.y)); });
+    for (size_t i = 0; i < 67; ++i)
+        EXPECT_EQ(order[i], Entity(198 - 3 * i));
+    EXPECT_TRUE(std::is_sorted(order.begin() + 67, order.end(), std::greater<Entity>()));
+    for (Entity e = 0; e < 200; ++e)
+        EXPECT_EQ(registry.Get<Position>(e).y, int(e));
+}
+#endif // !COMPOSIA_ARCHETYPE_STORAGE
+
+#if !defined(COMPOSIA_ARCHETYPE_STORAGE)
+// -------------------------
+// Compact tests
+// -------------------------
+TEST(CompactTest, ReleasesMemoryAfterSpike)
+{
+    Registry registry;
+    for (int i = 0; i < 20000; ++i)
+    {
+        Entity e = registry.Create();
+        registry.Emplace<Position>(e, i, i);
+        registry.Emplace<Visible>(e);
+        registry.Emplace<DebugLabel>(e, i);
+    }
+    for (Entity e = 100; e < 20000; ++e)
+        registry.Destroy(e);
+
+    MemoryReport before = registry.MemoryStats();
+
+    // a small budget spreads the pass over several calls
+    CompactResult result;
+    size_t calls = 0;
+    size_t released = 0;
+    do
+    {
+        result = registry.Compact(1, true);
+        released += result.released;
+        ++calls;
+    } while (!result.swept);
+    EXPECT_GT(calls, 1u);
+
+    MemoryReport after = registry.MemoryStats();
+    EXPECT_LT(after.Total().reserved, before.Total().reserved / 4);
+    EXPECT_EQ(before.Total().reserved - after.Total().reserved, released);
+    EXPECT_EQ(after.entities.ids, 100u);
+    EXPECT_EQ(after.entities.freeListLength, 0u);
+    EXPECT_LE(after.Find(TypeName<Position>())->sparse.used, 128 * sizeof(uint32_t));
+
+    for (Entity e = 0; e < 100; ++e)
+    {
+        EXPECT_EQ(registry.Get<Position>(e).y, int(e));
+        EXPECT_TRUE(registry.Has<Visible>(e));
+        EXPECT_EQ(registry.Get<DebugLabel>(e).id, int(e));
+    }
+    EXPECT_EQ(registry.Create(), Entity(100));
+
+    // nothing left to give back
+    EXPECT_EQ(registry.Compact().released, 0u);
+}
+
+TEST(CompactTest, LargePoolsAreCompactedWithinTheBudget)
+{
+    Registry registry;
+    for (int i = 0; i < (1 << 20); ++i)
+        registry.Emplace<Position>(registry.Create(), i, i);
+    for (Entity e = 1000; e < (1 << 20); ++e)
+        registry.Destroy(e);
+
+    MemoryReport before = registry.MemoryStats();
+
+    // the pool is cut and reallocated over many calls, none of them going far past the budget
+    const size_t budget = 10000;
+    CompactResult result;
+    size_t calls = 0;
+    do
+    {
+        result = registry.Compact(budget);
+        EXPECT_LE(result.work, budget + CompactBudget::COMPACT_STEP);
+        ++calls;
+    } while (!result.swept);
+    EXPECT_GT(calls, (1u << 20) / (budget + CompactBudget::COMPACT_STEP));
+
+    MemoryReport after = registry.MemoryStats();
+    EXPECT_LT(after.Find(TypeName<Position>())->Total().reserved, before.Find(TypeName<Position>())->Total().reserved / 100);
+    for (Entity e = 0; e < 1000; ++e)
+        EXPECT_EQ(registry.Get<Position>(e).x, int(e));
+}
+
+TEST(CompactTest, IdsAreTrimmedWithinTheBudget)
+{
+    Registry registry;
+    for (int i = 0; i < (1 << 20); ++i)
+        registry.Emplace<Position>(registry.Create(), i, i);
+    for (Entity e = 1000; e < (1 << 20); ++e)
+        registry.Destroy(e);
+
+    // an entity recycled between the calls is the last one freed, it is set aside again. Midway
+    // the ids set aside still count as free, in stats and snapshots.
+    const size_t budget = 10000;
+    CompactResult result;
+    size_t calls = 0;
+    do
+    {
+        registry.Destroy(registry.Create());
+        result = registry.Compact(budget, true);
+        EXPECT_LE(result.work, budget + CompactBudget::COMPACT_STEP);
+        if (++calls == 240)
+        {
+            EXPECT_EQ(registry.MemoryStats().entities.alive, 1000u);
+            std::stringstream stream;
+            ASSERT_TRUE(registry.Save(stream));
+            Registry loaded;
+            ASSERT_TRUE(loaded.Load(stream));
+            EXPECT_EQ(loaded.MemoryStats().entities.alive, 1000u);
+            EXPECT_EQ(loaded.MemoryStats().entities.freeListLength, (1u << 20) - 1000u);
+        }
+    } while (!result.swept);
+    EXPECT_GT(calls, 240u);
+
+    EntityMemory entities = registry.MemoryStats().entities;
+    EXPECT_EQ(entities.ids, 1000u);
+    EXPECT_EQ(entities.alive, 1000u);
+    EXPECT_EQ(entities.freeListLength, 0u);
+    EXPECT_EQ(registry.Create(), Entity(1000));
+    EXPECT_EQ(registry.Get<Position>(999).x, 999);
+}
+
+TEST(CompactTest, ReallocationsLargerThanTheBudgetAreReportedAsDeferred)
+{
+    // 100000 live positions are too many to move within one step of the budget
+    Registry registry;
+    for (int i = 0; i < (1 << 20); ++i)
+        registry.Emplace<Position>(registry.Create(), i, i);
+    for (Entity e = 100000; e < (1 << 20); ++e)
+        registry.Destroy(e);
+
+    const size_t budget = 10000;
+    CompactResult result;
+    size_t deferred = 0;
+    do
+    {
+        result = registry.Compact(budget);
+        EXPECT_LE(result.work, budget + CompactBudget::COMPACT_STEP);
+        deferred += result.deferred;
+    } while (!result.swept);
+    EXPECT_GT(deferred, 100000 * sizeof(Position));
+
+    // a call with a budget covering them gives those bytes back
+    result = registry.Compact();
+    EXPECT_EQ(result.released, deferred);
+    EXPECT_EQ(result.deferred, 0u);
+    EXPECT_EQ(registry.Get<Position>(99999).x, 99999);
+}
+
+// -------------------------
+// Defragment tests
+// -------------------------
+TEST(DefragmentTest, RenumbersLiveEntitiesDensely)
+{
+    Registry registry;
+    for (int i = 0; i < 1000; ++i)
+    {
+        Entity e = registry.Create();
+        registry.Emplace<Position>(e, i, 0);
+        if (i % 2 == 0) registry.Emplace<Visible>(e);
+        if (i % 7 == 0) registry.Emplace<DebugLabel>(e, i);
+        if (i % 3 == 0) registry.Emplace<Velocity>(e, float(i), 0.f);
+    }
+    auto& observer = registry.Observe<Velocity>(Exclude<Visible>{});
+    for (Entity e = 0; e < 1000; ++e)
+    {
+        if (e % 5 != 0)
+            registry.Destroy(e);
+    }
+    registry.Sort<Velocity>([](Entity a, Entity b) { return a > b; });
+
+    DynamicArray<Entity> remap = registry.Defragment<Velocity>();
+    ASSERT_EQ(remap.Size(), 1000u);
+
+    // the 67 Velocity owners among the 200 survivors come first, in Velocity's order
+    std::vector<Entity> velocityOwners;
+    registry.View<Velocity>().each([&](Velocity& v) { velocityOwners.push_back(Entity(v.vx)); });
+    for (Entity old = 0; old < 1000; ++old)
+    {
+        if (old % 5 != 0)
+        {
+            EXPECT_EQ(remap[old], INVALID_ENTITY);
+            continue;
+        }
+
+        Entity e = remap[old];
+        ASSERT_LT(e, 200u);
+        EXPECT_EQ(registry.Get<Position>(e).x, int(old));
+        EXPECT_EQ(registry.Has<Visible>(e), old % 2 == 0);
+        EXPECT_EQ(registry.Has<DebugLabel>(e), old % 7 == 0);
+        if (old % 7 == 0)
+        {
+            EXPECT_EQ(registry.Get<DebugLabel>(e).id, int(old));
+        }
+        if (old % 3 == 0)
+        {
+            EXPECT_LT(e, 67u);
+            EXPECT_EQ(Entity(registry.Get<Velocity>(e).vx), old);
+        }
+        EXPECT_EQ(observer.Has(e), old % 3 == 0 && old % 2 != 0);
+    }
+    EXPECT_EQ(remap[velocityOwners.front()], 0u);
+    EXPECT_EQ(remap[velocityOwners.back()], 66u);
+
+    MemoryReport report = registry.MemoryStats();
+    EXPECT_EQ(report.entities.ids, 200u);
+    EXPECT_EQ(report.entities.freeListLength, 0u);
+    EXPECT_EQ(report.Find(TypeName<Position>())->sparse.used, 200 * sizeof(uint32_t));
+    EXPECT_EQ(registry.Create(), Entity(200));
+}
+
+// -------------------------
+// Enable/Disable tests
+// -------------------------
+TEST(DisableTest, ViewsSkipDisabledEntitiesAndKeepTheirComponents)
+{
+    Registry registry;
+    std::vector<Entity> entities;
+    for (int i = 0; i < 100; ++i)
+    {
+        Entity e = registry.Create();
+        registry.Emplace<Position>(e, i, 0);
+        registry.Emplace<Visible>(e);
+        if (i % 2 == 0) registry.Emplace<Velocity>(e, float(i), 0.f);
+        if (i % 4 == 0) registry.Emplace<DebugLabel>(e, i);
+        if (i % 5 == 0) registry.Emplace<Enemy>(e);
+        entities.push_back(e);
+    }
+
+    for (Entity e : entities)
+    {
+        if (e % 3 == 0)
+            registry.Disable(e);
+    }
+    registry.Disable(entities[3]); // already disabled
+
+    auto visited = [&](auto view) {
+        std::vector<Entity> result;
+        view.each([&](auto&&...) {});
+        for (Entity e : view)
+            result.push_back(e);
+        std::sort(result.begin(), result.end());
+        return result;
+        };
+    auto expected = [&](auto owns) {
+        std::vector<Entity> result;
+        for (Entity e : entities)
+        {
+            if (e % 3 != 0 && owns(e))
+                result.push_back(e);
+        }
+        return result;
+        };
+
+    EXPECT_EQ(visited(registry.View<Position>()), expected([](Entity) { return true; }));
+    EXPECT_EQ(visited(registry.View<Position, Velocity>()), expected([](Entity e) { return e % 2 == 0; }));
+    EXPECT_EQ(visited(registry.View<DebugLabel, Position>()), expected([](Entity e) { return e % 4 == 0; }));
+    EXPECT_EQ(visited(registry.View<Enemy>()), expected([](Entity e) { return e % 5 == 0; }));
+
+    // bitset pools have no enabled prefix, their words are masked instead
+    size_t visible = 0;
+    registry.View<Visible>().each([&]() { ++visible; });
+    EXPECT_EQ(visible, 66u);
+
+    // disabled entities keep their components
+    EXPECT_FALSE(registry.IsEnabled(entities[9]));
+    EXPECT_TRUE(registry.IsEnabled(entities[10]));
+    EXPECT_EQ(registry.Get<Position>(entities[9]).x, 9);
+    EXPECT_TRUE(registry.Has<Visible>(entities[9]));
+
+    // components added or removed while disabled keep the partition
+    registry.Emplace<Velocity>(entities[9], 9.f, 0.f);
+    registry.Remove<Position>(entities[12]);
+    registry.Remove<Position>(entities[13]);
+    registry.Emplace<Velocity>(entities[13], 13.f, 0.f);
+    registry.Sort<Position>([](const Position& a, const Position& b) { return a.x > b.x; });
+    EXPECT_EQ(visited(registry.View<Position, Velocity>()), expected([](Entity e) { return e % 2 == 0; }));
+    EXPECT_EQ(visited(registry.View<Velocity>()), expected([](Entity e) { return e % 2 == 0 || e == 13; }));
+
+    registry.Enable(entities[9]);
+    registry.Enable(entities[12]);
+    EXPECT_TRUE(registry.IsEnabled(entities[9]));
+    auto velocityOwners = visited(registry.View<Position, Velocity>());
+    EXPECT_TRUE(std::binary_search(velocityOwners.begin(), velocityOwners.end(), entities[9]));
+    EXPECT_EQ(registry.Get<Velocity>(entities[9]).vx, 9.f);
+
+    // destroyed entities don't hand their disabled state to the recycled id
+    registry.Destroy(entities[15]);
+    Entity recycled = registry.Create();
+    EXPECT_EQ(recycled, entities[15]);
+    EXPECT_TRUE(registry.IsEnabled(recycled));
+
+    // the disabled state survives snapshots
+    std::stringstream stream;
+    ASSERT_TRUE(registry.Save(stream));
+    Registry loaded;
+    ASSERT_TRUE((loaded.Load<Position, Velocity, Visible, DebugLabel, Enemy>(stream)));
+    EXPECT_FALSE(loaded.IsEnabled(entities[3]));
+    EXPECT_EQ(visited(loaded.View<Position, Velocity>()), visited(registry.View<Position, Velocity>()));
+    EXPECT_EQ(visited(loaded.View<Enemy>()), visited(registry.View<Enemy>()));
+}
+#endif // !COMPOSIA_ARCHETYPE_STORAGE
+
+// -------------------------
+// Resource tests
+// -------------------------
+struct GameTime { float delta; int frame; };
+struct InputState { std::vector<int> pressed; };
+
+TEST(ResourceTest, SetReplacesInPlaceAndHandlesStayValid)
+{
+    Registry registry;
+    EXPECT_FALSE(registry.Resource<GameTime>());
+
+    GameTime& time = registry.SetResource<GameTime>(0.016f, 0);
+    registry.SetResource<InputState>(InputState{ { 1, 2 } });
+    ResourceHandle<GameTime> handle = registry.Resource<GameTime>();
+    ASSERT_TRUE(handle);
+    EXPECT_EQ(handle.Get(), &time);
+    EXPECT_EQ(handle->frame, 0);
+
+    // replacing keeps the address, so cached handles see the new value
+    registry.SetResource<GameTime>(0.033f, 7);
+    EXPECT_EQ(registry.Resource<GameTime>().Get(), &time);
+    EXPECT_EQ(handle->frame, 7);
+    (*handle).frame = 8;
+    EXPECT_EQ(registry.Resource<GameTime>()->frame, 8);
+    EXPECT_EQ(registry.Resource<InputState>()->pressed.size(), 2u);
+
+    // resources live apart from entities and pools
+    Entity e = registry.Create();
+    registry.Emplace<Position>(e, 1, 2);
+    EXPECT_FALSE(registry.Has<GameTime>(e));
+
+    Registry copy = registry.Clone();
+    ASSERT_TRUE(copy.Resource<GameTime>());
+    EXPECT_NE(copy.Resource<GameTime>().Get(), &time);
+    EXPECT_EQ(copy.Resource<GameTime>()->frame, 8);
+    copy.Resource<InputState>()->pressed.push_back(3);
+    EXPECT_EQ(registry.Resource<InputState>()->pressed.size(), 2u);
+
+    EXPECT_TRUE(registry.RemoveResource<GameTime>());
+    EXPECT_FALSE(registry.RemoveResource<GameTime>());
+    EXPECT_FALSE(registry.Resource<GameTime>());
+    EXPECT_EQ(registry.Resource<InputState>()->pressed.size(), 2u);
+    EXPECT_TRUE(copy.Resource<GameTime>());
+}
+
+#if !defined(COMPOSIA_ARCHETYPE_STORAGE)
+// -------------------------
+// Storage handle tests
+// -------------------------
+TEST(StorageTest, HandleReadsAndWritesThePool)
+{
+    Registry registry;
+    StorageHandle<Position> positions = registry.Storage<Position>();
+    StorageHandle<DebugLabel> labels = registry.Storage<DebugLabel>();
+
+    std::vector<Entity> entities;
+    for (int i = 0; i < 200; ++i)
+    {
+        Entity e = registry.Create();
+        if (i % 3 != 0) positions.Emplace(e, i, -i);
+        if (i % 2 == 0) labels.Emplace(e, i);
+        entities.push_back(e);
+    }
+    EXPECT_TRUE(positions.Has(entities[1]));
+    EXPECT_FALSE(positions.Has(entities[3]));
+    EXPECT_EQ(registry.Get<Position>(entities[1]).x, 1);
+    positions.Get(entities[1]).x = 42;
+    EXPECT_EQ(registry.Get<Position>(entities[1]).x, 42);
+    EXPECT_EQ(&positions.Pool(), &registry.Storage<Position>().Pool());
+
+    positions.Remove(entities[1]);
+    EXPECT_FALSE(registry.Has<Position>(entities[1]));
+
+    // reversed, so the batch is not in pool order, and long enough to use every prefetch stage
+    std::vector<Entity> batch(entities.rbegin(), entities.rend());
+    std::vector<Position*> found(batch.size());
+    std::vector<DebugLabel*> foundLabels(batch.size());
+    positions.GetMany(batch.data(), batch.size(), found.data());
+    labels.GetMany(batch.data(), batch.size(), foundLabels.data());
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        Entity e = batch[i];
+        if (e % 3 != 0 && e != entities[1])
+        {
+            ASSERT_NE(found[i], nullptr);
+            EXPECT_EQ(found[i], &registry.Get<Position>(e));
+        }
+        else
+        {
+            EXPECT_EQ(found[i], nullptr);
+        }
+        EXPECT_EQ(foundLabels[i] != nullptr, e % 2 == 0);
+        if (foundLabels[i])
+        {
+            EXPECT_EQ(foundLabels[i]->id, int(e));
+        }
+    }
+
+    // components emplaced through the handle follow the entity's enabled state
+    registry.Disable(entities[3]);
+    positions.Emplace(entities[3], 3, 3);
+    size_t visited = 0;
+    registry.View<Position>().each([&](Position& p) { visited += p.x == 3; });
+    EXPECT_EQ(visited, 0u);
+
+    // the handle moves along with the registry, disabled entities included
+    Registry moved = std::move(registry);
+    moved.Disable(entities[6]);
+    positions.Emplace(entities[6], 6, 6);
+    EXPECT_EQ(moved.Get<Position>(entities[6]).y, 6);
+    visited = 0;
+    moved.View<Position>().each([&](Position& p) { visited += p.x == 6; });
+    EXPECT_EQ(visited, 0u);
+}
+
+// -------------------------
+// View prefetch tests
+// -------------------------
+TEST(PrefetchTest, LargeViewsVisitTheSameEntitiesWithAndWithoutPrefetching)
+{
+    // above the size views start prefetching at, with a shuffled second pool
+    Registry registry;
+    std::vector<Entity> entities;
+    for (int i = 0; i < 40000; ++i)
+    {
+        Entity e = registry.Create();
+        registry.Emplace<Position>(e, i, 0);
+        entities.push_back(e);
+    }
+    std::shuffle(entities.begin(), entities.end(), std::mt19937(7));
+    for (Entity e : entities)
+    {
+        if (e % 3 != 0)
+            registry.Emplace<Velocity>(e, float(e), 0.f);
+    }
+    registry.Disable(entities[0]);
+
+    auto sum = [&](size_t distance) {
+        int64_t total = 0;
+        size_t visited = 0;
+        registry.View<Position, Velocity>().PrefetchDistance(distance).each([&](Position& p, Velocity& v) {
+            total += p.x + int64_t(v.vx);
+            ++visited;
+            });
+        return std::make_pair(total, visited);
+        };
+
+    auto withoutPrefetch = sum(0);
+    EXPECT_EQ(withoutPrefetch.second, 40000u - 13334u - (entities[0] % 3 != 0 ? 1u : 0u));
+    EXPECT_EQ(sum(PREFETCH_DISTANCE), withoutPrefetch);
+    EXPECT_EQ(sum(1), withoutPrefetch);
+    EXPECT_EQ(sum(100000), withoutPrefetch);
+}
+#endif // !COMPOSIA_ARCHETYPE_STORAGE
+
+// -------------------------
+// HasBatch tests
+// -------------------------
+TEST(HasBatchTest, MasksMatchHasForEverySetType)
+{
+    SparseSet<int> sparse;
+    SparseSet<void> keys;
+    HashedSet<int> hashed;
+    BitSet bits;
+    for (Key k = 0; k < 300; k += 3)
+    {
+        sparse.Add(k, int(k));
+        keys.Add(k);
+        hashed.Add(k, int(k));
+        bits.Add(k);
+    }
+    sparse.Remove(30);
+    keys.Remove(30);
+    hashed.Remove(30);
+    bits.Remove(30);
+
+    // 8 wide steps, a scalar tail, a partial last word and keys past every sparse array
+    std::vector<Key> batch;
+    for (Key k = 0; k < 140; ++k)
+        batch.push_back(k * 7 % 320);
+    batch.push_back(100000);
+    batch.push_back(std::numeric_limits<Key>::max());
+
+    auto check = [&](const auto& set) {
+        std::vector<uint64_t> mask(3, ~uint64_t(0));
+        set.HasBatch(batch.data(), batch.size(), mask.data());
+        for (size_t i = 0; i < batch.size(); ++i)
+            EXPECT_EQ(((mask[i / 64] >> (i % 64)) & 1) != 0, set.Has(batch[i])) << "key " << batch[i];
+        EXPECT_EQ(mask[2] >> (batch.size() % 64), 0u);
+        };
+    check(sparse);
+    check(keys);
+    check(hashed);
+    check(bits);
+
+    // the dispatched kernel, AVX2 where the CPU has it, agrees with the scalar one
+    std::vector<uint64_t> scalar(3);
+    std::vector<uint64_t> dispatched(3);
+    SparseHasBatchScalar(keys.RawSparse().Data(), keys.RawSparse().Size(), keys.Size(), batch.data(), batch.size(), scalar.data());
+    SparseHasBatch(keys.RawSparse().Data(), keys.RawSparse().Size(), keys.Size(), batch.data(), batch.size(), dispatched.data());
+    EXPECT_EQ(scalar, dispatched);
+}
+
+// -------------------------
+// Archetype storage tests
+// -------------------------
+#include <ArchetypeRegistry.h>
+
+TEST(ArchetypeTest, RowsMoveBetweenArchetypesAndKeepTheirValues)
+{
+    ArchetypeRegistry registry;
+    std::vector<Entity> entities;
+    for (int i = 0; i < 3000; ++i)
+    {
+        Entity e = registry.Create();
+        entities.push_back(e);
+        registry.Emplace<Position>(e, i, -i);
+        if (i % 2 == 0) registry.Emplace<Velocity>(e, float(i), 0.0f);
+        if (i % 3 == 0) registry.Emplace<Name>(e, "entity " + std::to_string(i));
+    }
+    // empty, P, PV, PN and PVN, every later move goes through a cached edge
+    EXPECT_EQ(registry.ArchetypeCount(), 5u);
+
+    for (int i = 0; i < 3000; ++i)
+    {
+        if (i % 4 == 0) registry.Remove<Velocity>(entities[i]);
+        if (i % 7 == 0) registry.Destroy(entities[i]);
+    }
+    registry.Emplace<Enemy>(entities[1]);
+    registry.Emplace<Position>(entities[1], 10, 20);
+    EXPECT_EQ(registry.ArchetypeCount(), 6u);
+
+    size_t expected = 0;
+    for (int i = 0; i < 3000; ++i)
+    {
+        Entity e = entities[i];
+        if (i % 7 == 0)
+        {
+            EXPECT_FALSE(registry.Has<Position>(e));
+            continue;
+        }
+        bool moving = i % 2 == 0 && i % 4 != 0;
+        expected += moving;
+        ASSERT_TRUE(registry.Has<Position>(e));
+        EXPECT_EQ(registry.Has<Velocity>(e), moving);
+        EXPECT_EQ(registry.Has<Name>(e), i % 3 == 0);
+        if (i != 1)
+        {
+            EXPECT_EQ(registry.Get<Position>(e).y, -i);
+        }
+        if (moving)
+        {
+            EXPECT_EQ(registry.Get<Velocity>(e).vx, float(i));
+        }
+        if (i % 3 == 0)
+        {
+            EXPECT_EQ(registry.Get<Name>(e).value, "entity " + std::to_string(i));
+        }
+    }
+    EXPECT_EQ(registry.Get<Position>(entities[1]).x, 10);
+
+    size_t visited = 0;
+    registry.View<Position, Velocity>().each([&](Position& p, Velocity& v) {
+        EXPECT_EQ(float(p.x), v.vx);
+        ++visited;
+        });
+    EXPECT_EQ(visited, expected);
+
+    std::vector<Entity> enemies;
+    registry.View<Enemy, Position>().each([](Position& p) { p.y = 0; });
+    for (Entity e : registry.View<Enemy, Position>())
+        enemies.push_back(e);
+    EXPECT_EQ(enemies, std::vector<Entity>{ entities[1] });
+    EXPECT_EQ(registry.Get<Position>(entities[1]).y, 0);
+}
+
+TEST(ArchetypeTest, CloneIsIndependent)
+{
+    ArchetypeRegistry registry;
+    Entity a = registry.Create();
+    Entity b = registry.Create();
+    registry.Emplace<Position>(a, 1, 2);
+    registry.Emplace<Name>(a, "a");
+    registry.Emplace<Enemy>(b);
+    registry.SetResource<GameTime>(0.5f, 3);
+
+    ArchetypeRegistry copy = registry.Clone();
+    copy.Get<Position>(a).x = 100;
+    copy.Emplace<Velocity>(a, 1.0f, 1.0f);
+    copy.Remove<Enemy>(b);
+
+    EXPECT_EQ(registry.Get<Position>(a).x, 1);
+    EXPECT_FALSE(registry.Has<Velocity>(a));
+    EXPECT_TRUE(registry.Has<Enemy>(b));
+    EXPECT_EQ(copy.Get<Position>(a).x, 100);
+    EXPECT_EQ(copy.Get<Name>(a).value, "a");
+    EXPECT_FALSE(copy.Has<Enemy>(b));
+    EXPECT_EQ(copy.Resource<GameTime>()->frame, 3);
+}
+
 int main(int argc, char** argv) 
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -1,13 +1,165 @@
 #ifndef COMPOSIA_H
 #define COMPOSIA_H
 
-#include <cstdint>
-#include <cstddef>
+#include <cstring>
 #include <algorithm>
+#include <atomic> // std::atomic
+#include <cstdint> // uint64_t
+#include <mutex> // std::mutex, std::lock_guard
+#include <string_view> // std::string_view
+
+// Hot-path counters. The premake Debug and Release configurations define COMPOSIA_INSTRUMENTATION,
+// except for the Benchmarks' Release; without it (Dist, or the amalgamated header on its own)
+// COMPOSIA_COUNT expands to nothing and its arguments are never evaluated.
+#if defined(COMPOSIA_INSTRUMENTATION)
+	#define COMPOSIA_COUNT(counter, amount) ::Composia::Core::Instrumentation::Add(::Composia::Core::Counter::counter, (amount))
+#else
+	#define COMPOSIA_COUNT(counter, amount) ((void)0)
+#endif
+
+namespace Composia::Core {
+
+	enum class Counter : uint32_t
+	{
+		ArrayReallocations, // DynamicArray::Reserve moving elements to a new buffer
+		ArrayBytesMoved,    // bytes copied by those reallocations
+		SparseResizes,      // SparseSet sparse array growths
+		ViewCandidates,     // pivot entities tested by views
+		ViewAccepted,       // candidates that owned every component
+		PoolMapLookups,
+		PoolMapProbes,      // buckets visited by those lookups, probes / lookups is the mean probe length
+		Count
+	};
+
+	inline constexpr size_t COUNTER_COUNT = static_cast<size_t>(Counter::Count);
+
+	struct CounterValues
+	{
+		uint64_t values[COUNTER_COUNT] = {};
+
+		[[nodiscard]] inline uint64_t operator[](Counter counter) const noexcept
+		{
+			return values[static_cast<size_t>(counter)];
+		}
+
+		[[nodiscard]] static constexpr std::string_view Name(Counter counter) noexcept
+		{
+			constexpr std::string_view names[COUNTER_COUNT] = {
+				"ArrayReallocations", "ArrayBytesMoved", "SparseResizes",
+				"ViewCandidates", "ViewAccepted", "PoolMapLookups", "PoolMapProbes"
+			};
+			return names[static_cast<size_t>(counter)];
+		}
+	};
+
+	// Every thread counts into its own block, so Add is a plain load and store without a lock prefix.
+	// Snapshot sums the blocks of live threads and of threads that already exited. Reset only moves a
+	// baseline, which keeps it safe while other threads are counting.
+	class Instrumentation
+	{
+	public:
+	#if defined(COMPOSIA_INSTRUMENTATION)
+		static constexpr bool Enabled = true;
+	#else
+		static constexpr bool Enabled = false;
+	#endif
+
+		static inline void Add(Counter counter, uint64_t amount) noexcept
+		{
+			std::atomic<uint64_t>& value = Local().values[static_cast<size_t>(counter)];
+			value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+		}
+
+		// Totals over all threads since the last Reset, e.g. taken once per frame
+		[[nodiscard]] static CounterValues Snapshot()
+		{
+			Shared& shared = State();
+			std::lock_guard lock(shared.mutex);
+
+			CounterValues totals = Totals(shared);
+			for (size_t i = 0; i < COUNTER_COUNT; ++i)
+				totals.values[i] -= shared.baseline.values[i];
+			return totals;
+		}
+
+		static void Reset()
+		{
+			Shared& shared = State();
+			std::lock_guard lock(shared.mutex);
+			shared.baseline = Totals(shared);
+		}
+
+	private:
+		struct ThreadBlock;
+
+		struct Shared
+		{
+			std::mutex mutex;
+			ThreadBlock* head = nullptr;
+			CounterValues retired;
+			CounterValues baseline;
+		};
+
+		struct ThreadBlock
+		{
+			std::atomic<uint64_t> values[COUNTER_COUNT] = {};
+			ThreadBlock* next = nullptr;
+
+			ThreadBlock()
+			{
+				Shared& shared = State();
+				std::lock_guard lock(shared.mutex);
+				next = shared.head;
+				shared.head = this;
+			}
+
+			~ThreadBlock()
+			{
+				Shared& shared = State();
+				std::lock_guard lock(shared.mutex);
+				for (size_t i = 0; i < COUNTER_COUNT; ++i)
+					shared.retired.values[i] += values[i].load(std::memory_order_relaxed);
+
+				ThreadBlock** link = &shared.head;
+				while (*link != this)
+					link = &(*link)->next;
+				*link = next;
+			}
+		};
+
+		static Shared& State() noexcept
+		{
+			static Shared shared;
+			return shared;
+		}
+
+		static ThreadBlock& Local() noexcept
+		{
+			thread_local ThreadBlock block;
+			return block;
+		}
+
+		static CounterValues Totals(const Shared& shared) noexcept
+		{
+			CounterValues totals = shared.retired;
+			for (const ThreadBlock* block = shared.head; block; block = block->next)
+			{
+				for (size_t i = 0; i < COUNTER_COUNT; ++i)
+					totals.values[i] += block->values[i].load(std::memory_order_relaxed);
+			}
+			return totals;
+		}
+	};
+
+} // namespace Composia::Core
+
+#include <cstddef>
 #include <new>       // operator new / delete
 #include <utility>   // std::move, std::forward
 #include <cassert> // assert
 #include <type_traits> // std::is_trivially_destructible_v
+#include <memory> // std::shared_ptr
+
 
 namespace Composia::Core {
 
@@ -21,11 +173,129 @@ namespace Composia::Core {
 			m_Data = static_cast<T*>(operator new(m_Capacity * sizeof(T)));
 		}
 
+		DynamicArray(const DynamicArray& other)
+			: m_Capacity(other.m_Size), m_Size(0), m_GrowMultiplier(other.m_GrowMultiplier), m_Data(nullptr)
+		{
+			m_Data = static_cast<T*>(operator new(m_Capacity * sizeof(T)));
+			CopyElements(other);
+		}
+
+		DynamicArray(DynamicArray&& other) noexcept
+			: m_Capacity(other.m_Capacity), m_Size(other.m_Size), m_GrowMultiplier(other.m_GrowMultiplier),
+			m_Data(other.m_Data), m_Owner(std::move(other.m_Owner)), m_CopyOnWrite(other.m_CopyOnWrite)
+		{
+			other.m_Capacity = 0;
+			other.m_Size = 0;
+			other.m_Data = nullptr;
+			other.m_CopyOnWrite = false;
+		}
+
+		DynamicArray& operator=(const DynamicArray& other)
+		{
+			if (this != &other)
+			{
+				Clear();
+				if (other.m_Size > m_Capacity || m_Owner)
+				{
+					Release();
+					m_Capacity = other.m_Size;
+					m_Data = static_cast<T*>(operator new(m_Capacity * sizeof(T)));
+				}
+				m_GrowMultiplier = other.m_GrowMultiplier;
+				CopyElements(other);
+			}
+			return *this;
+		}
+
+		DynamicArray& operator=(DynamicArray&& other) noexcept
+		{
+			if (this != &other)
+			{
+				Release();
+				m_Capacity = other.m_Capacity;
+				m_Size = other.m_Size;
+				m_GrowMultiplier = other.m_GrowMultiplier;
+				m_Data = other.m_Data;
+				m_Owner = std::move(other.m_Owner);
+				m_CopyOnWrite = other.m_CopyOnWrite;
+
+				other.m_Capacity = 0;
+				other.m_Size = 0;
+				other.m_Data = nullptr;
+				other.m_CopyOnWrite = false;
+			}
+			return *this;
+		}
+
 		~DynamicArray()
 		{
-			for (size_t i = 0; i < m_Size; ++i)
-				m_Data[i].~T();
-			operator delete(m_Data);
+			Release();
+		}
+
+		// Uses size elements at data in place instead of an owned buffer, owner keeps that memory alive.
+		// Elements may be written in place; the first growth copies them to an owned buffer.
+		void Adopt(T* data, size_t size, std::shared_ptr<const void> owner)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable elements can live in borrowed memory");
+
+			Release();
+			m_Data = data;
+			m_Size = size;
+			m_Capacity = size;
+			m_Owner = std::move(owner);
+		}
+
+		// True while the elements live in memory adopted through Adopt or shared through Share
+		inline bool Borrowed() const noexcept
+		{
+			return m_Owner != nullptr;
+		}
+
+		// Returns an array reading the same elements without copying them. Both arrays are copy-on-write
+		// from then on: their owners have to call Detach before modifying them in any way other than growing.
+		// Arrays of non trivially copyable elements are copied right away.
+		DynamicArray Share()
+		{
+			if constexpr (!std::is_trivially_copyable_v<T>)
+			{
+				return DynamicArray(*this);
+			}
+			else
+			{
+				// hand the buffer over to an owner both arrays keep alive
+				if (!m_Owner)
+					m_Owner = std::shared_ptr<const void>(m_Data, [](const void* data) { operator delete(const_cast<void*>(data)); });
+				m_Capacity = m_Size;
+				m_CopyOnWrite = true;
+
+				DynamicArray shared(0);
+				shared.Release();
+				shared.m_Capacity = m_Size;
+				shared.m_Size = m_Size;
+				shared.m_GrowMultiplier = m_GrowMultiplier;
+				shared.m_Data = m_Data;
+				shared.m_Owner = m_Owner;
+				shared.m_CopyOnWrite = true;
+				return shared;
+			}
+		}
+
+		// Copies shared elements to an owned buffer, a no-op unless the array came out of Share. Once
+		// every other array sharing them was detached or destroyed the elements are taken over as they are.
+		inline void Detach()
+		{
+			if (m_CopyOnWrite) [[unlikely]]
+			{
+				if (m_Owner.use_count() == 1)
+					m_CopyOnWrite = false;
+				else
+					Reserve(m_Capacity + 1);
+			}
+		}
+
+		inline bool Shared() const noexcept
+		{
+			return m_CopyOnWrite;
 		}
 
 		inline void PushBack(const T& value) noexcept
@@ -94,6 +364,12 @@ namespace Composia::Core {
 			return m_Size;
 		}
 
+		// Bytes Compact would give back
+		[[nodiscard]] inline size_t CompactBytes() const noexcept
+		{
+			return CompactMoves() == 0 ? 0 : (m_Capacity - (m_Size + m_Size / 4)) * sizeof(T);
+		}
+
 		inline size_t Capacity() const noexcept
 		{
 			return m_Capacity;
@@ -107,25 +383,27 @@ namespace Composia::Core {
 		void Reserve(size_t newCapacity)
 		{
 			if (newCapacity <= m_Capacity) return;
-			T* newPtr = static_cast<T*>(operator new(newCapacity * sizeof(T)));
+			Reallocate(newCapacity);
+		}
 
-			if constexpr (std::is_trivially_copyable_v<T>)
-			{
-				memcpy(newPtr, m_Data, m_Size * sizeof(T));
-			}
-			else
-			{
-				for (size_t i = 0; i < m_Size; ++i)
-				{
-					new (&newPtr[i]) T(std::move(m_Data[i]));
-					if constexpr (!std::is_trivially_destructible_v<T>)
-						m_Data[i].~T();
-				}
-			}
+		// Gives capacity back once less than half of it is used, keeping a quarter of the size as headroom
+		// so an array that shrank does not bounce between growing and shrinking. Arrays smaller than a page
+		// and borrowed arrays are left alone. Returns the bytes released.
+		size_t Compact()
+		{
+			size_t released = CompactBytes();
+			if (released != 0)
+				Reallocate(m_Size + m_Size / 4);
+			return released;
+		}
 
-			operator delete(m_Data);
-			m_Data = newPtr;
-			m_Capacity = newCapacity;
+		// Elements Compact would move, 0 when it would leave the array as it is
+		[[nodiscard]] inline size_t CompactMoves() const noexcept
+		{
+			size_t target = m_Size + m_Size / 4;
+			if (m_Owner || m_Capacity <= 2 * m_Size || (m_Capacity - target) * sizeof(T) < COMPACT_MIN_BYTES)
+				return 0;
+			return m_Size;
 		}
 
 		void Resize(size_t newSize)
@@ -229,7 +507,7 @@ namespace Composia::Core {
 			return m_GrowMultiplier;
 		}
 
-		inline void GrowMultiplier(uint8_t newMultipier) noexcept
+		inline void GrowMultiplier(uint8_t newMultiplyer) noexcept
 		{
 			if (newMultiplyer <= 1) return;
 			m_GrowMultiplier = newMultiplyer;
@@ -242,27 +520,402 @@ namespace Composia::Core {
 		const T* end() const noexcept { return m_Data + m_Size; }
 
 	private:
+		inline void Release() noexcept
+		{
+			for (size_t i = 0; i < m_Size; ++i)
+				m_Data[i].~T();
+			if (!m_Owner)
+				operator delete(m_Data);
+			m_Owner.reset();
+			m_CopyOnWrite = false;
+		}
+
+		inline void CopyElements(const DynamicArray& other)
+		{
+			if constexpr (std::is_trivially_copyable_v<T>)
+			{
+				if (other.m_Size > 0)
+					memcpy(m_Data, other.m_Data, other.m_Size * sizeof(T));
+			}
+			else
+			{
+				for (size_t i = 0; i < other.m_Size; ++i)
+					new (&m_Data[i]) T(other.m_Data[i]);
+			}
+			m_Size = other.m_Size;
+		}
+
+		void Reallocate(size_t newCapacity)
+		{
+			T* newPtr = static_cast<T*>(operator new(newCapacity * sizeof(T)));
+			COMPOSIA_COUNT(ArrayReallocations, 1);
+			COMPOSIA_COUNT(ArrayBytesMoved, m_Size * sizeof(T));
+
+			if constexpr (std::is_trivially_copyable_v<T>)
+			{
+				memcpy(newPtr, m_Data, m_Size * sizeof(T));
+			}
+			else
+			{
+				for (size_t i = 0; i < m_Size; ++i)
+				{
+					new (&newPtr[i]) T(std::move(m_Data[i]));
+					if constexpr (!std::is_trivially_destructible_v<T>)
+						m_Data[i].~T();
+				}
+			}
+
+			if (!m_Owner)
+				operator delete(m_Data);
+			m_Owner.reset();
+			m_CopyOnWrite = false;
+			m_Data = newPtr;
+			m_Capacity = newCapacity;
+		}
+
 		inline void Grow() noexcept
 		{
 			size_t newCapacity = m_Capacity != 0 ? m_Capacity * m_GrowMultiplier : 1;
 			Reserve(newCapacity);
 		}
 
+		static constexpr size_t COMPACT_MIN_BYTES = 4096;
+
 		size_t m_Capacity;
 		size_t m_Size;
 		uint8_t m_GrowMultiplier;
 		T* m_Data;
+		std::shared_ptr<const void> m_Owner;
+		bool m_CopyOnWrite = false;
+	};
+
+	// Work allowance of one budgeted compaction pass, shared by every array it visits. work counts the
+	// elements scanned or moved so far; a step may run COMPACT_STEP elements past budget, so every pass
+	// makes progress however small budget is, but never further.
+	struct CompactBudget
+	{
+		static constexpr size_t COMPACT_STEP = 1024;
+
+		size_t budget = SIZE_MAX;
+		size_t work = 0;
+		size_t released = 0;
+		size_t deferred = 0; // bytes the skipped steps would have given back
+
+		// Elements that may still be scanned or moved in this pass
+		[[nodiscard]] inline size_t Left() const noexcept
+		{
+			size_t limit = budget < SIZE_MAX - COMPACT_STEP ? budget + COMPACT_STEP : SIZE_MAX;
+			return work < limit ? limit - work : 0;
+		}
+
+		// Whether the pass should stop before starting on another array
+		[[nodiscard]] inline bool Spent() const noexcept
+		{
+			return work >= budget;
+		}
+
+		// Runs step, which moves that many elements to give back bytes, if it fits what is left. Returns
+		// false without running it when it would fit a fresh pass instead. A step larger than budget +
+		// COMPACT_STEP fits no pass of this budget: it is skipped and its bytes are counted as deferred.
+		template<typename Func>
+		bool Step(size_t moves, size_t bytes, Func&& step)
+		{
+			if (moves - std::min(moves, COMPACT_STEP) > budget)
+			{
+				deferred += bytes;
+				return true;
+			}
+			if (moves > Left())
+				return false;
+
+			step();
+			work += moves;
+			released += bytes;
+			return true;
+		}
+
+		// Reallocates array smaller as one Step, see DynamicArray::Compact
+		template<typename T>
+		bool Compact(DynamicArray<T>& array)
+		{
+			size_t moves = array.CompactMoves();
+			if (moves == 0)
+				return true;
+			return Step(moves, array.CompactBytes(), [&] { array.Compact(); });
+		}
 	};
 
 } // namespace Composia::Core 
 
+
+#if defined(_MSC_VER) && !defined(__clang__) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h> // _mm_prefetch
+#endif
+
+namespace Composia::Core {
+
+	// How many keys ahead batched lookups start loading. Sparse slots are fetched at twice this
+	// distance, so their dense index is cached by the time the dense slot is fetched at this one.
+	inline constexpr size_t PREFETCH_DISTANCE = 16;
+
+	// Asks for the cache line holding address to be loaded, a hint that never faults
+	inline void Prefetch(const void* address) noexcept
+	{
+	#if defined(__GNUC__) || defined(__clang__)
+		__builtin_prefetch(address, 0, 3);
+	#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		_mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+	#else
+		(void)address;
+	#endif
+	}
+
+} // namespace Composia::Core
+
+
+// AVX2 kernels are compiled for their own target and only called once the CPU reports AVX2,
+// so the library itself keeps building for baseline x86-64
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define COMPOSIA_AVX2_DISPATCH
+#define COMPOSIA_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define COMPOSIA_AVX2_DISPATCH
+#define COMPOSIA_TARGET_AVX2
+#include <intrin.h> // __cpuid, _xgetbv
+#endif
+
+namespace Composia::Core {
+
+	// Detected once, true if both the CPU and the OS (saving ymm registers) support AVX2
+	inline bool CpuHasAvx2() noexcept
+	{
+	#if defined(COMPOSIA_AVX2_DISPATCH) && defined(_MSC_VER) && !defined(__clang__)
+		static const bool hasAvx2 = [] {
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7)
+				return false;
+
+			__cpuid(info, 1);
+			bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+			__cpuid(info, 7);
+			return osSavesYmm && (info[1] & (1 << 5)) != 0;
+			}();
+		return hasAvx2;
+	#elif defined(COMPOSIA_AVX2_DISPATCH)
+		static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+		return hasAvx2;
+	#else
+		return false;
+	#endif
+	}
+
+	// Sets bit i of mask (64 keys per word) when keys[i] has a sparse slot below size, the
+	// membership test of a sparse set. Every word the count keys span is overwritten.
+	inline void SparseHasBatchScalar(const uint32_t* sparse, size_t sparseSize, size_t size,
+		const uint32_t* keys, size_t count, uint64_t* mask) noexcept
+	{
+		std::fill(mask, mask + (count + 63) / 64, 0);
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint32_t k = keys[i];
+			bool has = k < sparseSize && sparse[k] < size;
+			mask[i / 64] |= uint64_t(has) << (i % 64);
+		}
+	}
+
+	#if defined(COMPOSIA_AVX2_DISPATCH)
+	// Eight keys per step: one masked gather loads their sparse slots, keys outside the sparse
+	// array load nothing and read as invalid. sparseSize must fit a signed gather index.
+	COMPOSIA_TARGET_AVX2 inline void SparseHasBatchAvx2(const uint32_t* sparse, size_t sparseSize, size_t size,
+		const uint32_t* keys, size_t count, uint64_t* mask) noexcept
+	{
+		std::fill(mask, mask + (count + 63) / 64, 0);
+
+		// unsigned compares are signed ones with the sign bits flipped
+		const __m256i sign = _mm256_set1_epi32(INT32_MIN);
+		const __m256i sparseLimit = _mm256_set1_epi32(static_cast<int32_t>(static_cast<uint32_t>(sparseSize) ^ 0x80000000u));
+		const __m256i sizeLimit = _mm256_set1_epi32(static_cast<int32_t>(static_cast<uint32_t>(size) ^ 0x80000000u));
+		const __m256i invalid = _mm256_set1_epi32(-1);
+		const int* base = reinterpret_cast<const int*>(sparse);
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+			__m256i inSparse = _mm256_cmpgt_epi32(sparseLimit, _mm256_xor_si256(k, sign));
+			__m256i index = _mm256_mask_i32gather_epi32(invalid, base, k, inSparse, 4);
+			__m256i has = _mm256_cmpgt_epi32(sizeLimit, _mm256_xor_si256(index, sign));
+			uint64_t bits = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(has)));
+			mask[i / 64] |= bits << (i % 64);
+		}
+
+		for (; i < count; ++i)
+		{
+			uint32_t k = keys[i];
+			bool has = k < sparseSize && sparse[k] < size;
+			mask[i / 64] |= uint64_t(has) << (i % 64);
+		}
+	}
+	#endif
+
+	inline void SparseHasBatch(const uint32_t* sparse, size_t sparseSize, size_t size,
+		const uint32_t* keys, size_t count, uint64_t* mask) noexcept
+	{
+	#if defined(COMPOSIA_AVX2_DISPATCH)
+		if (sparseSize <= static_cast<size_t>(INT32_MAX) && CpuHasAvx2())
+		{
+			SparseHasBatchAvx2(sparse, sparseSize, size, keys, count, mask);
+			return;
+		}
+	#endif
+		SparseHasBatchScalar(sparse, sparseSize, size, keys, count, mask);
+	}
+
+} // namespace Composia::Core
+
+#include <numeric> // std::iota
+#include <tuple> // std::tuple, std::get
+
+
+namespace Composia::Core {
+
+	// Moves element order[i] of every array to index i. The permutation is followed cycle by cycle,
+	// so each array only ever holds one element aside instead of being copied. order ends up as the identity.
+	template<typename... Elements>
+	void PermuteInPlace(DynamicArray<uint32_t>& order, DynamicArray<Elements>&... arrays)
+	{
+		for (uint32_t start = 0; start < order.Size(); ++start)
+		{
+			if (order[start] == start)
+				continue;
+
+			std::tuple<Elements...> held(std::move(arrays[start])...);
+			uint32_t current = start;
+			while (order[current] != start)
+			{
+				uint32_t next = order[current];
+				((arrays[current] = std::move(arrays[next])), ...);
+				order[current] = current;
+				current = next;
+			}
+
+			[&]<size_t... I>(std::index_sequence<I...>) {
+				((arrays[current] = std::move(std::get<I>(held))), ...);
+			}(std::index_sequence_for<Elements...>{});
+			order[current] = current;
+		}
+	}
+
+	// Fills order with the indices of keys in ascending key order, stable for equal keys. LSD radix
+	// sort over 8 bit digits; digits every key shares (e.g. the high bytes of small keys) are skipped.
+	template<typename K>
+	void RadixOrder(const DynamicArray<K>& keys, DynamicArray<uint32_t>& order)
+	{
+		static_assert(std::is_integral_v<K>, "Radix sort keys must be integers");
+
+		using Unsigned = std::make_unsigned_t<K>;
+		// flipping the sign bit makes signed keys sort as unsigned ones
+		constexpr Unsigned SIGN = std::is_signed_v<K> ? Unsigned(Unsigned(1) << (sizeof(K) * 8 - 1)) : Unsigned(0);
+
+		struct Item
+		{
+			Unsigned key;
+			uint32_t index;
+		};
+
+		constexpr size_t DIGITS = sizeof(K);
+		size_t count = keys.Size();
+		DynamicArray<Item> items(count);
+		DynamicArray<Item> scratch(count);
+		items.Resize(count);
+		scratch.Resize(count);
+
+		// one pass counts every digit
+		DynamicArray<size_t> offsets(DIGITS * 256);
+		offsets.Resize(DIGITS * 256, 0);
+		for (size_t i = 0; i < count; ++i)
+		{
+			Unsigned key = static_cast<Unsigned>(static_cast<Unsigned>(keys[i]) ^ SIGN);
+			items[i] = Item{ key, static_cast<uint32_t>(i) };
+			for (size_t digit = 0; digit < DIGITS; ++digit)
+				++offsets[digit * 256 + ((key >> (digit * 8)) & 0xFF)];
+		}
+
+		for (size_t digit = 0; digit < DIGITS && count > 0; ++digit)
+		{
+			size_t* digitOffsets = offsets.Data() + digit * 256;
+			size_t shift = digit * 8;
+			if (digitOffsets[(items[0].key >> shift) & 0xFF] == count)
+				continue;
+
+			size_t total = 0;
+			for (size_t bucket = 0; bucket < 256; ++bucket)
+			{
+				size_t bucketCount = digitOffsets[bucket];
+				digitOffsets[bucket] = total;
+				total += bucketCount;
+			}
+
+			for (const Item& item : items)
+				scratch[digitOffsets[(item.key >> shift) & 0xFF]++] = item;
+			std::swap(items, scratch);
+		}
+
+		order.Clear();
+		order.Reserve(count);
+		for (const Item& item : items)
+			order.PushBack(item.index);
+	}
+
+} // namespace Composia::Core
+
 #include <limits> // std::numeric_limits
 
+
 using Composia::Core::DynamicArray;
 using Key = uint32_t;
 
 namespace Composia::Core {
 
+	// Scans a sparse array down from its end while its keys are absent, at most budget.Left() of them,
+	// and cuts it past the highest key found present, rounded up to 64. The cut keeps the progress of a
+	// scan that ran out of budget. Returns false when the highest present key was not reached yet.
+	template<typename HasFunc>
+	inline bool CutSparse(DynamicArray<uint32_t>& sparse, CompactBudget& budget, HasFunc&& has)
+	{
+		size_t size = sparse.Size();
+		size_t end = size - std::min(size, budget.Left());
+		size_t top = size;
+		while (top > end && !has(static_cast<Key>(top - 1)))
+			--top;
+		budget.work += size - top;
+
+		size_t cut = (top + 63) & ~size_t(63);
+		if (cut < size)
+			sparse.Resize(cut);
+		return top == 0 || top > end || has(static_cast<Key>(top - 1));
+	}
+
+	// True if sparse maps exactly the keys of packed to their positions. A sparse array read from a file
+	// is checked this way before it is used instead of rebuilt; every present entry naming a distinct
+	// key of packed and as many entries as keys means each key maps back to its own position.
+	inline bool SparseMatches(const DynamicArray<Key>& packed, const DynamicArray<uint32_t>& sparse) noexcept
+	{
+		size_t present = 0;
+		for (size_t k = 0; k < sparse.Size(); ++k)
+		{
+			uint32_t index = sparse[k];
+			if (index == std::numeric_limits<uint32_t>::max())
+				continue;
+			if (index >= packed.Size() || packed[index] != k)
+				return false;
+			++present;
+		}
+		return present == packed.Size();
+	}
+
 	template<typename T>
 	class SparseSet
 	{
@@ -293,6 +946,7 @@ namespace Composia::Core {
 			m_Sparse[k] = static_cast<uint32_t>(m_Dense.Size());
 			m_Dense.PushBack(value);
 			m_Packed.PushBack(k);
+			EnableLast();
 		}
 
 		template<typename... Args>
@@ -308,6 +962,7 @@ namespace Composia::Core {
 			m_Sparse[k] = static_cast<uint32_t>(m_Dense.Size());
 			m_Dense.EmplaceBack(std::forward<Args>(args)...);
 			m_Packed.PushBack(k);
+			EnableLast();
 		}
 
 		inline void Remove(Key k)
@@ -317,6 +972,13 @@ namespace Composia::Core {
 			uint32_t denseRemovedIndex = m_Sparse[k];
 			uint32_t denseLastIndex = static_cast<uint32_t>(m_Dense.Size() - 1);
 
+			// an enabled element first trades places with the last enabled one, keeping the partition
+			if (denseRemovedIndex < m_Enabled && --m_Enabled != denseLastIndex)
+			{
+				Swap(denseRemovedIndex, m_Enabled);
+				denseRemovedIndex = m_Enabled;
+			}
+
 			// move last element into removed slot
 			m_Dense[denseRemovedIndex] = std::move(m_Dense[denseLastIndex]);
 			Key movedKey = m_Packed[denseLastIndex];
@@ -336,6 +998,139 @@ namespace Composia::Core {
 			return &m_Dense[m_Sparse[k]];
 		}
 
+		// Has for count keys at once, bit i of mask (64 keys per word) is set when keys[i] is in the
+		// set. Uses AVX2 gathers when the CPU has them, see Core::SparseHasBatch.
+		inline void HasBatch(const Key* keys, size_t count, uint64_t* mask) const noexcept
+		{
+			SparseHasBatch(m_Sparse.Data(), m_Sparse.Size(), m_Dense.Size(), keys, count, mask);
+		}
+
+		// Two step prefetch for batched lookups: the sparse slot first, then once that is cached the
+		// dense slot it points at. Keys outside the set are ignored.
+		inline void PrefetchSparse(Key k) const noexcept
+		{
+			if (k < m_Sparse.Size())
+				Prefetch(m_Sparse.Data() + k);
+		}
+
+		inline void PrefetchDense(Key k) const noexcept
+		{
+			if (k < m_Sparse.Size() && m_Sparse[k] < m_Dense.Size())
+				Prefetch(m_Dense.Data() + m_Sparse[k]);
+		}
+
+		// Packed order is split into enabled keys followed by disabled ones. Both calls swap k
+		// across the boundary, so they are O(1) and only move k and one other element.
+		inline void Disable(Key k) noexcept
+		{
+			if (!Has(k) || m_Sparse[k] >= m_Enabled) return;
+			Swap(m_Sparse[k], --m_Enabled);
+		}
+
+		inline void Enable(Key k) noexcept
+		{
+			if (!Has(k) || m_Sparse[k] < m_Enabled) return;
+			Swap(m_Sparse[k], m_Enabled++);
+		}
+
+		[[nodiscard]] inline bool IsEnabled(Key k) const noexcept
+		{
+			return Has(k) && m_Sparse[k] < m_Enabled;
+		}
+
+		inline void Reserve(size_t capacity)
+		{
+			m_Dense.Reserve(capacity);
+			m_Packed.Reserve(capacity);
+		}
+
+		// Cuts the sparse array past the highest key and gives back spare capacity, see DynamicArray::Compact.
+		// Stays within budget and returns false when it has to be called again to finish.
+		bool Compact(CompactBudget& budget)
+		{
+			return CutSparse(m_Sparse, budget, [this](Key k) { return Has(k); }) &&
+				budget.Compact(m_Sparse) && budget.Compact(m_Packed) && budget.Compact(m_Dense);
+		}
+
+		// Renames every key k to remap[k] and rebuilds the sparse array for keys below keyCount
+		void Remap(const DynamicArray<Key>& remap, size_t keyCount)
+		{
+			for (Key& k : m_Packed)
+			{
+				assert(k < remap.Size() && remap[k] < keyCount && "Key missing from the remap table");
+				k = remap[k];
+			}
+
+			m_Sparse = DynamicArray<uint32_t>(keyCount);
+			m_Sparse.Resize(keyCount, INVALID_INDEX);
+			for (uint32_t i = 0; i < m_Packed.Size(); ++i)
+				m_Sparse[m_Packed[i]] = i;
+		}
+
+		// Copy that shares all arrays with this set, see DynamicArray::Share
+		SparseSet Share()
+		{
+			SparseSet shared(0);
+			shared.m_Dense = m_Dense.Share();
+			shared.m_Sparse = m_Sparse.Share();
+			shared.m_Packed = m_Packed.Share();
+			shared.m_Enabled = m_Enabled;
+			return shared;
+		}
+
+		// Must be called before modifying a set that came out of Share
+		inline void Detach()
+		{
+			m_Dense.Detach();
+			m_Sparse.Detach();
+			m_Packed.Detach();
+		}
+
+		inline void Clear()
+		{
+			for (Key k : m_Packed)
+				m_Sparse[k] = INVALID_INDEX;
+			m_Dense.Clear();
+			m_Packed.Clear();
+			m_Enabled = 0;
+		}
+
+		// Takes over packed keys and their values, then rebuilds the sparse array in a single pass
+		void Assign(DynamicArray<Key>&& packed, DynamicArray<T>&& dense) noexcept
+		{
+			m_Packed = std::move(packed);
+			m_Dense = std::move(dense);
+			m_Enabled = static_cast<uint32_t>(m_Packed.Size());
+			RebuildSparse();
+		}
+
+		// Same as above with a sparse array that already matches packed, nothing is rebuilt
+		void Assign(DynamicArray<Key>&& packed, DynamicArray<T>&& dense, DynamicArray<uint32_t>&& sparse) noexcept
+		{
+			m_Packed = std::move(packed);
+			m_Dense = std::move(dense);
+			m_Sparse = std::move(sparse);
+			m_Enabled = static_cast<uint32_t>(m_Packed.Size());
+		}
+
+		// Position of k in the packed order, k must be in the set
+		[[nodiscard]] inline uint32_t Index(Key k) const noexcept
+		{
+			return m_Sparse[k];
+		}
+
+		// Moves the element at packed index order[i] to index i
+		void Permute(DynamicArray<uint32_t>& order)
+		{
+			// only rows that move need their sparse entry rewritten
+			for (uint32_t i = 0; i < order.Size(); ++i)
+			{
+				if (order[i] != i)
+					m_Sparse[m_Packed[order[i]]] = i;
+			}
+			PermuteInPlace(order, m_Packed, m_Dense);
+		}
+
 		[[nodiscard]] const DynamicArray<T>& RawDense() const noexcept
 		{
 			return m_Dense;
@@ -346,14 +1141,41 @@ namespace Composia::Core {
 			return m_Packed;
 		}
 
+		[[nodiscard]] inline const DynamicArray<uint32_t>& RawSparse() const noexcept
+		{
+			return m_Sparse;
+		}
+
 		[[nodiscard]] inline size_t Size() const noexcept
 		{
 			return m_Dense.Size();
 		}
 
+		// Number of enabled keys, which come first in the packed order
+		[[nodiscard]] inline size_t EnabledSize() const noexcept
+		{
+			return m_Enabled;
+		}
+
 	private:
 		static constexpr Key INVALID_INDEX = std::numeric_limits<Key>::max();
 
+		inline void Swap(uint32_t a, uint32_t b) noexcept
+		{
+			if (a == b) return;
+
+			std::swap(m_Dense[a], m_Dense[b]);
+			std::swap(m_Packed[a], m_Packed[b]);
+			m_Sparse[m_Packed[a]] = a;
+			m_Sparse[m_Packed[b]] = b;
+		}
+
+		// Moves a key just appended in front of the disabled ones
+		inline void EnableLast() noexcept
+		{
+			Swap(m_Enabled++, static_cast<uint32_t>(m_Packed.Size() - 1));
+		}
+
 		inline void EnsureSparseSize(Key k) noexcept
 		{
 			if (k >= m_Sparse.Size())
@@ -362,675 +1184,6149 @@ namespace Composia::Core {
 				while (k >= newCapacity)
 					newCapacity *= 2;
 
+				COMPOSIA_COUNT(SparseResizes, 1);
 				m_Sparse.Resize(newCapacity, INVALID_INDEX);
 			}
 		}
 
+		inline void RebuildSparse() noexcept
+		{
+			for (uint32_t& index : m_Sparse)
+				index = INVALID_INDEX;
+
+			for (size_t i = 0; i < m_Packed.Size(); ++i)
+			{
+				EnsureSparseSize(m_Packed[i]);
+				m_Sparse[m_Packed[i]] = static_cast<uint32_t>(i);
+			}
+		}
+
 		DynamicArray<T> m_Dense;
 		DynamicArray<uint32_t> m_Sparse;
 		DynamicArray<Key> m_Packed;
-
+		uint32_t m_Enabled = 0;
 	};
 
-} // namespace Composia::Core 
+	// Key-only sparse set, used where membership is all that has to be tracked.
+	template<>
+	class SparseSet<void>
+	{
+	public:
+		SparseSet(size_t reserveSize = 1024)
+		{
+			m_Sparse.Resize(reserveSize, INVALID_INDEX);
+			m_Packed.Reserve(reserveSize);
+		}
 
-#include <cstdint> // uint32_t
+		inline bool Has(Key k) const noexcept
+		{
+			return k < m_Sparse.Size() &&
+				m_Sparse[k] != INVALID_INDEX &&
+				m_Sparse[k] < m_Packed.Size();
+		}
 
-namespace Composia {
+		inline void Add(Key k) noexcept
+		{
+			EnsureSparseSize(k);
+			if (Has(k)) return;
 
-	using Entity = uint32_t;
-	static constexpr Entity INVALID_ENTITY = std::numeric_limits<Entity>::max();
+			m_Sparse[k] = static_cast<uint32_t>(m_Packed.Size());
+			m_Packed.PushBack(k);
+			EnableLast();
+		}
 
-} // namespace Composia
+		inline void Remove(Key k) noexcept
+		{
+			if (!Has(k)) return;
 
-#include <vector>
-using Composia::Core::DynamicArray;
+			uint32_t removedIndex = m_Sparse[k];
+			uint32_t lastIndex = static_cast<uint32_t>(m_Packed.Size() - 1);
+			if (removedIndex < m_Enabled && --m_Enabled != lastIndex)
+			{
+				Swap(removedIndex, m_Enabled);
+				removedIndex = m_Enabled;
+			}
 
-namespace Composia {
+			Key movedKey = m_Packed.Back();
+			m_Packed[removedIndex] = movedKey;
+			m_Sparse[movedKey] = removedIndex;
 
-	class EntityManager
-	{
-	public:
-		EntityManager(size_t initialCapacity = 4096)
+			m_Packed.PopBack();
+			m_Sparse[k] = INVALID_INDEX;
+		}
+
+		inline void HasBatch(const Key* keys, size_t count, uint64_t* mask) const noexcept
 		{
-			m_Generations.Reserve(initialCapacity);
-			m_Alive.reserve(initialCapacity);
-			m_FreeList.Reserve(initialCapacity);
+			SparseHasBatch(m_Sparse.Data(), m_Sparse.Size(), m_Packed.Size(), keys, count, mask);
 		}
 
-		inline Entity Create() noexcept
+		inline void PrefetchSparse(Key k) const noexcept
 		{
-			if (!m_FreeList.Empty())
-			{
-				Entity removedEntity = m_FreeList.Back();
-				m_FreeList.PopBack();
+			if (k < m_Sparse.Size())
+				Prefetch(m_Sparse.Data() + k);
+		}
 
-				m_Generations[removedEntity]++;
-				m_Alive[removedEntity] = true;
-				return removedEntity;
-			}
+		// Keys only, there is no dense slot to fetch
+		inline void PrefetchDense(Key) const noexcept {}
 
-			Entity id = static_cast<Entity>(m_Generations.Size());
-			m_Generations.PushBack(0);
-			m_Alive.push_back(true);
-			return id;
+		inline void Disable(Key k) noexcept
+		{
+			if (!Has(k) || m_Sparse[k] >= m_Enabled) return;
+			Swap(m_Sparse[k], --m_Enabled);
 		}
 
-		inline bool IsAlive(Entity e) const noexcept
+		inline void Enable(Key k) noexcept
 		{
-			return e < m_Generations.Size() && m_Alive[e];
+			if (!Has(k) || m_Sparse[k] < m_Enabled) return;
+			Swap(m_Sparse[k], m_Enabled++);
 		}
 
-		inline void Destroy(Entity e) noexcept
+		[[nodiscard]] inline bool IsEnabled(Key k) const noexcept
 		{
-			if (!IsAlive(e)) return;
-
-			m_Alive[e] = false;
-			m_FreeList.PushBack(e);
+			return Has(k) && m_Sparse[k] < m_Enabled;
 		}
 
-		inline uint32_t Generation(Entity e) const noexcept
+		inline void Reserve(size_t capacity)
 		{
-			return e < m_Generations.Size() ? m_Generations.At(e) : 0;
+			m_Packed.Reserve(capacity);
 		}
 
-	private:
-		DynamicArray<uint32_t> m_Generations;
-		std::vector<bool> m_Alive;
-		DynamicArray<Entity> m_FreeList;
-	};
+		bool Compact(CompactBudget& budget)
+		{
+			return CutSparse(m_Sparse, budget, [this](Key k) { return Has(k); }) &&
+				budget.Compact(m_Sparse) && budget.Compact(m_Packed);
+		}
 
-} // namespace Composia 
+		void Remap(const DynamicArray<Key>& remap, size_t keyCount)
+		{
+			for (Key& k : m_Packed)
+			{
+				assert(k < remap.Size() && remap[k] < keyCount && "Key missing from the remap table");
+				k = remap[k];
+			}
 
-using Composia::Core::SparseSet;
+			m_Sparse = DynamicArray<uint32_t>(keyCount);
+			m_Sparse.Resize(keyCount, INVALID_INDEX);
+			for (uint32_t i = 0; i < m_Packed.Size(); ++i)
+				m_Sparse[m_Packed[i]] = i;
+		}
 
-namespace Composia {
+		SparseSet Share()
+		{
+			SparseSet shared(0);
+			shared.m_Sparse = m_Sparse.Share();
+			shared.m_Packed = m_Packed.Share();
+			shared.m_Enabled = m_Enabled;
+			return shared;
+		}
 
-	template<typename T>
-	class ComponentPool
-	{
-	public:
-		ComponentPool() = default;
+		inline void Detach()
+		{
+			m_Sparse.Detach();
+			m_Packed.Detach();
+		}
 
-		inline bool Has(Entity e) const noexcept
+		inline void Clear() noexcept
 		{
-			return m_Set.Has(e);
+			for (Key k : m_Packed)
+				m_Sparse[k] = INVALID_INDEX;
+			m_Packed.Clear();
+			m_Enabled = 0;
 		}
 
-		inline void Add(Entity e, const T& value) noexcept
+		void Assign(DynamicArray<Key>&& packed) noexcept
 		{
-			m_Set.Add(e, value);
+			m_Packed = std::move(packed);
+			m_Enabled = static_cast<uint32_t>(m_Packed.Size());
+			RebuildSparse();
 		}
 
-		template<typename... Args>
-		void Emplace(Entity e, Args&&... args) noexcept
+		void Assign(DynamicArray<Key>&& packed, DynamicArray<uint32_t>&& sparse) noexcept
 		{
-			m_Set.Emplace(e, std::forward<Args>(args)...);
+			m_Packed = std::move(packed);
+			m_Sparse = std::move(sparse);
+			m_Enabled = static_cast<uint32_t>(m_Packed.Size());
 		}
 
-		inline void Remove(Entity e)
+		[[nodiscard]] inline uint32_t Index(Key k) const noexcept
 		{
-			m_Set.Remove(e);
+			return m_Sparse[k];
 		}
 
-		[[nodiscard]] inline T* Get(Entity e) noexcept
+		void Permute(DynamicArray<uint32_t>& order)
 		{
-			if (!Has(e)) return nullptr;
-			return m_Set.Get(e);
+			// only rows that move need their sparse entry rewritten
+			for (uint32_t i = 0; i < order.Size(); ++i)
+			{
+				if (order[i] != i)
+					m_Sparse[m_Packed[order[i]]] = i;
+			}
+			PermuteInPlace(order, m_Packed);
 		}
 
-		[[nodiscard]] inline const DynamicArray<T>& RawDense() const noexcept
+		[[nodiscard]] inline const DynamicArray<Key>& RawPacked() const noexcept
 		{
-			return m_Set.RawDense();
+			return m_Packed;
 		}
 
-		[[nodiscard]] inline const DynamicArray<Entity>& RawEntities() const noexcept
+		[[nodiscard]] inline const DynamicArray<uint32_t>& RawSparse() const noexcept
 		{
-			return m_Set.RawPacked();
+			return m_Sparse;
 		}
 
 		[[nodiscard]] inline size_t Size() const noexcept
 		{
-			return m_Set.Size();
+			return m_Packed.Size();
+		}
+
+		[[nodiscard]] inline size_t EnabledSize() const noexcept
+		{
+			return m_Enabled;
 		}
 
 	private:
-		SparseSet<T> m_Set;
-	};
+		static constexpr Key INVALID_INDEX = std::numeric_limits<Key>::max();
 
-	// Type-erased component pool interface
-	struct IComponentPool
-	{
-		virtual ~IComponentPool() = default;
-		virtual void Remove(Entity e) noexcept = 0;
-		virtual bool Has(Entity e) const noexcept = 0;
-		virtual size_t Size() const noexcept = 0;
-	};
+		inline void Swap(uint32_t a, uint32_t b) noexcept
+		{
+			if (a == b) return;
 
-	template<typename T>
-	struct ComponentPoolWrapper : IComponentPool
-	{
-		ComponentPool<T> pool;
-		void Remove(Entity e) noexcept override
+			std::swap(m_Packed[a], m_Packed[b]);
+			m_Sparse[m_Packed[a]] = a;
+			m_Sparse[m_Packed[b]] = b;
+		}
+
+		inline void EnableLast() noexcept
 		{
-			pool.Remove(e);
+			Swap(m_Enabled++, static_cast<uint32_t>(m_Packed.Size() - 1));
 		}
 
-		bool Has(Entity e) const noexcept override
+		inline void EnsureSparseSize(Key k) noexcept
 		{
-			return pool.Has(e);
+			if (k >= m_Sparse.Size())
+			{
+				size_t newCapacity = m_Sparse.Size() == 0 ? 64 : m_Sparse.Size();
+				while (k >= newCapacity)
+					newCapacity *= 2;
+
+				COMPOSIA_COUNT(SparseResizes, 1);
+				m_Sparse.Resize(newCapacity, INVALID_INDEX);
+			}
 		}
 
-		size_t Size() const noexcept override
+		inline void RebuildSparse() noexcept
 		{
-			return pool.Size();
+			for (uint32_t& index : m_Sparse)
+				index = INVALID_INDEX;
+
+			for (size_t i = 0; i < m_Packed.Size(); ++i)
+			{
+				EnsureSparseSize(m_Packed[i]);
+				m_Sparse[m_Packed[i]] = static_cast<uint32_t>(i);
+			}
 		}
 
+		DynamicArray<uint32_t> m_Sparse;
+		DynamicArray<Key> m_Packed;
+		uint32_t m_Enabled = 0;
 	};
 
-} // namespace Composia 
+} // namespace Composia::Core 
 
-#include <typeindex> // std::type_index
-#include <memory> // std::unique_ptr
+#include <bit> // std::popcount, std::countr_zero
 
-using Composia::Core::DynamicArray;
 
-class IComponentPool; // forward declaration
+using Composia::Core::DynamicArray;
+using Key = uint32_t;
 
 namespace Composia::Core {
 
-	// Map structure for storing storing ComponentPools by type_index using robin hood hashing.
-	class PoolMap
+	// Membership set with one bit per key. Costs maxKey / 8 bytes regardless of how many keys
+	// are present, which beats a sparse set's 8+ bytes per key once the set is dense.
+	class BitSet
 	{
-	private:
-		struct Entry
+	public:
+		static constexpr size_t BITS_PER_WORD = 64;
+
+		BitSet(size_t reserveKeys = 1024)
 		{
-			std::type_index key;
-			std::unique_ptr<IComponentPool> value;
-			size_t probeDistance = 0;
-			bool occupied = false;
+			m_Words.Resize((reserveKeys + BITS_PER_WORD - 1) / BITS_PER_WORD, 0);
+		}
 
-			Entry() noexcept : key(typeid(void)), value(nullptr), probeDistance(0), occupied(false) {}
-		};
+		inline bool Has(Key k) const noexcept
+		{
+			size_t word = k / BITS_PER_WORD;
+			return word < m_Words.Size() && (m_Words[word] >> (k % BITS_PER_WORD)) & 1;
+		}
 
-		DynamicArray<Entry> m_Buckets;
-		size_t m_Size = 0;
-		float m_LoadFactor = 0.7f;
+		inline void Add(Key k) noexcept
+		{
+			size_t word = k / BITS_PER_WORD;
+			if (word >= m_Words.Size())
+				EnsureWordCount(word + 1);
 
-	private:
-		void Rehash(size_t newCapacity) noexcept
+			uint64_t mask = uint64_t(1) << (k % BITS_PER_WORD);
+			m_Count += (m_Words[word] & mask) == 0;
+			m_Words[word] |= mask;
+		}
+
+		inline void Remove(Key k) noexcept
 		{
-			DynamicArray<Entry> oldBuckets = std::move(m_Buckets);
-			m_Buckets.Clear();
-			m_Buckets.Resize(newCapacity);
-			m_Size = 0;
+			size_t word = k / BITS_PER_WORD;
+			if (word >= m_Words.Size()) return;
 
-			for (auto& e : oldBuckets)
-			{
-				if (e.occupied)
-					Insert(e.key, std::move(e.value));
-			}
+			uint64_t mask = uint64_t(1) << (k % BITS_PER_WORD);
+			m_Count -= (m_Words[word] & mask) != 0;
+			m_Words[word] &= ~mask;
 		}
-	public:
-		PoolMap(size_t capacity = 16)
+
+		// See SparseSet::HasBatch
+		inline void HasBatch(const Key* keys, size_t count, uint64_t* mask) const noexcept
 		{
-			m_Buckets.Resize(capacity);
+			std::fill(mask, mask + (count + 63) / 64, 0);
+			for (size_t i = 0; i < count; ++i)
+				mask[i / 64] |= uint64_t(Has(keys[i])) << (i % 64);
 		}
 
-		void Insert(std::type_index key, std::unique_ptr<IComponentPool> value) noexcept
+		// Same interface as SparseSet, a key's word is all there is to fetch
+		inline void PrefetchSparse(Key k) const noexcept
 		{
-			if ((float)(m_Size + 1) / m_Buckets.Size() > m_LoadFactor)
+			if (k / BITS_PER_WORD < m_Words.Size())
+				Prefetch(m_Words.Data() + k / BITS_PER_WORD);
+		}
+
+		inline void PrefetchDense(Key) const noexcept {}
+
+		inline void Reserve(size_t keys)
+		{
+			m_Words.Reserve((keys + BITS_PER_WORD - 1) / BITS_PER_WORD);
+		}
+
+		// Drops the all-zero words past the highest key and gives back spare capacity. Stays within
+		// budget, words are dropped as they are scanned, and returns false when it has to be called again.
+		bool Compact(CompactBudget& budget)
+		{
+			size_t end = m_Words.Size() - std::min(m_Words.Size(), budget.Left());
+			size_t words = m_Words.Size();
+			while (words > end && m_Words[words - 1] == 0)
+				--words;
+			budget.work += m_Words.Size() - words;
+			m_Words.Resize(words);
+
+			if (words != 0 && words == end && m_Words[words - 1] == 0)
+				return false;
+			return budget.Compact(m_Words);
+		}
+
+		// Renames every key k to remap[k], keeping words for keys below keyCount only
+		void Remap(const DynamicArray<Key>& remap, size_t keyCount)
+		{
+			DynamicArray<uint64_t> words((keyCount + BITS_PER_WORD - 1) / BITS_PER_WORD);
+			words.Resize((keyCount + BITS_PER_WORD - 1) / BITS_PER_WORD, 0);
+			Each([&](Key k) {
+				assert(k < remap.Size() && remap[k] < keyCount && "Key missing from the remap table");
+				Key renamed = remap[k];
+				words[renamed / BITS_PER_WORD] |= uint64_t(1) << (renamed % BITS_PER_WORD);
+				});
+			m_Words = std::move(words);
+		}
+
+		// Copy that shares the words with this set, see DynamicArray::Share
+		BitSet Share()
+		{
+			BitSet shared(0);
+			shared.m_Words = m_Words.Share();
+			shared.m_Count = m_Count;
+			return shared;
+		}
+
+		// Must be called before modifying a set that came out of Share
+		inline void Detach()
+		{
+			m_Words.Detach();
+		}
+
+		inline void Clear() noexcept
+		{
+			for (uint64_t& word : m_Words)
+				word = 0;
+			m_Count = 0;
+		}
+
+		// Takes over words, recounting the set bits
+		void Assign(DynamicArray<uint64_t>&& words) noexcept
+		{
+			m_Words = std::move(words);
+
+			m_Count = 0;
+			for (uint64_t word : m_Words)
+				m_Count += std::popcount(word);
+		}
+
+		// Calls func(key) for every set bit in ascending order, one tzcnt per key
+		template<typename Func>
+		void Each(Func&& func) const
+		{
+			for (size_t w = 0; w < m_Words.Size(); ++w)
+			{
+				uint64_t word = m_Words[w];
+				while (word)
+				{
+					func(static_cast<Key>(w * BITS_PER_WORD + std::countr_zero(word)));
+					word &= word - 1;
+				}
+			}
+		}
+
+		[[nodiscard]] inline const DynamicArray<uint64_t>& RawWords() const noexcept
+		{
+			return m_Words;
+		}
+
+		[[nodiscard]] inline size_t WordCount() const noexcept
+		{
+			return m_Words.Size();
+		}
+
+		[[nodiscard]] inline size_t Size() const noexcept
+		{
+			return m_Count;
+		}
+
+	private:
+		inline void EnsureWordCount(size_t count) noexcept
+		{
+			size_t newCount = m_Words.Size() == 0 ? 1 : m_Words.Size();
+			while (newCount < count)
+				newCount *= 2;
+
+			m_Words.Resize(newCount, 0);
+		}
+
+		DynamicArray<uint64_t> m_Words;
+		size_t m_Count = 0;
+	};
+
+} // namespace Composia::Core
+
+
+
+using Composia::Core::DynamicArray;
+using Key = uint32_t;
+
+namespace Composia::Core {
+
+	// Sparse set variant for very rare keys: the key -> dense index mapping lives in an
+	// open-addressing table (linear probing, backward shift deletion) sized by the number of
+	// keys instead of a sparse array sized by the largest key. The packed and dense arrays are
+	// kept as in SparseSet so iteration stays linear. T = void stores keys only.
+	template<typename T>
+	class HashedSet
+	{
+		struct NoValues {};
+
+	public:
+		HashedSet(size_t reserveSize = 16)
+		{
+			m_Packed.Reserve(reserveSize);
+			if constexpr (!std::is_void_v<T>)
+				m_Dense.Reserve(reserveSize);
+			Rehash(MIN_SLOTS);
+		}
+
+		inline bool Has(Key k) const noexcept
+		{
+			return Find(k) != NOT_FOUND;
+		}
+
+		template<typename U = T>
+		inline void Add(Key k, const U& value) noexcept requires (!std::is_void_v<T>)
+		{
+			size_t slot = Find(k);
+			if (slot != NOT_FOUND)
+			{
+				m_Dense[m_Slots[slot].index] = value;
+				return;
+			}
+
+			Insert(k);
+			m_Dense.PushBack(value);
+			EnableLast();
+		}
+
+		template<typename... Args>
+		inline void Emplace(Key k, Args&&... args) requires (!std::is_void_v<T>)
+		{
+			size_t slot = Find(k);
+			if (slot != NOT_FOUND)
+			{
+				m_Dense[m_Slots[slot].index] = T(std::forward<Args>(args)...);
+				return;
+			}
+
+			Insert(k);
+			m_Dense.EmplaceBack(std::forward<Args>(args)...);
+			EnableLast();
+		}
+
+		inline void Add(Key k) noexcept requires std::is_void_v<T>
+		{
+			if (Find(k) == NOT_FOUND)
+			{
+				Insert(k);
+				EnableLast();
+			}
+		}
+
+		inline void Remove(Key k) noexcept
+		{
+			size_t slot = Find(k);
+			if (slot == NOT_FOUND) return;
+
+			uint32_t removedIndex = m_Slots[slot].index;
+			uint32_t lastIndex = static_cast<uint32_t>(m_Packed.Size() - 1);
+
+			// an enabled element first trades places with the last enabled one, keeping the partition
+			if (removedIndex < m_Enabled && --m_Enabled != lastIndex)
+			{
+				Swap(removedIndex, m_Enabled);
+				removedIndex = m_Enabled;
+			}
+			EraseSlot(slot);
+
+			// move last element into removed slot
+			if (removedIndex != lastIndex)
+			{
+				Key movedKey = m_Packed[lastIndex];
+				m_Packed[removedIndex] = movedKey;
+				m_Slots[Find(movedKey)].index = removedIndex;
+				if constexpr (!std::is_void_v<T>)
+					m_Dense[removedIndex] = std::move(m_Dense[lastIndex]);
+			}
+
+			m_Packed.PopBack();
+			if constexpr (!std::is_void_v<T>)
+				m_Dense.PopBack();
+		}
+
+		template<typename U = T>
+		[[nodiscard]] inline U* Get(Key k) noexcept requires (!std::is_void_v<T>)
+		{
+			size_t slot = Find(k);
+			if (slot == NOT_FOUND) return nullptr;
+			return &m_Dense[m_Slots[slot].index];
+		}
+
+		// See SparseSet::HasBatch, probes one key at a time
+		inline void HasBatch(const Key* keys, size_t count, uint64_t* mask) const noexcept
+		{
+			std::fill(mask, mask + (count + 63) / 64, 0);
+			for (size_t i = 0; i < count; ++i)
+				mask[i / 64] |= uint64_t(Has(keys[i])) << (i % 64);
+		}
+
+		// See SparseSet::PrefetchSparse. Only the home slot is fetched, and the dense slot only when
+		// the key sits there, which the low load factor makes the common case.
+		inline void PrefetchSparse(Key k) const noexcept
+		{
+			Prefetch(m_Slots.Data() + Home(k));
+		}
+
+		inline void PrefetchDense(Key k) const noexcept
+		{
+			if constexpr (!std::is_void_v<T>)
+			{
+				const Slot& slot = m_Slots[Home(k)];
+				if (slot.key == k)
+					Prefetch(m_Dense.Data() + slot.index);
+			}
+		}
+
+		// Enabled keys come first in the packed order, see SparseSet::Disable
+		inline void Disable(Key k) noexcept
+		{
+			size_t slot = Find(k);
+			if (slot == NOT_FOUND || m_Slots[slot].index >= m_Enabled) return;
+			Swap(m_Slots[slot].index, --m_Enabled);
+		}
+
+		inline void Enable(Key k) noexcept
+		{
+			size_t slot = Find(k);
+			if (slot == NOT_FOUND || m_Slots[slot].index < m_Enabled) return;
+			Swap(m_Slots[slot].index, m_Enabled++);
+		}
+
+		[[nodiscard]] inline bool IsEnabled(Key k) const noexcept
+		{
+			size_t slot = Find(k);
+			return slot != NOT_FOUND && m_Slots[slot].index < m_Enabled;
+		}
+
+		inline void Reserve(size_t capacity)
+		{
+			m_Packed.Reserve(capacity);
+			if constexpr (!std::is_void_v<T>)
+				m_Dense.Reserve(capacity);
+
+			size_t slots = m_Slots.Size();
+			while (capacity * 2 > slots)
+				slots *= 2;
+			if (slots != m_Slots.Size())
+				Rehash(slots);
+		}
+
+		// Copy that shares all arrays with this set, see DynamicArray::Share
+		HashedSet Share()
+		{
+			HashedSet shared(0);
+			shared.m_Slots = m_Slots.Share();
+			shared.m_Packed = m_Packed.Share();
+			if constexpr (!std::is_void_v<T>)
+				shared.m_Dense = m_Dense.Share();
+			shared.m_Shift = m_Shift;
+			shared.m_Enabled = m_Enabled;
+			return shared;
+		}
+
+		// Must be called before modifying a set that came out of Share
+		inline void Detach()
+		{
+			m_Slots.Detach();
+			m_Packed.Detach();
+			if constexpr (!std::is_void_v<T>)
+				m_Dense.Detach();
+		}
+
+		inline void Clear()
+		{
+			m_Packed.Clear();
+			if constexpr (!std::is_void_v<T>)
+				m_Dense.Clear();
+			m_Enabled = 0;
+			Rehash(MIN_SLOTS);
+		}
+
+		// Takes over packed keys and their values, then rebuilds the table in one pass
+		template<typename U = T>
+		void Assign(DynamicArray<Key>&& packed, DynamicArray<U>&& dense) noexcept requires (!std::is_void_v<T>)
+		{
+			m_Dense = std::move(dense);
+			AssignPacked(std::move(packed));
+		}
+
+		void Assign(DynamicArray<Key>&& packed) noexcept requires std::is_void_v<T>
+		{
+			AssignPacked(std::move(packed));
+		}
+
+		template<typename U = T>
+		[[nodiscard]] const DynamicArray<U>& RawDense() const noexcept requires (!std::is_void_v<T>)
+		{
+			return m_Dense;
+		}
+
+		// Halves the slot table while it is less than an eighth full and gives back spare capacity.
+		// The rehash is one CompactBudget::Step, so it may wait for the next call (returning false).
+		bool Compact(CompactBudget& budget)
+		{
+			size_t slots = m_Slots.Size();
+			while (slots > MIN_SLOTS && m_Packed.Size() * 8 < slots)
+				slots /= 2;
+			if (slots != m_Slots.Size())
+			{
+				size_t bytes = (m_Slots.Size() - slots) * sizeof(Slot);
+				bool stepped = budget.Step(slots + m_Packed.Size(), bytes, [&] {
+					m_Slots = DynamicArray<Slot>(slots);
+					Rehash(slots);
+					});
+				if (!stepped)
+					return false;
+			}
+
+			if constexpr (!std::is_void_v<T>)
+				return budget.Compact(m_Packed) && budget.Compact(m_Dense);
+			else
+				return budget.Compact(m_Packed);
+		}
+
+		// Renames every key k to remap[k], the table is rebuilt at its current size
+		void Remap(const DynamicArray<Key>& remap, size_t keyCount)
+		{
+			for (Key& k : m_Packed)
+			{
+				assert(k < remap.Size() && remap[k] < keyCount && "Key missing from the remap table");
+				k = remap[k];
+			}
+			Rehash(m_Slots.Size());
+		}
+
+		// Position of k in the packed order, k must be in the set
+		[[nodiscard]] inline uint32_t Index(Key k) const noexcept
+		{
+			return m_Slots[Find(k)].index;
+		}
+
+		// Moves the element at packed index order[i] to index i
+		void Permute(DynamicArray<uint32_t>& order)
+		{
+			for (uint32_t i = 0; i < order.Size(); ++i)
+			{
+				if (order[i] != i)
+					m_Slots[Find(m_Packed[order[i]])].index = i;
+			}
+
+			if constexpr (std::is_void_v<T>)
+				PermuteInPlace(order, m_Packed);
+			else
+				PermuteInPlace(order, m_Packed, m_Dense);
+		}
+
+		[[nodiscard]] inline const DynamicArray<Key>& RawPacked() const noexcept
+		{
+			return m_Packed;
+		}
+
+		[[nodiscard]] inline size_t Size() const noexcept
+		{
+			return m_Packed.Size();
+		}
+
+		[[nodiscard]] inline size_t EnabledSize() const noexcept
+		{
+			return m_Enabled;
+		}
+
+		[[nodiscard]] inline size_t SlotCount() const noexcept
+		{
+			return m_Slots.Size();
+		}
+
+		[[nodiscard]] inline const auto& RawSlots() const noexcept
+		{
+			return m_Slots;
+		}
+
+	private:
+		struct Slot
+		{
+			Key key = EMPTY_KEY;
+			uint32_t index = 0;
+		};
+
+		static constexpr Key EMPTY_KEY = std::numeric_limits<Key>::max();
+		static constexpr size_t NOT_FOUND = std::numeric_limits<size_t>::max();
+		static constexpr size_t MIN_SLOTS = 16;
+
+		// Fibonacci hashing spreads sequential entity ids over the table
+		inline size_t Home(Key k) const noexcept
+		{
+			return static_cast<size_t>((uint64_t(k) * 0x9E3779B97F4A7C15ull) >> m_Shift);
+		}
+
+		inline void AssignPacked(DynamicArray<Key>&& packed) noexcept
+		{
+			m_Packed = std::move(packed);
+			m_Enabled = static_cast<uint32_t>(m_Packed.Size());
+
+			size_t slots = MIN_SLOTS;
+			while (m_Packed.Size() * 2 > slots)
+				slots *= 2;
+			Rehash(slots);
+		}
+
+		inline size_t Find(Key k) const noexcept
+		{
+			size_t mask = m_Slots.Size() - 1;
+			for (size_t i = Home(k);; i = (i + 1) & mask)
+			{
+				const Slot& slot = m_Slots[i];
+				if (slot.key == k)
+					return i;
+				if (slot.key == EMPTY_KEY)
+					return NOT_FOUND;
+			}
+		}
+
+		inline void Insert(Key k) noexcept
+		{
+			// keep the load factor at or below 1/2 so probe sequences stay short
+			if ((m_Packed.Size() + 1) * 2 > m_Slots.Size())
+				Rehash(m_Slots.Size() * 2);
+
+			Place(k, static_cast<uint32_t>(m_Packed.Size()));
+			m_Packed.PushBack(k);
+		}
+
+		// Trades the packed (and dense) positions of two elements, slots only change their index
+		inline void Swap(uint32_t a, uint32_t b) noexcept
+		{
+			if (a == b) return;
+
+			m_Slots[Find(m_Packed[a])].index = b;
+			m_Slots[Find(m_Packed[b])].index = a;
+			std::swap(m_Packed[a], m_Packed[b]);
+			if constexpr (!std::is_void_v<T>)
+				std::swap(m_Dense[a], m_Dense[b]);
+		}
+
+		// Moves an element just appended in front of the disabled ones
+		inline void EnableLast() noexcept
+		{
+			Swap(m_Enabled++, static_cast<uint32_t>(m_Packed.Size() - 1));
+		}
+
+		inline void Place(Key k, uint32_t index) noexcept
+		{
+			size_t mask = m_Slots.Size() - 1;
+			size_t i = Home(k);
+			while (m_Slots[i].key != EMPTY_KEY)
+				i = (i + 1) & mask;
+
+			m_Slots[i].key = k;
+			m_Slots[i].index = index;
+		}
+
+		// Backward shift deletion, no tombstones are left behind
+		inline void EraseSlot(size_t hole) noexcept
+		{
+			size_t mask = m_Slots.Size() - 1;
+			size_t i = hole;
+			while (true)
+			{
+				i = (i + 1) & mask;
+				if (m_Slots[i].key == EMPTY_KEY)
+					break;
+
+				size_t home = Home(m_Slots[i].key);
+				// entry at i may fill the hole only if its home is not in (hole, i]
+				bool movable = hole <= i ? (home <= hole || home > i) : (home <= hole && home > i);
+				if (movable)
+				{
+					m_Slots[hole] = m_Slots[i];
+					hole = i;
+				}
+			}
+			m_Slots[hole] = Slot{};
+		}
+
+		void Rehash(size_t slotCount) noexcept
+		{
+			m_Shift = 64;
+			for (size_t n = slotCount; n > 1; n >>= 1)
+				--m_Shift;
+
+			m_Slots.Clear();
+			m_Slots.Resize(slotCount, Slot{});
+			for (size_t i = 0; i < m_Packed.Size(); ++i)
+				Place(m_Packed[i], static_cast<uint32_t>(i));
+		}
+
+		DynamicArray<Slot> m_Slots;
+		DynamicArray<Key> m_Packed;
+		[[no_unique_address]] std::conditional_t<std::is_void_v<T>, NoValues, DynamicArray<std::conditional_t<std::is_void_v<T>, char, T>>> m_Dense;
+		uint32_t m_Shift = 64;
+		uint32_t m_Enabled = 0;
+	};
+
+} // namespace Composia::Core
+
+
+using Composia::Core::DynamicArray;
+
+namespace Composia::Core {
+
+	// Multicast callback list. A listener is a plain function pointer plus an opaque instance
+	// pointer, so publishing never allocates and connecting never type-erases through std::function.
+	template<typename... Args>
+	class Signal
+	{
+	public:
+		using Callback = void(*)(void*, Args...);
+
+		template<auto Candidate>
+		inline void Connect()
+		{
+			Connect(&FreeThunk<Candidate>, nullptr);
+		}
+
+		template<auto Candidate, typename Type>
+		inline void Connect(Type& instance)
+		{
+			Connect(&MemberThunk<Candidate, Type>, &instance);
+		}
+
+		inline void Connect(Callback callback, void* instance)
+		{
+			m_Listeners.PushBack({ callback, instance });
+		}
+
+		// Returns the number of listeners removed
+		template<auto Candidate>
+		inline uint32_t Disconnect()
+		{
+			return Disconnect(&FreeThunk<Candidate>, nullptr);
+		}
+
+		template<auto Candidate, typename Type>
+		inline uint32_t Disconnect(Type& instance)
+		{
+			return Disconnect(&MemberThunk<Candidate, Type>, &instance);
+		}
+
+		uint32_t Disconnect(Callback callback, const void* instance)
+		{
+			uint32_t removed = 0;
+			for (size_t i = m_Listeners.Size(); i > 0; --i)
+			{
+				if (m_Listeners[i - 1].callback == callback && m_Listeners[i - 1].instance == instance)
+				{
+					EraseAt(i - 1);
+					++removed;
+				}
+			}
+			return removed;
+		}
+
+		// Removes every listener bound to instance
+		uint32_t Disconnect(const void* instance)
+		{
+			uint32_t removed = 0;
+			for (size_t i = m_Listeners.Size(); i > 0; --i)
+			{
+				if (m_Listeners[i - 1].instance == instance)
+				{
+					EraseAt(i - 1);
+					++removed;
+				}
+			}
+			return removed;
+		}
+
+		inline void Publish(Args... args) const
+		{
+			for (size_t i = 0; i < m_Listeners.Size(); ++i)
+				m_Listeners[i].callback(m_Listeners[i].instance, args...);
+		}
+
+		[[nodiscard]] inline bool Empty() const noexcept
+		{
+			return m_Listeners.Empty();
+		}
+
+		[[nodiscard]] inline size_t Size() const noexcept
+		{
+			return m_Listeners.Size();
+		}
+
+	private:
+		struct Listener
+		{
+			Callback callback;
+			void* instance;
+		};
+
+		template<auto Candidate>
+		static void FreeThunk(void*, Args... args)
+		{
+			Candidate(args...);
+		}
+
+		template<auto Candidate, typename Type>
+		static void MemberThunk(void* instance, Args... args)
+		{
+			(static_cast<Type*>(instance)->*Candidate)(args...);
+		}
+
+		// Keeps connection order, listeners are expected to run in the order they were added
+		inline void EraseAt(size_t index)
+		{
+			for (size_t i = index + 1; i < m_Listeners.Size(); ++i)
+				m_Listeners[i - 1] = m_Listeners[i];
+			m_Listeners.PopBack();
+		}
+
+		DynamicArray<Listener> m_Listeners{ 0 };
+	};
+
+	// Connection handle handed out by pools. It keeps the owner's listener count in sync,
+	// which lets the owner skip all signal work with a single branch when nobody listens.
+	template<typename... Args>
+	class Sink
+	{
+	public:
+		using Callback = typename Signal<Args...>::Callback;
+
+		Sink(Signal<Args...>& signal, uint32_t& listenerCount) noexcept
+			: m_Signal(signal), m_ListenerCount(listenerCount) {}
+
+		template<auto Candidate>
+		inline void Connect()
+		{
+			m_Signal.template Connect<Candidate>();
+			++m_ListenerCount;
+		}
+
+		template<auto Candidate, typename Type>
+		inline void Connect(Type& instance)
+		{
+			m_Signal.template Connect<Candidate>(instance);
+			++m_ListenerCount;
+		}
+
+		inline void Connect(Callback callback, void* instance)
+		{
+			m_Signal.Connect(callback, instance);
+			++m_ListenerCount;
+		}
+
+		template<auto Candidate>
+		inline void Disconnect()
+		{
+			m_ListenerCount -= m_Signal.template Disconnect<Candidate>();
+		}
+
+		template<auto Candidate, typename Type>
+		inline void Disconnect(Type& instance)
+		{
+			m_ListenerCount -= m_Signal.template Disconnect<Candidate>(instance);
+		}
+
+		inline void Disconnect(const void* instance)
+		{
+			m_ListenerCount -= m_Signal.Disconnect(instance);
+		}
+
+		[[nodiscard]] inline bool Empty() const noexcept
+		{
+			return m_Signal.Empty();
+		}
+
+	private:
+		Signal<Args...>& m_Signal;
+		uint32_t& m_ListenerCount;
+	};
+
+} // namespace Composia::Core
+
+#include <istream> // std::istream
+#include <ostream> // std::ostream
+
+
+using Composia::Core::DynamicArray;
+
+namespace Composia::Core {
+
+	// Binary writer used by snapshots. Without a stream it only counts bytes, which is how encoded
+	// sizes are computed without writing anything. A non-zero block alignment pads
+	// every block so it starts at a multiple of it, which lets a mapped archive be used in place.
+	class OutputArchive
+	{
+	public:
+		// offset is where the archive starts within the final output, padding is computed from it
+		OutputArchive(std::ostream* stream = nullptr, size_t blockAlignment = 0, size_t offset = 0) noexcept
+			: m_Stream(stream), m_BlockAlignment(blockAlignment), m_Written(offset) {}
+
+		inline void Write(const void* data, size_t size)
+		{
+			if (m_Stream && size > 0)
+				m_Stream->write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+			m_Written += size;
+		}
+
+		template<typename T>
+		inline void Write(const T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be written as raw bytes");
+			Write(&value, sizeof(T));
+		}
+
+		inline void WriteBlock(const void* data, size_t size)
+		{
+			if (m_BlockAlignment != 0)
+			{
+				static constexpr char zeros[64] = {};
+				size_t padding = (m_BlockAlignment - m_Written % m_BlockAlignment) % m_BlockAlignment;
+				for (; padding > 0; padding -= std::min(padding, sizeof(zeros)))
+					Write(zeros, std::min(padding, sizeof(zeros)));
+			}
+			Write(data, size);
+		}
+
+		// Writes the element count followed by the elements as one contiguous block
+		template<typename T>
+		inline void WriteArray(const DynamicArray<T>& array)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable arrays can be written as one block");
+			Write(static_cast<uint64_t>(array.Size()));
+			WriteBlock(array.Data(), array.Size() * sizeof(T));
+		}
+
+		// LEB128, seven bits per byte
+		inline void WriteVarint(uint64_t value)
+		{
+			uint8_t bytes[10];
+			size_t size = 0;
+			do
+			{
+				bytes[size++] = static_cast<uint8_t>((value & 0x7F) | (value > 0x7F ? 0x80 : 0));
+				value >>= 7;
+			} while (value != 0);
+			Write(bytes, size);
+		}
+
+		[[nodiscard]] inline size_t Written() const noexcept
+		{
+			return m_Written;
+		}
+
+		// True if Patch can rewrite bytes already written, always so when only counting
+		[[nodiscard]] inline bool Patchable() const
+		{
+			return !m_Stream || m_Stream->tellp() != std::streampos(-1);
+		}
+
+		// Overwrites the value written at offset, e.g. a length only known once what follows it is written
+		template<typename T>
+		inline void Patch(size_t offset, const T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be written as raw bytes");
+			if (!m_Stream)
+				return;
+
+			std::streampos end = m_Stream->tellp();
+			m_Stream->seekp(end - static_cast<std::streamoff>(m_Written - offset));
+			m_Stream->write(reinterpret_cast<const char*>(&value), sizeof(T));
+			m_Stream->seekp(end);
+		}
+
+		[[nodiscard]] inline size_t BlockAlignment() const noexcept
+		{
+			return m_BlockAlignment;
+		}
+
+		[[nodiscard]] inline bool Good() const noexcept
+		{
+			return !m_Stream || m_Stream->good();
+		}
+
+	private:
+		std::ostream* m_Stream;
+		size_t m_BlockAlignment;
+		size_t m_Written;
+	};
+
+	// Reads archives written by OutputArchive, either from a stream or from memory. In memory mode
+	// ReadArray can adopt aligned blocks in place instead of copying them, owner keeps the memory alive.
+	// Counts read from the archive are checked against the bytes left before anything is allocated for
+	// them, so corrupt data fails the read instead of exhausting memory.
+	class InputArchive
+	{
+	public:
+		InputArchive(std::istream& stream, size_t blockAlignment = 0)
+			: m_Stream(&stream), m_Size(UNKNOWN_SIZE), m_BlockAlignment(blockAlignment)
+		{
+			// the bytes left are only known for streams that can seek
+			std::streampos start = stream.tellg();
+			if (start == std::streampos(-1))
+				return;
+
+			if (stream.seekg(0, std::ios::end))
+			{
+				std::streampos end = stream.tellg();
+				if (end != std::streampos(-1) && end >= start)
+					m_Size = static_cast<size_t>(end - start);
+			}
+			stream.clear();
+			stream.seekg(start);
+		}
+
+		InputArchive(const void* data, size_t size, std::shared_ptr<const void> owner, size_t blockAlignment = 0) noexcept
+			: m_Data(static_cast<const char*>(data)), m_Size(size), m_Owner(std::move(owner)), m_BlockAlignment(blockAlignment), m_Borrowing(m_Owner != nullptr) {}
+
+		inline bool Read(void* data, size_t size)
+		{
+			if (!m_Stream)
+			{
+				if (!m_Good || size > m_Size - m_Position)
+					return m_Good = false;
+				memcpy(data, m_Data + m_Position, size);
+			}
+			else if (size > 0)
+			{
+				m_Stream->read(static_cast<char*>(data), static_cast<std::streamsize>(size));
+			}
+			m_Position += size;
+			return Good();
+		}
+
+		inline bool ReadVarint(uint64_t& value)
+		{
+			value = 0;
+			for (uint32_t shift = 0; shift < 64; shift += 7)
+			{
+				uint8_t byte = 0;
+				if (!Read(byte))
+					return false;
+
+				value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0)
+					return true;
+			}
+			return false;
+		}
+
+		inline bool ReadBlock(void* data, size_t size)
+		{
+			return SkipPadding() && Read(data, size);
+		}
+
+		template<typename T>
+		inline bool Read(T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be read as raw bytes");
+			return Read(&value, sizeof(T));
+		}
+
+		// Reads an array written by OutputArchive::WriteArray, replacing the content of array
+		template<typename T>
+		inline bool ReadArray(DynamicArray<T>& array)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable arrays can be read as one block");
+			uint64_t size = 0;
+			if (!Read(size) || !SkipPadding() || !Holds(size, sizeof(T))) return false;
+
+			if (!m_Stream && m_Borrowing && reinterpret_cast<uintptr_t>(m_Data + m_Position) % alignof(T) == 0)
+			{
+				array.Adopt(reinterpret_cast<T*>(const_cast<char*>(m_Data + m_Position)), static_cast<size_t>(size), m_Owner);
+				m_Position += static_cast<size_t>(size) * sizeof(T);
+				return true;
+			}
+			return ReadElements(array, size);
+		}
+
+		// Reads count elements into array, replacing its content
+		template<typename T>
+		bool ReadElements(DynamicArray<T>& array, uint64_t count)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable elements can be read as raw bytes");
+			if (!Holds(count, sizeof(T)))
+				return false;
+
+			array.Clear();
+			if (m_Size != UNKNOWN_SIZE)
+			{
+				array.Resize(static_cast<size_t>(count));
+				return Read(array.Data(), array.Size() * sizeof(T));
+			}
+
+			// nothing bounds count on streams that can't seek, the array only grows as data arrives
+			constexpr size_t STEP = std::max<size_t>(1, UNKNOWN_SIZE_STEP_BYTES / sizeof(T));
+			for (size_t read = 0; read < count; )
+			{
+				size_t step = static_cast<size_t>(std::min<uint64_t>(STEP, count - read));
+				array.Reserve(std::max(array.Capacity() * 2, read + step));
+				array.Resize(read + step);
+				if (!Read(array.Data() + read, step * sizeof(T)))
+					return false;
+				read += step;
+			}
+			return true;
+		}
+
+		// True if count elements of elementSize bytes may still be in the archive: their total size does
+		// not overflow and does not exceed the bytes left, when those are known
+		[[nodiscard]] inline bool Holds(uint64_t count, size_t elementSize) const noexcept
+		{
+			size_t left = m_Size == UNKNOWN_SIZE ? std::numeric_limits<size_t>::max() : m_Size - std::min(m_Position, m_Size);
+			return elementSize == 0 || count <= left / elementSize;
+		}
+
+		inline bool Skip(size_t size)
+		{
+			if (!m_Stream)
+			{
+				if (size > m_Size - m_Position)
+					return m_Good = false;
+			}
+			else
+			{
+				m_Stream->ignore(static_cast<std::streamsize>(size));
+			}
+			m_Position += size;
+			return Good();
+		}
+
+		// Bytes read or skipped so far
+		[[nodiscard]] inline size_t Consumed() const noexcept
+		{
+			return m_Position;
+		}
+
+		// Memory mode adopts blocks in place only while borrowing is enabled
+		inline void Borrowing(bool enabled) noexcept
+		{
+			m_Borrowing = enabled && m_Owner != nullptr;
+		}
+
+		[[nodiscard]] inline bool Borrowing() const noexcept
+		{
+			return m_Borrowing;
+		}
+
+		[[nodiscard]] inline size_t BlockAlignment() const noexcept
+		{
+			return m_BlockAlignment;
+		}
+
+		// Set once the archive header telling how blocks were written has been read
+		inline void BlockAlignment(size_t alignment) noexcept
+		{
+			m_BlockAlignment = alignment;
+		}
+
+		[[nodiscard]] inline bool Good() const noexcept
+		{
+			return m_Stream ? m_Stream->good() : m_Good;
+		}
+
+	private:
+		static constexpr size_t UNKNOWN_SIZE = std::numeric_limits<size_t>::max();
+		static constexpr size_t UNKNOWN_SIZE_STEP_BYTES = 1 << 20;
+
+		inline bool SkipPadding()
+		{
+			if (m_BlockAlignment == 0)
+				return Good();
+			return Skip((m_BlockAlignment - m_Position % m_BlockAlignment) % m_BlockAlignment);
+		}
+
+		std::istream* m_Stream = nullptr;
+		const char* m_Data = nullptr;
+		size_t m_Size = 0;
+		std::shared_ptr<const void> m_Owner;
+		size_t m_BlockAlignment;
+		size_t m_Position = 0;
+		bool m_Borrowing = false;
+		bool m_Good = true;
+	};
+
+} // namespace Composia::Core
+
+#include <cstdio> // std::fprintf
+#include <cstdlib> // std::abort
+#include <unordered_map> // std::unordered_map
+
+namespace Composia::Core {
+
+	template<typename T>
+	constexpr std::string_view RawTypeName() noexcept
+	{
+	#if defined(_MSC_VER)
+		return __FUNCSIG__;
+	#else
+		return __PRETTY_FUNCTION__;
+	#endif
+	}
+
+	// Offsets of the type inside RawTypeName's signature, measured once on a known type
+	inline constexpr std::string_view TYPE_NAME_PROBE = RawTypeName<int>();
+	inline constexpr size_t TYPE_NAME_PREFIX = TYPE_NAME_PROBE.find("int");
+	inline constexpr size_t TYPE_NAME_SUFFIX = TYPE_NAME_PROBE.size() - TYPE_NAME_PREFIX - 3;
+
+	// Compile-time name of T as spelled by the compiler
+	template<typename T>
+	constexpr std::string_view TypeName() noexcept
+	{
+		constexpr std::string_view raw = RawTypeName<T>();
+		return raw.substr(TYPE_NAME_PREFIX, raw.size() - TYPE_NAME_PREFIX - TYPE_NAME_SUFFIX);
+	}
+
+	// 64-bit FNV-1a
+	constexpr uint64_t HashString(std::string_view text) noexcept
+	{
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (char c : text)
+		{
+			hash ^= static_cast<uint8_t>(c);
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	// FNV-1a over a type name with the class/struct/enum keywords and all spaces dropped, so
+	// "struct Foo<int, float>" (MSVC) and "Foo<int,float>" hash the same
+	constexpr uint64_t HashTypeName(std::string_view name) noexcept
+	{
+		constexpr std::string_view keywords[] = { "struct ", "class ", "enum " };
+
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (size_t i = 0; i < name.size();)
+		{
+			bool wordStart = i == 0 || !(name[i - 1] == '_' || (name[i - 1] >= '0' && name[i - 1] <= '9') ||
+				(name[i - 1] >= 'a' && name[i - 1] <= 'z') || (name[i - 1] >= 'A' && name[i - 1] <= 'Z'));
+
+			size_t skip = 0;
+			for (std::string_view keyword : keywords)
+			{
+				if (wordStart && name.substr(i, keyword.size()) == keyword)
+					skip = keyword.size();
+			}
+			if (skip != 0)
+			{
+				i += skip;
+				continue;
+			}
+
+			if (name[i] != ' ')
+			{
+				hash ^= static_cast<uint8_t>(name[i]);
+				hash *= 0x100000001b3ull;
+			}
+			++i;
+		}
+		return hash;
+	}
+
+	// Hash of T's name, unlike std::type_index::hash_code it is the same in every process
+	template<typename T>
+	constexpr uint64_t TypeHash() noexcept
+	{
+		return HashTypeName(TypeName<T>());
+	}
+
+	// Process wide record of which type name owns each id. Returns false when id is already
+	// owned by another name, i.e. two types collide.
+	inline bool RegisterTypeId(uint64_t id, std::string_view name)
+	{
+		static std::mutex mutex;
+		static std::unordered_map<uint64_t, std::string_view> owners;
+
+		std::lock_guard lock(mutex);
+		auto [it, inserted] = owners.try_emplace(id, name);
+		return inserted || it->second == name;
+	}
+
+	// RegisterTypeId that aborts on a collision, in every build: the colliding types would share a pool
+	// or resource and be cast to each other. Returns true so typed lookups can run it once from a static.
+	inline bool ClaimTypeId(uint64_t id, std::string_view name)
+	{
+		if (RegisterTypeId(id, name))
+			return true;
+
+		std::fprintf(stderr, "Composia: %.*s shares its TypeId with another type, specialize Composia::TypeIdTraits for one of them\n",
+			static_cast<int>(name.size()), name.data());
+		std::abort();
+	}
+
+} // namespace Composia::Core
+
+namespace Composia {
+
+	// Specialize to pin a type's id, e.g. when its name differs between compilers or it is renamed:
+	// template<> struct Composia::TypeIdTraits<Position> { static constexpr uint64_t value = 0x1234; };
+	template<typename T>
+	struct TypeIdTraits
+	{
+		static constexpr uint64_t value = Core::TypeHash<T>();
+	};
+
+	// Stable 64-bit type id, the same across builds, compilers and processes. Keys the pool map and
+	// tags serialized pools.
+	template<typename T>
+	inline constexpr uint64_t TypeId = TypeIdTraits<std::remove_cv_t<T>>::value;
+
+} // namespace Composia
+
+
+#if defined(_WIN32)
+// The few kernel32 functions used below, declared with windows.h's exact signatures (HANDLE is void*,
+// DWORD unsigned long, BOOL int) instead of including it: its macros (min, max, LoadImage, ...) would
+// leak into everything including Composia. Declaring them again is fine when windows.h is included too.
+struct _SECURITY_ATTRIBUTES;
+
+extern "C" {
+	__declspec(dllimport) void* __stdcall CreateFileA(const char* name, unsigned long access, unsigned long share,
+		struct _SECURITY_ATTRIBUTES* security, unsigned long disposition, unsigned long flags, void* templateFile);
+	__declspec(dllimport) unsigned long __stdcall GetFileSize(void* file, unsigned long* sizeHigh);
+	__declspec(dllimport) void* __stdcall CreateFileMappingA(void* file, struct _SECURITY_ATTRIBUTES* security,
+		unsigned long protect, unsigned long sizeHigh, unsigned long sizeLow, const char* name);
+	__declspec(dllimport) void* __stdcall MapViewOfFile(void* mapping, unsigned long access, unsigned long offsetHigh,
+		unsigned long offsetLow, size_t bytes);
+	__declspec(dllimport) int __stdcall UnmapViewOfFile(const void* address);
+	__declspec(dllimport) int __stdcall CloseHandle(void* handle);
+}
+#else
+#include <fcntl.h> // open
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#include <unistd.h> // close
+#endif
+
+namespace Composia::Core {
+
+	// Private (copy-on-write) mapping of a whole file. Pages are read on first access and
+	// writes go to process-local copies, the file itself is never modified.
+	class MappedFile
+	{
+	public:
+		// Returns nullptr if the file can not be opened or mapped
+		static std::shared_ptr<MappedFile> Open(const char* path)
+		{
+			std::shared_ptr<MappedFile> file(new MappedFile());
+			if (!file->Map(path))
+				return nullptr;
+			return file;
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		~MappedFile()
+		{
+	#if defined(_WIN32)
+			if (m_Data) UnmapViewOfFile(m_Data);
+	#else
+			if (m_Data) munmap(m_Data, m_Size);
+	#endif
+		}
+
+		[[nodiscard]] inline void* Data() const noexcept
+		{
+			return m_Data;
+		}
+
+		[[nodiscard]] inline size_t Size() const noexcept
+		{
+			return m_Size;
+		}
+
+	private:
+	#if defined(_WIN32)
+		// Values of the windows.h macros Map needs, named apart from them in case windows.h is included first
+		static constexpr unsigned long ACCESS_READ = 0x80000000ul;         // GENERIC_READ
+		static constexpr unsigned long SHARE_READ = 0x1;                   // FILE_SHARE_READ
+		static constexpr unsigned long OPEN_IF_EXISTING = 3;               // OPEN_EXISTING
+		static constexpr unsigned long ATTRIBUTES_NORMAL = 0x80;           // FILE_ATTRIBUTE_NORMAL
+		static constexpr unsigned long PROTECT_WRITECOPY = 0x08;           // PAGE_WRITECOPY
+		static constexpr unsigned long VIEW_COPY = 0x1;                    // FILE_MAP_COPY
+		static constexpr uint64_t SIZE_INVALID = 0xFFFFFFFFull;            // INVALID_FILE_SIZE with no high word
+		static inline void* const HANDLE_INVALID = reinterpret_cast<void*>(intptr_t(-1)); // INVALID_HANDLE_VALUE
+	#endif
+
+		MappedFile() = default;
+
+		bool Map(const char* path)
+		{
+	#if defined(_WIN32)
+			void* file = CreateFileA(path, ACCESS_READ, SHARE_READ, nullptr, OPEN_IF_EXISTING, ATTRIBUTES_NORMAL, nullptr);
+			if (file == HANDLE_INVALID)
+				return false;
+
+			unsigned long sizeHigh = 0;
+			unsigned long sizeLow = GetFileSize(file, &sizeHigh);
+			uint64_t size = (uint64_t(sizeHigh) << 32) | sizeLow;
+			void* mapping = nullptr;
+			if (size != SIZE_INVALID && size > 0 && size <= SIZE_MAX)
+				mapping = CreateFileMappingA(file, nullptr, PROTECT_WRITECOPY, 0, 0, nullptr);
+			CloseHandle(file);
+			if (!mapping)
+				return false;
+
+			m_Data = MapViewOfFile(mapping, VIEW_COPY, 0, 0, 0);
+			CloseHandle(mapping);
+			m_Size = static_cast<size_t>(size);
+	#else
+			int fd = open(path, O_RDONLY);
+			if (fd < 0)
+				return false;
+
+			struct stat info {};
+			void* data = MAP_FAILED;
+			if (fstat(fd, &info) == 0 && info.st_size > 0)
+				data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+			close(fd);
+			if (data == MAP_FAILED)
+				return false;
+
+			m_Data = data;
+			m_Size = static_cast<size_t>(info.st_size);
+	#endif
+			return m_Data != nullptr;
+		}
+
+		void* m_Data = nullptr;
+		size_t m_Size = 0;
+	};
+
+} // namespace Composia::Core
+
+#include <chrono> // std::chrono::steady_clock
+#include <fstream> // std::ofstream
+#include <string> // std::string
+#include <thread> // std::this_thread::yield
+
+#if defined(_M_X64)
+#elif defined(__x86_64__)
+#include <x86intrin.h> // __rdtsc
+#endif
+
+
+// Timeline zones, exported as Chrome trace JSON (chrome://tracing, ui.perfetto.dev). Like the
+// counters in Instrumentation.h they only exist when COMPOSIA_INSTRUMENTATION is defined.
+// Zone names are not copied, they must outlive the export (string literals, TypeName<T>()).
+// A zone reads the clock twice, which dominates its cost: tens of ns, more under virtualization
+// (see the TraceZone benchmark). Zones belong around work of microseconds, not per entity.
+#if defined(COMPOSIA_INSTRUMENTATION)
+	#define COMPOSIA_TRACE_CONCAT_IMPL(a, b) a##b
+	#define COMPOSIA_TRACE_CONCAT(a, b) COMPOSIA_TRACE_CONCAT_IMPL(a, b)
+	#define COMPOSIA_TRACE_ZONE(name) ::Composia::Core::TraceZone COMPOSIA_TRACE_CONCAT(composiaTraceZone, __LINE__)(name)
+#else
+	#define COMPOSIA_TRACE_ZONE(name) ((void)0)
+#endif
+
+namespace Composia::Core {
+
+	// rdtsc where available, converted to wall time once at export. A read takes some 20 cycles on
+	// bare metal and several times that in a VM.
+	inline uint64_t TraceTicks() noexcept
+	{
+	#if defined(_M_X64) || defined(__x86_64__)
+		return __rdtsc();
+	#else
+		return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+	#endif
+	}
+
+	struct TraceEvent
+	{
+		std::string_view name;
+		uint64_t begin;
+		uint64_t end;
+	};
+
+	// Every thread writes zones into its own ring without locking, the oldest zones are overwritten
+	// once a ring is full. Exporting while other threads record is safe, zones that may have been
+	// overwritten during the copy are dropped.
+	class Trace
+	{
+	public:
+	#if defined(COMPOSIA_INSTRUMENTATION)
+		static constexpr bool Enabled = true;
+	#else
+		static constexpr bool Enabled = false;
+	#endif
+
+		static constexpr size_t RING_CAPACITY = size_t(1) << 15; // zones kept per thread
+
+		static inline void Record(std::string_view name, uint64_t begin, uint64_t end) noexcept
+		{
+			ThreadRing& ring = Local();
+			uint64_t head = ring.head.load(std::memory_order_relaxed);
+			ring.events[head & (RING_CAPACITY - 1)] = TraceEvent{ name, begin, end };
+			ring.head.store(head + 1, std::memory_order_release);
+		}
+
+		// Label shown for the calling thread's track
+		static void NameThread(std::string name)
+		{
+			ThreadRing& ring = Local();
+			std::lock_guard lock(State().mutex);
+			ring.name = std::move(name);
+		}
+
+		// Drops every zone recorded so far
+		static void Clear()
+		{
+			Shared& shared = State();
+			std::lock_guard lock(shared.mutex);
+			for (auto& ring : shared.rings)
+				ring->cleared = ring->head.load(std::memory_order_acquire);
+		}
+
+		static void WriteChromeJson(std::ostream& stream)
+		{
+			Shared& shared = State();
+			std::lock_guard lock(shared.mutex);
+
+			double microsecondsPerTick = Calibrate(shared);
+
+			stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+			bool first = true;
+			for (auto& ring : shared.rings)
+			{
+				if (!ring->name.empty())
+				{
+					stream << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->id
+						<< ",\"args\":{\"name\":\"";
+					WriteEscaped(stream, ring->name);
+					stream << "\"}}";
+					first = false;
+				}
+
+				uint64_t head = ring->head.load(std::memory_order_acquire);
+				uint64_t oldest = std::max(ring->cleared, head > RING_CAPACITY ? head - RING_CAPACITY : 0);
+				DynamicArray<TraceEvent> events(static_cast<size_t>(head - oldest));
+				for (uint64_t i = oldest; i < head; ++i)
+					events.PushBack(ring->events[i & (RING_CAPACITY - 1)]);
+
+				// zones the owner wrote over while they were copied are torn, including the slot it may
+				// be writing right now
+				uint64_t after = ring->head.load(std::memory_order_acquire) + 1;
+				uint64_t valid = after > RING_CAPACITY ? after - RING_CAPACITY : 0;
+
+				for (uint64_t i = std::max(oldest, valid); i < head; ++i)
+				{
+					const TraceEvent& event = events[static_cast<size_t>(i - oldest)];
+					stream << (first ? "" : ",") << "\n{\"name\":\"";
+					WriteEscaped(stream, event.name);
+					stream << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->id
+						<< ",\"ts\":" << static_cast<double>(event.begin - shared.startTicks) * microsecondsPerTick
+						<< ",\"dur\":" << static_cast<double>(event.end - event.begin) * microsecondsPerTick << "}";
+					first = false;
+				}
+			}
+			stream << "\n]}\n";
+		}
+
+		// Returns false if the file could not be written
+		static bool Save(const char* path)
+		{
+			std::ofstream stream(path, std::ios::binary);
+			WriteChromeJson(stream);
+			return stream.good();
+		}
+
+	private:
+		struct ThreadRing
+		{
+			std::unique_ptr<TraceEvent[]> events = std::make_unique<TraceEvent[]>(RING_CAPACITY);
+			std::atomic<uint64_t> head = 0;
+			uint64_t cleared = 0;
+			uint32_t id = 0;
+			std::string name;
+		};
+
+		struct Shared
+		{
+			std::mutex mutex;
+			DynamicArray<std::unique_ptr<ThreadRing>> rings;
+			uint64_t startTicks = TraceTicks();
+			std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+		};
+
+		static Shared& State() noexcept
+		{
+			static Shared shared;
+			return shared;
+		}
+
+		// Rings are kept after their thread exits so its zones can still be exported
+		static ThreadRing& Local() noexcept
+		{
+			thread_local ThreadRing* ring = nullptr;
+			if (!ring) [[unlikely]]
+			{
+				Shared& shared = State();
+				std::lock_guard lock(shared.mutex);
+				shared.rings.PushBack(std::make_unique<ThreadRing>());
+				ring = shared.rings.Back().get();
+				ring->id = static_cast<uint32_t>(shared.rings.Size());
+			}
+			return *ring;
+		}
+
+		static double Calibrate(const Shared& shared) noexcept
+		{
+	#if defined(_M_X64) || defined(__x86_64__)
+			// measure the tsc rate over at least 10 ms since the first zone
+			using namespace std::chrono;
+			steady_clock::time_point now = steady_clock::now();
+			while (now - shared.startTime < milliseconds(10))
+			{
+				std::this_thread::yield();
+				now = steady_clock::now();
+			}
+			uint64_t ticks = TraceTicks() - shared.startTicks;
+			return duration<double, std::micro>(now - shared.startTime).count() / static_cast<double>(ticks);
+	#else
+			(void)shared;
+			return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::duration(1)).count();
+	#endif
+		}
+
+		static void WriteEscaped(std::ostream& stream, std::string_view text)
+		{
+			for (char c : text)
+			{
+				if (c == '"' || c == '\\')
+					stream << '\\' << c;
+				else if (static_cast<unsigned char>(c) < 0x20)
+					stream << ' ';
+				else
+					stream << c;
+			}
+		}
+	};
+
+	// Records the time between its construction and destruction as one zone
+	class TraceZone
+	{
+	public:
+		explicit TraceZone(std::string_view name) noexcept
+			: m_Name(name), m_Begin(TraceTicks()) {}
+
+		~TraceZone()
+		{
+			Trace::Record(m_Name, m_Begin, TraceTicks());
+		}
+
+		TraceZone(const TraceZone&) = delete;
+		TraceZone& operator=(const TraceZone&) = delete;
+
+	private:
+		std::string_view m_Name;
+		uint64_t m_Begin;
+	};
+
+} // namespace Composia::Core
+
+ 
+
+namespace Composia {
+
+	using Entity = uint32_t;
+	static constexpr Entity INVALID_ENTITY = std::numeric_limits<Entity>::max();
+
+} // namespace Composia
+
+
+using Composia::Core::DynamicArray;
+using Composia::Core::OutputArchive;
+using Composia::Core::InputArchive;
+
+namespace Composia {
+
+	// Appends size bytes, growing geometrically since Resize only grows to the exact size
+	inline void AppendBytes(DynamicArray<uint8_t>& bytes, const void* data, size_t size)
+	{
+		size_t offset = bytes.Size();
+		if (offset + size > bytes.Capacity())
+			bytes.Reserve(std::max(bytes.Capacity() * 2, offset + size));
+		bytes.Resize(offset + size);
+		if (size > 0)
+			memcpy(bytes.Data() + offset, data, size);
+	}
+
+	// Copy of one pool's entities and raw component bytes, the reference pool deltas are computed against.
+	// Rows are kept packed like a sparse set so lookups and updates stay O(1).
+	class PoolState
+	{
+	public:
+		PoolState(uint64_t typeHash = 0, uint32_t valueSize = 0) noexcept
+			: m_TypeHash(typeHash), m_ValueSize(valueSize), m_Entities(0), m_Values(0), m_Rows(0) {}
+
+		[[nodiscard]] inline bool Has(Entity e) const noexcept
+		{
+			return e < m_Rows.Size() && m_Rows[e] != INVALID_ROW;
+		}
+
+		[[nodiscard]] inline const uint8_t* Value(Entity e) const noexcept
+		{
+			return m_Values.Data() + static_cast<size_t>(m_Rows[e]) * m_ValueSize;
+		}
+
+		// Replaces the content with count entities and their values laid out back to back
+		void Assign(const Entity* entities, const void* values, size_t count)
+		{
+			for (Entity e : m_Entities)
+				m_Rows[e] = INVALID_ROW;
+
+			m_Entities.Clear();
+			m_Entities.Resize(count);
+			if (count > 0)
+				memcpy(m_Entities.Data(), entities, count * sizeof(Entity));
+
+			m_Values.Clear();
+			m_Values.Resize(count * m_ValueSize);
+			if (count > 0 && m_ValueSize > 0)
+				memcpy(m_Values.Data(), values, count * m_ValueSize);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				EnsureRows(m_Entities[i]);
+				m_Rows[m_Entities[i]] = static_cast<uint32_t>(i);
+			}
+		}
+
+		void Set(Entity e, const void* value)
+		{
+			if (!Has(e))
+			{
+				EnsureRows(e);
+				m_Rows[e] = static_cast<uint32_t>(m_Entities.Size());
+				m_Entities.PushBack(e);
+				AppendBytes(m_Values, value, m_ValueSize);
+				return;
+			}
+
+			if (m_ValueSize > 0)
+				memcpy(m_Values.Data() + static_cast<size_t>(m_Rows[e]) * m_ValueSize, value, m_ValueSize);
+		}
+
+		void Erase(Entity e)
+		{
+			if (!Has(e)) return;
+
+			// move last row into the erased one
+			uint32_t row = m_Rows[e];
+			uint32_t last = static_cast<uint32_t>(m_Entities.Size() - 1);
+			if (row != last)
+			{
+				Entity moved = m_Entities[last];
+				m_Entities[row] = moved;
+				m_Rows[moved] = row;
+				if (m_ValueSize > 0)
+					memcpy(m_Values.Data() + static_cast<size_t>(row) * m_ValueSize, m_Values.Data() + static_cast<size_t>(last) * m_ValueSize, m_ValueSize);
+			}
+
+			m_Entities.PopBack();
+			m_Values.Resize(m_Values.Size() - m_ValueSize);
+			m_Rows[e] = INVALID_ROW;
+		}
+
+		[[nodiscard]] inline const DynamicArray<Entity>& Entities() const noexcept
+		{
+			return m_Entities;
+		}
+
+		// Values in the same row order as Entities
+		[[nodiscard]] inline const DynamicArray<uint8_t>& Values() const noexcept
+		{
+			return m_Values;
+		}
+
+		[[nodiscard]] inline uint64_t TypeHash() const noexcept
+		{
+			return m_TypeHash;
+		}
+
+		[[nodiscard]] inline uint32_t ValueSize() const noexcept
+		{
+			return m_ValueSize;
+		}
+
+	private:
+		static constexpr uint32_t INVALID_ROW = std::numeric_limits<uint32_t>::max();
+
+		inline void EnsureRows(Entity e)
+		{
+			if (e >= m_Rows.Size())
+			{
+				size_t newSize = m_Rows.Size() == 0 ? 64 : m_Rows.Size();
+				while (e >= newSize)
+					newSize *= 2;
+
+				m_Rows.Resize(newSize, INVALID_ROW);
+			}
+		}
+
+		uint64_t m_TypeHash;
+		uint32_t m_ValueSize;
+		DynamicArray<Entity> m_Entities;
+		DynamicArray<uint8_t> m_Values;
+		DynamicArray<uint32_t> m_Rows;
+	};
+
+	// Component changes of one pool between a baseline and the current state. Old values are kept
+	// next to new ones so the delta can be reverted as well as applied.
+	struct PoolDelta
+	{
+		uint64_t typeHash = 0;
+		uint32_t valueSize = 0;
+
+		DynamicArray<Entity> added{ 0 };
+		DynamicArray<uint8_t> addedValues{ 0 };
+		DynamicArray<Entity> removed{ 0 };
+		DynamicArray<uint8_t> removedValues{ 0 };
+		DynamicArray<Entity> changed{ 0 };
+		DynamicArray<uint8_t> changedBefore{ 0 };
+		DynamicArray<uint8_t> changedAfter{ 0 };
+
+		[[nodiscard]] inline bool Empty() const noexcept
+		{
+			return added.Empty() && removed.Empty() && changed.Empty();
+		}
+	};
+
+	// Generations and free list of an EntityManager. Liveness is not stored: an id below the
+	// generation count is alive unless it sits in the free list.
+	struct EntityState
+	{
+		DynamicArray<uint32_t> generations{ 0 };
+		DynamicArray<Entity> freeList{ 0 };
+	};
+
+	// Ids whose generation changed or that exist on one side only, plus both free lists when they
+	// differ since liveness follows from them and recycling order matters
+	struct EntityDelta
+	{
+		uint32_t countBefore = 0;
+		uint32_t countAfter = 0;
+		DynamicArray<Entity> ids{ 0 };
+		DynamicArray<uint32_t> generationsBefore{ 0 };
+		DynamicArray<uint32_t> generationsAfter{ 0 };
+		DynamicArray<Entity> freeListBefore{ 0 };
+		DynamicArray<Entity> freeListAfter{ 0 };
+		bool freeListChanged = false;
+
+		[[nodiscard]] inline bool Empty() const noexcept
+		{
+			return countBefore == countAfter && ids.Empty() && !freeListChanged;
+		}
+	};
+
+	// Applies an entity delta to a captured state, keeping a baseline in step with the world
+	inline void ApplyEntityDelta(EntityState& state, const EntityDelta& delta, bool revert)
+	{
+		const auto& generations = revert ? delta.generationsBefore : delta.generationsAfter;
+		const auto& freeList = revert ? delta.freeListBefore : delta.freeListAfter;
+		uint32_t count = revert ? delta.countBefore : delta.countAfter;
+
+		state.generations.Resize(count, 0);
+		for (size_t i = 0; i < delta.ids.Size(); ++i)
+		{
+			if (delta.ids[i] < count)
+				state.generations[delta.ids[i]] = generations[i];
+		}
+
+		if (delta.freeListChanged)
+		{
+			state.freeList.Clear();
+			for (Entity e : freeList)
+				state.freeList.PushBack(e);
+		}
+	}
+
+	// World changes since a DeltaBaseline, see Registry::Diff. Entity lists are encoded as zigzag
+	// varints of the difference to the previous id, which keeps sorted or clustered ids to a byte or two.
+	class Delta
+	{
+	public:
+		EntityDelta entities;
+		DynamicArray<PoolDelta> pools{ 0 };
+
+		[[nodiscard]] bool Empty() const noexcept
+		{
+			for (const PoolDelta& pool : pools)
+			{
+				if (!pool.Empty())
+					return false;
+			}
+			return entities.Empty();
+		}
+
+		bool Save(std::ostream& stream) const
+		{
+			OutputArchive archive(&stream);
+			Write(archive);
+			return archive.Good();
+		}
+
+		// Encoded size in bytes
+		[[nodiscard]] size_t EncodedSize() const
+		{
+			OutputArchive counter;
+			Write(counter);
+			return counter.Written();
+		}
+
+		bool Load(std::istream& stream)
+		{
+			InputArchive archive(stream);
+			entities = EntityDelta{};
+			pools.Clear();
+
+			uint32_t magic = 0;
+			uint32_t poolCount = 0;
+			if (!archive.Read(magic) || magic != DELTA_MAGIC)
+				return false;
+			if (!archive.Read(entities.countBefore) || !archive.Read(entities.countAfter) ||
+				!ReadIds(archive, entities.ids) ||
+				!ReadValues(archive, entities.generationsBefore, entities.ids.Size()) ||
+				!ReadValues(archive, entities.generationsAfter, entities.ids.Size()) ||
+				!archive.Read(entities.freeListChanged) ||
+				!ReadIds(archive, entities.freeListBefore) || !ReadIds(archive, entities.freeListAfter) ||
+				!archive.Read(poolCount))
+				return false;
+
+			for (uint32_t i = 0; i < poolCount; ++i)
+			{
+				PoolDelta pool;
+				if (!archive.Read(pool.typeHash) || !archive.Read(pool.valueSize) ||
+					!ReadIds(archive, pool.added) || !ReadValues(archive, pool.addedValues, pool.added.Size(), pool.valueSize) ||
+					!ReadIds(archive, pool.removed) || !ReadValues(archive, pool.removedValues, pool.removed.Size(), pool.valueSize) ||
+					!ReadIds(archive, pool.changed) || !ReadValues(archive, pool.changedBefore, pool.changed.Size(), pool.valueSize) ||
+					!ReadValues(archive, pool.changedAfter, pool.changed.Size(), pool.valueSize))
+					return false;
+				pools.PushBack(std::move(pool));
+			}
+			return true;
+		}
+
+	private:
+		static constexpr uint32_t DELTA_MAGIC = 0x544C4443; // "CDLT"
+		static constexpr uint64_t ID_RESERVE_LIMIT = 1 << 16;
+
+		void Write(OutputArchive& archive) const
+		{
+			archive.Write(DELTA_MAGIC);
+			archive.Write(entities.countBefore);
+			archive.Write(entities.countAfter);
+			WriteIds(archive, entities.ids);
+			archive.Write(entities.generationsBefore.Data(), entities.generationsBefore.Size() * sizeof(uint32_t));
+			archive.Write(entities.generationsAfter.Data(), entities.generationsAfter.Size() * sizeof(uint32_t));
+			archive.Write(entities.freeListChanged);
+			WriteIds(archive, entities.freeListBefore);
+			WriteIds(archive, entities.freeListAfter);
+
+			uint32_t poolCount = 0;
+			for (const PoolDelta& pool : pools)
+				poolCount += !pool.Empty();
+			archive.Write(poolCount);
+
+			for (const PoolDelta& pool : pools)
+			{
+				if (pool.Empty())
+					continue;
+
+				archive.Write(pool.typeHash);
+				archive.Write(pool.valueSize);
+				WriteIds(archive, pool.added);
+				archive.Write(pool.addedValues.Data(), pool.addedValues.Size());
+				WriteIds(archive, pool.removed);
+				archive.Write(pool.removedValues.Data(), pool.removedValues.Size());
+				WriteIds(archive, pool.changed);
+				archive.Write(pool.changedBefore.Data(), pool.changedBefore.Size());
+				archive.Write(pool.changedAfter.Data(), pool.changedAfter.Size());
+			}
+		}
+
+		static void WriteIds(OutputArchive& archive, const DynamicArray<Entity>& ids)
+		{
+			archive.WriteVarint(ids.Size());
+			int64_t previous = 0;
+			for (Entity e : ids)
+			{
+				int64_t difference = static_cast<int64_t>(e) - previous;
+				archive.WriteVarint((static_cast<uint64_t>(difference) << 1) ^ static_cast<uint64_t>(difference >> 63));
+				previous = e;
+			}
+		}
+
+		static bool ReadIds(InputArchive& archive, DynamicArray<Entity>& ids)
+		{
+			uint64_t count = 0;
+			if (!archive.ReadVarint(count))
+				return false;
+
+			// every id takes at least a byte, larger counts can't be in the archive
+			if (!archive.Holds(count, 1))
+				return false;
+
+			// streams that can't seek leave count unbounded, past the cap ids grow as they are read
+			ids.Clear();
+			ids.Reserve(static_cast<size_t>(std::min<uint64_t>(count, ID_RESERVE_LIMIT)));
+			int64_t previous = 0;
+			for (uint64_t i = 0; i < count; ++i)
+			{
+				uint64_t encoded = 0;
+				if (!archive.ReadVarint(encoded))
+					return false;
+
+				previous += static_cast<int64_t>(encoded >> 1) ^ -static_cast<int64_t>(encoded & 1);
+				ids.PushBack(static_cast<Entity>(previous));
+			}
+			return true;
+		}
+
+		// Reads count values of width elements each
+		template<typename T>
+		static bool ReadValues(InputArchive& archive, DynamicArray<T>& values, size_t count, size_t width = 1)
+		{
+			return archive.Holds(count, width) && archive.ReadElements(values, static_cast<uint64_t>(count) * width);
+		}
+	};
+
+	// Captured world the next Diff is computed against. Advance moves it forward by a delta
+	// so a baseline can follow the world tick by tick without being captured again.
+	class DeltaBaseline
+	{
+	public:
+		EntityState entities;
+		DynamicArray<PoolState> pools{ 0 };
+
+		[[nodiscard]] PoolState* Find(uint64_t typeHash) noexcept
+		{
+			for (PoolState& pool : pools)
+			{
+				if (pool.TypeHash() == typeHash)
+					return &pool;
+			}
+			return nullptr;
+		}
+
+		[[nodiscard]] const PoolState* Find(uint64_t typeHash) const noexcept
+		{
+			return const_cast<DeltaBaseline*>(this)->Find(typeHash);
+		}
+
+		void Advance(const Delta& delta)
+		{
+			ApplyEntityDelta(entities, delta.entities, false);
+
+			for (const PoolDelta& change : delta.pools)
+			{
+				PoolState* pool = Find(change.typeHash);
+				if (!pool)
+				{
+					pools.PushBack(PoolState(change.typeHash, change.valueSize));
+					pool = &pools.Back();
+				}
+
+				for (size_t i = 0; i < change.removed.Size(); ++i)
+					pool->Erase(change.removed[i]);
+				for (size_t i = 0; i < change.added.Size(); ++i)
+					pool->Set(change.added[i], change.addedValues.Data() + i * change.valueSize);
+				for (size_t i = 0; i < change.changed.Size(); ++i)
+					pool->Set(change.changed[i], change.changedAfter.Data() + i * change.valueSize);
+			}
+		}
+	};
+
+} // namespace Composia
+
+
+using Composia::Core::DynamicArray;
+
+namespace Composia {
+
+	// Bytes held by one array: used covers its elements, reserved its whole allocation
+	struct ArrayMemory
+	{
+		size_t used = 0;
+		size_t reserved = 0;
+
+		template<typename T>
+		[[nodiscard]] static ArrayMemory Of(const DynamicArray<T>& array) noexcept
+		{
+			return ArrayMemory{ array.Size() * sizeof(T), array.Capacity() * sizeof(T) };
+		}
+
+		inline ArrayMemory& operator+=(const ArrayMemory& other) noexcept
+		{
+			used += other.used;
+			reserved += other.reserved;
+			return *this;
+		}
+	};
+
+	// Footprint of one component pool. Sparse is whatever maps entities to rows: the sparse array,
+	// the hash table of HashMap pools or the words of Bitset pools.
+	struct PoolMemory
+	{
+		std::string_view typeName;
+		uint64_t typeId = 0;
+		size_t count = 0;
+		ArrayMemory dense;
+		ArrayMemory packed;
+		ArrayMemory sparse;
+
+		[[nodiscard]] inline ArrayMemory Total() const noexcept
+		{
+			ArrayMemory total = dense;
+			total += packed;
+			total += sparse;
+			return total;
+		}
+	};
+
+	struct EntityMemory
+	{
+		size_t alive = 0;
+		size_t ids = 0; // high-water mark, alive + free list
+		size_t freeListLength = 0;
+		ArrayMemory generations;
+		ArrayMemory aliveFlags;
+		ArrayMemory freeList;
+
+		[[nodiscard]] inline ArrayMemory Total() const noexcept
+		{
+			ArrayMemory total = generations;
+			total += aliveFlags;
+			total += freeList;
+			return total;
+		}
+	};
+
+	// Registry wide report returned by Registry::MemoryStats. Arrays shared by a CloneShared copy
+	// or borrowed from a mapped image are counted in every registry that uses them.
+	struct MemoryReport
+	{
+		EntityMemory entities;
+		DynamicArray<PoolMemory> pools;
+		ArrayMemory poolMap;
+
+		[[nodiscard]] inline ArrayMemory Total() const noexcept
+		{
+			ArrayMemory total = entities.Total();
+			total += poolMap;
+			for (const PoolMemory& pool : pools)
+				total += pool.Total();
+			return total;
+		}
+
+		[[nodiscard]] inline const PoolMemory* Find(std::string_view typeName) const noexcept
+		{
+			for (const PoolMemory& pool : pools)
+			{
+				if (pool.typeName == typeName)
+					return &pool;
+			}
+			return nullptr;
+		}
+	};
+
+	// Outcome of a Registry::Compact call
+	struct CompactResult
+	{
+		size_t released = 0;  // bytes given back
+		size_t deferred = 0;  // bytes kept because giving them back is a larger step than budget allows
+		size_t work = 0;      // array elements scanned or moved
+		bool swept = false;   // the call finished a pass over every pool and the entity ids
+	};
+
+} // namespace Composia
+
+#include <vector>
+using Composia::Core::DynamicArray;
+using Composia::Core::OutputArchive;
+using Composia::Core::InputArchive;
+
+namespace Composia {
+
+	class EntityManager
+	{
+	public:
+		EntityManager(size_t initialCapacity = 4096)
+		{
+			m_Generations.Reserve(initialCapacity);
+			m_Alive.reserve(initialCapacity);
+			m_FreeList.Reserve(initialCapacity);
+		}
+
+		inline Entity Create() noexcept
+		{
+			if (!m_FreeList.Empty())
+			{
+				Entity removedEntity = m_FreeList.Back();
+				m_FreeList.PopBack();
+
+				m_Generations[removedEntity]++;
+				m_Alive[removedEntity] = true;
+				return removedEntity;
+			}
+
+			Entity id = static_cast<Entity>(m_Generations.Size());
+			m_Generations.PushBack(0);
+			m_Alive.push_back(true);
+			return id;
+		}
+
+		inline bool IsAlive(Entity e) const noexcept
+		{
+			return e < m_Generations.Size() && m_Alive[e];
+		}
+
+		inline void Destroy(Entity e) noexcept
+		{
+			if (!IsAlive(e)) return;
+
+			m_Alive[e]= false;
+			m_FreeList.PushBack(e);
+		}
+
+		inline uint32_t Generation(Entity e) const noexcept
+		{
+			return e < m_Generations.Size() ? m_Generations.At(e) : 0;
+		}
+
+		// Every id below the high-water mark is either alive or free
+		EntityMemory Memory() const noexcept
+		{
+			EntityMemory memory;
+			memory.ids = m_Generations.Size();
+			memory.freeListLength = m_FreeList.Size() + m_Trimmed.Size();
+			memory.alive = memory.ids - memory.freeListLength;
+			memory.generations = ArrayMemory::Of(m_Generations);
+			memory.aliveFlags = ArrayMemory{ (m_Alive.size() + 7) / 8, (m_Alive.capacity() + 7) / 8 };
+			memory.freeList = ArrayMemory::Of(m_FreeList);
+			memory.freeList += ArrayMemory::Of(m_Trimmed);
+			return memory;
+		}
+
+		// Gives back spare capacity. With trimIds the dead ids above the highest live one are forgotten,
+		// lowering the high-water mark; they are handed out again starting from generation 0. Stays within
+		// budget, returns false when it has to be called again to finish.
+		bool Compact(bool trimIds, Core::CompactBudget& budget)
+		{
+			if (!Trim(trimIds, budget))
+				return false;
+
+			if (m_Alive.capacity() > 2 * m_Alive.size() + 8 * 4096)
+			{
+				size_t words = m_Alive.size() / 64 + 1;
+				bool stepped = budget.Step(words, (m_Alive.capacity() - m_Alive.size()) / 8, [&] { m_Alive.shrink_to_fit(); });
+				if (!stepped)
+					return false;
+			}
+			return budget.Compact(m_Generations) && budget.Compact(m_FreeList);
+		}
+
+		// Numbers the live ids 0..alive-1: those listed in first come first in that order (dead or repeated
+		// ones are skipped), the other live ids follow in ascending order. remap receives the new id of every
+		// old id, INVALID_ENTITY for dead ones. Generations move with their ids and the free list empties.
+		size_t Renumber(const Entity* first, size_t firstCount, DynamicArray<Entity>& remap)
+		{
+			EndTrim();
+			constexpr Entity PENDING = INVALID_ENTITY - 1;
+			size_t ids = m_Generations.Size();
+			size_t alive = ids - m_FreeList.Size();
+
+			remap.Clear();
+			remap.Resize(ids);
+			for (Entity e = 0; e < ids; ++e)
+				remap[e] = m_Alive[e] ? PENDING : INVALID_ENTITY;
+
+			// new ids are handed out in order, so generations are written front to back
+			DynamicArray<uint32_t> generations(alive + 1);
+			for (size_t i = 0; i < firstCount; ++i)
+			{
+				Entity e = first[i];
+				if (e < ids && remap[e] == PENDING)
+				{
+					remap[e] = static_cast<Entity>(generations.Size());
+					generations.PushBack(m_Generations[e]);
+				}
+			}
+
+			// branchless, whether an id is still pending is close to random after heavy churn
+			Entity next = static_cast<Entity>(generations.Size());
+			generations.Resize(alive + 1);
+			for (Entity e = 0; e < ids; ++e)
+			{
+				bool pending = remap[e] == PENDING;
+				generations[next] = m_Generations[e];
+				remap[e] = pending ? next : remap[e];
+				next += pending;
+			}
+			generations.Resize(next);
+
+			m_Generations = std::move(generations);
+			m_Alive.assign(next, true);
+			m_FreeList.Clear();
+			return next;
+		}
+
+		void Save(OutputArchive& archive) const
+		{
+			DynamicArray<Entity> scratch(0);
+			archive.WriteArray(m_Generations);
+			archive.WriteArray(FreeIds(scratch));
+		}
+
+		// Every id below the saved count is alive unless it sits in the free list
+		bool Load(InputArchive& archive)
+		{
+			m_Trimmed.Clear();
+			m_Trim = TrimPass{};
+			if (!archive.ReadArray(m_Generations) || !archive.ReadArray(m_FreeList))
+				return false;
+
+			m_Alive.assign(m_Generations.Size(), true);
+			for (Entity e : m_FreeList)
+			{
+				if (e >= m_Generations.Size())
+					return false;
+				m_Alive[e] = false;
+			}
+			return true;
+		}
+
+		void Capture(EntityState& state) const
+		{
+			state.generations.Clear();
+			state.generations.Resize(m_Generations.Size());
+			if (!m_Generations.Empty())
+				memcpy(state.generations.Data(), m_Generations.Data(), m_Generations.Size() * sizeof(uint32_t));
+
+			DynamicArray<Entity> scratch(0);
+			state.freeList.Clear();
+			for (Entity e : FreeIds(scratch))
+				state.freeList.PushBack(e);
+		}
+
+		void Diff(const EntityState& baseline, EntityDelta& delta) const
+		{
+			DynamicArray<Entity> scratch(0);
+			const DynamicArray<Entity>& freeList = FreeIds(scratch);
+
+			delta.countBefore = static_cast<uint32_t>(baseline.generations.Size());
+			delta.countAfter = static_cast<uint32_t>(m_Generations.Size());
+
+			// generations only change when ids are recycled, so whole blocks are skipped
+			constexpr size_t BLOCK = 1024;
+			size_t shared = std::min(baseline.generations.Size(), m_Generations.Size());
+			for (size_t i = 0; i < shared; i += BLOCK)
+			{
+				size_t blockEnd = std::min(i + BLOCK, shared);
+				if (memcmp(baseline.generations.Data() + i, m_Generations.Data() + i, (blockEnd - i) * sizeof(uint32_t)) == 0)
+					continue;
+
+				for (size_t j = i; j < blockEnd; ++j)
+				{
+					if (baseline.generations[j] != m_Generations[j])
+						AddChangedId(delta, static_cast<Entity>(j), baseline.generations[j], m_Generations[j]);
+				}
+			}
+
+			for (size_t i = shared; i < baseline.generations.Size(); ++i)
+				AddChangedId(delta, static_cast<Entity>(i), baseline.generations[i], 0);
+			for (size_t i = shared; i < m_Generations.Size(); ++i)
+				AddChangedId(delta, static_cast<Entity>(i), 0, m_Generations[i]);
+
+			delta.freeListChanged = baseline.freeList.Size() != freeList.Size() ||
+				(!freeList.Empty() && memcmp(baseline.freeList.Data(), freeList.Data(), freeList.Size() * sizeof(Entity)) != 0);
+			if (delta.freeListChanged)
+			{
+				for (Entity e : baseline.freeList)
+					delta.freeListBefore.PushBack(e);
+				for (Entity e : freeList)
+					delta.freeListAfter.PushBack(e);
+			}
+		}
+
+		// Checks a delta, possibly read from an untrusted source, before Apply. Ids past the current
+		// count must be listed in the delta, as Diff lists every id it adds, and the free list it sets
+		// must name distinct ids below its count. Dropping ids takes a new free list without them.
+		[[nodiscard]] bool Accepts(const EntityDelta& delta, bool revert) const
+		{
+			if (delta.generationsBefore.Size() != delta.ids.Size() || delta.generationsAfter.Size() != delta.ids.Size())
+				return false;
+
+			uint32_t count = revert ? delta.countBefore : delta.countAfter;
+			if (count > m_Generations.Size() && count - m_Generations.Size() > delta.ids.Size())
+				return false;
+			if (!delta.freeListChanged)
+				return count >= m_Generations.Size() || delta.Empty();
+
+			std::vector<bool> listed(count, false);
+			for (Entity e : revert ? delta.freeListBefore : delta.freeListAfter)
+			{
+				if (e >= count || listed[e])
+					return false;
+				listed[e] = true;
+			}
+			return true;
+		}
+
+		// Moves the entity state to the delta's end state, or back to its start state when reverting.
+		// The delta must pass Accepts.
+		void Apply(const EntityDelta& delta, bool revert)
+		{
+			assert(Accepts(delta, revert));
+			if (delta.Empty())
+				return;
+
+			EndTrim();
+
+			const auto& generations = revert ? delta.generationsBefore : delta.generationsAfter;
+			const auto& freeListFrom = revert ? delta.freeListAfter : delta.freeListBefore;
+			const auto& freeListTo = revert ? delta.freeListBefore : delta.freeListAfter;
+			uint32_t count = revert ? delta.countBefore : delta.countAfter;
+
+			m_Generations.Resize(count, 0);
+			m_Alive.resize(count, true);
+			for (size_t i = 0; i < delta.ids.Size(); ++i)
+			{
+				if (delta.ids[i] < count)
+					m_Generations[delta.ids[i]] = generations[i];
+			}
+
+			if (delta.freeListChanged)
+			{
+				for (Entity e : freeListFrom)
+				{
+					if (e < count)
+						m_Alive[e] = true;
+				}
+
+				m_FreeList.Clear();
+				for (Entity e : freeListTo)
+				{
+					m_Alive[e] = false;
+					m_FreeList.PushBack(e);
+				}
+			}
+		}
+
+	private:
+		// Progress of the id trimming Compact spreads over calls. The dead ids above the highest live one
+		// are found scanning down from top, then moved out of the free list into m_Trimmed, where Create
+		// doesn't recycle them; once all of them are there the ids are cut in one go.
+		struct TrimPass
+		{
+			size_t top = SIZE_MAX;  // id count the pass started from, SIZE_MAX when none is under way
+			size_t count = 0;       // the ids from count to top were found dead
+			size_t filtered = 0;    // free list entries checked so far
+			bool scanned = false;
+		};
+
+		// Returns true once a trimming pass is finished, or with !trimIds once none is under way
+		bool Trim(bool trimIds, Core::CompactBudget& budget)
+		{
+			// ids created since the pass started, or the pass being called off, put the ids it set aside back
+			size_t size = m_Generations.Size();
+			if (!trimIds || m_Trim.top != size)
+			{
+				if (!Restore(budget))
+					return false;
+				m_Trim = TrimPass{ size, size, 0, false };
+				if (!trimIds)
+					return true;
+			}
+
+			if (!m_Trim.scanned)
+			{
+				size_t end = m_Trim.count - std::min(m_Trim.count, budget.Left());
+				size_t count = m_Trim.count;
+				while (count > end && !m_Alive[count - 1])
+					--count;
+				budget.work += m_Trim.count - count;
+				m_Trim.count = count;
+				if (count != 0 && !m_Alive[count - 1])
+					return false;
+
+				m_Trim.scanned = true;
+				m_Trimmed.Reserve(m_Trim.top - m_Trim.count);
+			}
+
+			size_t dead = m_Trim.top - m_Trim.count;
+			size_t steps = budget.Left();
+			m_Trim.filtered = std::min(m_Trim.filtered, m_FreeList.Size());
+			while (m_Trimmed.Size() < dead && m_Trim.filtered < m_FreeList.Size() && steps > 0)
+			{
+				--steps;
+				Entity e = m_FreeList[m_Trim.filtered];
+				if (e < m_Trim.count)
+				{
+					++m_Trim.filtered;
+					continue;
+				}
+				m_Trimmed.PushBack(e);
+				m_FreeList[m_Trim.filtered] = m_FreeList.Back();
+				m_FreeList.PopBack();
+			}
+			budget.work += budget.Left() - steps;
+			if (m_Trimmed.Size() < dead && m_Trim.filtered < m_FreeList.Size())
+				return false;
+
+			// every id from count up sits in m_Trimmed unless one was recycled while the free list was
+			// being filtered, in which case the pass ends without trimming
+			if (m_Trimmed.Size() == dead)
+			{
+				m_Generations.Resize(m_Trim.count);
+				m_Alive.resize(m_Trim.count);
+			}
+			else if (!Restore(budget))
+				return false;
+
+			// the set aside ids only needed a buffer for the duration of the pass
+			m_Trimmed = DynamicArray<Entity>(0);
+			m_Trim = TrimPass{};
+			return true;
+		}
+
+		// Moves the ids a trimming pass set aside back to the free list, returns true once they all are
+		bool Restore(Core::CompactBudget& budget)
+		{
+			size_t moves = std::min(m_Trimmed.Size(), budget.Left());
+			for (size_t i = 0; i < moves; ++i)
+			{
+				m_FreeList.PushBack(m_Trimmed.Back());
+				m_Trimmed.PopBack();
+			}
+			budget.work += moves;
+			return m_Trimmed.Empty();
+		}
+
+		// Calls off a trimming pass whatever it costs, before the ids or the free list are rewritten
+		inline void EndTrim()
+		{
+			for (Entity e : m_Trimmed)
+				m_FreeList.PushBack(e);
+			m_Trimmed.Clear();
+			m_Trim = TrimPass{};
+		}
+
+		// The free list, with the ids a trimming pass set aside appended in scratch if there are any
+		const DynamicArray<Entity>& FreeIds(DynamicArray<Entity>& scratch) const
+		{
+			if (m_Trimmed.Empty())
+				return m_FreeList;
+
+			scratch.Reserve(m_FreeList.Size() + m_Trimmed.Size());
+			for (Entity e : m_FreeList)
+				scratch.PushBack(e);
+			for (Entity e : m_Trimmed)
+				scratch.PushBack(e);
+			return scratch;
+		}
+
+		static void AddChangedId(EntityDelta& delta, Entity e, uint32_t before, uint32_t after)
+		{
+			delta.ids.PushBack(e);
+			delta.generationsBefore.PushBack(before);
+			delta.generationsAfter.PushBack(after);
+		}
+
+		DynamicArray<uint32_t> m_Generations;
+		std::vector<bool> m_Alive;
+		DynamicArray<Entity> m_FreeList;
+		DynamicArray<Entity> m_Trimmed{ 0 };
+		TrimPass m_Trim;
+	};
+
+} // namespace Composia 
+
+#include <concepts> // std::convertible_to
+
+using Composia::Core::SparseSet;
+using Composia::Core::BitSet;
+using Composia::Core::HashedSet;
+using Composia::Core::Signal;
+using Composia::Core::Sink;
+using Composia::Core::OutputArchive;
+using Composia::Core::InputArchive;
+
+
+
+namespace Composia {
+
+	// Empty types are tags: their pools only track membership and keep no dense value array
+	template<typename T>
+	inline constexpr bool IsTag = std::is_empty_v<T>;
+
+	enum class StoragePolicy
+	{
+		SparseSet, // sparse + packed entity arrays, plus a dense value array for non-tags
+		Bitset,    // one bit per entity id, for very dense tags
+		HashMap    // open-addressing entity -> index table instead of a sparse array, for very rare components
+	};
+
+	// Specialize to choose how a component type is stored, e.g.
+	// template<> struct Composia::ComponentTraits<Visible> { static constexpr auto Storage = StoragePolicy::Bitset; };
+	template<typename T>
+	struct ComponentTraits
+	{
+		static constexpr StoragePolicy Storage = StoragePolicy::SparseSet;
+	};
+
+	template<typename T>
+	inline constexpr bool UsesBitset = ComponentTraits<T>::Storage == StoragePolicy::Bitset;
+
+	// Snapshots copy trivially copyable components as raw blocks. Other components need a
+	// specialization of this hook to be saved, pools of types without one are skipped:
+	// template<> struct Composia::ComponentSerializer<Name> {
+	//     static void Save(OutputArchive& archive, const Name& value);
+	//     static bool Load(InputArchive& archive, Name& value);
+	// };
+	template<typename T>
+	struct ComponentSerializer {};
+
+	template<typename T>
+	inline constexpr bool HasSerializer = requires(OutputArchive& out, InputArchive& in, const T& saved, T& loaded)
+	{
+		ComponentSerializer<T>::Save(out, saved);
+		{ ComponentSerializer<T>::Load(in, loaded) } -> std::convertible_to<bool>;
+	};
+
+	// Identity and memory layout of a component type as recorded in snapshots
+	struct ComponentLayout
+	{
+		uint64_t typeHash;
+		uint32_t size;
+		uint32_t alignment;
+		uint32_t storage;
+	};
+
+	template<typename T>
+	inline constexpr bool IsSerializable = IsTag<T> ||
+		(std::is_default_constructible_v<T> && (std::is_trivially_copyable_v<T> || HasSerializer<T>));
+
+	// Delta snapshots compare and copy components as raw bytes
+	template<typename T>
+	inline constexpr bool IsDeltaTracked = IsTag<T> ||
+		(std::is_default_constructible_v<T> && std::is_trivially_copyable_v<T>);
+
+	template<typename T>
+	class ComponentPool
+	{
+	public:
+		static_assert(!UsesBitset<T> || IsTag<T>, "Bitset storage only holds tag components");
+
+		using ComponentType = T;
+		using ValueType = std::conditional_t<IsTag<T>, void, T>;
+		using StorageType = std::conditional_t<UsesBitset<T>, BitSet,
+			std::conditional_t<ComponentTraits<T>::Storage == StoragePolicy::HashMap, HashedSet<ValueType>, SparseSet<ValueType>>>;
+
+		ComponentPool() = default;
+
+		inline bool Has(Entity e) const noexcept
+		{
+			return m_Set.Has(e);
+		}
+
+		// Bit i of mask (64 entities per word) is set when entities[i] has a T, see SparseSet::HasBatch
+		inline void HasBatch(const Entity* entities, size_t count, uint64_t* mask) const noexcept
+		{
+			m_Set.HasBatch(entities, count, mask);
+		}
+
+		inline void Add(Entity e, const T& value) noexcept
+		{
+			Unshare();
+			if (m_ListenerCount == 0) [[likely]]
+			{
+				Store(e, value);
+				return;
+			}
+
+			bool existed = m_Set.Has(e);
+			Store(e, value);
+			PublishEmplaced(e, existed);
+		}
+
+		template<typename... Args>
+		void Emplace(Entity e, Args&&... args) noexcept
+		{
+			static_assert(!IsTag<T> || sizeof...(Args) == 0, "Tag components are emplaced without arguments");
+
+			Unshare();
+			if (m_ListenerCount == 0) [[likely]]
+			{
+				EmplaceStore(e, std::forward<Args>(args)...);
+				return;
+			}
+
+			bool existed = m_Set.Has(e);
+			EmplaceStore(e, std::forward<Args>(args)...);
+			PublishEmplaced(e, existed);
+		}
+
+		// Bulk insert, entities that already own the component get value assigned
+		void Insert(const Entity* entities, size_t count, const T& value)
+		{
+			Unshare();
+			if constexpr (!UsesBitset<T>)
+				m_Set.Reserve(m_Set.Size() + count);
+
+			if (m_ListenerCount == 0) [[likely]]
+			{
+				for (size_t i = 0; i < count; ++i)
+					Store(entities[i], value);
+				return;
+			}
+
+			// sparse sets append newly constructed entities to the packed array, unless disabled
+			// entities sit at its end and get swapped behind them
+			bool appended = false;
+			if constexpr (!UsesBitset<T>)
+				appended = m_Set.EnabledSize() == m_Set.Size();
+
+			DynamicArray<Entity> constructed(0);
+			size_t firstInserted = m_Set.Size();
+			for (size_t i = 0; i < count; ++i)
+			{
+				bool existed = m_Set.Has(entities[i]);
+				Store(entities[i], value);
+				if (existed)
+					m_OnUpdate.Publish(entities[i]);
+				else if (!appended)
+					constructed.PushBack(entities[i]);
+			}
+
+			const Entity* inserted = constructed.Data();
+			if (appended)
+				inserted = m_Set.RawPacked().Data() + firstInserted;
+
+			size_t insertedCount = m_Set.Size() - firstInserted;
+			for (size_t i = 0; i < insertedCount; ++i)
+				m_OnConstruct.Publish(inserted[i]);
+			if (insertedCount > 0)
+				m_OnConstructBatch.Publish(inserted, insertedCount);
+		}
+
+		inline void Remove(Entity e)
+		{
+			Unshare();
+			if (m_ListenerCount != 0) [[unlikely]]
+			{
+				if (!m_Set.Has(e)) return;
+
+				// published before removal so listeners can still read the component
+				m_OnDestroy.Publish(e);
+				m_OnDestroyBatch.Publish(&e, 1);
+			}
+			m_Set.Remove(e);
+		}
+
+		void Remove(const Entity* entities, size_t count)
+		{
+			Unshare();
+			if (m_ListenerCount != 0) [[unlikely]]
+			{
+				DynamicArray<Entity> removed(count);
+				for (size_t i = 0; i < count; ++i)
+				{
+					if (m_Set.Has(entities[i]))
+					{
+						m_OnDestroy.Publish(entities[i]);
+						removed.PushBack(entities[i]);
+					}
+				}
+				if (!removed.Empty())
+					m_OnDestroyBatch.Publish(removed.Data(), removed.Size());
+
+				for (Entity e : removed)
+					m_Set.Remove(e);
+				return;
+			}
+
+			for (size_t i = 0; i < count; ++i)
+				m_Set.Remove(entities[i]);
+		}
+
+		// Tags have no storage to point at, query them with Has instead
+		[[nodiscard]] inline T* Get(Entity e) noexcept requires (!IsTag<T>)
+		{
+			if (!Has(e)) return nullptr;
+			Unshare();
+			return m_Set.Get(e);
+		}
+
+		// Fills out[i] with the component of entities[i], nullptr where there is none. The sparse and
+		// dense slots of later entities are prefetched while earlier ones are read, so random lookups
+		// overlap their cache misses instead of taking them one after another.
+		void GetMany(const Entity* entities, size_t count, T** out) noexcept requires (!IsTag<T>)
+		{
+			Unshare();
+			constexpr size_t DISTANCE = Core::PREFETCH_DISTANCE;
+			size_t i = 0;
+			for (; i + 2 * DISTANCE < count; ++i)
+			{
+				m_Set.PrefetchSparse(entities[i + 2 * DISTANCE]);
+				m_Set.PrefetchDense(entities[i + DISTANCE]);
+				out[i] = m_Set.Get(entities[i]);
+			}
+			for (; i + DISTANCE < count; ++i)
+			{
+				m_Set.PrefetchDense(entities[i + DISTANCE]);
+				out[i] = m_Set.Get(entities[i]);
+			}
+			for (; i < count; ++i)
+				out[i] = m_Set.Get(entities[i]);
+		}
+
+		// Cache hints for a coming lookup of e, see SparseSet::PrefetchSparse
+		inline void PrefetchSparse(Entity e) const noexcept
+		{
+			m_Set.PrefetchSparse(e);
+		}
+
+		inline void PrefetchDense(Entity e) const noexcept
+		{
+			m_Set.PrefetchDense(e);
+		}
+
+		[[nodiscard]] inline const DynamicArray<T>& RawDense() const noexcept requires (!IsTag<T>)
+		{
+			return m_Set.RawDense();
+		}
+
+		// Bitset pools have no packed array, iterate them with Each or RawWords.
+		// The first EnabledSize() entities are the enabled ones.
+		[[nodiscard]] inline const DynamicArray<Entity>& RawEntities() const noexcept requires (!UsesBitset<T>)
+		{
+			return m_Set.RawPacked();
+		}
+
+		[[nodiscard]] inline const DynamicArray<uint64_t>& RawWords() const noexcept requires UsesBitset<T>
+		{
+			return m_Set.RawWords();
+		}
+
+		// Calls func(entity) for every entity in the pool, whatever the storage
+		template<typename Func>
+		void Each(Func&& func) const
+		{
+			if constexpr (UsesBitset<T>)
+			{
+				m_Set.Each(std::forward<Func>(func));
+			}
+			else
+			{
+				for (Entity e : m_Set.RawPacked())
+					func(e);
+			}
+		}
+
+		[[nodiscard]] inline size_t Size() const noexcept
+		{
+			return m_Set.Size();
+		}
+
+		// Moves e's component behind the enabled ones, where views don't look. No signals are published.
+		// Bitset pools have no order to split, views mask their words with the disabled set instead.
+		inline void Disable(Entity e)
+		{
+			if constexpr (!UsesBitset<T>)
+			{
+				Unshare();
+				m_Set.Disable(e);
+			}
+		}
+
+		inline void Enable(Entity e)
+		{
+			if constexpr (!UsesBitset<T>)
+			{
+				Unshare();
+				m_Set.Enable(e);
+			}
+		}
+
+		// Number of components of enabled entities, they come first in RawEntities/RawDense
+		[[nodiscard]] inline size_t EnabledSize() const noexcept requires (!UsesBitset<T>)
+		{
+			return m_Set.EnabledSize();
+		}
+
+		// Reorders the pool so iteration follows compare, which takes two components or two entities
+		// (tags only have the latter). Membership does not change, so no signals are published.
+		template<typename Compare>
+		void Sort(Compare compare) requires (!UsesBitset<T>)
+		{
+			DynamicArray<uint32_t> order(Size());
+			order.Resize(Size());
+			std::iota(order.begin(), order.end(), 0u);
+
+			if constexpr (!IsTag<T> && std::is_invocable_r_v<bool, Compare&, const T&, const T&>)
+			{
+				const DynamicArray<T>& dense = RawDense();
+				std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return compare(dense[a], dense[b]); });
+			}
+			else
+			{
+				const DynamicArray<Entity>& packed = m_Set.RawPacked();
+				std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return compare(packed[a], packed[b]); });
+			}
+			Reorder(order);
+		}
+
+		// Sorts by an integer returned by key(component) or key(entity). Radix sorted, so linear in the
+		// pool size and cheap enough to run every frame, e.g. on a render layer or spatial cell.
+		template<typename KeyFunc>
+		void SortByKey(KeyFunc key) requires (!UsesBitset<T>)
+		{
+			constexpr bool byValue = !IsTag<T> && std::is_invocable_v<KeyFunc&, const T&>;
+			using KeyType = std::decay_t<decltype(SortKey<byValue>(key, 0))>;
+
+			DynamicArray<KeyType> keys(Size());
+			for (uint32_t i = 0; i < Size(); ++i)
+				keys.PushBack(SortKey<byValue>(key, i));
+
+			DynamicArray<uint32_t> order(0);
+			Core::RadixOrder(keys, order);
+			Reorder(order);
+		}
+
+		// Moves the entities this pool shares with other to the front, in other's order, and keeps the rest
+		// behind them in their current order. A view driven by other then reads this pool front to back.
+		template<typename U>
+		void SortAs(const ComponentPool<U>& other) requires (!UsesBitset<T>)
+		{
+			const DynamicArray<Entity>& packed = m_Set.RawPacked();
+			DynamicArray<uint32_t> order(Size());
+			other.Each([&](Entity e) {
+				if (m_Set.Has(e))
+					order.PushBack(m_Set.Index(e));
+				});
+			for (uint32_t i = 0; i < Size(); ++i)
+			{
+				if (!other.Has(packed[i]))
+					order.PushBack(i);
+			}
+			Reorder(order);
+		}
+
+		// Removes every component, publishing OnDestroy for each of them
+		void Clear()
+		{
+			if (m_ListenerCount != 0) [[unlikely]]
+			{
+				DynamicArray<Entity> entities(Size());
+				Each([&](Entity e) { entities.PushBack(e); });
+				for (Entity e : entities)
+					m_OnDestroy.Publish(e);
+				if (!entities.Empty())
+					m_OnDestroyBatch.Publish(entities.Data(), entities.Size());
+			}
+			Unshare();
+			m_Set.Clear();
+		}
+
+		// Writes the packed entities and the dense values as contiguous blocks. Archives with a block
+		// alignment (world images) also carry the sparse array so it can be mapped instead of rebuilt.
+		bool Save(OutputArchive& archive) const
+		{
+			if constexpr (!IsSerializable<T>)
+			{
+				return false;
+			}
+			else if constexpr (UsesBitset<T>)
+			{
+				archive.WriteArray(m_Set.RawWords());
+				return true;
+			}
+			else
+			{
+				archive.WriteArray(m_Set.RawPacked());
+				if constexpr (!IsTag<T>)
+				{
+					if constexpr (std::is_trivially_copyable_v<T>)
+					{
+						archive.WriteArray(RawDense());
+					}
+					else
+					{
+						for (const T& value : RawDense())
+							ComponentSerializer<T>::Save(archive, value);
+					}
+				}
+
+				if constexpr (ComponentTraits<T>::Storage == StoragePolicy::SparseSet)
+				{
+					if (archive.BlockAlignment() != 0)
+						archive.WriteArray(m_Set.RawSparse());
+				}
+				return true;
+			}
+		}
+
+		// Replaces the pool content with a block written by Save, by a pool of this type stored as saved.
+		// Blocks of a mapped archive are used in place when possible, see InputArchive::ReadArray.
+		// Listeners see the old components destroyed and the loaded ones constructed.
+		bool Load(InputArchive& archive, StoragePolicy saved = ComponentTraits<T>::Storage)
+		{
+			if constexpr (!IsSerializable<T>)
+			{
+				return false;
+			}
+			else
+			{
+				Clear();
+
+				bool loaded = LoadStorage(archive, saved);
+				if (loaded)
+					PublishLoaded();
+				return loaded;
+			}
+		}
+
+		// Replaces the pool content with the components Load read into loaded, a pool discarded afterwards.
+		// Listeners see the old components destroyed and the new ones constructed, as with Load.
+		void Take(ComponentPool&& loaded)
+		{
+			Clear();
+			m_Set = std::move(loaded.m_Set);
+			m_Shared = false;
+			PublishLoaded();
+		}
+
+		// Replaces the components with a copy of source's. Listeners are not copied.
+		void CopyFrom(const ComponentPool& source)
+		{
+			m_Set = source.m_Set;
+			m_Shared = false;
+		}
+
+		// Like CopyFrom, but the arrays are shared with source until either pool is modified,
+		// at which point that pool copies them (see DynamicArray::Share)
+		void ShareFrom(ComponentPool& source)
+		{
+			m_Set = source.m_Set.Share();
+			m_Shared = source.m_Shared = true;
+		}
+
+		// Copies the arrays shared with a CloneShared copy, if any. Every write and every Get does this
+		// first; views call it before reading the pool's arrays, which it may reallocate.
+		inline void Unshare()
+		{
+			if (m_Shared) [[unlikely]]
+			{
+				m_Set.Detach();
+				m_Shared = false;
+			}
+		}
+
+		// Gives back memory the pool no longer needs, see Registry::Compact. Pools sharing their
+		// arrays with a CloneShared copy are skipped until they are written to. Returns false when budget
+		// ran out inside the pool, the next call picks up where this one stopped.
+		bool Compact(Core::CompactBudget& budget)
+		{
+			if (m_Shared)
+				return true;
+			return m_Set.Compact(budget);
+		}
+
+		// Renames every entity e to remap[e], see Registry::Defragment. No signals are published.
+		void Remap(const DynamicArray<Entity>& remap, size_t entityCount)
+		{
+			Unshare();
+			m_Set.Remap(remap, entityCount);
+		}
+
+		// Bytes used and reserved by the pool's arrays
+		[[nodiscard]] PoolMemory Memory() const noexcept
+		{
+			PoolMemory memory;
+			memory.typeName = Core::TypeName<T>();
+			memory.typeId = TypeId<T>;
+			memory.count = Size();
+
+			if constexpr (UsesBitset<T>)
+			{
+				memory.sparse = ArrayMemory::Of(m_Set.RawWords());
+			}
+			else
+			{
+				memory.packed = ArrayMemory::Of(m_Set.RawPacked());
+				if constexpr (!IsTag<T>)
+					memory.dense = ArrayMemory::Of(m_Set.RawDense());
+				if constexpr (ComponentTraits<T>::Storage == StoragePolicy::HashMap)
+					memory.sparse = ArrayMemory::Of(m_Set.RawSlots());
+				else
+					memory.sparse = ArrayMemory::Of(m_Set.RawSparse());
+			}
+			return memory;
+		}
+
+		// Copies the pool into state as the baseline for later Diff calls
+		void Capture(PoolState& state) const requires IsDeltaTracked<T>
+		{
+			state = PoolState(Layout().typeHash, Layout().size);
+			if constexpr (!IsTag<T>)
+			{
+				state.Assign(m_Set.RawPacked().Data(), RawDense().Data(), Size());
+			}
+			else
+			{
+				DynamicArray<Entity> entities(Size());
+				Each([&](Entity e) { entities.PushBack(e); });
+				state.Assign(entities.Data(), nullptr, entities.Size());
+			}
+		}
+
+		// Records what was added, removed and changed since baseline. Changes are found by comparing bytes.
+		void Diff(const PoolState& baseline, PoolDelta& delta) const requires IsDeltaTracked<T>
+		{
+			constexpr size_t valueSize = Layout().size;
+			delta.typeHash = Layout().typeHash;
+			delta.valueSize = valueSize;
+			size_t addedBefore = delta.added.Size();
+
+			auto visit = [&](Entity e, const void* value) {
+				if (!baseline.Has(e))
+				{
+					delta.added.PushBack(e);
+					AppendBytes(delta.addedValues, value, valueSize);
+				}
+				else if (valueSize > 0 && memcmp(baseline.Value(e), value, valueSize) != 0)
+				{
+					delta.changed.PushBack(e);
+					AppendBytes(delta.changedBefore, baseline.Value(e), valueSize);
+					AppendBytes(delta.changedAfter, value, valueSize);
+				}
+				};
+
+			if constexpr (!IsTag<T>)
+			{
+				const Entity* packed = m_Set.RawPacked().Data();
+				const T* dense = RawDense().Data();
+				const Entity* before = baseline.Entities().Data();
+				const uint8_t* beforeValues = baseline.Values().Data();
+
+				// rows that kept their entity are compared a block at a time, usually most of the pool
+				constexpr size_t BLOCK = 256;
+				size_t unmoved = std::min(Size(), baseline.Entities().Size());
+				size_t i = 0;
+				for (; i + BLOCK <= unmoved; i += BLOCK)
+				{
+					if (memcmp(packed + i, before + i, BLOCK * sizeof(Entity)) == 0 &&
+						memcmp(dense + i, beforeValues + i * valueSize, BLOCK * valueSize) == 0)
+						continue;
+
+					for (size_t j = i; j < i + BLOCK; ++j)
+					{
+						if (packed[j] != before[j])
+							visit(packed[j], &dense[j]);
+						else if (memcmp(&dense[j], beforeValues + j * valueSize, valueSize) != 0)
+							visit(packed[j], &dense[j]);
+					}
+				}
+				for (; i < Size(); ++i)
+					visit(packed[i], &dense[i]);
+			}
+			else
+			{
+				Each([&](Entity e) { visit(e, nullptr); });
+			}
+
+			// every baseline entity is still present unless some were replaced by the added ones
+			if (Size() - (delta.added.Size() - addedBefore) == baseline.Entities().Size())
+				return;
+
+			for (Entity e : baseline.Entities())
+			{
+				if (!m_Set.Has(e))
+				{
+					delta.removed.PushBack(e);
+					AppendBytes(delta.removedValues, baseline.Value(e), valueSize);
+				}
+			}
+		}
+
+		// Moves the pool to the delta's end state, or back to its start state when reverting. Goes through
+		// Add and Remove, so listeners see the changes as regular construct, update and destroy events.
+		void Apply(const PoolDelta& delta, bool revert) requires IsDeltaTracked<T>
+		{
+			auto store = [this](Entity e, const uint8_t* bytes) {
+				if constexpr (IsTag<T>)
+				{
+					Emplace(e);
+				}
+				else
+				{
+					T value;
+					memcpy(&value, bytes, sizeof(T));
+					Add(e, value);
+				}
+				};
+
+			const auto& gone = revert ? delta.added : delta.removed;
+			const auto& back = revert ? delta.removed : delta.added;
+			const auto& backValues = revert ? delta.removedValues : delta.addedValues;
+			const auto& changedValues = revert ? delta.changedBefore : delta.changedAfter;
+
+			for (Entity e : gone)
+				Remove(e);
+			for (size_t i = 0; i < back.Size(); ++i)
+				store(back[i], backValues.Data() + i * delta.valueSize);
+			for (size_t i = 0; i < delta.changed.Size(); ++i)
+				store(delta.changed[i], changedValues.Data() + i * delta.valueSize);
+		}
+
+		// Layout the pool's blocks are written with, stored in snapshots to validate them on load
+		[[nodiscard]] static constexpr ComponentLayout Layout() noexcept
+		{
+			return ComponentLayout{
+				TypeId<T>,
+				IsTag<T> ? 0u : static_cast<uint32_t>(sizeof(T)),
+				static_cast<uint32_t>(alignof(T)),
+				static_cast<uint32_t>(ComponentTraits<T>::Storage)
+			};
+		}
+
+		// Fired after a component is added to an entity that did not own one
+		[[nodiscard]] inline Sink<Entity> OnConstruct() noexcept
+		{
+			return { m_OnConstruct, m_ListenerCount };
+		}
+
+		// Fired after an existing component is replaced through Add/Emplace/Insert
+		[[nodiscard]] inline Sink<Entity> OnUpdate() noexcept
+		{
+			return { m_OnUpdate, m_ListenerCount };
+		}
+
+		// Fired before a component is removed, including removals done by Registry::Destroy
+		[[nodiscard]] inline Sink<Entity> OnDestroy() noexcept
+		{
+			return { m_OnDestroy, m_ListenerCount };
+		}
+
+		// Batch variants receive every constructed/destroyed entity as well, as contiguous arrays
+		[[nodiscard]] inline Sink<const Entity*, size_t> OnConstructBatch() noexcept
+		{
+			return { m_OnConstructBatch, m_ListenerCount };
+		}
+
+		[[nodiscard]] inline Sink<const Entity*, size_t> OnDestroyBatch() noexcept
+		{
+			return { m_OnDestroyBatch, m_ListenerCount };
+		}
+
+	private:
+
+		// Moves the element at packed index order[i] to index i. Disabled elements stay behind the
+		// enabled ones, both keeping the relative order they have in order.
+		inline void Reorder(DynamicArray<uint32_t>& order)
+		{
+			Unshare();
+			uint32_t enabled = static_cast<uint32_t>(m_Set.EnabledSize());
+			if (enabled != Size())
+				std::stable_partition(order.begin(), order.end(), [enabled](uint32_t index) { return index < enabled; });
+			m_Set.Permute(order);
+		}
+
+		template<bool ByValue, typename KeyFunc>
+		inline auto SortKey(KeyFunc& key, uint32_t index) const
+		{
+			if constexpr (ByValue)
+				return key(RawDense()[index]);
+			else
+				return key(m_Set.RawPacked()[index]);
+		}
+
+		inline void PublishLoaded()
+		{
+			if (m_ListenerCount == 0) [[likely]]
+				return;
+
+			DynamicArray<Entity> entities(Size());
+			Each([&](Entity e) { entities.PushBack(e); });
+			for (Entity e : entities)
+				m_OnConstruct.Publish(e);
+			if (!entities.Empty())
+				m_OnConstructBatch.Publish(entities.Data(), entities.Size());
+		}
+
+		bool LoadStorage(InputArchive& archive, StoragePolicy saved)
+		{
+			if constexpr (UsesBitset<T>)
+			{
+				DynamicArray<uint64_t> words(0);
+				if (!archive.ReadArray(words))
+					return false;
+
+				m_Set.Assign(std::move(words));
+				return true;
+			}
+			else
+			{
+				DynamicArray<Entity> packed(0);
+				if (!archive.ReadArray(packed))
+					return false;
+
+				DynamicArray<std::conditional_t<IsTag<T>, char, T>> dense(0);
+				if constexpr (!IsTag<T>)
+				{
+					if constexpr (std::is_trivially_copyable_v<T>)
+					{
+						if (!archive.ReadArray(dense) || dense.Size() != packed.Size())
+							return false;
+					}
+					else
+					{
+						dense.Resize(packed.Size());
+						for (T& value : dense)
+						{
+							if (!ComponentSerializer<T>::Load(archive, value))
+								return false;
+						}
+					}
+				}
+
+				// images of sparse set pools end with the sparse array, used only if it maps exactly
+				// the loaded keys and rebuilt otherwise
+				DynamicArray<uint32_t> sparse(0);
+				if (saved == StoragePolicy::SparseSet && archive.BlockAlignment() != 0 && !archive.ReadArray(sparse))
+					return false;
+
+				if constexpr (ComponentTraits<T>::Storage == StoragePolicy::SparseSet)
+				{
+					if (!sparse.Empty() && Core::SparseMatches(packed, sparse))
+					{
+						if constexpr (IsTag<T>)
+							m_Set.Assign(std::move(packed), std::move(sparse));
+						else
+							m_Set.Assign(std::move(packed), std::move(dense), std::move(sparse));
+						return true;
+					}
+				}
+
+				if constexpr (IsTag<T>)
+					m_Set.Assign(std::move(packed));
+				else
+					m_Set.Assign(std::move(packed), std::move(dense));
+				return true;
+			}
+		}
+
+		inline void Store(Entity e, const T& value)
+		{
+			if constexpr (IsTag<T>)
+				m_Set.Add(e);
+			else
+				m_Set.Add(e, value);
+		}
+
+		template<typename... Args>
+		inline void EmplaceStore(Entity e, Args&&... args)
+		{
+			if constexpr (IsTag<T>)
+				m_Set.Add(e);
+			else
+				m_Set.Emplace(e, std::forward<Args>(args)...);
+		}
+
+		inline void PublishEmplaced(Entity e, bool existed)
+		{
+			if (existed)
+			{
+				m_OnUpdate.Publish(e);
+				return;
+			}
+
+			m_OnConstruct.Publish(e);
+			m_OnConstructBatch.Publish(&e, 1);
+		}
+
+		StorageType m_Set;
+		bool m_Shared = false;
+
+		uint32_t m_ListenerCount = 0;
+		Signal<Entity> m_OnConstruct;
+		Signal<Entity> m_OnUpdate;
+		Signal<Entity> m_OnDestroy;
+		Signal<const Entity*, size_t> m_OnConstructBatch;
+		Signal<const Entity*, size_t> m_OnDestroyBatch;
+	};
+
+	// Type-erased component pool interface
+	struct IComponentPool
+	{
+		virtual ~IComponentPool() = default;
+		virtual void Remove(Entity e) noexcept = 0;
+		virtual bool Has(Entity e) const noexcept = 0;
+		virtual void Disable(Entity e) = 0;
+		virtual void Enable(Entity e) = 0;
+		virtual size_t Size() const noexcept = 0;
+		virtual void Clear() = 0;
+		virtual std::string_view TypeName() const noexcept = 0;
+		virtual PoolMemory Memory() const noexcept = 0;
+		virtual bool Compact(Core::CompactBudget& budget) = 0;
+		virtual void Remap(const DynamicArray<Entity>& remap, size_t entityCount) = 0;
+
+		virtual ComponentLayout Layout() const noexcept = 0;
+		virtual bool Serializable() const noexcept = 0;
+		virtual bool Save(OutputArchive& archive) const = 0;
+		virtual bool Load(InputArchive& archive, StoragePolicy saved) = 0;
+		// An empty pool of the same type, filled by Load and then handed to Take
+		virtual std::unique_ptr<IComponentPool> Empty() const = 0;
+		virtual void Take(IComponentPool& loaded) = 0;
+
+		virtual bool DeltaTracked() const noexcept = 0;
+		virtual void Capture(PoolState& state) const = 0;
+		virtual void Diff(const PoolState& baseline, PoolDelta& delta) const = 0;
+		virtual void Apply(const PoolDelta& delta, bool revert) = 0;
+
+		// nullptr for components that are not copy constructible
+		virtual std::unique_ptr<IComponentPool> Clone() const = 0;
+		virtual std::unique_ptr<IComponentPool> Share() = 0;
+	};
+
+	template<typename T>
+	struct ComponentPoolWrapper : IComponentPool
+	{
+		ComponentPool<T> pool;
+		void Remove(Entity e) noexcept override
+		{
+			pool.Remove(e);
+		}
+
+		bool Has(Entity e) const noexcept override
+		{
+			return pool.Has(e);
+		}
+
+		void Disable(Entity e) override
+		{
+			pool.Disable(e);
+		}
+
+		void Enable(Entity e) override
+		{
+			pool.Enable(e);
+		}
+
+		size_t Size() const noexcept override
+		{
+			return pool.Size();
+		}
+
+		void Clear() override
+		{
+			pool.Clear();
+		}
+
+		std::string_view TypeName() const noexcept override
+		{
+			return Core::TypeName<T>();
+		}
+
+		PoolMemory Memory() const noexcept override
+		{
+			return pool.Memory();
+		}
+
+		bool Compact(Core::CompactBudget& budget) override
+		{
+			return pool.Compact(budget);
+		}
+
+		void Remap(const DynamicArray<Entity>& remap, size_t entityCount) override
+		{
+			pool.Remap(remap, entityCount);
+		}
+
+		ComponentLayout Layout() const noexcept override
+		{
+			return ComponentPool<T>::Layout();
+		}
+
+		bool Serializable() const noexcept override
+		{
+			return IsSerializable<T>;
+		}
+
+		bool Save(OutputArchive& archive) const override
+		{
+			return pool.Save(archive);
+		}
+
+		bool Load(InputArchive& archive, StoragePolicy saved) override
+		{
+			return pool.Load(archive, saved);
+		}
+
+		std::unique_ptr<IComponentPool> Empty() const override
+		{
+			return std::make_unique<ComponentPoolWrapper<T>>();
+		}
+
+		void Take(IComponentPool& loaded) override
+		{
+			pool.Take(std::move(static_cast<ComponentPoolWrapper<T>&>(loaded).pool));
+		}
+
+		bool DeltaTracked() const noexcept override
+		{
+			return IsDeltaTracked<T>;
+		}
+
+		void Capture(PoolState& state) const override
+		{
+			if constexpr (IsDeltaTracked<T>)
+				pool.Capture(state);
+		}
+
+		void Diff(const PoolState& baseline, PoolDelta& delta) const override
+		{
+			if constexpr (IsDeltaTracked<T>)
+				pool.Diff(baseline, delta);
+		}
+
+		void Apply(const PoolDelta& delta, bool revert) override
+		{
+			if constexpr (IsDeltaTracked<T>)
+				pool.Apply(delta, revert);
+		}
+
+		std::unique_ptr<IComponentPool> Clone() const override
+		{
+			if constexpr (!std::is_copy_constructible_v<T>)
+			{
+				return nullptr;
+			}
+			else
+			{
+				auto copy = std::make_unique<ComponentPoolWrapper<T>>();
+				copy->pool.CopyFrom(pool);
+				return copy;
+			}
+		}
+
+		std::unique_ptr<IComponentPool> Share() override
+		{
+			if constexpr (!std::is_copy_constructible_v<T>)
+			{
+				return nullptr;
+			}
+			else
+			{
+				auto copy = std::make_unique<ComponentPoolWrapper<T>>();
+				copy->pool.ShareFrom(pool);
+				return copy;
+			}
+		}
+	};
+
+} // namespace Composia 
+
+
+using Composia::Core::DynamicArray;
+
+class IComponentPool; // forward declaration
+
+namespace Composia::Core {
+
+	// Map structure for storing ComponentPools by TypeId using robin hood hashing.
+	class PoolMap
+	{
+	private:
+		struct Entry
+		{
+			uint64_t key = 0;
+			std::unique_ptr<IComponentPool> value;
+			size_t probeDistance = 0;
+			bool occupied = false;
+
+			Entry() noexcept : key(0), value(nullptr), probeDistance(0), occupied(false) {}
+		};
+
+		DynamicArray<Entry> m_Buckets;
+		size_t m_Size = 0;
+		float m_LoadFactor = 0.7f;
+
+	private:
+		void Rehash(size_t newCapacity) noexcept
+		{
+			DynamicArray<Entry> oldBuckets = std::move(m_Buckets);
+			m_Buckets.Clear();
+			m_Buckets.Resize(newCapacity);
+			m_Size = 0;
+
+			for (auto& e : oldBuckets)
+			{
+				if (e.occupied)
+					Insert(e.key, std::move(e.value));
+			}
+		}
+	public:
+		PoolMap(size_t capacity = 16)
+		{
+			m_Buckets.Resize(capacity);
+		}
+
+		void Insert(uint64_t key, std::unique_ptr<IComponentPool> value) noexcept
+		{
+			if ((float)(m_Size + 1) / m_Buckets.Size() > m_LoadFactor)
+			{
+				Rehash(m_Buckets.Size() * 2);
+			}
+
+			size_t hash = static_cast<size_t>(key);
+			size_t index = hash % m_Buckets.Size();
+			size_t dist = 0;
+
+			while (true)
+			{
+				Entry& e = m_Buckets[index];
+				if (!e.occupied)
+				{
+					e.key = key;
+					e.value = std::move(value);
+					e.probeDistance = dist;
+					e.occupied = true;
+					++m_Size;
+					return;
+				}
+
+				if (e.key == key) // overwrite
+				{
+					e.value = std::move(value);
+					return;
+				}
+
+				if (e.probeDistance < dist)
+				{
+					std::swap(key, e.key);
+					std::swap(value, e.value);
+					std::swap(dist, e.probeDistance);
+				}
+
+				index = (index + 1) % m_Buckets.Size();
+				++dist;
+			}
+		}
+
+		[[nodiscard]] IComponentPool* Get(uint64_t key) noexcept
+		{
+			size_t hash = static_cast<size_t>(key);
+			size_t index = hash % m_Buckets.Size();
+			size_t dist = 0;
+			COMPOSIA_COUNT(PoolMapLookups, 1);
+
+			while (true)
+			{
+				COMPOSIA_COUNT(PoolMapProbes, 1);
+				Entry& e = m_Buckets[index];
+				if (!e.occupied || dist > m_Buckets.Size())
+					return nullptr;
+
+				if (e.key == key)
+					return e.value.get();
+
+				++dist;
+				index = (index + 1) % m_Buckets.Size();
+			}
+		}
+
+		[[nodiscard]] const IComponentPool* Get(uint64_t key) const noexcept
+		{
+			size_t hash = static_cast<size_t>(key);
+			size_t index = hash % m_Buckets.Size();
+			size_t dist = 0;
+			COMPOSIA_COUNT(PoolMapLookups, 1);
+
+			while (true)
+			{
+				COMPOSIA_COUNT(PoolMapProbes, 1);
+				const auto& e = m_Buckets.At(index);
+				if (!e.occupied || dist > m_Buckets.Size())
+					return nullptr;
+
+				if (e.key == key)
+					return e.value.get();
+
+				++dist;
+				index = (index + 1) % m_Buckets.Size();
+			}
+		}
+
+		[[nodiscard]] size_t Size() const noexcept
+		{
+			return m_Size;
+		}
+
+		[[nodiscard]] const DynamicArray<Entry>& GetBuckets() const noexcept
+		{
+			return m_Buckets;
+		}
+
+	};
+
+} // namespace Composia::Core 
+
+using Composia::Core::PoolMap;
+
+namespace Composia {
+
+	// T's pool resolved once, see Registry::Storage. Calls skip the pool map and go straight to the
+	// sparse lookup. Valid as long as the pool, which moves along with the registry.
+	template<typename T>
+	class StorageHandle
+	{
+	public:
+		StorageHandle(ComponentPool<T>& pool, const BitSet& disabled) noexcept
+			: m_Pool(&pool), m_Disabled(&disabled) {}
+
+		[[nodiscard]] inline T& Get(Entity e) noexcept requires (!IsTag<T>)
+		{
+			return *m_Pool->Get(e);
+		}
+
+		// See ComponentPool::GetMany
+		inline void GetMany(const Entity* entities, size_t count, T** out) noexcept requires (!IsTag<T>)
+		{
+			m_Pool->GetMany(entities, count, out);
+		}
+
+		[[nodiscard]] inline bool Has(Entity e) const noexcept
+		{
+			return m_Pool->Has(e);
+		}
+
+		template<typename... Args>
+		inline void Emplace(Entity e, Args&&... args) noexcept
+		{
+			m_Pool->Emplace(e, std::forward<Args>(args)...);
+			if (m_Disabled->Size() != 0 && m_Disabled->Has(e)) [[unlikely]]
+				m_Pool->Disable(e);
+		}
+
+		inline void Remove(Entity e) noexcept
+		{
+			m_Pool->Remove(e);
+		}
+
+		[[nodiscard]] inline ComponentPool<T>& Pool() const noexcept
+		{
+			return *m_Pool;
+		}
+
+	private:
+		ComponentPool<T>* m_Pool;
+		const BitSet* m_Disabled; // components emplaced for disabled entities start out disabled
+	};
+
+	class ComponentManager
+	{
+	public:
+		ComponentManager() = default;
+
+		// The disabled set goes along with the pools, the moved-from manager keeps an empty one
+		ComponentManager(ComponentManager&& other) noexcept
+		{
+			*this = std::move(other);
+		}
+
+		ComponentManager& operator=(ComponentManager&& other) noexcept
+		{
+			m_Pools = std::move(other.m_Pools);
+			std::swap(m_Disabled, other.m_Disabled);
+			other.m_Disabled->Clear();
+			m_CompactCursor = other.m_CompactCursor;
+			return *this;
+		}
+
+		template<typename T>
+		inline void Add(Entity e, const T& comp) noexcept
+		{
+			auto* wrapper = GetOrCreatePool<T>();
+			wrapper->pool.Add(e, comp);
+			if (m_Disabled->Size() != 0) [[unlikely]]
+				KeepDisabled(wrapper->pool, e);
+		}
+
+		template<typename T, typename... Args>
+		inline void Emplace(Entity e, Args&&... args) noexcept
+		{
+			auto* wrapper = GetOrCreatePool<T>();
+			wrapper->pool.Emplace(e, std::forward<Args>(args)...);
+			if (m_Disabled->Size() != 0) [[unlikely]]
+				KeepDisabled(wrapper->pool, e);
+		}
+
+		template<typename T>
+		inline void Insert(const Entity* entities, size_t count, const T& comp)
+		{
+			auto* wrapper = GetOrCreatePool<T>();
+			wrapper->pool.Insert(entities, count, comp);
+			if (m_Disabled->Size() != 0) [[unlikely]]
+			{
+				for (size_t i = 0; i < count; ++i)
+					KeepDisabled(wrapper->pool, entities[i]);
+			}
+		}
+
+		template<typename T>
+		void Remove(Entity e) noexcept
+		{
+			if (auto existing = LookupPool<T>())
+			{
+				existing->pool.Remove(e);
+			}
+		}
+
+		template<typename T>
+		void Remove(const Entity* entities, size_t count) noexcept
+		{
+			if (auto existing = LookupPool<T>())
+			{
+				existing->pool.Remove(entities, count);
+			}
+		}
+
+		template<typename T>
+		T* Get(Entity e) noexcept
+		{
+			static_assert(!IsTag<T>, "Tag components have no value, query them with Has");
+
+			auto existing = LookupPool<T>();
+			if (!existing)
+			{
+				return nullptr;
+			}
+
+			return existing->pool.Get(e);
+		}
+
+		template<typename T>
+		bool Has(Entity e) noexcept
+		{
+			auto existing = LookupPool<T>();
+			if (!existing)
+				return false;
+
+			return existing->Has(e);
+		}
+
+		template<typename T>
+		ComponentPool<T>* Pool()
+		{
+			auto existing = LookupPool<T>();
+			if (!existing)
+			{
+				return nullptr;
+			}
+
+			return &existing->pool;
+		}
+
+		void RemoveAllForEntity(Entity entity) noexcept
+		{
+			for (size_t i = 0; i < m_Pools.GetBuckets().Size(); ++i)
+			{
+				auto& slot = m_Pools.GetBuckets().At(i);
+				if (slot.occupied && slot.value)
+				{
+					slot.value->Remove(entity);
+				}
+			}
+			m_Disabled->Remove(entity);
+		}
+
+		// Moves the entity's components behind the enabled ones in every pool, see Registry::Disable
+		void Disable(Entity e)
+		{
+			if (m_Disabled->Has(e))
+				return;
+
+			m_Disabled->Add(e);
+			ForEachPool([&](IComponentPool& pool) { pool.Disable(e); });
+		}
+
+		void Enable(Entity e)
+		{
+			if (!m_Disabled->Has(e))
+				return;
+
+			m_Disabled->Remove(e);
+			ForEachPool([&](IComponentPool& pool) { pool.Enable(e); });
+		}
+
+		[[nodiscard]] inline bool IsEnabled(Entity e) const noexcept
+		{
+			return !m_Disabled->Has(e);
+		}
+
+		// One bit per disabled entity, views over bitset pools mask their words with it
+		[[nodiscard]] inline const BitSet& Disabled() const noexcept
+		{
+			return *m_Disabled;
+		}
+
+		// Forgets the disabled state of the entities dead(e) returns true for, e.g. after a delta destroyed them
+		template<typename Dead>
+		void DropDisabled(Dead dead)
+		{
+			if (m_Disabled->Size() == 0)
+				return;
+
+			DynamicArray<Entity> dropped(0);
+			m_Disabled->Each([&](Entity e) {
+				if (dead(e))
+					dropped.PushBack(e);
+				});
+			for (Entity e : dropped)
+				m_Disabled->Remove(e);
+		}
+
+		// Writes every serializable pool as a section tagged with its component layout and byte length
+		void Save(OutputArchive& archive) const
+		{
+			uint32_t sections = 0;
+			ForEachPool([&](const IComponentPool& pool) { sections += pool.Serializable(); });
+			archive.Write(sections);
+
+			ForEachPool([&](const IComponentPool& pool) {
+				if (!pool.Serializable())
+					return;
+
+				ComponentLayout layout = pool.Layout();
+				archive.Write(layout.typeHash);
+				archive.Write(layout.size);
+				archive.Write(layout.alignment);
+				archive.Write(layout.storage);
+
+				// the length is patched in once the section is written. Streams that can't seek back get
+				// it counted first, from the section's real offset so block padding comes out the same.
+				size_t lengthAt = archive.Written();
+				size_t start = lengthAt + sizeof(uint64_t);
+				bool patch = archive.Patchable();
+				uint64_t length = 0;
+				if (!patch)
+				{
+					OutputArchive counter(nullptr, archive.BlockAlignment(), start);
+					pool.Save(counter);
+					length = counter.Written() - start;
+				}
+				archive.Write(length);
+				pool.Save(archive);
+				if (patch)
+					archive.Patch(lengthAt, static_cast<uint64_t>(archive.Written() - start));
+				});
+
+			// pools are saved in packed order, so only which entities were disabled has to be kept
+			archive.WriteArray(m_Disabled->RawWords());
+		}
+
+		// Loads sections written by Save into the existing pools. Sections of types without a pool
+		// are skipped and pools missing from the archive are cleared. A section the running build can't
+		// read, its component size changed or it switched to or from bitset storage, is skipped the same
+		// way. Sections with a different alignment or other storage, or whose mapped blocks don't check
+		// out, are copied instead of being used in place. Sections are read into empty pools first, so
+		// the existing ones are left untouched when the archive turns out to be invalid.
+		bool Load(InputArchive& archive)
+		{
+			uint32_t sections = 0;
+			if (!archive.Read(sections) || !archive.Holds(sections, SECTION_HEADER_BYTES))
+				return false;
+
+			struct Loaded
+			{
+				IComponentPool* pool;
+				std::unique_ptr<IComponentPool> content;
+			};
+			DynamicArray<Loaded> loaded(0);
+			for (uint32_t i = 0; i < sections; ++i)
+			{
+				ComponentLayout layout{};
+				uint64_t size = 0;
+				if (!archive.Read(layout.typeHash) || !archive.Read(layout.size) || !archive.Read(layout.alignment) ||
+					!archive.Read(layout.storage) || !archive.Read(size))
+					return false;
+
+				IComponentPool* pool = FindPool(layout.typeHash);
+				if (!pool || !Readable(layout, pool->Layout()))
+				{
+					if (!archive.Skip(static_cast<size_t>(size)))
+						return false;
+					continue;
+				}
+
+				std::unique_ptr<IComponentPool> content = pool->Empty();
+				size_t start = archive.Consumed();
+				bool borrowing = archive.Borrowing();
+				archive.Borrowing(borrowing && layout.alignment == pool->Layout().alignment);
+				bool restored = content->Load(archive, static_cast<StoragePolicy>(layout.storage));
+				archive.Borrowing(borrowing);
+
+				// a section read as another storage may leave blocks behind, the sparse array of an image
+				size_t used = archive.Consumed() - start;
+				if (!restored || used > size || !archive.Skip(static_cast<size_t>(size - used)))
+					return false;
+				loaded.PushBack(Loaded{ pool, std::move(content) });
+			}
+
+			DynamicArray<uint64_t> disabled(0);
+			if (!archive.ReadArray(disabled))
+				return false;
+
+			ForEachPool([&](IComponentPool& pool) {
+				auto found = std::find_if(loaded.begin(), loaded.end(), [&](const Loaded& entry) { return entry.pool == &pool; });
+				if (found != loaded.end())
+					pool.Take(*found->content);
+				else
+					pool.Clear();
+				});
+			m_Disabled->Assign(std::move(disabled));
+			m_Disabled->Each([&](Entity e) {
+				ForEachPool([&](IComponentPool& pool) { pool.Disable(e); });
+				});
+			return true;
+		}
+
+		// Captures every delta tracked pool, replacing states
+		void Capture(DynamicArray<PoolState>& states) const
+		{
+			states.Clear();
+			ForEachPool([&](const IComponentPool& pool) {
+				if (!pool.DeltaTracked())
+					return;
+
+				PoolState state;
+				pool.Capture(state);
+				states.PushBack(std::move(state));
+				});
+		}
+
+		// Appends the changes of every delta tracked pool since baseline, pools created after it start empty
+		void Diff(const DeltaBaseline& baseline, DynamicArray<PoolDelta>& deltas) const
+		{
+			const PoolState empty;
+			ForEachPool([&](const IComponentPool& pool) {
+				if (!pool.DeltaTracked())
+					return;
+
+				const PoolState* state = baseline.Find(pool.Layout().typeHash);
+				PoolDelta delta;
+				pool.Diff(state ? *state : empty, delta);
+				if (!delta.Empty())
+					deltas.PushBack(std::move(delta));
+				});
+		}
+
+		// Applies (or reverts) pool deltas. Nothing is changed unless every delta has a matching pool.
+		bool Apply(const DynamicArray<PoolDelta>& deltas, bool revert)
+		{
+			for (const PoolDelta& delta : deltas)
+			{
+				IComponentPool* pool = FindPool(delta.typeHash);
+				if (!pool || !pool->DeltaTracked() || pool->Layout().size != delta.valueSize)
+					return false;
+			}
+
+			for (const PoolDelta& delta : deltas)
+			{
+				IComponentPool* pool = FindPool(delta.typeHash);
+				pool->Apply(delta, revert);
+
+				// deltas don't record the enabled state, components coming back keep their entity's
+				if (m_Disabled->Size() != 0) [[unlikely]]
+				{
+					for (Entity e : revert ? delta.removed : delta.added)
+					{
+						if (m_Disabled->Has(e))
+							pool->Disable(e);
+					}
+				}
+			}
+			return true;
+		}
+
+		// Copies every pool with bulk array copies
+		[[nodiscard]] ComponentManager Clone() const
+		{
+			ComponentManager copy;
+			for (size_t i = 0; i < m_Pools.GetBuckets().Size(); ++i)
+			{
+				auto& slot = m_Pools.GetBuckets().At(i);
+				if (!slot.occupied || !slot.value)
+					continue;
+
+				if (auto pool = slot.value->Clone())
+					copy.m_Pools.Insert(slot.key, std::move(pool));
+			}
+			*copy.m_Disabled = *m_Disabled;
+			return copy;
+		}
+
+		// Copy-on-write clone, every pool shares its arrays with this manager's until one side modifies it
+		[[nodiscard]] ComponentManager Share()
+		{
+			ComponentManager copy;
+			for (size_t i = 0; i < m_Pools.GetBuckets().Size(); ++i)
+			{
+				auto& slot = m_Pools.GetBuckets().At(i);
+				if (!slot.occupied || !slot.value)
+					continue;
+
+				if (auto pool = slot.value->Share())
+					copy.m_Pools.Insert(slot.key, std::move(pool));
+			}
+			*copy.m_Disabled = *m_Disabled;
+			return copy;
+		}
+
+		// Adds every pool's footprint and the pool map's buckets to report
+		void Memory(MemoryReport& report) const
+		{
+			report.pools.Clear();
+			ForEachPool([&](const IComponentPool& pool) { report.pools.PushBack(pool.Memory()); });
+
+			report.poolMap = ArrayMemory::Of(m_Pools.GetBuckets());
+			report.poolMap.used = m_Pools.Size() * sizeof(*m_Pools.GetBuckets().Data());
+		}
+
+		// Compacts pools from where the previous call stopped until budget work is done, stopping inside a
+		// pool if needed (see Core::CompactBudget). Returns true once the last pool was compacted.
+		bool Compact(Core::CompactBudget& budget)
+		{
+			const auto& buckets = m_Pools.GetBuckets();
+			while (m_CompactCursor < buckets.Size())
+			{
+				if (budget.Spent())
+					return false;
+
+				// an unfinished pool keeps the cursor, it is resumed first next time
+				auto& slot = buckets.At(m_CompactCursor);
+				if (slot.occupied && slot.value && !slot.value->Compact(budget))
+					return false;
+				++m_CompactCursor;
+			}
+
+			if (!m_Disabled->Compact(budget))
+				return false;
+			m_CompactCursor = 0;
+			return true;
+		}
+
+		// Renames the entities of every pool, see Registry::Defragment
+		void Remap(const DynamicArray<Entity>& remap, size_t entityCount)
+		{
+			ForEachPool([&](IComponentPool& pool) { pool.Remap(remap, entityCount); });
+			m_Disabled->Remap(remap, entityCount);
+		}
+
+		// Returns the pool for T, creating it if needed. Pools are never moved once created.
+		template<typename T>
+		ComponentPool<T>* AssurePool()
+		{
+			return &GetOrCreatePool<T>()->pool;
+		}
+
+		template<typename T>
+		StorageHandle<T> Storage()
+		{
+			return StorageHandle<T>(*AssurePool<T>(), *m_Disabled);
+		}
+
+	private:
+		// type hash, size, alignment, storage and byte count in front of every saved pool
+		static constexpr size_t SECTION_HEADER_BYTES = sizeof(uint64_t) + 3 * sizeof(uint32_t) + sizeof(uint64_t);
+
+		// Sparse set and hash map pools save the same blocks, apart from the sparse array of images
+		[[nodiscard]] static bool Readable(const ComponentLayout& saved, const ComponentLayout& expected) noexcept
+		{
+			constexpr uint32_t BITSET = static_cast<uint32_t>(StoragePolicy::Bitset);
+			constexpr uint32_t HASH_MAP = static_cast<uint32_t>(StoragePolicy::HashMap);
+			return saved.size == expected.size && saved.storage <= HASH_MAP &&
+				(saved.storage == BITSET) == (expected.storage == BITSET);
+		}
+
+		template<typename Func>
+		void ForEachPool(Func&& func) const
+		{
+			for (size_t i = 0; i < m_Pools.GetBuckets().Size(); ++i)
+			{
+				auto& slot = m_Pools.GetBuckets().At(i);
+				if (slot.occupied && slot.value)
+					func(*slot.value);
+			}
+		}
+
+		template<typename T>
+		inline void KeepDisabled(ComponentPool<T>& pool, Entity e)
+		{
+			if (m_Disabled->Has(e))
+				pool.Disable(e);
+		}
+
+		IComponentPool* FindPool(uint64_t typeId) noexcept
+		{
+			return m_Pools.Get(typeId);
+		}
+
+		// Every typed lookup goes through here, so T's id is registered on its first use and a
+		// collision with another type aborts before that type's pool is cast to T
+		template<typename T>
+		ComponentPoolWrapper<T>* LookupPool() noexcept
+		{
+			static const bool claimed = Core::ClaimTypeId(TypeId<T>, Core::TypeName<T>());
+			(void)claimed;
+
+			return static_cast<ComponentPoolWrapper<T>*>(m_Pools.Get(TypeId<T>));
+		}
+
+		template<typename T>
+		ComponentPoolWrapper<T>* GetOrCreatePool()
+		{
+			auto existing = LookupPool<T>();
+			if (existing)
+			{
+				return existing;
+			}
+
+			auto wrapper = std::make_unique<ComponentPoolWrapper<T>>();
+			auto ptr = wrapper.get();
+			m_Pools.Insert(TypeId<T>, std::move(wrapper));
+
+			return ptr;
+		}
+	private:
+		PoolMap m_Pools;
+		std::unique_ptr<BitSet> m_Disabled = std::make_unique<BitSet>(0); // held apart so storage handles survive moves
+		size_t m_CompactCursor = 0; // next bucket Compact visits
+	};
+
+} // namespace Composia 
+
+using Composia::Core::DynamicArray;
+
+namespace Composia {
+
+	// Cached access to a resource, one pointer load per use. Stays valid until the resource is
+	// removed or its registry destroyed, SetResource on an existing resource assigns in place.
+	template<typename T>
+	class ResourceHandle
+	{
+	public:
+		ResourceHandle() = default;
+		explicit ResourceHandle(T* value) noexcept : m_Value(value) {}
+
+		[[nodiscard]] inline T& operator*() const noexcept
+		{
+			assert(m_Value && "Resource was never set");
+			return *m_Value;
+		}
+
+		[[nodiscard]] inline T* operator->() const noexcept
+		{
+			assert(m_Value && "Resource was never set");
+			return m_Value;
+		}
+
+		[[nodiscard]] inline T* Get() const noexcept
+		{
+			return m_Value;
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return m_Value != nullptr;
+		}
+
+	private:
+		T* m_Value = nullptr;
+	};
+
+	// Type-erased resource holder
+	struct IResource
+	{
+		virtual ~IResource() = default;
+
+		// nullptr for resources that are not copy constructible
+		virtual std::unique_ptr<IResource> Clone() const = 0;
+	};
+
+	template<typename T>
+	struct ResourceHolder : IResource
+	{
+		template<typename... Args>
+		explicit ResourceHolder(Args&&... args) : value(std::forward<Args>(args)...) {}
+
+		T value;
+
+		std::unique_ptr<IResource> Clone() const override
+		{
+			if constexpr (!std::is_copy_constructible_v<T>)
+				return nullptr;
+			else
+				return std::make_unique<ResourceHolder<T>>(value);
+		}
+	};
+
+	// One instance per type, keyed by TypeId like the component pools. Worlds hold a handful of
+	// resources, so lookup is a scan over their ids; each value sits in its own allocation and never moves.
+	class ResourceManager
+	{
+	public:
+		ResourceManager() = default;
+		ResourceManager(ResourceManager&&) noexcept = default;
+		ResourceManager& operator=(ResourceManager&&) noexcept = default;
+
+		template<typename T, typename... Args>
+		T& Set(Args&&... args)
+		{
+			if (T* existing = Find<T>())
+			{
+				*existing = T(std::forward<Args>(args)...);
+				return *existing;
+			}
+
+			auto holder = std::make_unique<ResourceHolder<T>>(std::forward<Args>(args)...);
+			T& value = holder->value;
+			m_Ids.PushBack(TypeId<T>);
+			m_Resources.PushBack(std::move(holder));
+			return value;
+		}
+
+		template<typename T>
+		[[nodiscard]] T* Find() noexcept
+		{
+			static const bool claimed = Core::ClaimTypeId(TypeId<T>, Core::TypeName<T>());
+			(void)claimed;
+
+			size_t index = IndexOf(TypeId<T>);
+			if (index == m_Ids.Size())
+				return nullptr;
+			return &static_cast<ResourceHolder<T>*>(m_Resources[index].get())->value;
+		}
+
+		// Returns false if there was no T
+		template<typename T>
+		bool Remove()
+		{
+			static const bool claimed = Core::ClaimTypeId(TypeId<T>, Core::TypeName<T>());
+			(void)claimed;
+
+			size_t index = IndexOf(TypeId<T>);
+			if (index == m_Ids.Size())
+				return false;
+
+			size_t last = m_Ids.Size() - 1;
+			if (index != last)
+			{
+				m_Ids[index] = m_Ids[last];
+				m_Resources[index] = std::move(m_Resources[last]);
+			}
+			m_Ids.PopBack();
+			m_Resources.PopBack();
+			return true;
+		}
+
+		[[nodiscard]] inline size_t Size() const noexcept
+		{
+			return m_Ids.Size();
+		}
+
+		// Copies every copy constructible resource, handles keep pointing at the originals
+		[[nodiscard]] ResourceManager Clone() const
+		{
+			ResourceManager copy;
+			for (size_t i = 0; i < m_Ids.Size(); ++i)
+			{
+				if (auto resource = m_Resources[i]->Clone())
+				{
+					copy.m_Ids.PushBack(m_Ids[i]);
+					copy.m_Resources.PushBack(std::move(resource));
+				}
+			}
+			return copy;
+		}
+
+	private:
+		inline size_t IndexOf(uint64_t id) const noexcept
+		{
+			size_t index = 0;
+			while (index < m_Ids.Size() && m_Ids[index] != id)
+				++index;
+			return index;
+		}
+
+		DynamicArray<uint64_t> m_Ids{ 0 };
+		DynamicArray<std::unique_ptr<IResource>> m_Resources{ 0 };
+	};
+
+} // namespace Composia
+
+#include <array>
+
+namespace Composia {
+
+	// each() passes one reference per non-tag component, in declaration order. Tags only filter.
+	// Iteration pivots on the smallest sparse set pool, or scans bitset pools word by word
+	// when one of them holds fewer entities than every sparse set pool. Disabled entities are
+	// skipped: the pivot is only read up to its enabled prefix, bitset words are masked.
+	// each() tests the pivot 64 entities at a time, with one HasBatch per pool, and prefetches
+	// the sparse slots of the next block and the dense slots of the matches, as they sit at
+	// random addresses once pools are shuffled.
+	template<typename... Components>
+	class View
+	{
+	public:
+		using PoolsTuple = std::tuple<ComponentPool<Components>*...>;
+
+		View(ComponentManager& manager)
+			: disabledWords(&manager.Disabled().RawWords())
+		{
+			pools = std::make_tuple(manager.AssurePool<Components>()...);
+			SelectPivot();
+		}
+
+		struct Iterator
+		{
+			using EntityVec = const Core::DynamicArray<Entity>&;
+
+			Iterator(PoolsTuple* pools, const DynamicArray<Entity>* entities, size_t idx, size_t size)
+				: pools(pools), entities(entities), index(idx), size(size)
+			{
+				AdvanceToValid();
+			}
+
+			Iterator& operator++() noexcept
+			{
+				++index;
+				AdvanceToValid();
+				return *this;
+			}
+
+			Entity operator*() const noexcept
+			{
+				return (*entities)[index];
+			}
+
+			bool operator!=(const Iterator& other) const noexcept
+			{
+				return index != other.index;
+			}
+
+		private:
+			void AdvanceToValid() noexcept
+			{
+				bool valid = false;
+				while (!valid) {
+					if (index >= size) break;
+
+					Entity e = (*entities)[index];
+					COMPOSIA_COUNT(ViewCandidates, 1);
+					if (HasAllComponents(e))
+					{
+						COMPOSIA_COUNT(ViewAccepted, 1);
+						valid = true;
+					}
+					else
+						++index;
+				}
+			}
+
+			inline bool HasAllComponents(Entity e) const noexcept
+			{
+				bool result = true;
+				ApplyAll([&](auto* pool) {
+					if (!pool->Has(e)) result = false;
+					});
+				return result;
+			}
+
+			template<typename Func>
+			inline void ApplyAll(Func&& func) const noexcept
+			{
+				std::apply([&](auto*... poolPtrs) {
+					(func(poolPtrs), ...);
+					}, *pools);
+			}
+
+			PoolsTuple* pools;
+			const DynamicArray<Entity>* entities;
+			size_t index;
+			size_t size;
+		};
+
+		inline Iterator begin() noexcept
+		{
+			static_assert(PackedCount > 0, "Views over bitset pools only can be iterated with each()");
+			return Iterator(&pools, pivotEntities, 0, pivotSize);
+		}
+
+		inline Iterator end() noexcept
+		{
+			static_assert(PackedCount > 0, "Views over bitset pools only can be iterated with each()");
+			return Iterator(&pools, pivotEntities, pivotSize, pivotSize);
+		}
+
+		// Pivot entities each() prefetches sparse slots ahead, one block by default. 0 turns prefetching off.
+		View& PrefetchDistance(size_t distance) noexcept
+		{
+			prefetchDistance = distance;
+			return *this;
+		}
+
+		template<typename Func>
+		void each(Func&& func) noexcept
+		{
+			COMPOSIA_TRACE_ZONE(Core::TypeName<View>());
+
+			// func gets its components through Get, which copies pools still shared with a CloneShared
+			// copy. Done up front so the pivot array read below is not reallocated under the loop.
+			[this]<size_t... Is>(std::index_sequence<Is...>) {
+				(std::get<ValueIndices[Is]>(pools)->Unshare(), ...);
+			}(std::make_index_sequence<ValueCount>{});
+
+			if constexpr (BitsetCount > 0)
+			{
+				if (wordScan)
+				{
+					EachWordwise(std::forward<Func>(func));
+					return;
+				}
+			}
+
+			if constexpr (PackedCount > 0)
+			{
+				// small worlds stay cached, the prefetches would only cost instructions there
+				if (prefetchDistance != 0 && pivotSize >= PREFETCH_MIN_SIZE)
+					EachPivot<true>(func);
+				else
+					EachPivot<false>(func);
+			}
+		}
+
+	private:
+		static constexpr size_t BitsetCount = (size_t(UsesBitset<Components>) + ... + 0);
+		static constexpr size_t PackedCount = sizeof...(Components) - BitsetCount;
+		static constexpr size_t PREFETCH_MIN_SIZE = 1 << 15;
+		static constexpr size_t BLOCK_SIZE = BitSet::BITS_PER_WORD;
+
+		// Tests the pivot entities a block of 64 at a time: one HasBatch per pool is ANDed into the
+		// block's match mask, so the pools are probed with gathers and func only sees matches.
+		// func may add to or remove from the pivot, so its array is read again after every call.
+		template<bool Prefetching, typename Func>
+		void EachPivot(Func& func) noexcept
+		{
+			size_t size = pivotSize;
+			[[maybe_unused]] size_t accepted = 0;
+			for (size_t start = 0; start < size; start += BLOCK_SIZE)
+			{
+				size_t end = std::min(size, pivotEntities->Size());
+				if (start >= end)
+					break;
+
+				const Entity* entities = pivotEntities->Data();
+				size_t count = std::min(BLOCK_SIZE, end - start);
+				if constexpr (Prefetching)
+				{
+					// sparse slots a block ahead, read by its HasBatch calls
+					size_t ahead = std::min(start + prefetchDistance, end);
+					size_t aheadEnd = std::min(ahead + BLOCK_SIZE, end);
+					for (size_t i = ahead; i < aheadEnd; ++i)
+						std::apply([&](auto*... poolPtrs) { (poolPtrs->PrefetchSparse(entities[i]), ...); }, pools);
+				}
+
+				uint64_t block = MatchBlock(entities + start, count);
+				if constexpr (Prefetching)
+				{
+					// dense slots of the matches, read by func right after
+					for (uint64_t bits = block; bits; bits &= bits - 1)
+					{
+						Entity e = entities[start + std::countr_zero(bits)];
+						std::apply([&](auto*... poolPtrs) { (poolPtrs->PrefetchDense(e), ...); }, pools);
+					}
+				}
+
+				// the first match is tested with the block, func may have changed the later ones
+				bool fresh = true;
+				while (block)
+				{
+					size_t index = start + std::countr_zero(block);
+					block &= block - 1;
+					if (index >= pivotEntities->Size())
+						break;
+
+					Entity e = (*pivotEntities)[index];
+					if (!fresh && MatchBlock(&e, 1) == 0)
+						continue;
+
+					fresh = false;
+					++accepted;
+					invokeFunc(e, func);
+				}
+			}
+			COMPOSIA_COUNT(ViewCandidates, size);
+			COMPOSIA_COUNT(ViewAccepted, accepted);
+		}
+
+		// Bit i is set when entities[i] is in every pool. The pivot pool is skipped, its enabled
+		// prefix holds the entities, and the remaining pools once no entity is left.
+		inline uint64_t MatchBlock(const Entity* entities, size_t count) const noexcept
+		{
+			uint64_t block = count == BLOCK_SIZE ? ~uint64_t(0) : (uint64_t(1) << count) - 1;
+			std::apply([&](auto*... poolPtrs) {
+				([&](auto* pool) {
+					if constexpr (!UsesBitset<typename std::remove_pointer_t<decltype(pool)>::ComponentType>)
+					{
+						if (&pool->RawEntities() == pivotEntities)
+							return;
+					}
+					if (block == 0)
+						return;
+
+					uint64_t mask;
+					pool->HasBatch(entities, count, &mask);
+					block &= mask;
+					}(poolPtrs), ...);
+				}, pools);
+			return block;
+		}
+
+		// ANDs the words of every bitset pool and clears the disabled entities' bits, then probes
+		// the sparse set pools for each remaining bit
+		template<typename Func>
+		void EachWordwise(Func&& func) noexcept
+		{
+			[[maybe_unused]] size_t candidates = 0;
+			[[maybe_unused]] size_t accepted = 0;
+			size_t wordCount = std::numeric_limits<size_t>::max();
+			ApplyBitsets([&](auto* pool) { wordCount = std::min(wordCount, pool->RawWords().Size()); });
+
+			const DynamicArray<uint64_t>& disabled = *disabledWords;
+			for (size_t w = 0; w < wordCount; ++w)
+			{
+				uint64_t word = ~uint64_t(0);
+				ApplyBitsets([&](auto* pool) { word &= pool->RawWords()[w]; });
+				if (w < disabled.Size())
+					word &= ~disabled[w];
+
+				while (word)
+				{
+					Entity e = static_cast<Entity>(w * BitSet::BITS_PER_WORD + std::countr_zero(word));
+					word &= word - 1;
+
+					bool matched = true;
+					ApplyPacked([&](auto* pool) { matched = matched && pool->Has(e); });
+					++candidates;
+					if (matched)
+					{
+						++accepted;
+						invokeFunc(e, std::forward<Func>(func));
+					}
+				}
+			}
+			COMPOSIA_COUNT(ViewCandidates, candidates);
+			COMPOSIA_COUNT(ViewAccepted, accepted);
+		}
+
+		template<typename Func>
+		inline void ApplyBitsets(Func&& func) const noexcept
+		{
+			std::apply([&](auto*... poolPtrs) {
+				([&](auto* pool) {
+					if constexpr (UsesBitset<typename std::remove_pointer_t<decltype(pool)>::ComponentType>)
+						func(pool);
+					}(poolPtrs), ...);
+				}, pools);
+		}
+
+		template<typename Func>
+		inline void ApplyPacked(Func&& func) const noexcept
+		{
+			std::apply([&](auto*... poolPtrs) {
+				([&](auto* pool) {
+					if constexpr (!UsesBitset<typename std::remove_pointer_t<decltype(pool)>::ComponentType>)
+						func(pool);
+					}(poolPtrs), ...);
+				}, pools);
+		}
+
+		static constexpr size_t ValueCount = (size_t(!IsTag<Components>) + ... + 0);
+
+		// Tuple indices of the components that carry a value
+		static constexpr std::array<size_t, ValueCount> ValueIndices = [] {
+			constexpr bool isTag[] = { IsTag<Components>... };
+			std::array<size_t, ValueCount> indices{};
+			size_t count = 0;
+			for (size_t i = 0; i < sizeof...(Components); ++i)
+			{
+				if (!isTag[i])
+					indices[count++] = i;
+			}
+			return indices;
+		}();
+
+		template<typename Func, size_t... Is>
+		inline void invokeFuncImpl([[maybe_unused]] Entity e, Func&& func, std::index_sequence<Is...>) noexcept
+		{
+			func(*std::get<ValueIndices[Is]>(pools)->Get(e)...);
+		}
+
+		template<typename Func>
+		inline void invokeFunc(Entity e, Func&& func) noexcept
+		{
+			invokeFuncImpl(e, std::forward<Func>(func), std::make_index_sequence<ValueCount>{});
+		}
+
+		void SelectPivot() noexcept
+		{
+			size_t smallestPacked = std::numeric_limits<size_t>::max();
+			size_t smallestBitset = std::numeric_limits<size_t>::max();
+
+			ApplyPacked([&](auto* pool) {
+				if (pool->EnabledSize() < smallestPacked)
+				{
+					smallestPacked = pool->EnabledSize();
+					pivotEntities = &pool->RawEntities();
+					pivotSize = pool->EnabledSize();
+				}
+				});
+			ApplyBitsets([&](auto* pool) { smallestBitset = std::min(smallestBitset, pool->Size()); });
+
+			wordScan = BitsetCount > 0 && (PackedCount == 0 || smallestBitset < smallestPacked);
+		}
+
+		PoolsTuple pools;
+		const DynamicArray<Entity>* pivotEntities = nullptr;
+		size_t pivotSize = 0;
+		size_t prefetchDistance = BLOCK_SIZE;
+		const DynamicArray<uint64_t>* disabledWords;
+		bool wordScan = false;
+	};
+
+} // namespace Composia
+
+
+namespace Composia {
+
+	// Marker listing the components an entity must not have to match an Observer
+	template<typename... Excluded>
+	struct Exclude {};
+
+	// Type-erased base so the Registry can own observers of any signature
+	struct IObserver
+	{
+		virtual ~IObserver() = default;
+		virtual void Remap(const DynamicArray<Entity>& remap, size_t entityCount) = 0;
+	};
+
+	template<typename ExcludeList, typename... Components>
+	class Observer;
+
+	// Persistent query that keeps the set of entities owning all Components and none of Excluded.
+	// The set is updated from the watched pools' signals, so iterating it costs
+	// only as much as the number of matches. Clear() drops the collected entities, which allows
+	// "collect then handle" workflows: entities come back once one of their watched components changes.
+	template<typename... Excluded, typename... Components>
+	class Observer<Exclude<Excluded...>, Components...> final : public IObserver
+	{
+	public:
+		static_assert(sizeof...(Components) > 0, "Observer needs at least one included component");
+
+		Observer(ComponentManager& manager)
+			: m_Included(manager.AssurePool<Components>()...), m_Excluded(manager.AssurePool<Excluded>()...)
+		{
+			std::apply([this](auto*... pools) {
+				(pools->OnConstruct().template Connect<&Observer::OnIncludedChange>(*this), ...);
+				(pools->OnUpdate().template Connect<&Observer::OnIncludedChange>(*this), ...);
+				(pools->OnDestroy().template Connect<&Observer::Discard>(*this), ...);
+				}, m_Included);
+			(std::get<ComponentPool<Excluded>*>(m_Excluded)->OnConstruct().template Connect<&Observer::Discard>(*this), ...);
+			(std::get<ComponentPool<Excluded>*>(m_Excluded)->OnDestroy().template Connect<&Observer::template OnExcludedDestroy<Excluded>>(*this), ...);
+			Populate();
+		}
+
+		~Observer() override
+		{
+			std::apply([this](auto*... pools) {
+				(pools->OnConstruct().Disconnect(this), ...);
+				(pools->OnUpdate().Disconnect(this), ...);
+				(pools->OnDestroy().Disconnect(this), ...);
+				}, m_Included);
+			std::apply([this](auto*... pools) {
+				(pools->OnConstruct().Disconnect(this), ...);
+				(pools->OnDestroy().Disconnect(this), ...);
+				}, m_Excluded);
+		}
+
+		Observer(const Observer&) = delete;
+		Observer& operator=(const Observer&) = delete;
+
+		[[nodiscard]] inline bool Has(Entity e) const noexcept
+		{
+			return m_Entities.Has(e);
+		}
+
+		[[nodiscard]] inline size_t Size() const noexcept
+		{
+			return m_Entities.Size();
+		}
+
+		[[nodiscard]] inline bool Empty() const noexcept
+		{
+			return m_Entities.Size() == 0;
+		}
+
+		inline void Clear() noexcept
+		{
+			m_Entities.Clear();
+		}
+
+		void Remap(const DynamicArray<Entity>& remap, size_t entityCount) override
+		{
+			m_Entities.Remap(remap, entityCount);
+		}
+
+		// Iterates back to front, so func may add or remove watched components of the visited entity.
+		template<typename Func>
+		void each(Func&& func)
+		{
+			const auto& entities = m_Entities.RawPacked();
+			for (size_t i = entities.Size(); i > 0; --i)
+			{
+				if (i > entities.Size())
+					continue;
+
+				func(entities[i - 1]);
+			}
+		}
+
+		const Entity* begin() const noexcept { return m_Entities.RawPacked().begin(); }
+		const Entity* end() const noexcept { return m_Entities.RawPacked().end(); }
+
+	private:
+		void OnIncludedChange(Entity e)
+		{
+			if (Matches(e))
+				m_Entities.Add(e);
+		}
+
+		void Discard(Entity e)
+		{
+			m_Entities.Remove(e);
+		}
+
+		// Destroy signals fire before removal, so the excluded pool being emptied is skipped
+		template<typename Removed>
+		void OnExcludedDestroy(Entity e)
+		{
+			if (Matches<Removed>(e))
+				m_Entities.Add(e);
+		}
+
+		template<typename Skipped = void>
+		inline bool Matches(Entity e) const noexcept
+		{
+			bool included = std::apply([e](auto*... pools) { return (pools->Has(e) && ...); }, m_Included);
+			bool excluded = (... || (!std::is_same_v<Excluded, Skipped> && std::get<ComponentPool<Excluded>*>(m_Excluded)->Has(e)));
+			return included && !excluded;
+		}
+
+		void Populate() noexcept
+		{
+			size_t smallest = std::numeric_limits<size_t>::max();
+			std::apply([&](auto*... pools) { ((smallest = std::min(smallest, pools->Size())), ...); }, m_Included);
+
+			bool populated = false;
+			auto populateFrom = [&](auto* pool) {
+				if (populated || pool->Size() != smallest)
+					return;
+
+				populated = true;
+				pool->Each([&](Entity e) {
+					if (Matches(e))
+						m_Entities.Add(e);
+					});
+				};
+			std::apply([&](auto*... pools) { (populateFrom(pools), ...); }, m_Included);
+		}
+
+		std::tuple<ComponentPool<Components>*...> m_Included;
+		std::tuple<ComponentPool<Excluded>*...> m_Excluded;
+		SparseSet<void> m_Entities;
+	};
+
+} // namespace Composia
+
+using Composia::Core::DynamicArray;
+
+namespace Composia {
+
+	// Type-erased operations on one component type, shared by every archetype column holding it
+	struct ColumnType
+	{
+		using Relocate = void(*)(void* to, void* from) noexcept;
+		using Copy = void(*)(void* to, const void* from);
+		using Destroy = void(*)(void* value) noexcept;
+
+		uint64_t id;
+		size_t size;
+		size_t alignment;
+		Relocate relocate; // move constructs to, then destroys from
+		Copy copy; // nullptr for types that are not copy constructible
+		Destroy destroy;
+
+		template<typename T>
+		static const ColumnType* Of() noexcept
+		{
+			static const ColumnType type{
+				TypeId<T>, sizeof(T), alignof(T),
+				[](void* to, void* from) noexcept {
+					T* source = static_cast<T*>(from);
+					new (to) T(std::move(*source));
+					source->~T();
+				},
+				CopyOf<T>(),
+				[](void* value) noexcept { static_cast<T*>(value)->~T(); }
+			};
+			return &type;
+		}
+
+	private:
+		template<typename T>
+		static Copy CopyOf() noexcept
+		{
+			if constexpr (std::is_copy_constructible_v<T>)
+				return [](void* to, const void* from) { new (to) T(*static_cast<const T*>(from)); };
+			else
+				return nullptr;
+		}
+	};
+
+	// Table of the entities owning exactly one set of component types. Rows live in chunks of about
+	// CHUNK_BYTES holding the rows' entity ids followed by one array per non-tag component, so a view
+	// reads every column of a chunk linearly. Rows stay dense: removing one moves the last row into it.
+	class Archetype
+	{
+	public:
+		static constexpr size_t CHUNK_BYTES = 16 * 1024;
+		static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+		// signature holds every component type id in ascending order, columns the non-tag ones in the same order
+		Archetype(DynamicArray<uint64_t>&& signature, DynamicArray<const ColumnType*>&& columns)
+			: m_Signature(std::move(signature)), m_Columns(std::move(columns))
+		{
+			size_t rowBytes = sizeof(Entity);
+			size_t padding = 0;
+			m_Alignment = alignof(Entity);
+			for (const ColumnType* column : m_Columns)
+			{
+				rowBytes += column->size;
+				padding += column->alignment - 1;
+				m_Alignment = std::max(m_Alignment, column->alignment);
+			}
+			m_Capacity = std::max<size_t>(1, (CHUNK_BYTES - std::min(padding, CHUNK_BYTES)) / rowBytes);
+
+			size_t offset = m_Capacity * sizeof(Entity);
+			for (const ColumnType* column : m_Columns)
+			{
+				offset = (offset + column->alignment - 1) & ~(column->alignment - 1);
+				m_Offsets.PushBack(offset);
+				offset += m_Capacity * column->size;
+			}
+			m_ChunkBytes = offset;
+		}
+
+		Archetype(const Archetype&) = delete;
+		Archetype& operator=(const Archetype&) = delete;
+
+		~Archetype()
+		{
+			for (uint32_t row = 0; row < m_Size; ++row)
+				DestroyRow(row);
+			while (!m_Chunks.Empty())
+				FreeLastChunk();
+		}
+
+		[[nodiscard]] inline bool Has(uint64_t id) const noexcept
+		{
+			return std::binary_search(m_Signature.begin(), m_Signature.end(), id);
+		}
+
+		// Position of id among the columns, NONE for tags and types the archetype doesn't hold
+		[[nodiscard]] inline uint32_t ColumnIndex(uint64_t id) const noexcept
+		{
+			for (uint32_t i = 0; i < m_Columns.Size(); ++i)
+			{
+				if (m_Columns[i]->id == id)
+					return i;
+			}
+			return NONE;
+		}
+
+		[[nodiscard]] inline const DynamicArray<uint64_t>& Signature() const noexcept
+		{
+			return m_Signature;
+		}
+
+		[[nodiscard]] inline const DynamicArray<const ColumnType*>& Columns() const noexcept
+		{
+			return m_Columns;
+		}
+
+		[[nodiscard]] inline size_t Size() const noexcept
+		{
+			return m_Size;
+		}
+
+		// Rows per chunk
+		[[nodiscard]] inline size_t ChunkCapacity() const noexcept
+		{
+			return m_Capacity;
+		}
+
+		// Chunks holding rows, a spare empty one may follow
+		[[nodiscard]] inline size_t ChunkCount() const noexcept
+		{
+			return (m_Size + m_Capacity - 1) / m_Capacity;
+		}
+
+		[[nodiscard]] inline size_t ChunkSize(size_t chunk) const noexcept
+		{
+			return std::min(m_Capacity, m_Size - chunk * m_Capacity);
+		}
+
+		[[nodiscard]] inline Entity* Entities(size_t chunk) const noexcept
+		{
+			return reinterpret_cast<Entity*>(m_Chunks[chunk]);
+		}
+
+		[[nodiscard]] inline void* Column(size_t chunk, uint32_t column) const noexcept
+		{
+			return m_Chunks[chunk] + m_Offsets[column];
+		}
+
+		[[nodiscard]] inline void* At(uint32_t row, uint32_t column) const noexcept
+		{
+			return m_Chunks[row / m_Capacity] + m_Offsets[column] + (row % m_Capacity) * m_Columns[column]->size;
+		}
+
+		[[nodiscard]] inline Entity EntityAt(uint32_t row) const noexcept
+		{
+			return Entities(row / m_Capacity)[row % m_Capacity];
+		}
+
+		// Appends a row for e and returns it. Its components are left unconstructed for the caller.
+		uint32_t Append(Entity e)
+		{
+			if (m_Size == m_Chunks.Size() * m_Capacity)
+				m_Chunks.PushBack(static_cast<std::byte*>(::operator new(m_ChunkBytes, std::align_val_t(m_Alignment))));
+
+			uint32_t row = m_Size++;
+			Entities(row / m_Capacity)[row % m_Capacity] = e;
+			return row;
+		}
+
+		inline void DestroyRow(uint32_t row) noexcept
+		{
+			for (uint32_t column = 0; column < m_Columns.Size(); ++column)
+				m_Columns[column]->destroy(At(row, column));
+		}
+
+		// Fills row, whose components were already destroyed or moved out, with the last row. Returns the
+		// entity now at row, INVALID_ENTITY if row was the last one. Only one spare chunk is kept.
+		Entity RemoveRow(uint32_t row) noexcept
+		{
+			uint32_t last = m_Size - 1;
+			Entity moved = INVALID_ENTITY;
+			if (row != last)
+			{
+				for (uint32_t column = 0; column < m_Columns.Size(); ++column)
+					m_Columns[column]->relocate(At(row, column), At(last, column));
+				moved = EntityAt(last);
+				Entities(row / m_Capacity)[row % m_Capacity] = moved;
+			}
+
+			--m_Size;
+			if (m_Chunks.Size() > ChunkCount() + 1)
+				FreeLastChunk();
+			return moved;
+		}
+
+		// Cached transition to the archetype with id added or removed, NONE until SetEdge
+		[[nodiscard]] inline uint32_t Edge(uint64_t id, bool adding) const noexcept
+		{
+			for (const Transition& edge : m_Edges)
+			{
+				if (edge.id == id)
+					return adding ? edge.add : edge.remove;
+			}
+			return NONE;
+		}
+
+		void SetEdge(uint64_t id, bool adding, uint32_t archetype)
+		{
+			for (Transition& edge : m_Edges)
+			{
+				if (edge.id == id)
+				{
+					(adding ? edge.add : edge.remove) = archetype;
+					return;
+				}
+			}
+			m_Edges.PushBack(adding ? Transition{ id, archetype, NONE } : Transition{ id, NONE, archetype });
+		}
+
+		// Copies rows and edges, every column type must be copy constructible
+		[[nodiscard]] std::unique_ptr<Archetype> Clone() const
+		{
+			auto copy = std::make_unique<Archetype>(DynamicArray<uint64_t>(m_Signature), DynamicArray<const ColumnType*>(m_Columns));
+			copy->m_Edges = m_Edges;
+			for (uint32_t row = 0; row < m_Size; ++row)
+			{
+				uint32_t copied = copy->Append(EntityAt(row));
+				for (uint32_t column = 0; column < m_Columns.Size(); ++column)
+				{
+					assert(m_Columns[column]->copy && "Cloned components must be copy constructible");
+					m_Columns[column]->copy(copy->At(copied, column), At(row, column));
+				}
+			}
+			return copy;
+		}
+
+	private:
+		struct Transition
+		{
+			uint64_t id;
+			uint32_t add;
+			uint32_t remove;
+		};
+
+		inline void FreeLastChunk() noexcept
+		{
+			::operator delete(m_Chunks.Back(), std::align_val_t(m_Alignment));
+			m_Chunks.PopBack();
+		}
+
+		DynamicArray<uint64_t> m_Signature;
+		DynamicArray<const ColumnType*> m_Columns;
+		DynamicArray<size_t> m_Offsets{ 0 };
+		DynamicArray<std::byte*> m_Chunks{ 0 };
+		DynamicArray<Transition> m_Edges{ 0 };
+		size_t m_Capacity = 1;
+		size_t m_ChunkBytes = 0;
+		size_t m_Alignment = alignof(Entity);
+		uint32_t m_Size = 0;
+	};
+
+} // namespace Composia
+
+
+namespace Composia {
+
+	// View over an ArchetypeRegistry, with the same each() as View: one reference per non-tag component,
+	// in declaration order. The archetypes holding every component are collected once; each() then walks
+	// their chunks and hands out the rows of each chunk straight from its column arrays.
+	template<typename... Components>
+	class ArchetypeView
+	{
+	public:
+		static_assert(sizeof...(Components) > 0, "Views need at least one component type");
+
+		ArchetypeView(const DynamicArray<std::unique_ptr<Archetype>>& archetypes)
+		{
+			for (const auto& archetype : archetypes)
 			{
-				Rehash(m_Buckets.Size() * 2);
+				if ((archetype->Has(TypeId<Components>) && ...) && archetype->Size() != 0)
+					matches.PushBack(archetype.get());
 			}
+		}
 
-			size_t hash = key.hash_code();
-			size_t index = hash % m_Buckets.Size();
-			size_t dist = 0;
+		struct Iterator
+		{
+			Iterator(const DynamicArray<Archetype*>* matches, size_t archetype)
+				: matches(matches), archetype(archetype)
+			{
+			}
 
-			while (true)
+			Iterator& operator++() noexcept
 			{
-				Entry& e = m_Buckets[index];
-				if (!e.occupied)
+				if (++row == (*matches)[archetype]->Size())
 				{
-					e.key = key;
-					e.value = std::move(value);
-					e.probeDistance = dist;
-					e.occupied = true;
-					++m_Size;
-					return;
+					++archetype;
+					row = 0;
 				}
+				return *this;
+			}
 
-				if (e.key == key) // overwrite
-				{
-					e.value = std::move(value);
+			Entity operator*() const noexcept
+			{
+				return (*matches)[archetype]->EntityAt(row);
+			}
+
+			bool operator!=(const Iterator& other) const noexcept
+			{
+				return archetype != other.archetype || row != other.row;
+			}
+
+		private:
+			const DynamicArray<Archetype*>* matches;
+			size_t archetype;
+			uint32_t row = 0;
+		};
+
+		inline Iterator begin() const noexcept
+		{
+			return Iterator(&matches, 0);
+		}
+
+		inline Iterator end() const noexcept
+		{
+			return Iterator(&matches, matches.Size());
+		}
+
+		template<typename Func>
+		void each(Func&& func) noexcept
+		{
+			COMPOSIA_TRACE_ZONE(Core::TypeName<ArchetypeView>());
+
+			[[maybe_unused]] size_t visited = 0;
+			for (Archetype* archetype : matches)
+			{
+				for (size_t chunk = 0; chunk < archetype->ChunkCount(); ++chunk)
+					EachInChunk(*archetype, chunk, func, std::make_index_sequence<ValueCount>{});
+				visited += archetype->Size();
+			}
+			COMPOSIA_COUNT(ViewCandidates, visited);
+			COMPOSIA_COUNT(ViewAccepted, visited);
+		}
+
+	private:
+		static constexpr size_t ValueCount = (size_t(!IsTag<Components>) + ... + 0);
+
+		// Indices into Components of the types that carry a value
+		static constexpr std::array<size_t, ValueCount> ValueIndices = [] {
+			constexpr bool isTag[] = { IsTag<Components>... };
+			std::array<size_t, ValueCount> indices{};
+			size_t count = 0;
+			for (size_t i = 0; i < sizeof...(Components); ++i)
+			{
+				if (!isTag[i])
+					indices[count++] = i;
+			}
+			return indices;
+		}();
+
+		template<size_t I>
+		using ValueType = std::tuple_element_t<ValueIndices[I], std::tuple<Components...>>;
+
+		template<typename Func, size_t... Is>
+		inline void EachInChunk(const Archetype& archetype, size_t chunk, Func& func, std::index_sequence<Is...>) noexcept
+		{
+			std::tuple<ValueType<Is>*...> columns{
+				static_cast<ValueType<Is>*>(archetype.Column(chunk, archetype.ColumnIndex(TypeId<ValueType<Is>>)))...
+			};
+			size_t count = archetype.ChunkSize(chunk);
+			for (size_t i = 0; i < count; ++i)
+				func(std::get<Is>(columns)[i]...);
+		}
+
+		DynamicArray<Archetype*> matches{ 0 };
+	};
+
+} // namespace Composia
+
+
+namespace Composia {
+
+	// Registry backend storing every entity as a row of the archetype matching its exact component set,
+	// see Archetype. Views read all their columns linearly whatever order entities were created in, while
+	// Emplace and Remove move the entity's row to another archetype, found through edges cached on the
+	// archetypes. Storage policies are ignored, every component lives in a column and tags only in the
+	// archetype signature.
+	//
+	// Defining COMPOSIA_ARCHETYPE_STORAGE makes Registry this class. It covers entities, components, views,
+	// resources and Clone; signals, observers, snapshots, deltas, sorting, compaction, enabling and storage
+	// handles are built on component pools and only exist on the sparse set Registry.
+	class ArchetypeRegistry
+	{
+	public:
+		ArchetypeRegistry()
+		{
+			// archetype 0 is the empty one, entities without components have no row anywhere
+			m_Archetypes.PushBack(std::make_unique<Archetype>(DynamicArray<uint64_t>(0), DynamicArray<const ColumnType*>(0)));
+		}
+
+		ArchetypeRegistry(ArchetypeRegistry&&) = default;
+		ArchetypeRegistry& operator=(ArchetypeRegistry&&) = default;
+
+		// Copies are made explicitly with Clone
+		ArchetypeRegistry(const ArchetypeRegistry&) = delete;
+		ArchetypeRegistry& operator=(const ArchetypeRegistry&) = delete;
+
+		inline Entity Create() noexcept
+		{
+			return m_EntityManager.Create();
+		}
+
+		inline void Destroy(Entity e) noexcept
+		{
+			if (e < m_Locations.Size())
+				Detach(e);
+			m_EntityManager.Destroy(e);
+		}
+
+		template<typename T>
+		inline void Add(Entity e, const T& comp) noexcept
+		{
+			Emplace<T>(e, comp);
+		}
+
+		// Assigns T in place if e already has one, otherwise moves e's row to the archetype with T added
+		template<typename T, typename... Args>
+		void Emplace(Entity e, Args&&... args) noexcept
+		{
+			Location& location = Locate(e);
+			const Archetype& source = *m_Archetypes[location.archetype];
+			if constexpr (IsTag<T>)
+			{
+				if (source.Has(TypeId<T>))
 					return;
-				}
 
-				if (e.probeDistance < dist)
+				Move(e, Transition(location.archetype, TypeId<T>, nullptr));
+			}
+			else
+			{
+				uint32_t column = source.ColumnIndex(TypeId<T>);
+				if (column != Archetype::NONE)
 				{
-					std::swap(key, e.key);
-					std::swap(value, e.value);
-					std::swap(dist, e.probeDistance);
+					*static_cast<T*>(source.At(location.row, column)) = T(std::forward<Args>(args)...);
+					return;
 				}
 
-				index = (index + 1) % m_Buckets.Size();
-				++dist;
+				// built before the move, args may refer to e's current components
+				T value(std::forward<Args>(args)...);
+				uint32_t target = Transition(location.archetype, TypeId<T>, ColumnType::Of<T>());
+				uint32_t row = Move(e, target);
+				const Archetype& archetype = *m_Archetypes[target];
+				new (archetype.At(row, archetype.ColumnIndex(TypeId<T>))) T(std::move(value));
 			}
 		}
 
-		[[nodiscard]] IComponentPool* Get(std::type_index key) noexcept
+		template<typename T>
+		inline void Insert(const Entity* entities, size_t count, const T& comp = {})
 		{
-			size_t hash = key.hash_code();
-			size_t index = hash % m_Buckets.Size();
-			size_t dist = 0;
+			for (size_t i = 0; i < count; ++i)
+				Emplace<T>(entities[i], comp);
+		}
 
-			while (true)
-			{
-				Entry& e = m_Buckets[index];
-				if (!e.occupied || dist > m_Buckets.Size())
-					return nullptr;
+		template<typename T>
+		void Remove(Entity e) noexcept
+		{
+			if (e >= m_Locations.Size() || !m_Archetypes[m_Locations[e].archetype]->Has(TypeId<T>))
+				return;
 
-				if (e.key == key)
-					return e.value.get();
+			uint32_t target = Transition(m_Locations[e].archetype, TypeId<T>, nullptr);
+			if (target == EMPTY)
+				Detach(e);
+			else
+				Move(e, target);
+		}
 
-				++dist;
-				index = (index + 1) % m_Buckets.Size();
+		template<typename T>
+		inline void Remove(const Entity* entities, size_t count) noexcept
+		{
+			for (size_t i = 0; i < count; ++i)
+				Remove<T>(entities[i]);
+		}
+
+		template<typename T>
+		[[nodiscard]] inline bool Has(Entity e)
+		{
+			return e < m_Locations.Size() && m_Archetypes[m_Locations[e].archetype]->Has(TypeId<T>);
+		}
+
+		template<typename T>
+		inline T& Get(Entity e) noexcept
+		{
+			const Location& location = m_Locations[e];
+			const Archetype& archetype = *m_Archetypes[location.archetype];
+			uint32_t column = archetype.ColumnIndex(TypeId<T>);
+			assert(column != Archetype::NONE && "Entity has no such component");
+			return *static_cast<T*>(archetype.At(location.row, column));
+		}
+
+		template<typename... Components>
+		inline ArchetypeView<Components...> View() noexcept
+		{
+			return ArchetypeView<Components...>(m_Archetypes);
+		}
+
+		// See Registry::SetResource
+		template<typename T, typename... Args>
+		inline T& SetResource(Args&&... args)
+		{
+			return m_Resources.Set<T>(std::forward<Args>(args)...);
+		}
+
+		template<typename T>
+		[[nodiscard]] inline ResourceHandle<T> Resource() noexcept
+		{
+			return ResourceHandle<T>(m_Resources.Find<T>());
+		}
+
+		template<typename T>
+		inline bool RemoveResource()
+		{
+			return m_Resources.Remove<T>();
+		}
+
+		// Number of archetypes created so far, including the empty one
+		[[nodiscard]] inline size_t ArchetypeCount() const noexcept
+		{
+			return m_Archetypes.Size();
+		}
+
+		// Copies entities, archetypes with their rows and the copy constructible resources
+		[[nodiscard]] ArchetypeRegistry Clone() const
+		{
+			ArchetypeRegistry copy;
+			copy.m_EntityManager = m_EntityManager;
+			copy.m_Locations = m_Locations;
+			copy.m_Archetypes.Clear();
+			for (const auto& archetype : m_Archetypes)
+				copy.m_Archetypes.PushBack(archetype->Clone());
+			copy.m_Resources = m_Resources.Clone();
+			return copy;
+		}
+
+	private:
+		static constexpr uint32_t EMPTY = 0;
+
+		struct Location
+		{
+			uint32_t archetype = EMPTY;
+			uint32_t row = 0;
+		};
+
+		inline Location& Locate(Entity e)
+		{
+			if (e >= m_Locations.Size())
+			{
+				size_t newSize = m_Locations.Size() == 0 ? 64 : m_Locations.Size();
+				while (e >= newSize)
+					newSize *= 2;
+				m_Locations.Resize(newSize, Location{});
 			}
+			return m_Locations[e];
 		}
 
-		[[nodiscard]] const IComponentPool* Get(std::type_index key) const noexcept
+		// Archetype with id added to, or removed from, archetype from. column is the added type's column,
+		// nullptr for tags and removals. Cached on both archetypes as an edge once found or created.
+		uint32_t Transition(uint32_t from, uint64_t id, const ColumnType* column)
 		{
-			size_t hash = key.hash_code();
-			size_t index = hash % m_Buckets.Size();
-			size_t dist = 0;
+			bool adding = !m_Archetypes[from]->Has(id);
+			uint32_t cached = m_Archetypes[from]->Edge(id, adding);
+			if (cached != Archetype::NONE)
+				return cached;
+
+			// both lists stay sorted by id, the added one is merged in on the way
+			const Archetype& source = *m_Archetypes[from];
+			DynamicArray<uint64_t> signature(source.Signature().Size() + 1);
+			for (uint64_t existing : source.Signature())
+			{
+				if (adding && id < existing && (signature.Empty() || signature.Back() < id))
+					signature.PushBack(id);
+				if (existing != id)
+					signature.PushBack(existing);
+			}
+			if (adding && (signature.Empty() || signature.Back() < id))
+				signature.PushBack(id);
 
-			while (true)
+			uint32_t target = Find(signature);
+			if (target == Archetype::NONE)
 			{
-				const auto& e = m_Buckets.At(index);
-				if (!e.occupied || dist > m_Buckets.Size())
-					return nullptr;
+				DynamicArray<const ColumnType*> columns(source.Columns().Size() + 1);
+				for (const ColumnType* existing : source.Columns())
+				{
+					if (column && id < existing->id && (columns.Empty() || columns.Back()->id < id))
+						columns.PushBack(column);
+					if (existing->id != id)
+						columns.PushBack(existing);
+				}
+				if (column && (columns.Empty() || columns.Back()->id < id))
+					columns.PushBack(column);
 
-				if (e.key == key)
-					return e.value.get();
+				target = static_cast<uint32_t>(m_Archetypes.Size());
+				m_Archetypes.PushBack(std::make_unique<Archetype>(std::move(signature), std::move(columns)));
+			}
 
-				++dist;
-				index = (index + 1) % m_Buckets.Size();
+			m_Archetypes[from]->SetEdge(id, adding, target);
+			m_Archetypes[target]->SetEdge(id, !adding, from);
+			return target;
+		}
+
+		inline uint32_t Find(const DynamicArray<uint64_t>& signature) const noexcept
+		{
+			for (uint32_t i = 0; i < m_Archetypes.Size(); ++i)
+			{
+				const DynamicArray<uint64_t>& candidate = m_Archetypes[i]->Signature();
+				if (candidate.Size() == signature.Size() && std::equal(candidate.begin(), candidate.end(), signature.begin()))
+					return i;
+			}
+			return Archetype::NONE;
+		}
+
+		// Moves e's row into target, carrying over the components both archetypes hold and destroying
+		// the others. Returns the new row, its columns missing from e's old archetype are unconstructed.
+		uint32_t Move(Entity e, uint32_t target)
+		{
+			Location& location = m_Locations[e];
+			Archetype& to = *m_Archetypes[target];
+			uint32_t row = to.Append(e);
+			if (location.archetype != EMPTY)
+			{
+				Archetype& from = *m_Archetypes[location.archetype];
+				const DynamicArray<const ColumnType*>& columns = from.Columns();
+				for (uint32_t column = 0; column < columns.Size(); ++column)
+				{
+					uint32_t kept = to.ColumnIndex(columns[column]->id);
+					if (kept != Archetype::NONE)
+						columns[column]->relocate(to.At(row, kept), from.At(location.row, column));
+					else
+						columns[column]->destroy(from.At(location.row, column));
+				}
+
+				Entity moved = from.RemoveRow(location.row);
+				if (moved != INVALID_ENTITY)
+					m_Locations[moved].row = location.row;
 			}
+
+			location = Location{ target, row };
+			return row;
+		}
+
+		// Destroys e's components and drops its row
+		inline void Detach(Entity e) noexcept
+		{
+			Location& location = m_Locations[e];
+			if (location.archetype == EMPTY)
+				return;
+
+			Archetype& archetype = *m_Archetypes[location.archetype];
+			archetype.DestroyRow(location.row);
+			Entity moved = archetype.RemoveRow(location.row);
+			if (moved != INVALID_ENTITY)
+				m_Locations[moved].row = location.row;
+			location = Location{};
+		}
+
+		EntityManager m_EntityManager;
+		DynamicArray<Location> m_Locations{ 0 };
+		DynamicArray<std::unique_ptr<Archetype>> m_Archetypes{ 0 };
+		ResourceManager m_Resources;
+	};
+
+} // namespace Composia
+
+// Defining COMPOSIA_ARCHETYPE_STORAGE swaps the backend at compile time, see ArchetypeRegistry
+#if defined(COMPOSIA_ARCHETYPE_STORAGE)
+
+namespace Composia {
+
+	using Registry = ArchetypeRegistry;
+
+} // namespace Composia
+
+#else
+
+
+namespace Composia {
+
+	class Registry
+	{
+	public:
+		Registry() = default;
+		Registry(Registry&&) = default;
+
+		// Copies are made explicitly with Clone or CloneShared
+		Registry(const Registry&) = delete;
+		Registry& operator=(const Registry&) = delete;
+
+		Registry& operator=(Registry&& other) noexcept
+		{
+			// observers disconnect from the pools before those are replaced
+			m_Observers.Clear();
+			m_EntityManager = std::move(other.m_EntityManager);
+			m_ComponentManager = std::move(other.m_ComponentManager);
+			m_Resources = std::move(other.m_Resources);
+			m_Observers = std::move(other.m_Observers);
+			m_CompactingEntities = other.m_CompactingEntities;
+			return *this;
+		}
+
+		inline Entity Create() noexcept
+		{
+			return m_EntityManager.Create();
+		}
+
+		template<typename T>
+		inline void Remove(Entity e) noexcept
+		{
+			m_ComponentManager.Remove<T>(e);
+		}
+
+		template<typename T>
+		inline void Remove(const Entity* entities, size_t count) noexcept
+		{
+			m_ComponentManager.Remove<T>(entities, count);
 		}
 
-		[[nodiscard]] const DynamicArray<Entry>& GetBuckets() const noexcept
+		inline void Destroy(Entity e) noexcept
 		{
-			return m_Buckets;
+			m_ComponentManager.RemoveAllForEntity(e);
+			m_EntityManager.Destroy(e);
 		}
 
-	};
+		template<typename T>
+		inline void Add(Entity e, const T& comp) noexcept
+		{
+			m_ComponentManager.Add<T>(e, comp);
+		}
 
-} // namespace Composia::Core 
+		template<typename T>
+		[[nodiscard]] inline bool Has(Entity e)
+		{
+			return m_ComponentManager.Has<T>(e);
+		}
 
-using Composia::Core::PoolMap;
+		// Hides e from views while keeping its components, e.g. for pooled or out of range objects.
+		// Each pool keeps the components of enabled entities in front of the disabled ones, so views read
+		// that prefix without checking anything per entity. Has, Get and signals are not affected, and
+		// components added to e while it is disabled start out disabled. Costs one swap per component
+		// of e plus a visit of every pool, as Destroy does.
+		inline void Disable(Entity e)
+		{
+			m_ComponentManager.Disable(e);
+		}
 
-namespace Composia {
+		inline void Enable(Entity e)
+		{
+			m_ComponentManager.Enable(e);
+		}
 
-	class ComponentManager
-	{
-	public:
-		template<typename T>
-		inline void Add(Entity e, const T& comp) noexcept
+		[[nodiscard]] inline bool IsEnabled(Entity e) const noexcept
 		{
-			auto* wrapper = GetOrCreatePool<T>();
-			wrapper->pool.Add(e, comp);
+			return m_ComponentManager.IsEnabled(e);
 		}
 
 		template<typename T, typename... Args>
 		inline void Emplace(Entity e, Args&&... args) noexcept
 		{
-			auto* wrapper = GetOrCreatePool<T>();
-			wrapper->pool.Emplace(e, std::forward<Args>(args)...);
+			m_ComponentManager.Emplace<T>(e, std::forward<Args>(args)...);
 		}
 
 		template<typename T>
-		void Remove(Entity e) noexcept
+		inline void Insert(const Entity* entities, size_t count, const T& comp = {})
 		{
-			auto existing = m_Pools.Get(typeid(T));
-			if (existing)
-			{
-				static_cast<ComponentPoolWrapper<T>*>(existing)->pool.Remove(e);
-			}
+			m_ComponentManager.Insert<T>(entities, count, comp);
 		}
 
 		template<typename T>
-		T* Get(Entity e) noexcept
+		inline T& Get(Entity e) noexcept
 		{
-			auto existing = m_Pools.Get(typeid(T));
-			if (!existing)
-			{
-				return nullptr;
-			}
-
-			return static_cast<ComponentPoolWrapper<T>*>(existing)->pool.Get(e);
+			return *m_ComponentManager.Get<T>(e);
 		}
 
+		// Handle to T's pool for hot loops doing random access, e.g. Get on target entities. The pool is
+		// looked up once here instead of on every call. Stays valid while the registry lives, including
+		// across moving it into another one, but not once another registry is assigned to it.
 		template<typename T>
-		bool Has(Entity e) noexcept
+		[[nodiscard]] inline StorageHandle<T> Storage()
 		{
-			auto existing = m_Pools.Get(typeid(T));
-			if (!existing)
-				return false;
-
-			auto wrapper = static_cast<ComponentPoolWrapper<T>*>(existing);
-			return wrapper->Has(e);
+			return m_ComponentManager.Storage<T>();
 		}
 
-		template<typename T>
-		ComponentPool<T>* Pool()
+		template<typename... Components>
+		inline Composia::View<Components...> View() noexcept
 		{
-			auto existing = m_Pools.Get(typeid(T));
-			if (!existing)
-			{
-				return nullptr;
-			}
-
-			return &static_cast<ComponentPoolWrapper<T>*>(existing)->pool;
+			return Composia::View<Components...>(this->m_ComponentManager);
 		}
 
-		void RemoveAllForEntity(Entity entity) noexcept
+		// Reorders T's pool, see ComponentPool::Sort
+		template<typename T, typename Compare>
+		inline void Sort(Compare compare)
 		{
-			for (size_t i = 0; i < m_Pools.GetBuckets().Size(); ++i)
-			{
-				auto& slot = m_Pools.GetBuckets().At(i);
-				if (slot.occupied && slot.value)
-				{
-					slot.value->Remove(entity);
-				}
-			}
+			m_ComponentManager.AssurePool<T>()->Sort(std::move(compare));
 		}
 
-	private:
-		template<typename T>
-		ComponentPoolWrapper<T>* GetOrCreatePool()
+		// Integer key sort of T's pool, see ComponentPool::SortByKey
+		template<typename T, typename KeyFunc>
+		inline void SortByKey(KeyFunc key)
 		{
-			static auto& idx = typeid(T);
-
-			auto existing = m_Pools.Get(idx);
-			if (existing)
-			{
-				return static_cast<ComponentPoolWrapper<T>*>(existing);
-			}
-
-			auto wrapper = std::make_unique<ComponentPoolWrapper<T>>();
-			auto ptr = wrapper.get();
-			m_Pools.Insert(idx, std::move(wrapper));
-
-			return ptr;
+			m_ComponentManager.AssurePool<T>()->SortByKey(std::move(key));
 		}
-	private:
-		PoolMap m_Pools;
-	};
-
-} // namespace Composia 
-
-#include <tuple>
-
-namespace Composia {
-
-	template<typename... Components>
-	class View
-	{
-	public:
-		using PoolsTuple = std::tuple<ComponentPool<Components>*...>;
 
-		View(ComponentManager& manager)
+		// Reorders T's pool to follow U's, see ComponentPool::SortAs
+		template<typename T, typename U>
+		inline void SortAs()
 		{
-			pools = std::make_tuple(manager.Pool<Components>()...);
-			smallestPoolIndex = FindSmallestPoolIndex();
+			m_ComponentManager.AssurePool<T>()->SortAs(*m_ComponentManager.AssurePool<U>());
 		}
 
-		struct Iterator
+		// Stores the registry's single T, e.g. settings, time or an input snapshot, replacing the current
+		// one in place. Resources are held directly instead of on an entity, so no pool is involved.
+		template<typename T, typename... Args>
+		inline T& SetResource(Args&&... args)
 		{
-			using EntityVec = const Core::DynamicArray<Entity>&;
-
-			Iterator(PoolsTuple* pools, size_t idx, size_t smallestPoolIndex)
-				: pools(pools), index(idx), smallestPoolIndex(smallestPoolIndex)
-			{
-				AdvanceToValid();
-			}
-
-			Iterator& operator++() noexcept
-			{
-				++index;
-				AdvanceToValid();
-				return *this;
-			}
-
-			Entity operator*() const noexcept
-			{
-				Entity result{};
-				get_by_index(*pools, smallestPoolIndex, [&](auto* pool) {
-					result = pool->RawEntities()[index];
-					});
-				return result;
-			}
-
-			bool operator!=(const Iterator& other) const noexcept
-			{
-				return index != other.index;
-			}
-
-		private:
-			void AdvanceToValid() noexcept
-			{
-				bool valid = false;
-				while (!valid) {
-					bool out_of_range = false;
-					get_by_index(*pools, smallestPoolIndex, [&](auto* pool) {
-						if (index >= pool->Size()) {
-							out_of_range = true;
-							return;
-						}
-						});
-					if (out_of_range) break;
-
-					Entity e{};
-					get_by_index(*pools, smallestPoolIndex, [&](auto* pool) {
-						e = pool->RawEntities()[index];
-						});
-					if (HasAllComponents(e))
-						valid = true;
-					else
-						++index;
-				}
-			}
-
-			inline bool HasAllComponents(Entity e) const noexcept
-			{
-				bool result = true;
-				ApplyAll([&](auto* pool) {
-					if (!pool->Has(e)) result = false;
-					});
-				return result;
-			}
-
-			template<typename Func>
-			inline void ApplyAll(Func&& func) const noexcept
-			{
-				std::apply([&](auto*... poolPtrs) {
-					(func(poolPtrs), ...);
-					}, *pools);
-			}
+			return m_Resources.Set<T>(std::forward<Args>(args)...);
+		}
 
-			PoolsTuple* pools;
-			size_t index;
-			size_t smallestPoolIndex;
-		};
+		// Handle to the registry's T, empty if none was set. Looking it up scans the few resource ids,
+		// systems that run often keep the handle and pay a single pointer load per access.
+		template<typename T>
+		[[nodiscard]] inline ResourceHandle<T> Resource() noexcept
+		{
+			return ResourceHandle<T>(m_Resources.Find<T>());
+		}
 
-		inline Iterator begin() noexcept
+		// Destroys the registry's T, handles to it dangle afterwards. Returns false if there was none.
+		template<typename T>
+		inline bool RemoveResource()
 		{
-			return Iterator(&pools, 0, smallestPoolIndex);
+			return m_Resources.Remove<T>();
 		}
 
-		inline Iterator end() noexcept
+		// Lifecycle signals of T's pool, see ComponentPool::OnConstruct/OnUpdate/OnDestroy
+		template<typename T>
+		[[nodiscard]] inline Sink<Entity> OnConstruct()
 		{
-			size_t size = 0;
-			get_by_index(pools, smallestPoolIndex, [&](auto* pool)
-				{
-					size = pool->Size();
-				});
-			return Iterator(&pools, size, smallestPoolIndex);
+			return m_ComponentManager.AssurePool<T>()->OnConstruct();
 		}
 
-		template<typename Func>
-		void each(Func&& func) noexcept
+		template<typename T>
+		[[nodiscard]] inline Sink<Entity> OnUpdate()
 		{
-			size_t size = 0;
-			get_by_index(pools, smallestPoolIndex, [&](auto* pool)
-				{
-					size = pool->Size();
-				});
-			auto& smallestPool = std::get<0>(pools);
+			return m_ComponentManager.AssurePool<T>()->OnUpdate();
+		}
 
-			for (size_t i = 0; i < size; ++i)
-			{
-				Entity e{};
-				get_by_index(pools, smallestPoolIndex, [&](auto* pool)
-					{
-						e = pool->RawEntities()[i];
-					});
-				if (!HasAllComponents(e))
-					continue;
+		template<typename T>
+		[[nodiscard]] inline Sink<Entity> OnDestroy()
+		{
+			return m_ComponentManager.AssurePool<T>()->OnDestroy();
+		}
 
-				invokeFunc(e, std::forward<Func>(func));
-			}
+		template<typename T>
+		[[nodiscard]] inline Sink<const Entity*, size_t> OnConstructBatch()
+		{
+			return m_ComponentManager.AssurePool<T>()->OnConstructBatch();
 		}
 
-	private:
-		inline bool HasAllComponents(Entity e) const noexcept
+		template<typename T>
+		[[nodiscard]] inline Sink<const Entity*, size_t> OnDestroyBatch()
 		{
-			bool result = true;
-			std::apply([&](auto*... poolPtrs) {
-				((result = result && poolPtrs->Has(e)), ...);
-				}, pools);
-			return result;
+			return m_ComponentManager.AssurePool<T>()->OnDestroyBatch();
 		}
 
-		template<typename Func, size_t... Is>
-		inline void invokeFuncImpl(Entity e, Func&& func, std::index_sequence<Is...>) noexcept
+		// Registers an observer that lives as long as the registry, e.g. Observe<Damage, Health>(Exclude<Dead>{})
+		template<typename... Components, typename... Excluded>
+		inline Observer<Exclude<Excluded...>, Components...>& Observe(Exclude<Excluded...> = {})
 		{
-			func(*std::get<Is>(pools)->Get(e)...);
+			auto observer = std::make_unique<Observer<Exclude<Excluded...>, Components...>>(m_ComponentManager);
+			auto* ptr = observer.get();
+			m_Observers.PushBack(std::move(observer));
+			return *ptr;
 		}
 
-		template<typename Func>
-		inline void invokeFunc(Entity e, Func&& func) noexcept
+		// Bytes used and reserved per pool and by the entity manager. Walks the pools once without
+		// touching their elements, cheap enough to poll every frame.
+		[[nodiscard]] MemoryReport MemoryStats() const
 		{
-			invokeFuncImpl(e, std::forward<Func>(func), std::index_sequence_for<Components...>{});
+			MemoryReport report;
+			report.entities = m_EntityManager.Memory();
+			m_ComponentManager.Memory(report);
+			return report;
 		}
 
-		size_t FindSmallestPoolIndex() const noexcept
+		// Gives memory back a little at a time, cheap enough to call every frame: arrays using less than half
+		// of their capacity are reallocated smaller and sparse arrays are cut past their pool's highest entity.
+		// With trimIds the dead ids above the highest live entity are dropped as well (they come back with
+		// generation 0). Each call does about budget elements of work, continuing where the last one stopped,
+		// also inside a large pool. A step overshoots budget by at most Core::CompactBudget::COMPACT_STEP;
+		// reallocating an array larger than that is skipped and counted in deferred, summed over the calls
+		// of a pass those are the bytes only a call with a larger budget (a loading screen, say) gives back.
+		CompactResult Compact(size_t budget = std::numeric_limits<size_t>::max(), bool trimIds = false)
 		{
-			size_t smallest = 0;
-			size_t smallestSize = std::numeric_limits<size_t>::max();
+			Core::CompactBudget step{ budget };
+			if (!m_CompactingEntities)
+				m_CompactingEntities = m_ComponentManager.Compact(step);
+			bool swept = m_CompactingEntities && m_EntityManager.Compact(trimIds, step);
+			if (swept)
+				m_CompactingEntities = false;
+
+			CompactResult result;
+			result.released = step.released;
+			result.deferred = step.deferred;
+			result.work = step.work;
+			result.swept = swept;
+			return result;
+		}
 
-			for (size_t i = 0; i < sizeof...(Components); ++i)
+		// Renumbers the live entities to 0..alive-1, so sparse arrays shrink to the live count and entity
+		// indexed data is dense. Entities owning OrderBy get the lowest ids, in OrderBy's pool order, the
+		// others follow in ascending id order. Every pool and observer is rewritten in one pass without
+		// publishing signals. Returns the new id of every old id (INVALID_ENTITY for dead ones) to patch
+		// entity references held outside the registry; delta baselines taken before are invalidated.
+		template<typename OrderBy = void>
+		DynamicArray<Entity> Defragment()
+		{
+			DynamicArray<Entity> first(0);
+			if constexpr (!std::is_void_v<OrderBy>)
 			{
-				bool sizeFetched = false;
-				size_t poolSize = 0;
-
-				get_by_index(pools, i, [&](auto* pool)
-					{
-						poolSize = pool->Size();
-						sizeFetched = true;
-					});
-
-				if (sizeFetched && poolSize < smallestSize)
+				if (auto* pool = m_ComponentManager.Pool<OrderBy>())
 				{
-					smallestSize = poolSize;
-					smallest = i;
+					first.Reserve(pool->Size());
+					pool->Each([&](Entity e) { first.PushBack(e); });
 				}
 			}
-			return smallest;
+
+			DynamicArray<Entity> remap(0);
+			size_t alive = m_EntityManager.Renumber(first.Data(), first.Size(), remap);
+			m_ComponentManager.Remap(remap, alive);
+			for (auto& observer : m_Observers)
+				observer->Remap(remap, alive);
+			return remap;
 		}
 
-		// Helper to get tuple element by runtime index
-		template<size_t I = 0, typename FuncT, typename TupleT>
-		inline static typename std::enable_if<I == std::tuple_size<TupleT>::value, void>::type
-			get_by_index(TupleT&, size_t, FuncT)
+		// Copies entities and components with one bulk copy per array, and the resources. Observers,
+		// listeners and pools or resources that are not copy constructible are not carried over.
+		[[nodiscard]] Registry Clone() const
 		{
-			// out of range, do nothing
+			Registry copy;
+			copy.m_EntityManager = m_EntityManager;
+			copy.m_ComponentManager = m_ComponentManager.Clone();
+			copy.m_Resources = m_Resources.Clone();
+			return copy;
 		}
 
-		template<size_t I = 0, typename FuncT, typename TupleT>
-		inline static typename std::enable_if < I < std::tuple_size<TupleT>::value, void>::type
-			get_by_index(TupleT& t, size_t index, FuncT f)
+		// Like Clone, but pools of trivially copyable components share their arrays with this registry
+		// instead of being copied. The first modification of a pool on either side copies that pool,
+		// so forking a large world only costs the entity copy up front. Get counts as a modification since
+		// it hands out a mutable reference, Has does not. Once one side has copied a pool or was destroyed,
+		// the other keeps the arrays without copying them.
+		[[nodiscard]] Registry CloneShared()
 		{
-			if (I == index)
-				f(std::get<I>(t));
-			else
-				get_by_index<I + 1, FuncT, TupleT>(t, index, f);
+			Registry copy;
+			copy.m_EntityManager = m_EntityManager;
+			copy.m_ComponentManager = m_ComponentManager.Share();
+			copy.m_Resources = m_Resources.Clone();
+			return copy;
 		}
 
-		PoolsTuple pools;
-		size_t smallestPoolIndex = 0;
-	};
+		// Writes entities and every serializable pool to stream, resources are not saved. Returns false if the stream failed.
+		bool Save(std::ostream& stream) const
+		{
+			return Write(stream, 0);
+		}
 
-} // namespace Composia
+		// Writes a world image, a snapshot whose blocks are aligned so LoadImage can use them in place.
+		// The image has to start at the beginning of its file.
+		bool SaveImage(std::ostream& stream) const
+		{
+			return Write(stream, IMAGE_BLOCK_ALIGNMENT);
+		}
 
-namespace Composia {
+		// Replaces the registry content with a snapshot written by Save or SaveImage. Pools are matched by type,
+		// so the component types stored in the snapshot must be listed unless their pool already exists.
+		// Returns false and keeps the current content if the snapshot can't be read.
+		template<typename... Components>
+		bool Load(std::istream& stream)
+		{
+			InputArchive archive(stream);
+			return Read<Components...>(archive);
+		}
 
-	class Registry
-	{
-	public:
-		inline Entity Create() noexcept
+		// Maps a world image privately and builds pools on top of its pages instead of copying them, so
+		// components are only read from disk when touched and the first write to a page copies it.
+		// Sections that can't be used in place are copied, as is the whole file when it can't be mapped.
+		template<typename... Components>
+		bool LoadImage(const char* path)
 		{
-			return m_EntityManager.Create();
+			if (auto file = Core::MappedFile::Open(path))
+			{
+				InputArchive archive(file->Data(), file->Size(), file);
+				return Read<Components...>(archive);
+			}
+
+			std::ifstream stream(path, std::ios::binary);
+			return stream && Load<Components...>(stream);
 		}
 
-		template<typename T>
-		inline void Remove(Entity e) noexcept
+		// Captures the world as the baseline Diff compares against
+		void Capture(DeltaBaseline& baseline) const
 		{
-			m_ComponentManager.Remove<T>(e);
+			m_EntityManager.Capture(baseline.entities);
+			m_ComponentManager.Capture(baseline.pools);
 		}
 
-		inline void Destroy(Entity e) noexcept
+		// Entity and component changes since baseline. Only pools of tags and trivially copyable
+		// components are tracked. baseline.Advance(delta) makes the result the next baseline.
+		[[nodiscard]] Delta Diff(const DeltaBaseline& baseline) const
 		{
-			m_ComponentManager.RemoveAllForEntity(e);
-			m_EntityManager.Destroy(e);
+			Delta delta;
+			m_EntityManager.Diff(baseline.entities, delta.entities);
+			m_ComponentManager.Diff(baseline, delta.pools);
+			return delta;
 		}
 
-		template<typename T>
-		inline void Add(Entity e, const T& comp) noexcept
+		// Moves the world from the state a delta was computed against to the state it was computed from.
+		// As with Load, component types that have no pool yet must be listed.
+		template<typename... Components>
+		bool Apply(const Delta& delta)
 		{
-			m_ComponentManager.Add<T>(e, comp);
+			(m_ComponentManager.AssurePool<Components>(), ...);
+			return ApplyDelta(delta, false);
 		}
 
-		template<typename T>
-		[[nodiscard]] inline bool Has(Entity e)
+		// Undoes a delta, moving the world back to its baseline state
+		template<typename... Components>
+		bool Revert(const Delta& delta)
 		{
-			return m_ComponentManager.Has<T>(e);
+			(m_ComponentManager.AssurePool<Components>(), ...);
+			return ApplyDelta(delta, true);
 		}
 
-		template<typename T, typename... Args>
-		inline void Emplace(Entity e, Args&&... args) noexcept
+	private:
+		static constexpr uint32_t SNAPSHOT_MAGIC = 0x53504D43; // "CMPS"
+		static constexpr uint32_t SNAPSHOT_VERSION = 4;
+		static constexpr uint32_t IMAGE_BLOCK_ALIGNMENT = 64;
+
+		bool Write(std::ostream& stream, uint32_t blockAlignment) const
 		{
-			m_ComponentManager.Emplace<T>(e, std::forward<Args>(args)...);
+			OutputArchive archive(&stream, blockAlignment);
+			archive.Write(SNAPSHOT_MAGIC);
+			archive.Write(SNAPSHOT_VERSION);
+			archive.Write(blockAlignment);
+			m_EntityManager.Save(archive);
+			m_ComponentManager.Save(archive);
+			return archive.Good();
 		}
 
-		template<typename T>
-		inline T& Get(Entity e) noexcept
+		bool ApplyDelta(const Delta& delta, bool revert)
 		{
-			return *m_ComponentManager.Get<T>(e);
+			if (!m_EntityManager.Accepts(delta.entities, revert) || !m_ComponentManager.Apply(delta.pools, revert))
+				return false;
+
+			m_EntityManager.Apply(delta.entities, revert);
+			m_ComponentManager.DropDisabled([&](Entity e) { return !m_EntityManager.IsAlive(e); });
+			return true;
 		}
 
 		template<typename... Components>
-		inline Composia::View<Components...> View() noexcept
+		bool Read(InputArchive& archive)
 		{
-			return Composia::View<Components...>(this->m_ComponentManager);
+			uint32_t magic = 0;
+			uint32_t version = 0;
+			uint32_t blockAlignment = 0;
+			if (!archive.Read(magic) || magic != SNAPSHOT_MAGIC)
+				return false;
+			if (!archive.Read(version) || version != SNAPSHOT_VERSION)
+				return false;
+			if (!archive.Read(blockAlignment))
+				return false;
+
+			archive.BlockAlignment(blockAlignment);
+			(m_ComponentManager.AssurePool<Components>(), ...);
+
+			// entities are read aside and the pools only replaced once their sections all loaded,
+			// so a truncated or corrupt snapshot leaves the registry as it was
+			EntityManager entities;
+			if (!entities.Load(archive) || !m_ComponentManager.Load(archive))
+				return false;
+			m_EntityManager = std::move(entities);
+			return true;
 		}
 
-	private:
 		EntityManager m_EntityManager;
 		ComponentManager m_ComponentManager;
+		ResourceManager m_Resources;
+		DynamicArray<std::unique_ptr<IObserver>> m_Observers{ 0 };
+		bool m_CompactingEntities = false; // Compact is past the pools, on to the entity ids
 	};
 
 } // namespace Composia 
 
+#endif // COMPOSIA_ARCHETYPE_STORAGE
+
 #endif // !COMPOSIA_H